@@ -22,173 +22,43 @@ Implements the program startup code
 
 */
 
-#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <lw_alloc.h>
+
 #include "lwar.h"
 
 void do_add(void)
 {
-	FILE *f;
-	unsigned char buf[8];
+	archive_t *ar, *ar2;
+	unsigned char *data;
 	long l;
-	int c;
-	FILE *f2;
-	int i;
-	
-	f = fopen(archive_file, "rb+");
-	if (!f)
-	{
-		if (errno == ENOENT)
-		{
-			f = fopen(archive_file, "wb");
-			if (f)
-			{
-				fputs("LWAR1V", f);
-				goto doadd;
-			}
-		}
-		perror("Cannot open archive file");
-	}
+	int i, j;
 	
-	(void)(fread(buf, 1, 6, f) && 1);
-	if (memcmp("LWAR1V", buf, 6))
-	{
-		fprintf(stderr, "%s is not a valid archive file.\n", archive_file);
-		exit(1);
-	}
+	ar = archive_open(archive_file, 1, 1);
 
-	for (;;)
-	{
-		c = fgetc(f);
-		if (c == EOF && ferror(f))
-		{
-			perror("Reading archive file");
-			exit(1);
-		}
-		if (c == EOF)
-			goto doadd;
-		
-		if (!c)
-		{
-			fseek(f, -1, SEEK_CUR);
-			goto doadd;
-		}
-		
-		// find the end of the file name
-		while (c)
-		{
-			c = fgetc(f);
-			if (c == EOF || ferror(f))
-			{
-				fprintf(stderr, "Bad archive file\n");
-				exit(1);
-			}
-		}
-		
-		// get length of archive member
-		l = 0;
-		c = fgetc(f);
-		l = c << 24;
-		c = fgetc(f);
-		l |= c << 16;
-		c = fgetc(f);
-		l |= c << 8;
-		c = fgetc(f);
-		l |= c;
-		
-		fseek(f, l, SEEK_CUR);
-	}
-	// back up to the NUL byte at the end of the file
-	fseek(f, -1, SEEK_CUR);
-doadd:
 	for (i = 0; i < nfiles; i++)
 	{
-		f2 = fopen(files[i], "rb");
-		if (!f2)
-		{
-			fprintf(stderr, "Cannot open file %s:", files[i]);
-			perror("");
-			exit(1);
-		}
-		(void)(fread(buf, 1, 6, f2) && 1);
-		if (mergeflag && !memcmp("LWAR1V", buf, 6))
+		data = read_whole_file(files[i], &l);
+		if (mergeflag && is_archive(data, l))
 		{
 			// add archive contents...
-			for (;;)
+			lw_free(data);
+			ar2 = archive_open(files[i], 0, 0);
+			for (j = 0; j < ar2 -> nmembers; j++)
 			{
-				c = fgetc(f2);
-				if (c == EOF || ferror(f2))
-				{
-					perror("Reading input archive file");
-					exit(1);
-				}
-				if (c == EOF)
-					break;
-		
-				if (!c)
-				{
-					break;
-				}
-		
-				// find the end of the file name
-				while (c)
-				{
-					fputc(c, f);
-					c = fgetc(f2);
-					if (c == EOF || ferror(f))
-					{
-						fprintf(stderr, "Bad input archive file\n");
-						exit(1);
-					}
-				}
-				fputc(0, f);
-				
-				// get length of archive member
-				l = 0;
-				c = fgetc(f2);
-				fputc(c, f);
-				l = c << 24;
-				c = fgetc(f2);
-				fputc(c, f);
-				l |= c << 16;
-				c = fgetc(f2);
-				fputc(c, f);
-				l |= c << 8;
-				c = fgetc(f2);
-				fputc(c, f);
-				l |= c;
-		
-				while (l)
-				{
-					c = fgetc(f2);
-					fputc(c, f);
-					l--;
-				}
+				data = archive_read_member(ar2, j);
+				archive_add(ar, ar2 -> members[j].name, data, ar2 -> members[j].size);
+				lw_free(data);
 			}
-			
-			fclose(f2);
+			archive_close(ar2);
 			continue;
 		}
-		fseek(f2, 0, SEEK_END);
-		l = ftell(f2);
-		fseek(f2, 0, SEEK_SET);
-		fputs(get_file_name(files[i]), f);
-		fputc(0, f);
-		fputc(l >> 24, f);
-		fputc((l >> 16) & 0xff, f);
-		fputc((l >> 8) & 0xff, f);
-		fputc(l & 0xff, f);
-		while (l)
-		{
-			c = fgetc(f2);
-			fputc(c, f);
-			l--;
-		}
+		archive_add(ar, get_file_name(files[i]), data, l);
+		lw_free(data);
 	}
 	
-	// flag end of file
-	fputc(0, f);	
+	archive_close(ar);
 }
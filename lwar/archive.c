@@ -0,0 +1,585 @@
+/*
+archive.c
+Copyright © 2026 William Astle
+
+This file is part of LWAR.
+
+LWAR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+Archive file access
+
+Two archive formats are understood. The original LWAR1V format is the magic
+number followed by a series of members, each of which is a NUL terminated
+file name, a 32 bit big endian length, and the member data. An empty file
+name marks the end of the archive. Finding anything in it means reading
+through the whole file.
+
+The LWAR2V format keeps a directory of the members so that they can be
+found, replaced, and removed without touching the rest of the archive:
+
+0	"LWAR2V" followed by two NULs
+8	32 bit offset of the member directory
+12	32 bit number of members in the directory
+16	member data; each member starts on a 16 byte boundary
+
+The directory follows the member data and has one entry per member:
+
+	NUL terminated member name
+	32 bit offset of the member data
+	32 bit member size
+	32 bit reserved; lwar writes the member size rounded up to a
+	multiple of 16 and ignores it when reading
+	64 bit hash of the member data
+
+All numbers are big endian.
+
+An LWAR2V archive is never overwritten where it is in use. New and replaced
+members, and then the new directory, are written after the end of the
+file, and the header is rewritten last to point at the new directory. If
+lwar is interrupted or fails before that, the old header still describes
+the old archive, all of which is intact. A replaced member keeps its place
+in the directory, so the order in which lwlink searches the members does
+not change.
+
+Removed and replaced members, and old directories, leave unused space
+behind. When more than half of the archive would be unused, it is rewritten
+to a temporary file without the unused space, which is then renamed over
+the archive.
+
+New archives are always written in LWAR2V format. An LWAR1V archive is
+converted the first time it is modified.
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lw_alloc.h>
+#include <lw_string.h>
+
+#ifdef _MSC_VER
+#include <lw_win.h>	// windows build
+#else
+#include <unistd.h>
+#endif
+#if !defined(WIN32) && !defined(WIN64)
+#include <sys/mman.h>
+#endif
+
+#define __archive_c_seen__
+#include "lwar.h"
+
+#define AR_HEADER_SIZE		16
+#define AR_ALIGN(l)			(((l) + 15) & ~15L)
+
+unsigned long long archive_hash(unsigned char *data, long size)
+{
+	unsigned long long h = 0xcbf29ce484222325ULL;
+
+	while (size-- > 0)
+	{
+		h ^= *data++;
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+static unsigned long get32(unsigned char *p)
+{
+	return ((unsigned long)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void put32(unsigned char *p, unsigned long v)
+{
+	p[0] = (v >> 24) & 0xff;
+	p[1] = (v >> 16) & 0xff;
+	p[2] = (v >> 8) & 0xff;
+	p[3] = v & 0xff;
+}
+
+// read an entire file into memory
+unsigned char *read_whole_file(char *fn, long *size)
+{
+	FILE *f;
+	unsigned char *buf;
+
+	f = fopen(fn, "rb");
+	if (!f)
+	{
+		fprintf(stderr, "Cannot open file %s:", fn);
+		perror("");
+		exit(1);
+	}
+	fseek(f, 0, SEEK_END);
+	*size = ftell(f);
+	rewind(f);
+	buf = lw_alloc(*size + 1);
+	if (fread(buf, 1, *size, f) < (size_t)*size)
+	{
+		fprintf(stderr, "Short read on file %s:", fn);
+		perror("");
+		exit(1);
+	}
+	fclose(f);
+	return buf;
+}
+
+static void ar_error(archive_t *ar, char *msg)
+{
+	fprintf(stderr, "%s: %s\n", ar -> filename, msg);
+	exit(1);
+}
+
+static void add_member_entry(archive_t *ar, char *name, long offset, long size, long space, unsigned long long hash)
+{
+	armember_t *m;
+
+	ar -> members = lw_realloc(ar -> members, sizeof(armember_t) * (ar -> nmembers + 1));
+	m = &(ar -> members[ar -> nmembers++]);
+	m -> name = lw_strdup(name);
+	m -> offset = offset;
+	m -> size = size;
+	m -> space = space;
+	m -> hash = hash;
+	m -> hashed = 1;
+}
+
+// read the member list of an LWAR1V archive in one pass over the headers
+static void read_directory_v1(archive_t *ar)
+{
+	char name[1024];
+	unsigned char lb[4];
+	long pos = 6, l;
+	int c, i;
+
+	fseek(ar -> f, pos, SEEK_SET);
+	for (;;)
+	{
+		c = fgetc(ar -> f);
+		if (c == EOF || c == 0)
+			break;
+		for (i = 0; c && c != EOF; c = fgetc(ar -> f))
+		{
+			if (i < (int)sizeof(name) - 1)
+				name[i++] = c;
+		}
+		name[i] = 0;
+		if (c == EOF || fread(lb, 1, 4, ar -> f) < 4)
+			ar_error(ar, "bad archive file");
+		l = get32(lb);
+		pos = ftell(ar -> f);
+		add_member_entry(ar, name, pos, l, l, 0);
+		ar -> members[ar -> nmembers - 1].hashed = 0;
+		if (fseek(ar -> f, l, SEEK_CUR) < 0)
+			ar_error(ar, "bad archive file");
+	}
+	ar -> dataend = ftell(ar -> f);
+}
+
+static void read_directory_v2(archive_t *ar, unsigned char *hdr)
+{
+	long diroff, dirsize, n, i;
+	unsigned char *dir, *p, *e;
+
+	diroff = get32(hdr + 8);
+	n = get32(hdr + 12);
+	fseek(ar -> f, 0, SEEK_END);
+	dirsize = ftell(ar -> f) - diroff;
+	if (diroff < AR_HEADER_SIZE || dirsize < 0)
+		ar_error(ar, "bad archive directory");
+
+	dir = lw_alloc(dirsize + 1);
+	fseek(ar -> f, diroff, SEEK_SET);
+	if (fread(dir, 1, dirsize, ar -> f) < (size_t)dirsize)
+		ar_error(ar, "bad archive directory");
+	dir[dirsize] = 0;
+
+	p = dir;
+	e = dir + dirsize;
+	for (i = 0; i < n; i++)
+	{
+		char *name = (char *)p;
+		unsigned long long h;
+
+		while (p < e && *p)
+			p++;
+		if (p + 21 > e)
+			ar_error(ar, "bad archive directory");
+		p++;
+		h = ((unsigned long long)get32(p + 12) << 32) | get32(p + 16);
+		add_member_entry(ar, name, get32(p), get32(p + 4), get32(p + 8), h);
+		if (ar -> members[i].offset + ar -> members[i].size > diroff)
+			ar_error(ar, "bad archive directory");
+		p += 20;
+	}
+	lw_free(dir);
+	// anything new goes after the current directory
+	ar -> dataend = diroff + dirsize;
+}
+
+/*
+Open an archive. If "create" is set, a missing archive is created. If
+"writable" is set, the archive is opened for update and converted to the
+current format if needed.
+*/
+archive_t *archive_open(char *fn, int writable, int create)
+{
+	archive_t *ar;
+	unsigned char hdr[AR_HEADER_SIZE];
+
+	ar = lw_alloc(sizeof(archive_t));
+	memset(ar, 0, sizeof(archive_t));
+	ar -> filename = lw_strdup(fn);
+	ar -> writable = writable;
+
+	ar -> f = fopen(fn, writable ? "rb+" : "rb");
+	if (!ar -> f)
+	{
+		if (errno != ENOENT || !create)
+		{
+			fprintf(stderr, "Cannot open archive file %s: %s\n", fn, strerror(errno));
+			exit(1);
+		}
+		ar -> f = fopen(fn, "wb+");
+		if (!ar -> f)
+		{
+			fprintf(stderr, "Cannot create archive file %s: %s\n", fn, strerror(errno));
+			exit(1);
+		}
+		ar -> version = 2;
+		ar -> dataend = AR_HEADER_SIZE;
+		ar -> dirty = 1;
+		return ar;
+	}
+
+	memset(hdr, 0, sizeof(hdr));
+	if (fread(hdr, 1, AR_HEADER_SIZE, ar -> f) < 6)
+		memset(hdr, 0, sizeof(hdr));
+
+	if (!memcmp(hdr, "LWAR2V", 6))
+	{
+		ar -> version = 2;
+		read_directory_v2(ar, hdr);
+	}
+	else if (!memcmp(hdr, "LWAR1V", 6))
+	{
+		ar -> version = 1;
+		read_directory_v1(ar);
+		if (writable)
+			archive_convert(ar);
+	}
+	else
+	{
+		fprintf(stderr, "%s is not a valid archive file.\n", fn);
+		exit(1);
+	}
+	return ar;
+}
+
+// return the index of the named member or -1 if it is not there
+int archive_find(archive_t *ar, char *name)
+{
+	int i;
+
+	for (i = 0; i < ar -> nmembers; i++)
+	{
+		if (!strcmp(get_file_name(ar -> members[i].name), name))
+			return i;
+	}
+	return -1;
+}
+
+// read the contents of a member into memory
+unsigned char *archive_read_member(archive_t *ar, int mn)
+{
+	unsigned char *buf;
+	armember_t *m = &(ar -> members[mn]);
+
+	buf = lw_alloc(m -> size + 1);
+	fseek(ar -> f, m -> offset, SEEK_SET);
+	if (fread(buf, 1, m -> size, ar -> f) < (size_t)(m -> size))
+		ar_error(ar, "short read on archive member");
+	if (!m -> hashed)
+	{
+		m -> hash = archive_hash(buf, m -> size);
+		m -> hashed = 1;
+	}
+	return buf;
+}
+
+static void write_at(archive_t *ar, long offset, unsigned char *data, long size)
+{
+	fseek(ar -> f, offset, SEEK_SET);
+	if (size > 0 && fwrite(data, 1, size, ar -> f) < (size_t)size)
+		ar_error(ar, "cannot write archive");
+}
+
+// write member data after everything else in the archive; returns its offset
+static long append_data(archive_t *ar, unsigned char *data, long size)
+{
+	long offset;
+
+	offset = AR_ALIGN(ar -> dataend);
+	write_at(ar, offset, data, size);
+	ar -> dataend = offset + size;
+	return offset;
+}
+
+// add a member at the end of the archive
+void archive_add(archive_t *ar, char *name, unsigned char *data, long size)
+{
+	long offset;
+
+	offset = append_data(ar, data, size);
+	add_member_entry(ar, name, offset, size, AR_ALIGN(size), archive_hash(data, size));
+	ar -> dirty = 1;
+	if (debug_level)
+		fprintf(stderr, "Added %s at %06lx (%ld bytes)\n", name, offset, size);
+}
+
+/*
+Replace a member with new contents. Unchanged members are left alone.
+Otherwise the new contents are written at the end of the archive and the
+member's directory entry is pointed at them, so the member keeps its place
+in the directory. Returns 1 if the archive changed.
+*/
+int archive_replace(archive_t *ar, int mn, unsigned char *data, long size)
+{
+	armember_t *m = &(ar -> members[mn]);
+	unsigned long long h;
+
+	h = archive_hash(data, size);
+	if (m -> hashed && m -> hash == h && m -> size == size)
+	{
+		if (debug_level)
+			fprintf(stderr, "Skipping unchanged %s\n", m -> name);
+		return 0;
+	}
+	m -> offset = append_data(ar, data, size);
+	m -> size = size;
+	m -> space = AR_ALIGN(size);
+	m -> hash = h;
+	m -> hashed = 1;
+	ar -> dirty = 1;
+	if (debug_level)
+		fprintf(stderr, "Replaced %s at %06lx (%ld bytes)\n", m -> name, m -> offset, size);
+	return 1;
+}
+
+// remove a member from the directory; its space is left unused
+void archive_remove(archive_t *ar, int mn)
+{
+	lw_free(ar -> members[mn].name);
+	memmove(ar -> members + mn, ar -> members + mn + 1, sizeof(armember_t) * (ar -> nmembers - mn - 1));
+	ar -> nmembers--;
+	ar -> dirty = 1;
+}
+
+// write the header and directory of an LWAR2V archive
+static void write_directory(archive_t *ar)
+{
+	unsigned char hdr[AR_HEADER_SIZE];
+	unsigned char *dir;
+	long dirsize = 0, p = 0, diroff;
+	int i;
+
+	for (i = 0; i < ar -> nmembers; i++)
+		dirsize += strlen(ar -> members[i].name) + 21;
+
+	dir = lw_alloc(dirsize + 1);
+	for (i = 0; i < ar -> nmembers; i++)
+	{
+		armember_t *m = &(ar -> members[i]);
+
+		strcpy((char *)dir + p, m -> name);
+		p += strlen(m -> name) + 1;
+		put32(dir + p, m -> offset);
+		put32(dir + p + 4, m -> size);
+		put32(dir + p + 8, m -> space);
+		put32(dir + p + 12, (unsigned long)(m -> hash >> 32));
+		put32(dir + p + 16, (unsigned long)(m -> hash & 0xffffffff));
+		p += 20;
+	}
+
+	diroff = AR_ALIGN(ar -> dataend);
+	write_at(ar, diroff, dir, dirsize);
+	lw_free(dir);
+	ar -> dataend = diroff + dirsize;
+
+	// everything the new header refers to must be on disk before it is
+	if (fflush(ar -> f) != 0)
+		ar_error(ar, "cannot write archive");
+#if !defined(WIN32) && !defined(WIN64)
+	fsync(fileno(ar -> f));
+#endif
+
+	memset(hdr, 0, sizeof(hdr));
+	memcpy(hdr, "LWAR2V", 6);
+	put32(hdr + 8, diroff);
+	put32(hdr + 12, ar -> nmembers);
+	write_at(ar, 0, hdr, AR_HEADER_SIZE);
+	if (fflush(ar -> f) != 0)
+		ar_error(ar, "cannot write archive");
+}
+
+/*
+Rewrite the archive to a temporary file in the current format, with no
+unused space, and rename it over the original. This is how an LWAR1V
+archive is converted and how unused space is reclaimed. The members are
+read from the open archive, so anything added or replaced since it was
+opened is included.
+*/
+void archive_convert(archive_t *ar)
+{
+	archive_t *nar;
+	unsigned char *data;
+	char *tfn;
+	int i;
+
+	tfn = lw_alloc(strlen(ar -> filename) + 5);
+	sprintf(tfn, "%s.tmp", ar -> filename);
+	unlink(tfn);
+	nar = archive_open(tfn, 1, 1);
+	for (i = 0; i < ar -> nmembers; i++)
+	{
+		data = archive_read_member(ar, i);
+		archive_add(nar, ar -> members[i].name, data, ar -> members[i].size);
+		lw_free(data);
+	}
+	write_directory(nar);
+	fclose(nar -> f);
+	nar -> f = NULL;
+	fclose(ar -> f);
+	if (rename(tfn, ar -> filename) < 0)
+	{
+		perror("Cannot replace old archive file");
+		unlink(tfn);
+		exit(1);
+	}
+	lw_free(tfn);
+
+	ar -> f = fopen(ar -> filename, "rb+");
+	if (!ar -> f)
+	{
+		perror("Cannot reopen archive file");
+		exit(1);
+	}
+	for (i = 0; i < ar -> nmembers; i++)
+		lw_free(ar -> members[i].name);
+	lw_free(ar -> members);
+	ar -> members = nar -> members;
+	ar -> nmembers = nar -> nmembers;
+	ar -> dataend = nar -> dataend;
+	ar -> version = 2;
+	ar -> dirty = 0;
+	lw_free(nar -> filename);
+	lw_free(nar);
+}
+
+/*
+Return a view of the whole archive file in memory so members can be used
+without copying them. Where the system can map files, the archive is mapped
+read only; otherwise the file is read in one go. The view remains valid
+until the archive is closed.
+*/
+unsigned char *archive_map(archive_t *ar)
+{
+	long size;
+
+	if (ar -> map)
+		return ar -> map;
+
+	fflush(ar -> f);
+	fseek(ar -> f, 0, SEEK_END);
+	size = ftell(ar -> f);
+	if (size <= 0)
+		ar_error(ar, "bad archive file");
+	ar -> mapsize = size;
+
+#if !defined(WIN32) && !defined(WIN64)
+	ar -> map = mmap(NULL, size, PROT_READ, MAP_SHARED, fileno(ar -> f), 0);
+	if (ar -> map != MAP_FAILED)
+	{
+		ar -> mapped = 1;
+		return ar -> map;
+	}
+	ar -> map = NULL;
+#endif
+
+	ar -> map = lw_alloc(size);
+	rewind(ar -> f);
+	if (fread(ar -> map, 1, size, ar -> f) < (size_t)size)
+		ar_error(ar, "short read on archive file");
+	return ar -> map;
+}
+
+static void archive_unmap(archive_t *ar)
+{
+	if (!ar -> map)
+		return;
+#if !defined(WIN32) && !defined(WIN64)
+	if (ar -> mapped)
+		munmap(ar -> map, ar -> mapsize);
+	else
+#endif
+		lw_free(ar -> map);
+	ar -> map = NULL;
+	ar -> mapped = 0;
+}
+
+// is more than half of the archive unused?
+static int archive_wasteful(archive_t *ar)
+{
+	long used = AR_HEADER_SIZE;
+	int i;
+
+	for (i = 0; i < ar -> nmembers; i++)
+		used += AR_ALIGN(ar -> members[i].size) + strlen(ar -> members[i].name) + 21;
+	return ar -> dataend > 2 * used;
+}
+
+// close the archive, writing the directory if anything changed
+void archive_close(archive_t *ar)
+{
+	int i;
+
+	archive_unmap(ar);
+	if (ar -> writable && ar -> dirty)
+	{
+		write_directory(ar);
+		if (archive_wasteful(ar))
+		{
+			if (debug_level)
+				fprintf(stderr, "Reclaiming unused space in %s\n", ar -> filename);
+			archive_convert(ar);
+		}
+	}
+	if (ar -> f)
+		fclose(ar -> f);
+	for (i = 0; i < ar -> nmembers; i++)
+		lw_free(ar -> members[i].name);
+	lw_free(ar -> members);
+	lw_free(ar -> filename);
+	lw_free(ar);
+}
+
+// is this data an archive in a format we understand?
+int is_archive(unsigned char *data, long size)
+{
+	if (size < 6)
+		return 0;
+	return !memcmp(data, "LWAR1V", 6) || !memcmp(data, "LWAR2V", 6);
+}
@@ -17,107 +17,270 @@ more details.
 You should have received a copy of the GNU General Public License along with
 this program. If not, see <http://www.gnu.org/licenses/>.
 
+Member extraction
+
+The archive is mapped (or read) once and each member is written out with a
+single bulk copy straight from that view. The set of members to extract is
+worked out up front with one pass over the directory, so extracting a few
+named members from a large archive does not compare every member against
+every name. With --jobs, the members are written by several threads.
 */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE	// for copy_file_range()
+#endif
+
 #include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <lw_alloc.h>
+
+#ifdef _MSC_VER
+#include <lw_win.h>	// windows build
+#define NO_THREADS
+#else
+#include <unistd.h>
+#endif
+
+#ifndef NO_THREADS
+#include <pthread.h>
+#endif
+
+#if defined(__linux__) && defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#define HAVE_COPY_FILE_RANGE
+#endif
 
 #include "lwar.h"
 
-void do_extract(void)
+static archive_t *ar;
+static unsigned char *arview;
+static int *extract_list;
+static int nextract;
+
+#ifndef NO_THREADS
+static pthread_mutex_t extract_lock = PTHREAD_MUTEX_INITIALIZER;
+static int extract_next;
+#endif
+
+static void extract_error(char *fn)
 {
-	FILE *f;
-	char buf[8];
-	char *filename;
-	long l;
-	int c;
-	char fnbuf[1024];
-	int i;
-	FILE *nf;
-	
-	f = fopen(archive_file, "rb");
-	if (!f)
+	fprintf(stderr, "Cannot extract '%s': %s\n", fn, strerror(errno));
+	exit(1);
+}
+
+// write one member out with as few system calls as possible
+static void extract_member(int mn)
+{
+	armember_t *m = &(ar -> members[mn]);
+	char *filename = get_file_name(m -> name);
+
+	if (debug_level)
+		fprintf(stderr, "Extracting %s (%ld bytes)\n", filename, m -> size);
+
+#if defined(WIN32) || defined(WIN64)
 	{
-		perror("Opening archive file");
-		exit(1);
+		FILE *nf;
+
+		nf = fopen(filename, "wb");
+		if (!nf)
+			extract_error(filename);
+		if (fwrite(arview + m -> offset, 1, m -> size, nf) < (size_t)(m -> size))
+			extract_error(filename);
+		if (fclose(nf) != 0)
+			extract_error(filename);
 	}
-	
-	(void)(fread(buf, 1, 6, f) && 1);
-	if (memcmp("LWAR1V", buf, 6))
+#else
 	{
-		fprintf(stderr, "%s is not a valid archive file.\n", archive_file);
-		exit(1);
-	}
+		unsigned char *p = arview + m -> offset;
+		long left = m -> size;
+		ssize_t l;
+		int fd;
 
-	for (;;)
-	{
-		c = fgetc(f);
-		if (ferror(f))
+		fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		if (fd < 0)
+			extract_error(filename);
+#ifdef HAVE_COPY_FILE_RANGE
 		{
-			perror("Reading archive file");
-			exit(1);
-		}
-		if (c == EOF)
-			return;
-		
-		
-		// find the end of the file name
-		if (!c)
-			return;
-		
-		i = 0;
-		while (c)
-		{
-			fnbuf[i++] = c;
-			c = fgetc(f);
-			if (c == EOF || ferror(f))
+			// let the kernel do the copy; fall back to writing from the view
+			// if the file systems involved do not support it
+			loff_t off = m -> offset;
+
+			while (left > 0)
 			{
-				fprintf(stderr, "Bad archive file\n");
-				exit(1);
+				l = copy_file_range(fileno(ar -> f), &off, fd, NULL, left, 0);
+				if (l <= 0)
+					break;
+				left -= l;
 			}
+			p += m -> size - left;
 		}
-		fnbuf[i] = 0;
-		filename = get_file_name(fnbuf);
-		
-		// get length of archive member
-		l = 0;
-		c = fgetc(f);
-		l = c << 24;
-		c = fgetc(f);
-		l |= c << 16;
-		c = fgetc(f);
-		l |= c << 8;
-		c = fgetc(f);
-		l |= c;
-		
-		for (i = 0; i < nfiles; i++)
+#endif
+		while (left > 0)
 		{
-			if (!strcmp(get_file_name(files[i]), filename))
-				break;
+			l = write(fd, p, left);
+			if (l < 0 && errno == EINTR)
+				continue;
+			if (l <= 0)
+				extract_error(filename);
+			p += l;
+			left -= l;
 		}
-		if (i < nfiles || nfiles == 0)
+		if (close(fd) < 0)
+			extract_error(filename);
+	}
+#endif
+}
+
+#ifndef NO_THREADS
+static void *extract_worker(void *arg)
+{
+	int i;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&extract_lock);
+		i = extract_next++;
+		pthread_mutex_unlock(&extract_lock);
+		if (i >= nextract)
+			break;
+		extract_member(extract_list[i]);
+	}
+	return NULL;
+}
+#endif
+
+static unsigned long name_hash(char *s)
+{
+	unsigned long h = 5381;
+
+	while (*s)
+		h = h * 33 + (unsigned char)*s++;
+	return h;
+}
+
+/*
+Work out which members to extract. When the same file name appears more
+than once in the archive, only the last one is extracted since that is
+the one that would be left behind after extracting them all in order.
+*/
+static void select_members(void)
+{
+	int *table, *chain, *want;
+	int tsize, mn, i;
+	unsigned long h;
+
+	for (tsize = 64; tsize < ar -> nmembers * 2; tsize *= 2)
+		/* do nothing */ ;
+	table = lw_alloc(sizeof(int) * tsize);
+	chain = lw_alloc(sizeof(int) * (ar -> nmembers + 1));
+	want = lw_alloc(sizeof(int) * (ar -> nmembers + 1));
+	for (i = 0; i < tsize; i++)
+		table[i] = -1;
+
+	// later members go on the front of the chain so they are found first
+	for (mn = 0; mn < ar -> nmembers; mn++)
+	{
+		h = name_hash(get_file_name(ar -> members[mn].name)) & (tsize - 1);
+		chain[mn] = table[h];
+		table[h] = mn;
+		want[mn] = 0;
+	}
+
+	if (nfiles == 0)
+	{
+		for (mn = 0; mn < ar -> nmembers; mn++)
 		{
-			// extract the file
-			nf = fopen(filename, "wb");
-			if (!nf)
+			h = name_hash(get_file_name(ar -> members[mn].name)) & (tsize - 1);
+			for (i = table[h]; i >= 0; i = chain[i])
 			{
-				fprintf(stderr, "Cannot extract '%s': %s\n", filename, strerror(errno));
-				exit(1);
+				if (!strcmp(get_file_name(ar -> members[i].name), get_file_name(ar -> members[mn].name)))
+					break;
 			}
-			while (l)
+			want[i] = 1;
+		}
+	}
+	else
+	{
+		for (i = 0; i < nfiles; i++)
+		{
+			char *fn = get_file_name(files[i]);
+
+			h = name_hash(fn) & (tsize - 1);
+			for (mn = table[h]; mn >= 0; mn = chain[mn])
 			{
-				c = fgetc(f);
-				fputc(c, nf);
-				l--;
+				if (!strcmp(get_file_name(ar -> members[mn].name), fn))
+					break;
 			}
-			fclose(nf);
+			if (mn >= 0)
+				want[mn] = 1;
 		}
-		else
+	}
+
+	extract_list = lw_alloc(sizeof(int) * (ar -> nmembers + 1));
+	nextract = 0;
+	for (mn = 0; mn < ar -> nmembers; mn++)
+	{
+		if (want[mn])
+			extract_list[nextract++] = mn;
+	}
+	lw_free(table);
+	lw_free(chain);
+	lw_free(want);
+}
+
+void do_extract(void)
+{
+	int i;
+
+	ar = archive_open(archive_file, 0, 0);
+	select_members();
+	if (nextract > 0)
+		arview = archive_map(ar);
+	for (i = 0; i < nextract; i++)
+	{
+		armember_t *m = &(ar -> members[extract_list[i]]);
+
+		if (m -> offset + m -> size > ar -> mapsize)
 		{
-			// skip the file
-			fseek(f, l, SEEK_CUR);
+			fprintf(stderr, "%s: bad archive file\n", archive_file);
+			exit(1);
 		}
 	}
+
+#ifndef NO_THREADS
+	if (extract_jobs > 1 && nextract > 1)
+	{
+		pthread_t *threads;
+		int nthreads = extract_jobs;
+
+		if (nthreads > nextract)
+			nthreads = nextract;
+		threads = lw_alloc(sizeof(pthread_t) * nthreads);
+		extract_next = 0;
+		for (i = 0; i < nthreads; i++)
+		{
+			if (pthread_create(&threads[i], NULL, extract_worker, NULL) != 0)
+				break;
+		}
+		// if no threads could be started, do the work here
+		if (i == 0)
+			extract_worker(NULL);
+		while (i-- > 0)
+			pthread_join(threads[i], NULL);
+		lw_free(threads);
+	}
+	else
+#endif
+	{
+		for (i = 0; i < nextract; i++)
+			extract_member(extract_list[i]);
+	}
+
+	lw_free(extract_list);
+	archive_close(ar);
 }
@@ -22,72 +22,18 @@ Implements the program startup code
 
 */
 
-#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
 
 #include "lwar.h"
 
 void do_list(void)
 {
-	FILE *f;
-	char buf[8];
-	long l;
-	int c;
-		
-	f = fopen(archive_file, "rb");
-	if (!f)
-	{
-		perror("Opening archive file");
-		exit(1);
-	}
+	archive_t *ar;
+	int i;
 	
-	(void)(fread(buf, 1, 6, f) && 1);
-	if (memcmp("LWAR1V", buf, 6))
-	{
-		fprintf(stderr, "%s is not a valid archive file.\n", archive_file);
-		exit(1);
-	}
-
-	for (;;)
-	{
-		c = fgetc(f);
-		if (ferror(f))
-		{
-			perror("Reading archive file");
-			exit(1);
-		}
-		if (c == EOF)
-			return;
-		
-		
-		// find the end of the file name
-		if (!c)
-			return;
-
-		while (c)
-		{
-			putchar(c);
-			c = fgetc(f);
-			if (c == EOF || ferror(f))
-			{
-				fprintf(stderr, "Bad archive file\n");
-				exit(1);
-			}
-		}
-		
-		// get length of archive member
-		l = 0;
-		c = fgetc(f);
-		l = c << 24;
-		c = fgetc(f);
-		l |= c << 16;
-		c = fgetc(f);
-		l |= c << 8;
-		c = fgetc(f);
-		l |= c;
-		printf(": %04lx bytes\n", l);
-		fseek(f, l, SEEK_CUR);
-	}
+	ar = archive_open(archive_file, 0, 0);
+	for (i = 0; i < ar -> nmembers; i++)
+		printf("%s: %04lx bytes\n", ar -> members[i].name, ar -> members[i].size);
+	archive_close(ar);
 }
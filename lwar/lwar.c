@@ -44,6 +44,7 @@ int nfiles = 0;
 char *archive_file = NULL;
 int mergeflag = 0;
 int filename_flag = 0;
+int extract_jobs = 1;
 
 char **files = NULL;
 
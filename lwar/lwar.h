@@ -31,6 +31,8 @@ Contains the main defs used by the linker
 #ifndef __lwar_h_seen__
 #define __lwar_h_seen__
 
+#include <stdio.h>
+
 #ifndef __lwar_c_seen__
 
 extern char *archive_file;
@@ -40,6 +42,7 @@ extern int nfiles;
 extern char **files;
 extern int mergeflag;
 extern int filename_flag;
+extern int extract_jobs;
 
 //typedef void * ARHANDLE;
 
@@ -62,4 +65,51 @@ __lwar_E__ char *get_file_name(char *fn);
 
 #undef __lwar_E__
 
+// archive access (archive.c)
+typedef struct
+{
+	char *name;					// member name
+	long offset;				// offset of the member data in the archive
+	long size;					// size of the member data
+	long space;					// written to the reserved directory field
+	unsigned long long hash;	// hash of the member data
+	int hashed;					// is "hash" valid?
+} armember_t;
+
+typedef struct
+{
+	char *filename;				// archive file name
+	FILE *f;					// open archive file
+	int version;				// 1 for LWAR1V, 2 for LWAR2V
+	int writable;				// opened for update?
+	int dirty;					// does the directory need writing?
+	int nmembers;				// number of members
+	armember_t *members;		// the member directory
+	long dataend;				// end of the member data
+	unsigned char *map;			// view of the whole file (archive_map)
+	long mapsize;				// size of the view
+	int mapped;					// is the view a memory mapping?
+} archive_t;
+
+#ifndef __archive_c_seen__
+#define __archive_E__ extern
+#else
+#define __archive_E__
+#endif
+
+__archive_E__ archive_t *archive_open(char *fn, int writable, int create);
+__archive_E__ void archive_close(archive_t *ar);
+__archive_E__ void archive_convert(archive_t *ar);
+__archive_E__ int archive_find(archive_t *ar, char *name);
+__archive_E__ unsigned char *archive_read_member(archive_t *ar, int mn);
+__archive_E__ unsigned char *archive_map(archive_t *ar);
+__archive_E__ void archive_add(archive_t *ar, char *name, unsigned char *data, long size);
+__archive_E__ int archive_replace(archive_t *ar, int mn, unsigned char *data, long size);
+__archive_E__ void archive_remove(archive_t *ar, int mn);
+__archive_E__ unsigned long long archive_hash(unsigned char *data, long size);
+__archive_E__ unsigned char *read_whole_file(char *fn, long *size);
+__archive_E__ int is_archive(unsigned char *data, long size);
+
+#undef __archive_E__
+
 #endif //__lwar_h_seen__
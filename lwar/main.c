@@ -86,6 +86,21 @@ static int parse_opts(int key, char *arg, void *state)
 		operation = LWAR_OP_EXTRACT;
 		break;
 
+	case 0x100:
+		// remove members
+		operation = LWAR_OP_REMOVE;
+		break;
+
+	case 'j':
+		// number of extraction threads
+		extract_jobs = atoi(arg);
+		if (extract_jobs < 1)
+		{
+			fprintf(stderr, "Invalid job count: %s\n", arg);
+			exit(1);
+		}
+		break;
+
 	case lw_cmdline_key_arg:
 		if (archive_file)
 		{
@@ -113,6 +128,8 @@ static struct lw_cmdline_options options[] =
 				"Extract members from the archive" },
 	{ "add",		'a',	0,		0,
 				"Add members to the archive" },
+	{ "remove",		0x100,	0,		0,
+				"Remove members from the archive" },
 	{ "list",		'l',	0,		0,
 				"List the contents of the archive" },
 	{ "create",		'c',	0,		0,
@@ -121,6 +138,8 @@ static struct lw_cmdline_options options[] =
 				"Add the contents of archive arguments instead of the archives themselves" },
 	{ "nopaths",	'n',	0,		0,
 				"Store only the filename when adding members and ignore the path, if any, when extracting members" },
+	{ "jobs",		'j',	"N",	0,
+				"Use N threads when extracting members" },
 	{ "debug",		'd',	0,		0,
 				"Set debug mode"},
 	{ 0 }
@@ -22,8 +22,26 @@ Implements the program startup code
 
 */
 
+#include <stdio.h>
+#include <stdlib.h>
+
 #include "lwar.h"
 
 void do_remove(void)
 {
+	archive_t *ar;
+	int i, mn;
+	
+	ar = archive_open(archive_file, 1, 0);
+	for (i = 0; i < nfiles; i++)
+	{
+		mn = archive_find(ar, get_file_name(files[i]));
+		if (mn < 0)
+		{
+			fprintf(stderr, "%s: not in archive\n", files[i]);
+			continue;
+		}
+		archive_remove(ar, mn);
+	}
+	archive_close(ar);
 }
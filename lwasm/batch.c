@@ -0,0 +1,282 @@
+/*
+batch.c
+
+Copyright © 2026 William Astle
+
+This file is part of LWTOOLS.
+
+LWTOOLS is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+Batch mode
+
+With --batch, each line of the batch file is a separate assembly with its
+own command line arguments, added after any given on the real command line
+(less --batch and --jobs themselves). Up to --jobs of them run at once.
+
+Each job is assembled by a child copy of lwasm (see job.c) which runs
+exactly as a separate lwasm process would, so every job has its own assembler state and
+produces the same output. Forking saves starting a new process for each
+job. The child's standard output and standard error are captured in
+temporary files and replayed by the parent in batch file order, so the
+diagnostics for one job are never mixed with those of another.
+
+The child also reports the include files it read from disk. The parent
+reads those into memory, and jobs started after that read them from there
+(see input.c), so include files shared by many jobs are only read once.
+The jobs must be independent: a job must not write a file another job
+includes.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lw_alloc.h>
+#include <lw_string.h>
+#include <lw_stringlist.h>
+
+#include "lwasm.h"
+
+#if defined(WIN32) || defined(WIN64)
+
+int lwasm_batch(asmstate_t *as, int argc, char **argv)
+{
+	fprintf(stderr, "Batch mode is not supported on this system\n");
+	return 1;
+}
+
+#else
+
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "job.h"
+
+struct batchjob
+{
+	int line;				// line number in the batch file
+	int argc;
+	char **argv;			// the complete command line for the job
+	struct lwasm_job job;	// job.pid is 0 if not started, -1 when finished
+	int status;				// the child's wait status
+};
+
+static void batch_addarg(struct batchjob *j, const char *arg, int len)
+{
+	j -> argv = lw_realloc(j -> argv, sizeof(char *) * (j -> argc + 2));
+	j -> argv[j -> argc++] = lw_strndup(arg, len);
+	j -> argv[j -> argc] = NULL;
+}
+
+/* is arg --batch or --jobs (or -j); set *skip if the value is the next argument */
+static int batch_isbatchopt(const char *arg, int *skip)
+{
+	*skip = 0;
+	if (!strcmp(arg, "--batch") || !strcmp(arg, "--jobs") || !strcmp(arg, "-j"))
+	{
+		*skip = 1;
+		return 1;
+	}
+	if (!strncmp(arg, "--batch=", 8) || !strncmp(arg, "--jobs=", 7) || !strncmp(arg, "-j", 2))
+		return 1;
+	return 0;
+}
+
+/*
+Split a batch file line into arguments. Arguments are separated by white
+space; double quotes group an argument containing spaces and a backslash
+inside them escapes the next character. A line starting with # is a
+comment. Returns the number of arguments found.
+*/
+static int batch_parseline(struct batchjob *j, char *line, const char *fn)
+{
+	char *p = line, *d, *start;
+	int n = 0, quoted;
+
+	for (;;)
+	{
+		while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+			p++;
+		if (!*p || (*p == '#' && n == 0))
+			break;
+		// unquote in place; the result is never longer than the original
+		start = d = p;
+		quoted = 0;
+		while (*p && (quoted || (*p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')))
+		{
+			if (*p == '"')
+			{
+				quoted = !quoted;
+				p++;
+				continue;
+			}
+			if (quoted && *p == '\\' && p[1])
+				p++;
+			*d++ = *p++;
+		}
+		if (quoted)
+		{
+			fprintf(stderr, "%s:%d: unterminated quote\n", fn, j -> line);
+			exit(1);
+		}
+		batch_addarg(j, start, d - start);
+		n++;
+	}
+	return n;
+}
+
+/* read the jobs from fn; each gets the common arguments first */
+static struct batchjob *batch_read(const char *fn, int argc, char **argv, int *njobs)
+{
+	struct batchjob *jobs = NULL, *j;
+	FILE *fp;
+	char *line = NULL;
+	size_t linesize = 0;
+	int lineno = 0, i, skip, n = 0;
+
+	if (!strcmp(fn, "-"))
+		fp = stdin;
+	else
+		fp = fopen(fn, "r");
+	if (!fp)
+	{
+		fprintf(stderr, "Cannot open batch file %s: %s\n", fn, strerror(errno));
+		exit(1);
+	}
+	while (getline(&line, &linesize, fp) > 0)
+	{
+		lineno++;
+		jobs = lw_realloc(jobs, sizeof(struct batchjob) * (n + 1));
+		j = &jobs[n];
+		memset(j, 0, sizeof(struct batchjob));
+		j -> line = lineno;
+		batch_addarg(j, argv[0], strlen(argv[0]));
+		for (i = 1; i < argc; i++)
+		{
+			if (batch_isbatchopt(argv[i], &skip))
+			{
+				i += skip;
+				continue;
+			}
+			batch_addarg(j, argv[i], strlen(argv[i]));
+		}
+		if (batch_parseline(j, line, fn) == 0)
+		{
+			for (i = 0; i < j -> argc; i++)
+				lw_free(j -> argv[i]);
+			lw_free(j -> argv);
+			continue;
+		}
+		n++;
+	}
+	free(line);
+	if (fp != stdin)
+		fclose(fp);
+	*njobs = n;
+	return jobs;
+}
+
+/* start a child lwasm for job j */
+static void batch_start(struct batchjob *j)
+{
+	if (job_start(&(j -> job), j -> argc, j -> argv, NULL, 0) == -1)
+	{
+		fprintf(stderr, "Failed to start job for line %d: %s\n", j -> line, strerror(errno));
+		exit(1);
+	}
+}
+
+/* output what a finished job printed and cache its include files;
+   returns nonzero if the job failed */
+static int batch_finish(struct batchjob *j, const char *fn)
+{
+	int i;
+
+	job_replay(j -> job.out, stdout);
+	fflush(stdout);
+	job_replay(j -> job.err, stderr);
+	if (WIFSIGNALED(j -> status))
+		fprintf(stderr, "%s:%d: lwasm terminated by signal %d\n", fn, j -> line, WTERMSIG(j -> status));
+
+	job_cacheresults(&(j -> job));
+
+	for (i = 0; i < j -> argc; i++)
+		lw_free(j -> argv[i]);
+	lw_free(j -> argv);
+
+	if (WIFEXITED(j -> status) && WEXITSTATUS(j -> status) == 0)
+		return 0;
+	return 1;
+}
+
+/*
+Run all the jobs in the batch file, up to as -> batch_jobs at once. All
+jobs are run even if some fail; the result is nonzero if any did.
+*/
+int lwasm_batch(asmstate_t *as, int argc, char **argv)
+{
+	struct batchjob *jobs;
+	int njobs, next = 0, done = 0, running = 0;
+	int i, status, retval = 0;
+	pid_t pid;
+
+	if (lw_stringlist_nstrings(as -> input_files) > 0)
+	{
+		fprintf(stderr, "Input files must be given in the batch file with --batch\n");
+		return 1;
+	}
+	jobs = batch_read(as -> batch_file, argc, argv, &njobs);
+
+	while (done < njobs)
+	{
+		while (running < as -> batch_jobs && next < njobs)
+		{
+			batch_start(&jobs[next++]);
+			running++;
+		}
+
+		while ((pid = waitpid(-1, &status, 0)) == -1 && errno == EINTR)
+			/* do nothing */ ;
+		if (pid == -1)
+		{
+			fprintf(stderr, "waitpid failed: %s\n", strerror(errno));
+			exit(1);
+		}
+		for (i = 0; i < next; i++)
+		{
+			if (jobs[i].job.pid == pid)
+			{
+				jobs[i].job.pid = -1;
+				jobs[i].status = status;
+				running--;
+				break;
+			}
+		}
+
+		/* report finished jobs in batch file order */
+		while (done < next && jobs[done].job.pid == -1)
+		{
+			if (batch_finish(&jobs[done], as -> batch_file))
+				retval = 1;
+			done++;
+		}
+	}
+	lw_free(jobs);
+	return retval;
+}
+
+#endif
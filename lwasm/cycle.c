@@ -619,13 +619,17 @@ static indtab_t indtab[] =
 /* calculates additional ticks from post byte in both indexed and indirect modes */
 int lwasm_cycle_calc_ind(line_t *cl)
 {
-	int pb = cl->pb;
+	return lwasm_cycle_indexed(cl->pb, !CURPRAGMA(cl, PRAGMA_6809));
+}
 
+/* additional ticks for indexed post byte pb without a source line */
+int lwasm_cycle_indexed(int pb, int is6309)
+{
 	if ((pb & 0x80) == 0) /* 5 bit offset */
 		return 1;
 
 	// These need special handling because the *register* bits determine the specific operation (and, thus, cycle counts)
-	if (!CURPRAGMA(cl, PRAGMA_6809))
+	if (is6309)
 	{
 		switch (pb)
 		{
@@ -647,9 +651,9 @@ int lwasm_cycle_calc_ind(line_t *cl)
 	}
 
 	if (pb & 0x10) /* indirect */
-		return CURPRAGMA(cl, PRAGMA_6809) ? indtab[pb & 0xf].cycles_6809_indirect : indtab[pb & 0xf].cycles_6309_indirect;
+		return is6309 ? indtab[pb & 0xf].cycles_6309_indirect : indtab[pb & 0xf].cycles_6809_indirect;
 	else
-		return CURPRAGMA(cl, PRAGMA_6809) ? indtab[pb & 0xf].cycles_6809_indexed : indtab[pb & 0xf].cycles_6309_indexed;
+		return is6309 ? indtab[pb & 0xf].cycles_6309_indexed : indtab[pb & 0xf].cycles_6809_indexed;
 }
 
 /* calculate additional ticks from post byte in rlist (PSHS A,B,X...) */
@@ -668,6 +672,39 @@ int lwasm_cycle_calc_rlist(line_t *cl)
 	return cycles;
 }
 
+static cycletable_t *cycle_lookup(int opc)
+{
+	int i;
+	for (i = 0; cycletable[i].opc != -1; i++)
+	{
+		if (cycletable[i].opc == opc)
+			return &cycletable[i];
+	}
+	return NULL;
+}
+
+/* base cycle count of opc for the CPU in effect on cl, 0 if unknown */
+int lwasm_cycle_base(line_t *cl, int opc)
+{
+	cycletable_t *ct = cycle_lookup(opc);
+
+	if (!ct)
+		return 0;
+	return CURPRAGMA(cl, PRAGMA_6809) ? ct->cycles_6809 : ct->cycles_6309;
+}
+
+/* base cycle count and flags of opc without a source line, -1 if unknown */
+int lwasm_cycle_lookup(int opc, int is6309, int *flags)
+{
+	cycletable_t *ct = cycle_lookup(opc);
+
+	if (!ct)
+		return -1;
+	if (flags)
+		*flags = ct->flags;
+	return is6309 ? ct->cycles_6309 : ct->cycles_6809;
+}
+
 void lwasm_cycle_update_count(line_t *cl, int opc)
 {
 	int i;
@@ -0,0 +1,923 @@
+/*
+cycreport.c
+
+Copyright © 2026 William Astle
+
+This file is part of LWTOOLS.
+
+LWTOOLS is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lw_alloc.h>
+#include <lw_expr.h>
+
+#include "lwasm.h"
+#include "instab.h"
+
+/*
+Cycle budget report
+
+The assembled code is split into routines, one for each global label, and
+each routine into basic blocks. A block starts at a label, at the target of
+a branch, or after anything that does not simply fall through to the next
+instruction. Subroutine calls stay inside their block; when the called
+routine is in the same source, its cost is added to the block.
+
+The cycles for a routine are the cheapest and dearest ways from its entry
+to a return, counting each block once. A branch back to a block already on
+the way is a loop; loops are reported separately with the cost of one
+trip around them, and the routine figures only include the first trip.
+*/
+
+enum
+{
+	CYC_NORMAL = 0,						// falls through to the next instruction
+	CYC_BRANCH,							// always goes to the target
+	CYC_COND,							// goes to the target or falls through
+	CYC_CALL,							// calls the target, then falls through
+	CYC_RETURN,							// leaves the routine
+	CYC_CONDRETURN,						// leaves the routine or falls through
+	CYC_JUMP							// goes somewhere that cannot be worked out
+};
+
+enum
+{
+	CYCF_ESTIMATED = 1,					// some counts are estimates
+	CYCF_UNKNOWN = 2,					// some flow could not be followed
+	CYCF_RECURSIVE = 4,					// recursion somewhere below; not counted
+	CYCF_LOOP = 8,						// contains a loop
+	CYCF_NOEXIT = 16					// never returns
+};
+
+static const char *cyc_flagnames[] = { "estimated", "unknown flow", "recursive", "loop", "no exit", NULL };
+static const char *cyc_jsonnames[] = { "estimated", "unknown", "recursive", "loop", "noexit", NULL };
+
+typedef struct
+{
+	line_t *cl;
+	int sect;							// section number
+	int addr;
+	int min, max;						// cycles
+	int est;							// count is an estimate
+	int flow;							// CYC_*
+	int known;							// target address is known
+	int taddr;							// target address
+	int target;							// target instruction or -1
+	int nofall;							// next instruction does not follow this one
+	int leader;							// starts a block
+	int routine;
+	int block;
+} cycinsn_t;
+
+typedef struct
+{
+	int first, last;					// instructions
+	int routine;
+	int min, max;						// cycles for the block, including calls
+	int flags;
+	int succ[2];						// following blocks or -1
+	int back[2];						// set if the edge to succ closes a loop
+	int exit;							// can leave the routine from here
+	int loop;							// part of a loop
+	int state;							// 0 = not seen, 1 = on the path, 2 = done
+	int pmin, pmax;						// ways out from here, -1 if none
+	int dmin, dmax;						// ways to a return or a loop end
+} cycblock_t;
+
+typedef struct
+{
+	int header, latch;					// blocks
+	int min, max;						// cycles per trip
+} cycloop_t;
+
+typedef struct
+{
+	char *name;
+	int first, last;					// blocks
+	int state;
+	int min, max;
+	int flags;
+	cycloop_t *loops;
+	int nloops;
+	int *calls;							// routines called
+	int ncalls;
+} cycroutine_t;
+
+typedef struct
+{
+	asmstate_t *as;
+	cycinsn_t *insns;
+	int ninsns;
+	int *byaddr;						// instructions sorted by section and address
+	cycblock_t *blocks;
+	int nblocks;
+	cycroutine_t *routines;
+	int nroutines;
+} cycstate_t;
+
+static int cyc_sectnum(asmstate_t *as, sectiontab_t *s)
+{
+	sectiontab_t *t;
+	int n = 1;
+
+	if (!s)
+		return 0;
+	for (t = as -> sections; t; t = t -> next, n++)
+	{
+		if (t == s)
+			return n;
+	}
+	return -1;
+}
+
+struct cyc_secttest
+{
+	sectiontab_t *sect;
+	int other;
+};
+
+static int cyc_secttest(lw_expr_t e, void *p)
+{
+	struct cyc_secttest *st = p;
+
+	if (lw_expr_istype(e, lw_expr_type_special) && lw_expr_specint(e) == lwasm_expr_secbase)
+	{
+		if (lw_expr_specptr(e) != st -> sect)
+			st -> other = 1;
+	}
+	return 0;
+}
+
+// value of e relative to the section of cl, if it has one there
+static int cyc_eval(asmstate_t *as, line_t *cl, lw_expr_t e, int *v)
+{
+	struct cyc_secttest st;
+	lw_expr_t te;
+	int r = 0;
+
+	if (!e)
+		return 0;
+	te = lw_expr_copy(e);
+	st.sect = cl -> csect;
+	st.other = 0;
+	lw_expr_testterms(te, cyc_secttest, &st);
+	if (!st.other)
+	{
+		as -> exportcheck = 1;
+		as -> csect = cl -> csect;
+		lwasm_reduce_expr(as, te);
+		as -> exportcheck = 0;
+		if (lw_expr_istype(te, lw_expr_type_int))
+		{
+			*v = lw_expr_intval(te) & 0xffff;
+			r = 1;
+		}
+	}
+	lw_expr_destroy(te);
+	return r;
+}
+
+static int cyc_islocal(line_t *cl, char *sym)
+{
+	for (; *sym; sym++)
+	{
+		if (*sym == '@' || *sym == '?')
+			return 1;
+		if (*sym == '$' && !CURPRAGMA(cl, PRAGMA_DOLLARNOTLOCAL))
+			return 1;
+	}
+	return 0;
+}
+
+// work out where the instruction goes next from the code it generated
+static void cyc_flow(cycstate_t *cs, cycinsn_t *ci)
+{
+	line_t *cl = ci -> cl;
+	unsigned char *o = cl -> output;
+	int op = o[0];
+	int rel = 0, v;
+
+	if ((op == 0x10 || op == 0x11) && cl -> outputl > 1)
+		op = (op << 8) | o[1];
+
+	ci -> flow = CYC_NORMAL;
+	if (cl -> conditional_return)
+	{
+		ci -> flow = CYC_CONDRETURN;
+		return;
+	}
+	switch (op)
+	{
+	case 0x20: case 0x16:
+		ci -> flow = CYC_BRANCH;
+		rel = 1;
+		break;
+
+	case 0x8d: case 0x17:
+		ci -> flow = CYC_CALL;
+		rel = 1;
+		break;
+
+	case 0x7e: case 0x0e:
+		ci -> flow = CYC_BRANCH;
+		break;
+
+	case 0xbd: case 0x9d:
+		ci -> flow = CYC_CALL;
+		break;
+
+	case 0xad: case 0x3f: case 0x103f: case 0x113f:
+		ci -> flow = CYC_CALL;
+		return;
+
+	case 0x6e:
+		ci -> flow = CYC_JUMP;
+		return;
+
+	case 0x39: case 0x3b:
+		ci -> flow = CYC_RETURN;
+		return;
+
+	case 0x35: case 0x37:
+		if (o[1] & 0x80)
+			ci -> flow = CYC_RETURN;
+		return;
+
+	case 0x1e: case 0x1f:
+		if ((o[1] & 0x0f) == 5 || (op == 0x1e && (o[1] >> 4) == 5))
+			ci -> flow = CYC_JUMP;
+		return;
+
+	default:
+		if ((op >= 0x22 && op <= 0x2f) || (op >= 0x1022 && op <= 0x102f))
+		{
+			ci -> flow = CYC_COND;
+			rel = 1;
+			break;
+		}
+		return;
+	}
+
+	if (!cyc_eval(cs -> as, cl, lwasm_fetch_expr(cl, 0), &v))
+		return;
+	if (rel)
+		v = (ci -> addr + cl -> len + v) & 0xffff;
+	else if (op == 0x0e || op == 0x9d)
+		v = ((cl -> dpval & 0xff) << 8) | (v & 0xff);
+	ci -> known = 1;
+	ci -> taddr = v;
+}
+
+static cycstate_t *cyc_sortstate;
+
+// order instructions by section and address
+static int cyc_addrcmp(const void *a, const void *b)
+{
+	cycinsn_t *x = &cyc_sortstate -> insns[*(const int *)a];
+	cycinsn_t *y = &cyc_sortstate -> insns[*(const int *)b];
+
+	if (x -> sect != y -> sect)
+		return x -> sect - y -> sect;
+	return x -> addr - y -> addr;
+}
+
+static int cyc_lookup(cycstate_t *cs, int sect, int addr)
+{
+	int lo = 0, hi = cs -> ninsns - 1, mid;
+	cycinsn_t *ci;
+
+	while (lo <= hi)
+	{
+		mid = (lo + hi) / 2;
+		ci = &cs -> insns[cs -> byaddr[mid]];
+		if (ci -> sect == sect && ci -> addr == addr)
+			return cs -> byaddr[mid];
+		if (ci -> sect < sect || (ci -> sect == sect && ci -> addr < addr))
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	return -1;
+}
+
+static void cyc_addroutine(cycstate_t *cs, char *name)
+{
+	cycroutine_t *rt;
+
+	cs -> routines = lw_realloc(cs -> routines, sizeof(cycroutine_t) * (cs -> nroutines + 1));
+	rt = &cs -> routines[cs -> nroutines++];
+	memset(rt, 0, sizeof(cycroutine_t));
+	rt -> name = name;
+	rt -> first = -1;
+}
+
+// gather the instructions and find where each one goes
+static void cyc_collect(cycstate_t *cs)
+{
+	asmstate_t *as = cs -> as;
+	line_t *cl;
+	cycinsn_t *ci, *prev = NULL;
+	lw_expr_t te;
+	char *rname = NULL;
+	int leader = 1, newroutine = 0;
+	int i, t;
+
+	for (cl = as -> line_head; cl; cl = cl -> next)
+	{
+		if (cl -> sym && !(cl -> symset) && (cl -> insn < 0 || (cl -> outputl > 0 && cl -> cycle_base > 0)))
+		{
+			leader = 1;
+			if (!cyc_islocal(cl, cl -> sym))
+			{
+				rname = cl -> sym;
+				newroutine = 1;
+			}
+		}
+		if (cl -> outputl <= 0)
+			continue;
+		if (cl -> insn < 0 || cl -> cycle_base == 0)
+		{
+			// data; whatever runs into it cannot be followed
+			if (prev)
+				prev -> nofall = 1;
+			prev = NULL;
+			leader = 1;
+			continue;
+		}
+
+		cs -> insns = lw_realloc(cs -> insns, sizeof(cycinsn_t) * (cs -> ninsns + 1));
+		// the previous instruction, if any, is always the last one collected
+		if (prev)
+			prev = &cs -> insns[cs -> ninsns - 1];
+		ci = &cs -> insns[cs -> ninsns++];
+		memset(ci, 0, sizeof(cycinsn_t));
+		ci -> cl = cl;
+		ci -> sect = cyc_sectnum(as, cl -> csect);
+		ci -> target = -1;
+		te = lw_expr_copy(cl -> addr);
+		as -> exportcheck = 1;
+		as -> csect = cl -> csect;
+		lwasm_reduce_expr(as, te);
+		as -> exportcheck = 0;
+		ci -> addr = lw_expr_istype(te, lw_expr_type_int) ? (lw_expr_intval(te) & 0xffff) : 0;
+		lw_expr_destroy(te);
+
+		ci -> min = ci -> max = cl -> cycle_base + cl -> cycle_adj;
+		if (cl -> cycle_flags & CYCLE_ESTIMATED)
+		{
+			ci -> est = 1;
+			// a long branch on the 6809 takes one more cycle if taken
+			if (cl -> insn >= 0 && instab[cl -> insn].ops[3] > 0x1000)
+				ci -> max++;
+		}
+		cyc_flow(cs, ci);
+
+		if (prev && (prev -> sect != ci -> sect || ((prev -> addr + prev -> cl -> outputl) & 0xffff) != ci -> addr))
+		{
+			prev -> nofall = 1;
+			leader = 1;
+		}
+		if (prev && prev -> flow != CYC_NORMAL && prev -> flow != CYC_CALL)
+			leader = 1;
+		if (newroutine || cs -> nroutines == 0)
+		{
+			cyc_addroutine(cs, newroutine ? rname : NULL);
+			newroutine = 0;
+			leader = 1;
+		}
+		ci -> routine = cs -> nroutines - 1;
+		ci -> leader = leader;
+		leader = 0;
+		prev = ci;
+	}
+	if (prev)
+		prev -> nofall = 1;
+
+	// branch targets start blocks too
+	cs -> byaddr = lw_alloc(sizeof(int) * (cs -> ninsns + 1));
+	for (i = 0; i < cs -> ninsns; i++)
+		cs -> byaddr[i] = i;
+	cyc_sortstate = cs;
+	qsort(cs -> byaddr, cs -> ninsns, sizeof(int), cyc_addrcmp);
+	for (i = 0; i < cs -> ninsns; i++)
+	{
+		ci = &cs -> insns[i];
+		if (!ci -> known)
+			continue;
+		t = cyc_lookup(cs, ci -> sect, ci -> taddr);
+		ci -> target = t;
+		if (t >= 0)
+			cs -> insns[t].leader = 1;
+	}
+}
+
+// split the instructions into blocks and link them up
+static void cyc_blocks(cycstate_t *cs)
+{
+	cycblock_t *blk = NULL;
+	cycinsn_t *ci, *li;
+	int i, b;
+
+	for (i = 0; i < cs -> ninsns; i++)
+	{
+		ci = &cs -> insns[i];
+		if (ci -> leader || !blk)
+		{
+			cs -> blocks = lw_realloc(cs -> blocks, sizeof(cycblock_t) * (cs -> nblocks + 1));
+			blk = &cs -> blocks[cs -> nblocks++];
+			memset(blk, 0, sizeof(cycblock_t));
+			blk -> first = i;
+			blk -> routine = ci -> routine;
+			blk -> succ[0] = blk -> succ[1] = -1;
+			if (cs -> routines[ci -> routine].first < 0)
+				cs -> routines[ci -> routine].first = cs -> nblocks - 1;
+			cs -> routines[ci -> routine].last = cs -> nblocks - 1;
+		}
+		blk -> last = i;
+		ci -> block = cs -> nblocks - 1;
+		if (ci -> est)
+			blk -> flags |= CYCF_ESTIMATED;
+	}
+
+	for (b = 0; b < cs -> nblocks; b++)
+	{
+		blk = &cs -> blocks[b];
+		li = &cs -> insns[blk -> last];
+		switch (li -> flow)
+		{
+		case CYC_BRANCH:
+			if (li -> target >= 0)
+				blk -> succ[0] = cs -> insns[li -> target].block;
+			else
+				blk -> exit = 1;
+			if (li -> target < 0)
+				blk -> flags |= CYCF_UNKNOWN;
+			continue;
+
+		case CYC_COND:
+			if (li -> target >= 0)
+				blk -> succ[0] = cs -> insns[li -> target].block;
+			else
+				blk -> flags |= CYCF_UNKNOWN;
+			break;
+
+		case CYC_RETURN:
+			blk -> exit = 1;
+			continue;
+
+		case CYC_CONDRETURN:
+			blk -> exit = 1;
+			break;
+
+		case CYC_JUMP:
+			blk -> exit = 1;
+			blk -> flags |= CYCF_UNKNOWN;
+			continue;
+		}
+		// falls through
+		if (li -> nofall)
+		{
+			blk -> exit = 1;
+			blk -> flags |= CYCF_UNKNOWN;
+		}
+		else
+		{
+			blk -> succ[1] = cs -> insns[blk -> last + 1].block;
+		}
+	}
+}
+
+static void cyc_merge(int *mn, int *mx, int a, int b)
+{
+	if (*mn < 0 || a < *mn)
+		*mn = a;
+	if (*mx < 0 || b > *mx)
+		*mx = b;
+}
+
+static void cyc_routine(cycstate_t *cs, int r);
+
+// the cost of going to block s of another routine; only its entry is known
+static int cyc_tail(cycstate_t *cs, int r, int s, int *mn, int *mx)
+{
+	cycroutine_t *rt = &cs -> routines[r];
+	int c = cs -> blocks[s].routine;
+
+	*mn = *mx = 0;
+	if (cs -> routines[c].first != s)
+	{
+		rt -> flags |= CYCF_UNKNOWN;
+		return 1;
+	}
+	if (cs -> routines[c].state == 1)
+	{
+		rt -> flags |= CYCF_RECURSIVE;
+		return 1;
+	}
+	if (cs -> routines[c].state == 0)
+		cyc_routine(cs, c);
+	*mn = cs -> routines[c].min;
+	*mx = cs -> routines[c].max;
+	rt -> flags |= cs -> routines[c].flags & ~CYCF_NOEXIT;
+	return 1;
+}
+
+static void cyc_path(cycstate_t *cs, int r, int b)
+{
+	cycblock_t *blk = &cs -> blocks[b];
+	cycblock_t *sb;
+	int pmin = -1, pmax = -1, dmin = -1, dmax = -1;
+	int i, s, mn, mx;
+
+	blk -> state = 1;
+	if (blk -> exit)
+		pmin = pmax = 0;
+	for (i = 0; i < 2; i++)
+	{
+		s = blk -> succ[i];
+		if (s < 0)
+			continue;
+		sb = &cs -> blocks[s];
+		if (sb -> routine != r)
+		{
+			cyc_tail(cs, r, s, &mn, &mx);
+			cyc_merge(&pmin, &pmax, mn, mx);
+			continue;
+		}
+		if (sb -> state == 1)
+		{
+			blk -> back[i] = 1;
+			cyc_merge(&dmin, &dmax, 0, 0);
+			continue;
+		}
+		if (sb -> state == 0)
+			cyc_path(cs, r, s);
+		if (sb -> pmin >= 0)
+			cyc_merge(&pmin, &pmax, sb -> pmin, sb -> pmax);
+		if (sb -> dmin >= 0)
+			cyc_merge(&dmin, &dmax, sb -> dmin, sb -> dmax);
+	}
+	if (pmin >= 0)
+		cyc_merge(&dmin, &dmax, pmin, pmax);
+	if (dmin < 0)
+		dmin = dmax = 0;
+	blk -> pmin = (pmin >= 0) ? pmin + blk -> min : -1;
+	blk -> pmax = (pmin >= 0) ? pmax + blk -> max : -1;
+	blk -> dmin = dmin + blk -> min;
+	blk -> dmax = dmax + blk -> max;
+	blk -> state = 2;
+}
+
+// cost of one trip from block b to the end of the loop
+static int cyc_trip(cycstate_t *cs, int r, int b, int latch, int *imin, int *imax)
+{
+	cycroutine_t *rt = &cs -> routines[r];
+	cycblock_t *blk = &cs -> blocks[b];
+	int n = b - rt -> first;
+	int i, s, mn = -1, mx = -1;
+
+	if (imin[n] != -2)
+		return imin[n] >= 0;
+	imin[n] = imax[n] = -1;
+	if (b == latch)
+	{
+		mn = mx = 0;
+	}
+	else
+	{
+		for (i = 0; i < 2; i++)
+		{
+			s = blk -> succ[i];
+			if (s < 0 || blk -> back[i] || cs -> blocks[s].routine != r)
+				continue;
+			if (cyc_trip(cs, r, s, latch, imin, imax))
+				cyc_merge(&mn, &mx, imin[s - rt -> first], imax[s - rt -> first]);
+		}
+	}
+	if (mn < 0)
+		return 0;
+	imin[n] = mn + blk -> min;
+	imax[n] = mx + blk -> max;
+	blk -> loop = 1;
+	return 1;
+}
+
+// the routine an instruction calls, if it is the entry of one
+static int cyc_callee(cycstate_t *cs, cycinsn_t *ci)
+{
+	int b, c;
+
+	if (ci -> target < 0)
+		return -1;
+	b = cs -> insns[ci -> target].block;
+	c = cs -> insns[ci -> target].routine;
+	if (cs -> routines[c].first != b || cs -> blocks[b].first != ci -> target)
+		return -1;
+	return c;
+}
+
+static void cyc_addcall(cycroutine_t *rt, int c)
+{
+	int i;
+
+	for (i = 0; i < rt -> ncalls; i++)
+	{
+		if (rt -> calls[i] == c)
+			return;
+	}
+	rt -> calls = lw_realloc(rt -> calls, sizeof(int) * (rt -> ncalls + 1));
+	rt -> calls[rt -> ncalls++] = c;
+}
+
+static void cyc_routine(cycstate_t *cs, int r)
+{
+	cycroutine_t *rt = &cs -> routines[r];
+	cycroutine_t *ct;
+	cycblock_t *blk;
+	cycinsn_t *ci;
+	cycloop_t *lp;
+	int *imin, *imax;
+	int b, i, c, n;
+
+	rt -> state = 1;
+
+	// cost of each block, with the routines it calls
+	for (b = rt -> first; b <= rt -> last; b++)
+	{
+		blk = &cs -> blocks[b];
+		for (i = blk -> first; i <= blk -> last; i++)
+		{
+			ci = &cs -> insns[i];
+			blk -> min += ci -> min;
+			blk -> max += ci -> max;
+			if (ci -> flow != CYC_CALL)
+				continue;
+			c = cyc_callee(cs, ci);
+			if (c < 0)
+			{
+				blk -> flags |= CYCF_UNKNOWN;
+				continue;
+			}
+			cyc_addcall(rt, c);
+			ct = &cs -> routines[c];
+			if (ct -> state == 1)
+			{
+				rt -> flags |= CYCF_RECURSIVE;
+				continue;
+			}
+			if (ct -> state == 0)
+				cyc_routine(cs, c);
+			blk -> min += ct -> min;
+			blk -> max += ct -> max;
+			rt -> flags |= ct -> flags & ~CYCF_NOEXIT;
+		}
+		rt -> flags |= blk -> flags;
+	}
+
+	// ways through the routine; blocks not reached from the entry are
+	// walked too so their loops are found
+	cyc_path(cs, r, rt -> first);
+	for (b = rt -> first; b <= rt -> last; b++)
+	{
+		if (cs -> blocks[b].state == 0)
+			cyc_path(cs, r, b);
+	}
+	blk = &cs -> blocks[rt -> first];
+	if (blk -> pmin >= 0)
+	{
+		rt -> min = blk -> pmin;
+		rt -> max = blk -> pmax;
+	}
+	else
+	{
+		rt -> min = blk -> dmin;
+		rt -> max = blk -> dmax;
+		rt -> flags |= CYCF_NOEXIT;
+	}
+
+	// one trip around each loop
+	n = rt -> last - rt -> first + 1;
+	imin = lw_alloc(sizeof(int) * n);
+	imax = lw_alloc(sizeof(int) * n);
+	for (b = rt -> first; b <= rt -> last; b++)
+	{
+		for (i = 0; i < 2; i++)
+		{
+			if (!cs -> blocks[b].back[i])
+				continue;
+			rt -> loops = lw_realloc(rt -> loops, sizeof(cycloop_t) * (rt -> nloops + 1));
+			lp = &rt -> loops[rt -> nloops++];
+			lp -> header = cs -> blocks[b].succ[i];
+			lp -> latch = b;
+			for (c = 0; c < n; c++)
+				imin[c] = imax[c] = -2;
+			cyc_trip(cs, r, lp -> header, b, imin, imax);
+			lp -> min = imin[lp -> header - rt -> first];
+			lp -> max = imax[lp -> header - rt -> first];
+			rt -> flags |= CYCF_LOOP;
+		}
+	}
+	lw_free(imin);
+	lw_free(imax);
+
+	rt -> state = 2;
+}
+
+static int cyc_start(cycstate_t *cs, int b)
+{
+	return cs -> insns[cs -> blocks[b].first].addr;
+}
+
+static int cyc_end(cycstate_t *cs, int b)
+{
+	cycinsn_t *ci = &cs -> insns[cs -> blocks[b].last];
+
+	return (ci -> addr + ci -> cl -> outputl - 1) & 0xffff;
+}
+
+static const char *cyc_cpu(cycstate_t *cs, cycroutine_t *rt)
+{
+	return CURPRAGMA(cs -> insns[cs -> blocks[rt -> first].first].cl, PRAGMA_6809) ? "6809" : "6309";
+}
+
+static void cyc_text(cycstate_t *cs, FILE *of)
+{
+	cycroutine_t *rt;
+	cycblock_t *blk;
+	char range[32], notes[40];
+	int r, b, i;
+
+	for (r = 0; r < cs -> nroutines; r++)
+	{
+		rt = &cs -> routines[r];
+		fprintf(of, "%s ($%04X-$%04X, %s): %d-%d cycles", rt -> name ? rt -> name : "(no label)",
+			cyc_start(cs, rt -> first), cyc_end(cs, rt -> last), cyc_cpu(cs, rt), rt -> min, rt -> max);
+		for (i = 0; cyc_flagnames[i]; i++)
+		{
+			if (rt -> flags & (1 << i))
+				fprintf(of, "; %s", cyc_flagnames[i]);
+		}
+		fprintf(of, "\n");
+
+		for (b = rt -> first; b <= rt -> last; b++)
+		{
+			blk = &cs -> blocks[b];
+			sprintf(range, "%d-%d", blk -> min, blk -> max);
+			sprintf(notes, "%s%s%s%s", blk -> loop ? " loop" : "", blk -> exit ? " exit" : "",
+				(blk -> flags & CYCF_ESTIMATED) ? " estimated" : "", (blk -> flags & CYCF_UNKNOWN) ? " unknown" : "");
+			if (*notes)
+				fprintf(of, "    $%04X-$%04X  %-11s%s\n", cyc_start(cs, b), cyc_end(cs, b), range, notes);
+			else
+				fprintf(of, "    $%04X-$%04X  %s\n", cyc_start(cs, b), cyc_end(cs, b), range);
+		}
+		for (i = 0; i < rt -> nloops; i++)
+		{
+			fprintf(of, "    loop $%04X-$%04X: %d-%d cycles per trip\n", cyc_start(cs, rt -> loops[i].header),
+				cyc_end(cs, rt -> loops[i].latch), rt -> loops[i].min, rt -> loops[i].max);
+		}
+		if (rt -> ncalls > 0)
+		{
+			fprintf(of, "    calls");
+			for (i = 0; i < rt -> ncalls; i++)
+				fprintf(of, " %s", cs -> routines[rt -> calls[i]].name ? cs -> routines[rt -> calls[i]].name : "(no label)");
+			fprintf(of, "\n");
+		}
+		fprintf(of, "\n");
+	}
+}
+
+static void cyc_jsonstr(FILE *of, const char *s)
+{
+	if (!s)
+	{
+		fprintf(of, "null");
+		return;
+	}
+	fputc('"', of);
+	for (; *s; s++)
+	{
+		if (*s == '"' || *s == '\\')
+			fprintf(of, "\\%c", *s);
+		else if ((unsigned char)*s < 0x20)
+			fprintf(of, "\\u%04x", *s);
+		else
+			fputc(*s, of);
+	}
+	fputc('"', of);
+}
+
+static void cyc_json(cycstate_t *cs, FILE *of)
+{
+	cycroutine_t *rt;
+	cycblock_t *blk;
+	int r, b, i, n;
+
+	fprintf(of, "{\n  \"routines\": [");
+	for (r = 0; r < cs -> nroutines; r++)
+	{
+		rt = &cs -> routines[r];
+		fprintf(of, "%s\n    {\n      \"name\": ", r ? "," : "");
+		cyc_jsonstr(of, rt -> name);
+		fprintf(of, ",\n      \"start\": %d,\n      \"end\": %d,\n      \"cpu\": \"%s\",\n", cyc_start(cs, rt -> first),
+			cyc_end(cs, rt -> last), cyc_cpu(cs, rt));
+		fprintf(of, "      \"min\": %d,\n      \"max\": %d,\n      \"flags\": [", rt -> min, rt -> max);
+		for (i = 0, n = 0; cyc_jsonnames[i]; i++)
+		{
+			if (rt -> flags & (1 << i))
+				fprintf(of, "%s\"%s\"", n++ ? ", " : "", cyc_jsonnames[i]);
+		}
+		fprintf(of, "],\n      \"blocks\": [");
+		for (b = rt -> first; b <= rt -> last; b++)
+		{
+			blk = &cs -> blocks[b];
+			fprintf(of, "%s\n        { \"start\": %d, \"end\": %d, \"min\": %d, \"max\": %d, ", b > rt -> first ? "," : "",
+				cyc_start(cs, b), cyc_end(cs, b), blk -> min, blk -> max);
+			fprintf(of, "\"loop\": %s, \"exit\": %s, \"estimated\": %s, \"unknown\": %s, \"successors\": [",
+				blk -> loop ? "true" : "false", blk -> exit ? "true" : "false",
+				(blk -> flags & CYCF_ESTIMATED) ? "true" : "false", (blk -> flags & CYCF_UNKNOWN) ? "true" : "false");
+			for (i = 0, n = 0; i < 2; i++)
+			{
+				if (blk -> succ[i] >= 0)
+					fprintf(of, "%s%d", n++ ? ", " : "", cyc_start(cs, blk -> succ[i]));
+			}
+			fprintf(of, "] }");
+		}
+		fprintf(of, "\n      ],\n      \"loops\": [");
+		for (i = 0; i < rt -> nloops; i++)
+		{
+			fprintf(of, "%s\n        { \"start\": %d, \"end\": %d, \"min\": %d, \"max\": %d }", i ? "," : "",
+				cyc_start(cs, rt -> loops[i].header), cyc_end(cs, rt -> loops[i].latch), rt -> loops[i].min, rt -> loops[i].max);
+		}
+		fprintf(of, "%s],\n      \"calls\": [", rt -> nloops ? "\n      " : "");
+		for (i = 0; i < rt -> ncalls; i++)
+		{
+			if (i)
+				fprintf(of, ", ");
+			cyc_jsonstr(of, cs -> routines[rt -> calls[i]].name);
+		}
+		fprintf(of, "]\n    }");
+	}
+	fprintf(of, "%s]\n}\n", cs -> nroutines ? "\n  " : "");
+}
+
+void do_cyclereport(asmstate_t *as)
+{
+	cycstate_t cs;
+	FILE *of;
+	int r;
+
+	if (!(as -> flags & FLAG_CYCLEREPORT) || (as -> flags & FLAG_DEPEND))
+		return;
+
+	if (!as -> cycle_report_file || strcmp(as -> cycle_report_file, "-") == 0)
+		of = stdout;
+	else
+		of = fopen(as -> cycle_report_file, "w");
+	if (!of)
+	{
+		fprintf(stderr, "Cannot open cycle report file; cycle report not generated\n");
+		return;
+	}
+
+	memset(&cs, 0, sizeof(cs));
+	cs.as = as;
+	cyc_collect(&cs);
+	cyc_blocks(&cs);
+	for (r = 0; r < cs.nroutines; r++)
+	{
+		if (cs.routines[r].state == 0)
+			cyc_routine(&cs, r);
+	}
+
+	if (as -> cycle_report_json)
+		cyc_json(&cs, of);
+	else
+		cyc_text(&cs, of);
+	if (of != stdout)
+		fclose(of);
+
+	for (r = 0; r < cs.nroutines; r++)
+	{
+		lw_free(cs.routines[r].loops);
+		lw_free(cs.routines[r].calls);
+	}
+	lw_free(cs.routines);
+	lw_free(cs.blocks);
+	lw_free(cs.byaddr);
+	lw_free(cs.insns);
+}
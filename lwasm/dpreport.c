@@ -0,0 +1,561 @@
+/*
+dpreport.c
+
+Copyright © 2026 William Astle
+
+This file is part of LWTOOLS.
+
+LWTOOLS is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lw_alloc.h>
+#include <lw_expr.h>
+
+#include "lwasm.h"
+#include "instab.h"
+
+/*
+Direct page promotion analysis
+
+Every variable reserved with RMB (or RMD, RMQ, and friends) is a candidate
+for the direct page. Each extended or direct reference to one of them is
+counted, weighted by how deeply it is nested in loops. A loop is any
+backward branch or jump within a section; a reference inside N loops counts
+10^N times (N is capped at DP_MAXDEPTH). The value of a variable is the
+weighted number of cycles direct addressing saves over extended addressing
+for all its references.
+
+Variables are then packed into one page by value per byte. The result is
+only a proposal: lwasm cannot move the variables itself since their
+definitions are the programmer's. The layout can be written out as source
+for the programmer to include in place of the original definitions.
+*/
+
+#define DP_MAXDEPTH 5
+
+PARSEFUNC(pseudo_parse_rmb);
+PARSEFUNC(pseudo_parse_rmd);
+PARSEFUNC(pseudo_parse_rmq);
+
+typedef struct
+{
+	line_t *cl;
+	char *name;
+	sectiontab_t *sect;
+	int addr;
+	int size;
+	int next, ndir;						// extended and direct references
+	unsigned long cext, cdir;			// weighted cycles direct addressing saves for each
+	unsigned long cycles;				// the total of both
+	int chosen;
+	int newaddr;						// offset in the proposed page
+} dpvar_t;
+
+typedef struct
+{
+	sectiontab_t *sect;
+	int start, end;						// addresses of the target and the branch
+} dploop_t;
+
+typedef struct
+{
+	line_t *cl;
+	sectiontab_t *sect;
+	int addr;
+} dpinsn_t;
+
+typedef struct
+{
+	asmstate_t *as;
+	dpvar_t *vars;
+	int nvars;
+	dploop_t *loops;
+	int nloops;
+	dpinsn_t *insns;
+	int ninsns;
+	unsigned long pages[256];			// weighted references made with each DP setting
+	int page;
+	int nchosen;
+	int used;
+	long bytes;							// expected savings
+	long cycles;
+} dpstate_t;
+
+struct dp_secttest
+{
+	sectiontab_t *sect;
+	int other;
+};
+
+static int dp_secttest(lw_expr_t e, void *p)
+{
+	struct dp_secttest *st = p;
+
+	if (lw_expr_istype(e, lw_expr_type_special) && lw_expr_specint(e) == lwasm_expr_secbase)
+	{
+		if (!st -> sect)
+			st -> sect = lw_expr_specptr(e);
+		else if (lw_expr_specptr(e) != st -> sect)
+			st -> other = 1;
+	}
+	return 0;
+}
+
+// value of e as an offset in the one section it refers to, if any
+static int dp_eval(asmstate_t *as, lw_expr_t e, sectiontab_t **sect, int *v)
+{
+	struct dp_secttest st;
+	lw_expr_t te;
+	int r = 0;
+
+	if (!e)
+		return 0;
+	te = lw_expr_copy(e);
+	st.sect = NULL;
+	st.other = 0;
+	lw_expr_testterms(te, dp_secttest, &st);
+	if (!st.other)
+	{
+		as -> exportcheck = 1;
+		as -> csect = st.sect;
+		lwasm_reduce_expr(as, te);
+		as -> exportcheck = 0;
+		if (lw_expr_istype(te, lw_expr_type_int))
+		{
+			*sect = st.sect;
+			*v = lw_expr_intval(te) & 0xffff;
+			r = 1;
+		}
+	}
+	lw_expr_destroy(te);
+	return r;
+}
+
+static int dp_islocal(line_t *cl, char *sym)
+{
+	for (; *sym; sym++)
+	{
+		if (*sym == '@' || *sym == '?')
+			return 1;
+		if (*sym == '$' && !CURPRAGMA(cl, PRAGMA_DOLLARNOTLOCAL))
+			return 1;
+	}
+	return 0;
+}
+
+static int dp_isreserve(line_t *cl)
+{
+	void (*fn)(asmstate_t *, line_t *, char **);
+
+	if (cl -> insn < 0)
+		return 0;
+	fn = instab[cl -> insn].parse;
+	return fn == pseudo_parse_rmb || fn == pseudo_parse_rmd || fn == pseudo_parse_rmq;
+}
+
+// the opcode of an instruction, including any prefix byte
+static int dp_opcode(line_t *cl)
+{
+	if (cl -> outputl >= 2 && (cl -> output[0] == 0x10 || cl -> output[0] == 0x11))
+		return (cl -> output[0] << 8) | cl -> output[1];
+	return cl -> output[0];
+}
+
+// 1 for extended addressing, 2 for direct addressing, 0 for anything else
+static int dp_mode(int opc)
+{
+	switch (opc & 0xf0)
+	{
+	case 0x70:
+	case 0xb0:
+	case 0xf0:
+		return 1;
+
+	case 0x00:
+	case 0x90:
+	case 0xd0:
+		return 2;
+	}
+	return 0;
+}
+
+// cycles saved by the direct form of an extended opcode
+static int dp_saving(int extopc, int is6309)
+{
+	int diropc, e, d;
+
+	diropc = ((extopc & 0xf0) == 0x70) ? extopc - 0x70 : extopc - 0x20;
+	e = lwasm_cycle_lookup(extopc, is6309, NULL);
+	d = lwasm_cycle_lookup(diropc, is6309, NULL);
+	if (e < 0 || d < 0 || e <= d)
+		return 1;
+	return e - d;
+}
+
+static int dp_varcmp(const void *a, const void *b)
+{
+	const dpvar_t *x = a, *y = b;
+
+	if (x -> sect != y -> sect)
+		return (x -> sect < y -> sect) ? -1 : 1;
+	return x -> addr - y -> addr;
+}
+
+static dpvar_t *dp_findvar(dpstate_t *ds, sectiontab_t *sect, int addr)
+{
+	int lo = 0, hi = ds -> nvars - 1, mid;
+	dpvar_t *v;
+
+	while (lo <= hi)
+	{
+		mid = (lo + hi) / 2;
+		v = &ds -> vars[mid];
+		if (v -> sect == sect && addr >= v -> addr && addr < v -> addr + v -> size)
+			return v;
+		if (v -> sect < sect || (v -> sect == sect && v -> addr < addr))
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	return NULL;
+}
+
+// gather the reserved variables and the instructions
+static void dp_collect(dpstate_t *ds)
+{
+	asmstate_t *as = ds -> as;
+	line_t *cl;
+	sectiontab_t *sect;
+	int addr;
+
+	for (cl = as -> line_head; cl; cl = cl -> next)
+	{
+		if (dp_isreserve(cl))
+		{
+			if (!cl -> sym || cl -> symset || cl -> lint || cl -> inmod || cl -> len <= 0)
+				continue;
+			if (dp_islocal(cl, cl -> sym))
+				continue;
+			if (!dp_eval(as, cl -> addr, &sect, &addr))
+				continue;
+			ds -> vars = lw_realloc(ds -> vars, sizeof(dpvar_t) * (ds -> nvars + 1));
+			memset(&ds -> vars[ds -> nvars], 0, sizeof(dpvar_t));
+			ds -> vars[ds -> nvars].cl = cl;
+			ds -> vars[ds -> nvars].name = cl -> sym;
+			ds -> vars[ds -> nvars].sect = sect;
+			ds -> vars[ds -> nvars].addr = addr;
+			ds -> vars[ds -> nvars].size = cl -> len;
+			ds -> nvars++;
+			continue;
+		}
+		if (cl -> insn < 0 || cl -> outputl <= 0 || cl -> cycle_base <= 0)
+			continue;
+		if (!dp_eval(as, cl -> addr, &sect, &addr))
+			continue;
+		ds -> insns = lw_realloc(ds -> insns, sizeof(dpinsn_t) * (ds -> ninsns + 1));
+		ds -> insns[ds -> ninsns].cl = cl;
+		ds -> insns[ds -> ninsns].sect = sect;
+		ds -> insns[ds -> ninsns].addr = addr;
+		ds -> ninsns++;
+	}
+	qsort(ds -> vars, ds -> nvars, sizeof(dpvar_t), dp_varcmp);
+}
+
+// find the loops: branches and jumps back to an earlier address
+static void dp_loops(dpstate_t *ds)
+{
+	dpinsn_t *di;
+	unsigned char *o;
+	sectiontab_t *sect;
+	int i, opc, disp, target;
+
+	for (i = 0; i < ds -> ninsns; i++)
+	{
+		di = &ds -> insns[i];
+		o = di -> cl -> output;
+		opc = dp_opcode(di -> cl);
+		if (opc >= 0x20 && opc <= 0x2f && opc != 0x21 && di -> cl -> outputl == 2)
+		{
+			disp = (signed char)o[1];
+		}
+		else if (opc == 0x16 && di -> cl -> outputl == 3)
+		{
+			disp = (short)((o[1] << 8) | o[2]);
+		}
+		else if (opc >= 0x1022 && opc <= 0x102f && di -> cl -> outputl == 4)
+		{
+			disp = (short)((o[2] << 8) | o[3]);
+		}
+		else if (opc == 0x7e || opc == 0x0e)
+		{
+			if (!dp_eval(ds -> as, lwasm_fetch_expr(di -> cl, 0), &sect, &target) || sect != di -> sect)
+				continue;
+			disp = target - di -> addr - di -> cl -> outputl;
+		}
+		else
+		{
+			continue;
+		}
+		target = (di -> addr + di -> cl -> outputl + disp) & 0xffff;
+		if (target > di -> addr)
+			continue;
+		ds -> loops = lw_realloc(ds -> loops, sizeof(dploop_t) * (ds -> nloops + 1));
+		ds -> loops[ds -> nloops].sect = di -> sect;
+		ds -> loops[ds -> nloops].start = target;
+		ds -> loops[ds -> nloops].end = di -> addr;
+		ds -> nloops++;
+	}
+}
+
+static unsigned long dp_weight(dpstate_t *ds, dpinsn_t *di)
+{
+	unsigned long w = 1;
+	int i, depth = 0;
+
+	for (i = 0; i < ds -> nloops; i++)
+	{
+		if (ds -> loops[i].sect == di -> sect && di -> addr >= ds -> loops[i].start && di -> addr <= ds -> loops[i].end)
+			depth++;
+	}
+	if (depth > DP_MAXDEPTH)
+		depth = DP_MAXDEPTH;
+	while (depth--)
+		w *= 10;
+	return w;
+}
+
+// count the references to each variable
+static void dp_refs(dpstate_t *ds)
+{
+	dpinsn_t *di;
+	dpvar_t *v;
+	sectiontab_t *sect;
+	unsigned long w;
+	int i, opc, mode, addr, is6309;
+
+	for (i = 0; i < ds -> ninsns; i++)
+	{
+		di = &ds -> insns[i];
+		opc = dp_opcode(di -> cl);
+		mode = dp_mode(opc);
+		if (!mode)
+			continue;
+		if (!dp_eval(ds -> as, lwasm_fetch_expr(di -> cl, 0), &sect, &addr))
+			continue;
+		v = dp_findvar(ds, sect, addr);
+		if (!v)
+			continue;
+		w = dp_weight(ds, di);
+		is6309 = !CURPRAGMA(di -> cl, PRAGMA_6809);
+		ds -> pages[di -> cl -> dpval & 0xff] += w;
+		if (mode == 1)
+		{
+			v -> next++;
+			v -> cext += w * dp_saving(opc, is6309);
+		}
+		else
+		{
+			v -> ndir++;
+			v -> cdir += w * dp_saving(opc + (((opc & 0xf0) == 0x00) ? 0x70 : 0x20), is6309);
+		}
+		v -> cycles = v -> cext + v -> cdir;
+	}
+}
+
+static dpstate_t *dp_sortstate;
+
+// most valuable per byte first
+static int dp_valuecmp(const void *a, const void *b)
+{
+	dpvar_t *x = &dp_sortstate -> vars[*(const int *)a];
+	dpvar_t *y = &dp_sortstate -> vars[*(const int *)b];
+	unsigned long long vx = (unsigned long long)x -> cycles * y -> size;
+	unsigned long long vy = (unsigned long long)y -> cycles * x -> size;
+
+	if (vx != vy)
+		return (vx > vy) ? -1 : 1;
+	if (x -> cycles != y -> cycles)
+		return (x -> cycles > y -> cycles) ? -1 : 1;
+	return x -> cl -> lineno - y -> cl -> lineno;
+}
+
+// pick the variables for the page
+static int *dp_choose(dpstate_t *ds)
+{
+	int *order;
+	dpvar_t *v;
+	int i;
+	unsigned long best = 0;
+
+	order = lw_alloc(sizeof(int) * (ds -> nvars + 1));
+	for (i = 0; i < ds -> nvars; i++)
+		order[i] = i;
+	dp_sortstate = ds;
+	qsort(order, ds -> nvars, sizeof(int), dp_valuecmp);
+
+	for (i = 0; i < 256; i++)
+	{
+		if (ds -> pages[i] > best)
+		{
+			best = ds -> pages[i];
+			ds -> page = i;
+		}
+	}
+
+	for (i = 0; i < ds -> nvars; i++)
+	{
+		v = &ds -> vars[order[i]];
+		if (v -> cycles == 0 || v -> size > 256 - ds -> used)
+		{
+			// references that are direct now have to go extended
+			ds -> bytes -= v -> ndir;
+			ds -> cycles -= v -> cdir;
+			continue;
+		}
+		v -> chosen = 1;
+		v -> newaddr = ds -> used;
+		ds -> used += v -> size;
+		ds -> nchosen++;
+		ds -> bytes += v -> next;
+		ds -> cycles += v -> cext;
+	}
+	return order;
+}
+
+static void dp_where(dpvar_t *v, char *buf)
+{
+	if (v -> sect)
+		sprintf(buf, "%.12s+$%04X", v -> sect -> name, v -> addr);
+	else
+		sprintf(buf, "$%04X", v -> addr);
+}
+
+static void dp_text(dpstate_t *ds, int *order, FILE *of)
+{
+	dpvar_t *v;
+	char where[32];
+	int i;
+
+	fprintf(of, "Direct page analysis (references in loops count 10 times per level)\n\n");
+	if (ds -> nvars == 0)
+	{
+		fprintf(of, "No variables reserved with RMB or similar\n");
+		return;
+	}
+	fprintf(of, "%-24s %5s %5s %5s %10s  %-18s %s\n", "Variable", "Size", "Ext", "Dir", "Cycles", "Address", "Proposed");
+	for (i = 0; i < ds -> nvars; i++)
+	{
+		v = &ds -> vars[order[i]];
+		dp_where(v, where);
+		fprintf(of, "%-24s %5d %5d %5d %10lu  %-18s ", v -> name, v -> size, v -> next, v -> ndir, v -> cycles, where);
+		if (v -> chosen)
+			fprintf(of, "$%04X\n", (ds -> page << 8) + v -> newaddr);
+		else
+			fprintf(of, "-\n");
+	}
+	fprintf(of, "\nProposed direct page $%02X: %d variable%s, %d of 256 bytes\n", ds -> page, ds -> nchosen, ds -> nchosen == 1 ? "" : "s", ds -> used);
+	fprintf(of, "Expected savings: %ld bytes, %ld weighted cycles\n", ds -> bytes, ds -> cycles);
+}
+
+static void dp_layout(dpstate_t *ds, int *order, FILE *of)
+{
+	dpvar_t *v;
+	int i;
+
+	fprintf(of, "; Direct page layout proposed by lwasm\n");
+	fprintf(of, "; Remove the original definitions of these variables and use this instead.\n");
+	if (ds -> as -> output_format == OUTPUT_OBJ)
+	{
+		fprintf(of, "; Reference the variables with < and place the section in the direct page\n");
+		fprintf(of, "; when linking, for instance with --dp-section=dp.\n");
+		fprintf(of, "\tsection\tdp\n");
+	}
+	else
+	{
+		fprintf(of, "; Put this ahead of the first ORG in the program.\n");
+		fprintf(of, "\tsetdp\t$%02X\n", ds -> page);
+		fprintf(of, "\torg\t$%04X\n", ds -> page << 8);
+	}
+	for (i = 0; i < ds -> nvars; i++)
+	{
+		v = &ds -> vars[order[i]];
+		if (!v -> chosen)
+			continue;
+		fprintf(of, "%s\trmb\t%d\t; %d extended, %d direct references\n", v -> name, v -> size, v -> next, v -> ndir);
+	}
+	if (ds -> as -> output_format == OUTPUT_OBJ)
+		fprintf(of, "\tendsection\n");
+}
+
+void do_dpreport(asmstate_t *as)
+{
+	dpstate_t ds;
+	FILE *of;
+	int *order;
+
+	if (!(as -> flags & FLAG_DPREPORT) || (as -> flags & FLAG_DEPEND))
+		return;
+
+	memset(&ds, 0, sizeof(ds));
+	ds.as = as;
+	dp_collect(&ds);
+	dp_loops(&ds);
+	dp_refs(&ds);
+	order = dp_choose(&ds);
+
+	if (as -> dp_report_file)
+	{
+		if (strcmp(as -> dp_report_file, "-") == 0)
+			of = stdout;
+		else
+			of = fopen(as -> dp_report_file, "w");
+		if (!of)
+		{
+			fprintf(stderr, "Cannot open direct page report file; report not generated\n");
+		}
+		else
+		{
+			dp_text(&ds, order, of);
+			if (of != stdout)
+				fclose(of);
+		}
+	}
+
+	if (as -> dp_layout_file)
+	{
+		if (strcmp(as -> dp_layout_file, "-") == 0)
+			of = stdout;
+		else
+			of = fopen(as -> dp_layout_file, "w");
+		if (!of)
+		{
+			fprintf(stderr, "Cannot open direct page layout file; layout not generated\n");
+		}
+		else
+		{
+			dp_layout(&ds, order, of);
+			if (of != stdout)
+				fclose(of);
+		}
+	}
+
+	lw_free(order);
+	lw_free(ds.vars);
+	lw_free(ds.loops);
+	lw_free(ds.insns);
+}
@@ -28,6 +28,12 @@ less difficult.
 #include <errno.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
 
 #include <lw_alloc.h>
 #include <lw_stringlist.h>
@@ -129,6 +135,179 @@ void input_add_to_resource_list(asmstate_t *as, const char *s)
 	}
 }
 
+/*
+Include file cache for batch and server modes (see batch.c and server.c).
+The parent reads each include file a job reports into memory; jobs started
+after that get a copy of the cache and read the file from there instead of
+from disk. Files are known by their full path, since server requests each
+have their own working directory.
+
+A cached copy is only used if the file's modification time and size are
+unchanged. A file modified in the same second it was read could change
+again without its modification time changing, so such a copy is not used
+until the file has been read again; if the contents are the same (by hash),
+the copy is kept.
+*/
+struct input_cache
+{
+	char *fn;
+	char *data;
+	long len;
+	time_t mtime;					// modification time when read
+	unsigned long hash;				// hash of the contents
+	int racy;						// modified in the second it was read
+	struct input_cache *next;
+};
+
+static struct input_cache *input_cache_head = NULL;
+static FILE *input_cache_report = NULL;
+
+/* report include files opened from disk to f */
+void input_cache_setreport(FILE *f)
+{
+	input_cache_report = f;
+}
+
+#if !defined(WIN32) && !defined(WIN64)
+/* return the current directory in allocated memory */
+char *input_getcwd(void)
+{
+	char *buf = NULL;
+	int size = 256;
+
+	for (;;)
+	{
+		buf = lw_realloc(buf, size);
+		if (getcwd(buf, size))
+			return buf;
+		if (errno != ERANGE)
+		{
+			strcpy(buf, ".");
+			return buf;
+		}
+		size *= 2;
+	}
+}
+
+/* the full path of fn, in allocated memory */
+static char *input_cache_path(const char *fn)
+{
+	char *cwd, *r;
+
+	if (fn[0] == '/')
+		return lw_strdup(fn);
+	cwd = input_getcwd();
+	r = lw_alloc(strlen(cwd) + strlen(fn) + 2);
+	sprintf(r, "%s/%s", cwd, fn);
+	lw_free(cwd);
+	return r;
+}
+#endif
+
+static unsigned long input_cache_hash(const char *data, long len)
+{
+	unsigned long h = 2166136261UL;
+
+	while (len-- > 0)
+		h = (h ^ (unsigned char)*data++) * 16777619UL;
+	return h & 0xffffffffUL;
+}
+
+void input_cache_add(const char *fn)
+{
+	struct input_cache *ic;
+	struct stat st;
+	FILE *fp;
+	char *data;
+	long len;
+
+	for (ic = input_cache_head; ic; ic = ic -> next)
+	{
+		if (strcmp(fn, ic -> fn) == 0)
+			break;
+	}
+	if (stat(fn, &st) != 0)
+		return;
+	if (ic && !(ic -> racy) && ic -> mtime == st.st_mtime && ic -> len == (long)st.st_size)
+		return;
+
+	fp = fopen(fn, "rb");
+	if (!fp)
+		return;
+	fseek(fp, 0, SEEK_END);
+	len = ftell(fp);
+	rewind(fp);
+	// an empty file cannot be opened from memory; leave it on disk
+	if (len <= 0)
+	{
+		fclose(fp);
+		return;
+	}
+	data = lw_alloc(len);
+	if ((long)fread(data, 1, len, fp) != len)
+	{
+		fclose(fp);
+		lw_free(data);
+		return;
+	}
+	fclose(fp);
+
+	if (!ic)
+	{
+		ic = lw_alloc(sizeof(struct input_cache));
+		ic -> fn = lw_strdup(fn);
+		ic -> data = NULL;
+		ic -> len = -1;
+		ic -> next = input_cache_head;
+		input_cache_head = ic;
+	}
+	if (ic -> len == len && ic -> hash == input_cache_hash(data, len))
+	{
+		lw_free(data);
+	}
+	else
+	{
+		lw_free(ic -> data);
+		ic -> data = data;
+		ic -> len = len;
+		ic -> hash = input_cache_hash(data, len);
+	}
+	ic -> mtime = st.st_mtime;
+	ic -> racy = (st.st_mtime >= time(NULL));
+}
+
+static FILE *input_fopen_include(const char *fn)
+{
+	FILE *fp;
+#if !defined(WIN32) && !defined(WIN64)
+	struct input_cache *ic;
+	struct stat st;
+	char *path = NULL;
+
+	if (input_cache_head || input_cache_report)
+		path = input_cache_path(fn);
+	for (ic = input_cache_head; ic; ic = ic -> next)
+	{
+		if (strcmp(path, ic -> fn) == 0)
+		{
+			if (!(ic -> racy) && stat(fn, &st) == 0 && st.st_mtime == ic -> mtime && (long)st.st_size == ic -> len)
+			{
+				lw_free(path);
+				return fmemopen(ic -> data, ic -> len, "r");
+			}
+			break;
+		}
+	}
+	fp = fopen(fn, "rb");
+	if (fp && input_cache_report)
+		fprintf(input_cache_report, "%s\n", path);
+	lw_free(path);
+#else
+	fp = fopen(fn, "rb");
+#endif
+	return fp;
+}
+
 void input_init(asmstate_t *as)
 {
 	struct input_stack *t;
@@ -238,7 +417,7 @@ void input_open(asmstate_t *as, char *s)
 		if (input_isabsolute(s))
 		{
 			/* absolute path */
-			IS -> data = fopen(s, "rb");
+			IS -> data = input_fopen_include(s);
 			debug_message(as, 1, "Opening (abs) %s", s);
 			if (!IS -> data && !IGNOREERROR)
 			{
@@ -257,7 +436,7 @@ void input_open(asmstate_t *as, char *s)
 		p = lw_stack_top(as -> file_dir);
 		p2 = make_filename(p, s);
 		debug_message(as, 1, "Open: (cd) %s\n", p2);
-		IS -> data = fopen(p2, "rb");
+		IS -> data = input_fopen_include(p2);
 		if (IS -> data)
 		{
 			input_pushpath(as, p2);
@@ -274,7 +453,7 @@ void input_open(asmstate_t *as, char *s)
 		{
 			p2 = make_filename(p, s);
 		debug_message(as, 1, "Open (sp): %s\n", p2);
-			IS -> data = fopen(p2, "rb");
+			IS -> data = input_fopen_include(p2);
 			if (IS -> data)
 			{
 				input_pushpath(as, p2);
@@ -297,7 +476,10 @@ void input_open(asmstate_t *as, char *s)
 		
 	case input_type_file:
 		debug_message(as, 1, "Opening (reg): %s\n", s);
-		IS -> data = fopen(s, "rb");
+		if (strcmp(s, "-") == 0)
+			IS -> data = stdin;
+		else
+			IS -> data = fopen(s, "rb");
 
 		if (!IS -> data)
 		{
@@ -421,7 +603,7 @@ nextfile:
 				{
 					struct input_stack *t;
 					struct input_stack_node *n;
-					if (IS -> data)
+					if (IS -> data && IS -> data != stdin)
 						fclose(IS -> data);
 					lw_free(lw_stack_pop(as -> file_dir));
 					lw_free(IS -> filespec);
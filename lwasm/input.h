@@ -39,6 +39,9 @@ char *input_readline(asmstate_t *as);
 char *input_curspec(asmstate_t *as);
 FILE *input_open_standalone(asmstate_t *as, char *s, char **rfn);
 int input_isinclude(asmstate_t *as);
+void input_cache_add(const char *fn);
+void input_cache_setreport(FILE *f);
+char *input_getcwd(void);
 
 struct ifl
 {
@@ -186,6 +186,13 @@ out:
 				l -> len = OPLEN(instab[l -> insn].ops[1]) + l -> lint + 1 + elen;
 		}
 	}
+	else
+	{
+		// not determined yet; let span sizing pick direct or extended
+		l -> span = SPAN_DIRECT;
+	}
+	if (l -> lint2 == 1 && l -> lint == -1)
+		l -> span = SPAN_INDEXED;
 }
 
 void insn_resolve_gen_aux(asmstate_t *as, line_t *l, int force, int elen)
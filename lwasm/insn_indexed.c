@@ -467,6 +467,8 @@ PARSEFUNC(insn_parse_indexed)
 {
 	l -> lint = -1;
 	insn_parse_indexed_aux(as, l, p);
+	l -> minlen = OPLEN(instab[l -> insn].ops[0]) + 1;
+	l -> maxlen = OPLEN(instab[l -> insn].ops[0]) + 3;
 
 	if (l -> lint != -1)
 	{
@@ -475,6 +477,10 @@ PARSEFUNC(insn_parse_indexed)
 		else
 			l -> len = OPLEN(instab[l -> insn].ops[0]) + l -> lint + 1;
 	}
+	else
+	{
+		l -> span = SPAN_INDEXED;
+	}
 }
 
 void insn_resolve_indexed_aux(asmstate_t *as, line_t *l, int force, int elen)
@@ -484,6 +490,7 @@ void insn_resolve_indexed_aux(asmstate_t *as, line_t *l, int force, int elen)
 	lw_expr_t e, e2;
 	int pb = -1;
 	int v;
+	int selfdep = 0;
 	
 	if (l -> len != -1)
 		return;
@@ -506,8 +513,22 @@ void insn_resolve_indexed_aux(asmstate_t *as, line_t *l, int force, int elen)
 		{
 			v = lw_expr_intval(e2);
 			// we have a reducible expression here which depends on
-			// the size of this instruction
-			if (v == 0 && !CURPRAGMA(l, PRAGMA_NOINDEX0TONONE) && (l -> pb & 0x07) <= 4)
+			// the size of this instruction; the no offset and 5 bit
+			// forms are a byte shorter, so if the offset changes at that
+			// size, it moves with the instruction and those forms are out
+			if (v >= -16 && v <= 15)
+			{
+				lw_expr_t e3;
+				
+				e3 = lw_expr_copy(e);
+				l -> len = OPLEN(instab[l -> insn].ops[0]) + elen + 1;
+				lwasm_reduce_expr(as, e3);
+				l -> len = -1;
+				if (!lw_expr_istype(e3, lw_expr_type_int) || lw_expr_intval(e3) != v)
+					selfdep = 1;
+				lw_expr_destroy(e3);
+			}
+			if (v == 0 && !selfdep && !CURPRAGMA(l, PRAGMA_NOINDEX0TONONE) && (l -> pb & 0x07) <= 4)
 			{
 				if ((l -> pb & 0x07) < 4)
 				{
@@ -549,7 +570,7 @@ void insn_resolve_indexed_aux(asmstate_t *as, line_t *l, int force, int elen)
 //				lw_expr_destroy(e3);
 				return;
 			}
-			else if ((l -> pb & 0x80) || ((l -> pb & 0x07) > 3) || v < -16 || v > 15)
+			else if (selfdep || (l -> pb & 0x80) || ((l -> pb & 0x07) > 3) || v < -16 || v > 15)
 			{
 				// if not a 5 bit value, is indirect, or is not X,Y,U,S
 				l -> lint = 1;
@@ -564,7 +585,7 @@ void insn_resolve_indexed_aux(asmstate_t *as, line_t *l, int force, int elen)
 			
 				case 4: // W
 					// use 16 bit because W doesn't have 8 bit, unless 0
-					if (v == 0 && !(CURPRAGMA(l, PRAGMA_NOINDEX0TONONE) || l -> pb & 0x40))
+					if (v == 0 && !selfdep && !(CURPRAGMA(l, PRAGMA_NOINDEX0TONONE) || l -> pb & 0x40))
 					{
 						pb = (l -> pb & 0x80) ? 0x90 : 0x8F;
 						l -> lint = 0;
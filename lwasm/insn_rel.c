@@ -192,6 +192,10 @@ PARSEFUNC(insn_parse_relgen)
 		}
 		lw_expr_destroy(e1);
 	}
+
+	// still unknown; let span sizing pick the branch length
+	if (l -> len == -1 && !(l -> conditional_return))
+		l -> span = SPAN_REL;
 }
 
 RESOLVEFUNC(insn_resolve_relgen)
@@ -20,7 +20,12 @@ this program. If not, see <http://www.gnu.org/licenses/>.
 
 Contains the instruction table for assembling code
 */
+#include <ctype.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <lw_alloc.h>
+
 #include "instab.h"
 
 // inherent
@@ -674,7 +679,7 @@ instab_t instab[] =
 	{ "fdb",		{	-1, 	-1, 	-1, 	-1 },	pseudo_parse_fdb,		pseudo_resolve_fdb,				pseudo_emit_fdb,			lwasm_insn_normal},
 	{ "fdbs",		{	-1, 	-1, 	-1, 	-1 },	pseudo_parse_fdbs,		pseudo_resolve_fdbs,			pseudo_emit_fdbs,			lwasm_insn_normal},
 	{ "fqb",		{	-1, 	-1, 	-1, 	-1 },	pseudo_parse_fqb,		pseudo_resolve_fqb,				pseudo_emit_fqb,			lwasm_insn_normal},
-	{ "end", 		{	-1, 	-1, 	-1, 	-1 },	pseudo_parse_end,		pseudo_resolve_end,				pseudo_emit_end,			lwasm_insn_normal},
+	{ "end", 		{	-1, 	-1, 	-1, 	-1 },	pseudo_parse_end,		pseudo_resolve_end,				pseudo_emit_end,			lwasm_insn_serial},
 
 	{ "includebin", {	-1, 	-1, 	-1, 	-1},	pseudo_parse_includebin,pseudo_resolve_includebin,		pseudo_emit_includebin,		lwasm_insn_normal},
 	{ "includestr", {   -1,     -1,     -1,     -1},    pseudo_parse_includestr,pseudo_resolve_includestr,      pseudo_emit_includestr,     lwasm_insn_normal},
@@ -740,8 +745,8 @@ instab_t instab[] =
 	
 	// for os9 target
 	{ "os9",		{	-1, 	-1, 	-1, 	-1 },	pseudo_parse_os9,		pseudo_resolve_os9,				pseudo_emit_os9,			lwasm_insn_normal},
-	{ "mod",		{	-1, 	-1, 	-1, 	-1 },	pseudo_parse_mod,		pseudo_resolve_mod,				pseudo_emit_mod,			lwasm_insn_normal},
-	{ "emod",		{	-1, 	-1, 	-1, 	-1 },	pseudo_parse_emod,		pseudo_resolve_emod,			pseudo_emit_emod,			lwasm_insn_normal},
+	{ "mod",		{	-1, 	-1, 	-1, 	-1 },	pseudo_parse_mod,		pseudo_resolve_mod,				pseudo_emit_mod,			lwasm_insn_serial},
+	{ "emod",		{	-1, 	-1, 	-1, 	-1 },	pseudo_parse_emod,		pseudo_resolve_emod,			pseudo_emit_emod,			lwasm_insn_serial},
 
 	// for compatibility with gcc6809 output...
 
@@ -773,7 +778,7 @@ instab_t instab[] =
 	{ ".rs",		{	-1, 	-1, 	-1, 	-1},	pseudo_parse_rmb,		pseudo_resolve_rmb,				pseudo_emit_rmb,			lwasm_insn_struct | lwasm_insn_setdata},
 
 	// for compatibility
-	{ ".end", 		{	-1, 	-1, 	-1, 	-1 },	pseudo_parse_end,		pseudo_resolve_end,				pseudo_emit_end,			lwasm_insn_normal},
+	{ ".end", 		{	-1, 	-1, 	-1, 	-1 },	pseudo_parse_end,		pseudo_resolve_end,				pseudo_emit_end,			lwasm_insn_serial},
 
 	// date and time stamps
 	{ "dts",		{	-1,		-1,		-1,		-1 },	pseudo_parse_dts,		pseudo_resolve_dts,				pseudo_emit_dts,			lwasm_insn_normal},
@@ -820,3 +825,67 @@ instab_t instab[] =
 	// flag end of table
 	{ NULL,			{	-1, 	-1, 	-1, 	-1 },	NULL,					NULL,							NULL,						lwasm_insn_normal}
 };
+
+/*
+Index of the table by mnemonic so finding an operation does not compare it
+against every entry. Each hash chain lists its entries in table order, so
+the first match that passes the caller's checks is the same entry a scan
+of the whole table would find. The index is built on first use; server
+mode builds it once before taking requests.
+*/
+#define INSTAB_HASHSIZE	1024
+
+static int instab_hash[INSTAB_HASHSIZE];
+static int *instab_chain;
+static int instab_end = -1;
+
+static unsigned int instab_hashfn(const char *opc)
+{
+	unsigned int h = 0;
+
+	for (; *opc; opc++)
+		h = h * 31 + tolower((unsigned char)*opc);
+	return h % INSTAB_HASHSIZE;
+}
+
+void instab_init(void)
+{
+	int i, h;
+
+	if (instab_end >= 0)
+		return;
+	for (instab_end = 0; instab[instab_end].opcode; instab_end++)
+		/* do nothing */ ;
+	instab_chain = lw_alloc(sizeof(int) * instab_end);
+	for (i = 0; i < INSTAB_HASHSIZE; i++)
+		instab_hash[i] = -1;
+	// add in reverse so each chain ends up in table order
+	for (i = instab_end - 1; i >= 0; i--)
+	{
+		h = instab_hashfn(instab[i].opcode);
+		instab_chain[i] = instab_hash[h];
+		instab_hash[h] = i;
+	}
+}
+
+/*
+Return the next entry after prev (or the first if prev is -1) for the
+mnemonic opc, ignoring case, or the index of the end of table marker if
+there are no more.
+*/
+int instab_find(const char *opc, int prev)
+{
+	int i;
+
+	instab_init();
+	if (prev < 0)
+		i = instab_hash[instab_hashfn(opc)];
+	else
+		i = instab_chain[prev];
+	for (; i >= 0; i = instab_chain[i])
+	{
+		if (!strcasecmp(instab[i].opcode, opc))
+			return i;
+	}
+	return instab_end;
+}
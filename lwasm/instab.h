@@ -50,6 +50,7 @@ enum
 	lwasm_insn_is6309conv	= 1 << 9,	/* insn is 6309 convenience only */
 	lwasm_insn_isemuext		= 1 << 10,	/* insn is an emulator extension */
 	lwasm_insn_org                  = 1 << 11,      /* insn sets assembly address */
+	lwasm_insn_serial		= 1 << 12,	/* emit uses assembler-wide state; never run on a worker thread */
 	lwasm_insn_normal		= 0
 };
 
@@ -60,4 +61,7 @@ enum
 
 extern instab_t instab[];
 
+void instab_init(void);
+int instab_find(const char *opc, int prev);
+
 #endif //__instab_h_seen__
@@ -0,0 +1,122 @@
+/*
+job.c
+
+Copyright © 2026 William Astle
+
+This file is part of LWTOOLS.
+
+LWTOOLS is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+Child assemblies for batch and server modes
+
+A job is one assembly run by a child copy of lwasm, forked from the batch
+or server process so it starts with that process's state and leaves it
+untouched. The child's standard output and standard error go to temporary
+files, and it reports the include files it reads (and, for the server, the
+output files it writes) to more of them. The parent waits for the child
+itself; then it replays or forwards the captured output and adds the
+include files to its cache.
+*/
+
+#if !defined(WIN32) && !defined(WIN64)
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "job.h"
+#include "input.h"
+
+int lwasm_main(int argc, char **argv);
+void output_setreport(FILE *f);
+
+/*
+Start a child running lwasm_main(argc, argv) in dir (or the current
+directory if dir is NULL). If outputs is nonzero, j -> outputs collects the
+names of the output files; otherwise it is NULL. Returns the child's pid,
+which is also in j -> pid, or -1 if the child cannot be started.
+*/
+pid_t job_start(struct lwasm_job *j, int argc, char **argv, const char *dir, int outputs)
+{
+	j -> out = tmpfile();
+	j -> err = tmpfile();
+	j -> results = tmpfile();
+	j -> outputs = outputs ? tmpfile() : NULL;
+	if (!(j -> out) || !(j -> err) || !(j -> results) || (outputs && !(j -> outputs)))
+	{
+		fprintf(stderr, "Failed to create temporary file: %s\n", strerror(errno));
+		exit(1);
+	}
+
+	/* make sure nothing buffered gets output twice */
+	fflush(NULL);
+
+	j -> pid = fork();
+	if (j -> pid != 0)
+		return j -> pid;
+
+	/* child process */
+	dup2(fileno(j -> out), 1);
+	dup2(fileno(j -> err), 2);
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+	signal(SIGHUP, SIG_DFL);
+	signal(SIGPIPE, SIG_DFL);
+	if (dir && chdir(dir) != 0)
+	{
+		fprintf(stderr, "Cannot change to directory %s: %s\n", dir, strerror(errno));
+		exit(1);
+	}
+	input_cache_setreport(j -> results);
+	if (j -> outputs)
+		output_setreport(j -> outputs);
+	exit(lwasm_main(argc, argv));
+}
+
+/* copy the contents of a capture file to f and close it */
+void job_replay(FILE *cf, FILE *f)
+{
+	char buf[4096];
+	size_t n;
+
+	rewind(cf);
+	while ((n = fread(buf, 1, sizeof(buf), cf)) > 0)
+		fwrite(buf, 1, n, f);
+	fclose(cf);
+}
+
+/* add the include files a finished job read to the cache */
+void job_cacheresults(struct lwasm_job *j)
+{
+	char *line = NULL;
+	size_t linesize = 0;
+	ssize_t len;
+
+	rewind(j -> results);
+	while ((len = getline(&line, &linesize, j -> results)) > 0)
+	{
+		if (line[len - 1] == '\n')
+			line[--len] = '\0';
+		input_cache_add(line);
+	}
+	free(line);
+	fclose(j -> results);
+}
+
+#endif
@@ -0,0 +1,42 @@
+/*
+job.h
+
+Copyright © 2026 William Astle
+
+This file is part of LWTOOLS.
+
+LWTOOLS is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ___job_h_seen___
+#define ___job_h_seen___
+
+#include <stdio.h>
+#include <sys/types.h>
+
+// a child copy of lwasm running one assembly (see job.c)
+struct lwasm_job
+{
+	pid_t pid;				// the child process
+	FILE *out;				// captured standard output
+	FILE *err;				// captured standard error
+	FILE *results;			// include files read by the child
+	FILE *outputs;			// output files written by the child, if wanted
+};
+
+pid_t job_start(struct lwasm_job *j, int argc, char **argv, const char *dir, int outputs);
+void job_replay(FILE *cf, FILE *f);
+void job_cacheresults(struct lwasm_job *j);
+
+#endif /* ___job_h_seen___ */
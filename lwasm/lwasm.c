@@ -453,29 +453,33 @@ void lwasm_emit(line_t *cl, int byte)
 	}
 	cl -> output[cl -> outputl++] = byte & 0xff;
 	
-	if (cl -> inmod)
+	// a worker thread's module lines are added to the CRC in order
+	// after the emit pass (see pass7.c)
+	if (cl -> inmod && !(cl -> as -> parallel))
+		lwasm_crc_update(cl -> as, byte);
+}
+
+void lwasm_crc_update(asmstate_t *as, int byte)
+{
+	// update module CRC
+	// this is a direct transliteration from the nitros9 asm source
+	// to C; it can, no doubt, be optimized for 32 bit processing  
+	byte &= 0xff;
+
+	byte ^= (as -> crc)[0];
+	(as -> crc)[0] = (as -> crc)[1];
+	(as -> crc)[1] = (as -> crc)[2];
+	(as -> crc)[1] ^= (byte >> 7);
+	(as -> crc)[2] = (byte << 1); 
+	(as -> crc)[1] ^= (byte >> 2);
+	(as -> crc)[2] ^= (byte << 6);
+	byte ^= (byte << 1);
+	byte ^= (byte << 2);
+	byte ^= (byte << 4);
+	if (byte & 0x80) 
 	{
-		asmstate_t *as = cl -> as;
-		// update module CRC
-		// this is a direct transliteration from the nitros9 asm source
-		// to C; it can, no doubt, be optimized for 32 bit processing  
-		byte &= 0xff;
-
-		byte ^= (as -> crc)[0];
-		(as -> crc)[0] = (as -> crc)[1];
-		(as -> crc)[1] = (as -> crc)[2];
-		(as -> crc)[1] ^= (byte >> 7);
-		(as -> crc)[2] = (byte << 1); 
-		(as -> crc)[1] ^= (byte >> 2);
-		(as -> crc)[2] ^= (byte << 6);
-		byte ^= (byte << 1);
-		byte ^= (byte << 2);
-		byte ^= (byte << 4);
-		if (byte & 0x80) 
-		{
-			(as -> crc)[0] ^= 0x80;
-		    (as -> crc)[2] ^= 0x21;
-		}
+		(as -> crc)[0] ^= 0x80;
+	    (as -> crc)[2] ^= 0x21;
 	}
 }
 
@@ -912,7 +916,11 @@ lw_expr_t lwasm_parse_expr(asmstate_t *as, char **p)
 
 int lwasm_reduce_expr(asmstate_t *as, lw_expr_t expr)
 {
-	if (expr)
+	if (!expr)
+		return 0;
+	if (as -> exprctx)
+		lw_expr_simplify_ctx(as -> exprctx, expr, as);
+	else
 		lw_expr_simplify(expr, as);
 	return 0;
 }
@@ -1001,6 +1009,25 @@ int lwasm_emitexpr_auxlwmod(lw_expr_t expr, void *arg)
 	return -1;
 }
 
+/*
+Relocations made by a worker thread are kept with the line and added to the
+section in line order after the emit pass so the object file does not
+depend on how the lines were divided between threads.
+*/
+static void lwasm_add_reloc(line_t *l, reloctab_t *re)
+{
+	if (l -> as -> parallel)
+	{
+		re -> next = l -> relocs;
+		l -> relocs = re;
+	}
+	else
+	{
+		re -> next = l -> csect -> reloctab;
+		l -> csect -> reloctab = re;
+	}
+}
+
 int lwasm_emitexpr(line_t *l, lw_expr_t expr, int size)
 {
 	int v = 0;
@@ -1072,8 +1099,7 @@ int lwasm_emitexpr(line_t *l, lw_expr_t expr, int size)
 
 			// add "expression" record to section table
 			re = lw_alloc(sizeof(reloctab_t));
-			re -> next = l -> csect -> reloctab;
-			l -> csect -> reloctab = re;
+			lwasm_add_reloc(l, re);
 			te = lw_expr_build(lw_expr_type_int, ol);
 			re -> offset = lw_expr_build(lw_expr_type_oper, lw_expr_oper_plus, l -> addr, te);
 			lw_expr_destroy(te);
@@ -1109,8 +1135,7 @@ int lwasm_emitexpr(line_t *l, lw_expr_t expr, int size)
 				lw_expr_destroy(te);
 				
 				re = lw_alloc(sizeof(reloctab_t));
-				re -> next = l -> csect -> reloctab;
-				l -> csect -> reloctab = re;
+				lwasm_add_reloc(l, re);
 				te = lw_expr_build(lw_expr_type_int, ol);
 				re -> offset = lw_expr_build(lw_expr_type_oper, lw_expr_oper_plus, l -> addr, te);
 				lw_expr_destroy(te);
@@ -1123,8 +1148,7 @@ int lwasm_emitexpr(line_t *l, lw_expr_t expr, int size)
 				lw_expr_destroy(te);
 				
 				re = lw_alloc(sizeof(reloctab_t));
-				re -> next = l -> csect -> reloctab;
-				l -> csect -> reloctab = re;
+				lwasm_add_reloc(l, re);
 				te = lw_expr_build(lw_expr_type_int, ol + 2);
 				re -> offset = lw_expr_build(lw_expr_type_oper, lw_expr_oper_plus, l -> addr, te);
 				lw_expr_destroy(te);
@@ -1136,8 +1160,7 @@ int lwasm_emitexpr(line_t *l, lw_expr_t expr, int size)
 			{
 				// add "expression" record to section table
 				re = lw_alloc(sizeof(reloctab_t));
-				re -> next = l -> csect -> reloctab;
-				l -> csect -> reloctab = re;
+				lwasm_add_reloc(l, re);
 				te = lw_expr_build(lw_expr_type_int, ol);
 				re -> offset = lw_expr_build(lw_expr_type_oper, lw_expr_oper_plus, l -> addr, te);
 				lw_expr_destroy(te);
@@ -80,6 +80,10 @@ enum lwasm_flags_e
 	FLAG_SYMBOLS_NOLOCALS = 0x0040,
 	FLAG_NOOUT = 0x80,
 	FLAG_SYMDUMP = 0x100,
+	FLAG_SPANSTATS = 0x200,
+	FLAG_PEEPSTATS = 0x400,
+	FLAG_CYCLEREPORT = 0x800,
+	FLAG_DPREPORT = 0x1000,
 	FLAG_NONE = 0
 };
 
@@ -115,6 +119,8 @@ enum lwasm_pragmas_e
 	PRAGMA_EMUEXT				= 1 << 26,  // enable emulator extensions
 	PRAGMA_NOOUTPUT             = 1 << 27,  // disable object code output
 	PRAGMA_NOEXPANDCOND         = 1 << 28,  // hide conditionals and skipped output in listings
+	PRAGMA_NOSPANSIZE			= 1 << 29,	// forward references on pass 1 get the maximum size instead of a guess
+	PRAGMA_PEEPHOLE				= 1 << 30,	// rewrite instruction sequences to smaller or faster equivalents
 	PRAGMA_CLEARBIT				= 1 << 31	// reserved to indicate negated pragma flag status
 };
 
@@ -259,6 +265,34 @@ struct importlist_s
 	importlist_t *next;					// next in the import list
 };
 
+enum
+{
+	SPAN_NONE = 0,						// size is not span dependent
+	SPAN_REL = 1,						// relative branch (8 or 16 bit offset)
+	SPAN_DIRECT = 2,					// direct or extended addressing
+	SPAN_INDEXED = 3					// indexed offset (none, 5, 8, or 16 bit)
+};
+
+typedef struct spanstate_s spanstate_t;
+struct spanstate_s
+{
+	int *guess;							// guessed length of each guessed line (0 if none yet)
+	int nguess;							// number of entries in guess
+	int rounds;							// number of assembly rounds done
+	int allmax;							// set to give up and use maximum lengths
+	int retry;							// set if the assembly must be redone
+};
+
+#define PEEP_MAXRULES 8
+
+typedef struct peepstats_s peepstats_t;
+struct peepstats_s
+{
+	int count;							// number of times the rule was applied
+	int bytes;							// bytes saved by the rule
+	int cycles;							// cycles saved by the rule
+};
+
 typedef enum
 {
 	CYCLE_ADJ = 1,
@@ -298,6 +332,10 @@ struct line_s
 	int lint;							// pass forward integer
 	int lint2;							// another pass forward integer
 	int conditional_return;				// for ?RTS handling (1 if RTS follows)
+	int span;							// span dependent sizing kind (SPAN_*)
+	int spanlen;						// guessed length (0 if not guessed)
+	int spanidx;						// index of the guess for this line
+	int spanpb;						// index post byte as parsed
 	asmstate_t *as;						// assembler state data ptr
 	int pragmas;						// pragmas in effect for the line
 	int context;						// the symbol context number
@@ -309,6 +347,7 @@ struct line_s
 	int dsize;							// set to 1 for 8 bit dshow value
 	int isbrpt;							// set to 1 if this line is a branch point
 	struct symtabe *dptr;				// symbol value to display
+	reloctab_t *relocs;					// relocations emitted by a worker thread, newest first
 
 	int noexpand_start;					// start of a no-expand block
 	int noexpand_end;					// end of a no-expand block
@@ -400,9 +439,14 @@ struct asmstate_s
 	int inmod;							// inside an os9 module?
 	int undefzero;						// used for handling "condundefzero"
 	int pretendmax;						// set if we need to pretend the instruction is max length
+	spanstate_t *spanstate;				// guesses carried between assembly rounds
+	int spancount;						// number of guessed lines so far
+	peepstats_t peepstats[PEEP_MAXRULES];	// peephole rule statistics
 	unsigned char crc[3];				// crc accumulator
 	int cycle_total;					// cycle count accumulator
 	int badsymerr;						// throw error on undef sym if set
+	int parallel;						// set in the copy of the state used by a worker thread
+	lw_expr_ctx_t *exprctx;				// expression context for a worker thread (NULL for the default)
 
 	line_t *line_head;					// start of lines list
 	line_t *line_tail;					// tail of lines list
@@ -421,6 +465,15 @@ struct asmstate_s
 	importlist_t *importlist;			// list of imported symbols
 	char *list_file;					// name of file to list to
 	char *symbol_dump_file;				// name of file to dump symbol table to
+	char *cycle_report_file;			// name of file for the cycle report
+	int cycle_report_json;				// write the cycle report as JSON
+	char *dp_report_file;				// name of file for the direct page report
+	char *dp_layout_file;				// name of file for the proposed direct page layout
+	char *batch_file;					// file of jobs for --batch
+	int batch_jobs;						// number of batch jobs to run at once
+	int threads;						// number of threads for the finalize and emit passes
+	char *server_socket;				// socket to listen on for --server
+	char *connect_socket;				// socket of the server for --connect
 	int tabwidth;						// tab width in list file
 	char *map_file;						// name of map file
 	char *output_file;					// output file name	
@@ -451,6 +504,9 @@ int parse_pragma_helper(char *p);
 int lwasm_cycle_calc_ind(line_t *cl);
 int lwasm_cycle_calc_rlist(line_t *cl);
 void lwasm_cycle_update_count(line_t *cl, int opc);
+int lwasm_cycle_base(line_t *cl, int opc);
+int lwasm_cycle_indexed(int pb, int is6309);
+int lwasm_cycle_lookup(int opc, int is6309, int *flags);
 
 void lwasm_parse_testmode_comment(line_t *cl, lwasm_testflags_t *flags, lwasm_errorcode_t *err, int *len, char **buf);
 void lwasm_error_testmode(line_t *cl, const char* msg, int fatal);
@@ -461,6 +517,11 @@ void lwasm_register_error2(asmstate_t *as, line_t *cl, lwasm_errorcode_t err, co
 int lwasm_next_context(asmstate_t *as);
 void lwasm_emit(line_t *cl, int byte);
 void lwasm_emitop(line_t *cl, int opc);
+void lwasm_crc_update(asmstate_t *as, int byte);
+
+// run a per-line function over the lines on worker threads (parallel.c)
+typedef void lwasm_linefn_t(asmstate_t *as, line_t *cl);
+int lwasm_parallel_pass(asmstate_t *as, lwasm_linefn_t *fn, int skipflags);
 
 void lwasm_save_expr(line_t *cl, int id, lw_expr_t expr);
 lw_expr_t lwasm_fetch_expr(line_t *cl, int id);
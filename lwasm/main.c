@@ -68,6 +68,18 @@ static struct lw_cmdline_options options[] =
 	{ "unicorns",	0x142,	0,			0,							"Add sooper sekrit sauce"},
 	{ "6800compat",	0x200,	0,			0,							"Enable 6800 compatibility instructions, equivalent to --pragma=6800compat" },
 	{ "no-output",  0x105,  0,          0,                          "Inhibit creation of output file" },
+	{ "span-stats", 0x109,  0,          0,                          "Report how forward referenced instructions were sized" },
+	{ "peephole",   0x10a,  0,          0,                          "Rewrite instruction sequences to smaller or faster equivalents, equivalent to --pragma=peephole" },
+	{ "peephole-stats", 0x10b, 0,       0,                          "Report bytes and cycles saved by each peephole rule" },
+	{ "cycle-report", 0x10c, "FILE",    lw_cmdline_opt_optional,    "Report cycle counts for each routine and basic block" },
+	{ "cycle-report-format", 0x10d, "FORMAT", 0,                    "Format for --cycle-report: text (default) or json" },
+	{ "dp-report",  0x10e,  "FILE",     lw_cmdline_opt_optional,    "Report which variables would gain most from the direct page" },
+	{ "dp-layout",  0x10f,  "FILE",     0,                          "Write the proposed direct page layout as source to FILE" },
+	{ "batch",      0x110,  "FILE",     0,                          "Assemble each line of FILE as a separate job with its own arguments" },
+	{ "jobs",       'j',    "N",        0,                          "Run up to N batch jobs at once" },
+	{ "threads",    0x111,  "N",        0,                          "Use N threads for the finalize and emit passes" },
+	{ "server",     0x112,  "SOCKET",   0,                          "Assemble requests sent to the Unix socket SOCKET until stopped" },
+	{ "connect",    0x113,  "SOCKET",   0,                          "Send this assembly to the server listening on SOCKET" },
 	{ 0 }
 };
 
@@ -114,6 +126,93 @@ static int parse_opts(int key, char *arg, void *state)
 		as -> flags |= FLAG_NOOUT;
 		break;
 
+	case 0x109:
+		as -> flags |= FLAG_SPANSTATS;
+		break;
+
+	case 0x10a:
+		as -> pragmas |= PRAGMA_PEEPHOLE;
+		break;
+
+	case 0x10b:
+		as -> flags |= FLAG_PEEPSTATS;
+		break;
+
+	case 0x10c:
+		if (as -> cycle_report_file)
+			lw_free(as -> cycle_report_file);
+		if (!arg)
+			as -> cycle_report_file = lw_strdup("-");
+		else
+			as -> cycle_report_file = lw_strdup(arg);
+		as -> flags |= FLAG_CYCLEREPORT;
+		break;
+
+	case 0x10e:
+		if (as -> dp_report_file)
+			lw_free(as -> dp_report_file);
+		if (!arg)
+			as -> dp_report_file = lw_strdup("-");
+		else
+			as -> dp_report_file = lw_strdup(arg);
+		as -> flags |= FLAG_DPREPORT;
+		break;
+
+	case 0x10f:
+		if (as -> dp_layout_file)
+			lw_free(as -> dp_layout_file);
+		as -> dp_layout_file = lw_strdup(arg);
+		as -> flags |= FLAG_DPREPORT;
+		break;
+
+	case 0x110:
+		if (as -> batch_file)
+			lw_free(as -> batch_file);
+		as -> batch_file = lw_strdup(arg);
+		break;
+
+	case 'j':
+		as -> batch_jobs = atoi(arg);
+		if (as -> batch_jobs < 1)
+		{
+			fprintf(stderr, "Invalid number of jobs: %s\n", arg);
+			exit(1);
+		}
+		break;
+
+	case 0x111:
+		as -> threads = atoi(arg);
+		if (as -> threads < 1)
+		{
+			fprintf(stderr, "Invalid number of threads: %s\n", arg);
+			exit(1);
+		}
+		break;
+
+	case 0x112:
+		if (as -> server_socket)
+			lw_free(as -> server_socket);
+		as -> server_socket = lw_strdup(arg);
+		break;
+
+	case 0x113:
+		if (as -> connect_socket)
+			lw_free(as -> connect_socket);
+		as -> connect_socket = lw_strdup(arg);
+		break;
+
+	case 0x10d:
+		if (!strcasecmp(arg, "text"))
+			as -> cycle_report_json = 0;
+		else if (!strcasecmp(arg, "json"))
+			as -> cycle_report_json = 1;
+		else
+		{
+			fprintf(stderr, "Invalid cycle report format: %s\n", arg);
+			exit(1);
+		}
+		break;
+
 	case 0x106:
 		if (as -> symbol_dump_file)
 			lw_free(as -> symbol_dump_file);
@@ -295,6 +394,10 @@ void do_pass1(asmstate_t *as);
 void do_pass2(asmstate_t *as);
 void do_pass3(asmstate_t *as);
 void do_pass4(asmstate_t *as);
+void do_spancheck(asmstate_t *as);
+void lwasm_peephole_report(asmstate_t *as);
+void do_cyclereport(asmstate_t *as);
+void do_dpreport(asmstate_t *as);
 void do_pass5(asmstate_t *as);
 void do_pass6(asmstate_t *as);
 void do_pass7(asmstate_t *as);
@@ -302,6 +405,9 @@ void do_output(asmstate_t *as);
 void do_symdump(asmstate_t *as);
 void do_list(asmstate_t *as);
 void do_map(asmstate_t *as);
+int lwasm_batch(asmstate_t *as, int argc, char **argv);
+int lwasm_server(asmstate_t *as, int argc, char **argv);
+int lwasm_connect(asmstate_t *as, int argc, char **argv);
 lw_expr_t lwasm_evaluate_special(int t, void *ptr, void *priv);
 lw_expr_t lwasm_evaluate_var(char *var, void *priv);
 lw_expr_t lwasm_parse_term(char **p, void *priv);
@@ -317,6 +423,7 @@ struct passlist_s
 	{ "symcheck", do_pass2 },
 	{ "resolve1", do_pass3 },
 	{ "resolve2", do_pass4 },
+	{ "spancheck", do_spancheck },
 	{ "addressresolve", do_pass5 },
 	{ "finalize", do_pass6 },
 	{ "emit", do_pass7 },
@@ -324,12 +431,15 @@ struct passlist_s
 };
 
 
-int main(int argc, char **argv)
+int lwasm_main(int argc, char **argv)
 {
 	int passnum;
+	char *fn;
+	char **oargv;
 
 	/* assembler state */
-	asmstate_t asmstate = { 0 };
+	asmstate_t asmstate;
+	spanstate_t spanstate = { 0 };
 	program_name = argv[0];
 
 	lw_expr_set_special_handler(lwasm_evaluate_special);
@@ -337,6 +447,15 @@ int main(int argc, char **argv)
 	lw_expr_set_term_parser(lwasm_parse_term);
 	lw_expr_setdivzero(lwasm_dividezero);
 
+	// parsing the command line reorders argv; batch mode needs it as given
+	oargv = lw_alloc(sizeof(char *) * (argc + 1));
+	memcpy(oargv, argv, sizeof(char *) * (argc + 1));
+
+	// the whole assembly is redone from here if the span check finds a
+	// forward reference guessed too small (see span.c)
+again:
+	memset(&asmstate, 0, sizeof(asmstate));
+
 	/* initialize assembler state */
 	asmstate.include_list = lw_stringlist_create();
 	asmstate.input_files = lw_stringlist_create();
@@ -354,11 +473,35 @@ int main(int argc, char **argv)
 		exit(1);
 	}
 
+	if (asmstate.batch_file)
+	{
+		if (asmstate.batch_jobs < 1)
+			asmstate.batch_jobs = 1;
+		exit(lwasm_batch(&asmstate, argc, oargv));
+	}
+
+	if (asmstate.server_socket)
+		exit(lwasm_server(&asmstate, argc, oargv));
+
+	if (asmstate.connect_socket)
+		exit(lwasm_connect(&asmstate, argc, oargv));
+
 	if (!asmstate.output_file)
 	{
 		asmstate.output_file = lw_strdup("a.out");
 	}
 
+	// guessed sizes need the source to be read again, which is not
+	// possible for standard input
+	asmstate.spanstate = &spanstate;
+	lw_stringlist_reset(asmstate.input_files);
+	while ((fn = lw_stringlist_current(asmstate.input_files)))
+	{
+		if (!strcmp(fn, "-"))
+			asmstate.spanstate = NULL;
+		lw_stringlist_next(asmstate.input_files);
+	}
+
 	input_init(&asmstate);
 
 	for (passnum = 0; passlist[passnum].fn; passnum++)
@@ -371,6 +514,12 @@ int main(int argc, char **argv)
 		debug_message(&asmstate, 50, "After pass %d (%s)\n", passnum, passlist[passnum].passname);
 		dump_state(&asmstate);
 
+		if (spanstate.retry)
+		{
+			spanstate.retry = 0;
+			goto again;
+		}
+
 		if (asmstate.preprocess)
 		{
 			/* we're done if we were preprocessing */
@@ -419,8 +568,16 @@ int main(int argc, char **argv)
 	do_symdump(&asmstate);
 	do_list(&asmstate);
 	do_map(&asmstate);
+	do_cyclereport(&asmstate);
+	do_dpreport(&asmstate);
+	lwasm_peephole_report(&asmstate);
 
 	if (asmstate.testmode_errorcount > 0) exit(1);
 
 	exit(0);
 }
+
+int main(int argc, char **argv)
+{
+	return lwasm_main(argc, argv);
+}
@@ -51,6 +51,14 @@ void write_code_abs(asmstate_t *as, FILE *of);
 // r++ prevents the "set but not used" warnings; should be optimized out
 #define writebytes(s, l, c, f)	do { int r; r = fwrite((s), (l), (c), (f)); r++; } while (0)
 
+static FILE *output_report = NULL;
+
+/* report the name of each output file written to f (see server.c) */
+void output_setreport(FILE *f)
+{
+	output_report = f;
+}
+
 void do_output(asmstate_t *as)
 {
 	FILE *of;
@@ -127,6 +135,8 @@ void do_output(asmstate_t *as)
 	}
 
 	fclose(of);
+	if (output_report)
+		fprintf(output_report, "%s\n", as -> output_file);
 }
 
 int write_code_BASIC_fprintf(FILE *of, int linelength, int *linenumber, int value)
@@ -0,0 +1,211 @@
+/*
+parallel.c
+
+Copyright © 2026 William Astle
+
+This file is part of LWTOOLS.
+
+LWTOOLS is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+Parallel line passes
+
+Once pass 5 has fixed every line address, finalizing or emitting a line
+only reads the rest of the assembly. With --threads, the lines are divided
+into chunks of consecutive lines which are handed out to a pool of worker
+threads.
+
+Each chunk has its own copy of the assembler state and its own expression
+context, and every line in the chunk points at that copy while the pass
+runs, so the current line, the error counts, and the expression evaluator
+state are never shared between threads. The workers leave alone anything
+whose result depends on the order of the lines: relocations are kept with
+their line, module CRCs are not accumulated, and lines whose emit function
+uses assembler-wide state (lwasm_insn_serial) are skipped. The caller does
+those in one ordered pass over the lines afterwards (see pass7.c).
+
+Small assemblies, and those that can change shared state while evaluating
+expressions (debugging output and PRAGMA UNDEFEXTERN imports), are left to
+the serial pass.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <lw_alloc.h>
+#include <lw_expr.h>
+
+#ifdef _MSC_VER
+#define NO_THREADS
+#endif
+
+#ifndef NO_THREADS
+#include <pthread.h>
+#endif
+
+#include "lwasm.h"
+#include "instab.h"
+
+#ifdef NO_THREADS
+
+int lwasm_parallel_pass(asmstate_t *as, lwasm_linefn_t *fn, int skipflags)
+{
+	return 0;
+}
+
+#else
+
+lw_expr_t lwasm_evaluate_special(int t, void *ptr, void *priv);
+lw_expr_t lwasm_evaluate_var(char *var, void *priv);
+lw_expr_t lwasm_parse_term(char **p, void *priv);
+void lwasm_dividezero(void *priv);
+
+// smallest chunk worth handing to a thread
+#define PARALLEL_MINLINES	256
+
+// chunks per thread so one slow chunk does not leave the other threads idle
+#define PARALLEL_CHUNKS		4
+
+struct parallel_chunk
+{
+	asmstate_t as;			// the chunk's copy of the assembler state
+	line_t *first;			// first line of the chunk
+	line_t *end;			// first line after the chunk (NULL at the end)
+};
+
+static pthread_mutex_t parallel_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct parallel_chunk *parallel_chunks;
+static int parallel_nchunks;
+static int parallel_next;
+static lwasm_linefn_t *parallel_fn;
+static int parallel_skipflags;
+
+static void *parallel_worker(void *arg)
+{
+	struct parallel_chunk *c;
+	line_t *cl;
+
+	for (;;)
+	{
+		c = NULL;
+		pthread_mutex_lock(&parallel_lock);
+		if (parallel_next < parallel_nchunks)
+			c = &parallel_chunks[parallel_next++];
+		pthread_mutex_unlock(&parallel_lock);
+		if (!c)
+			return NULL;
+
+		for (cl = c -> first; cl != c -> end; cl = cl -> next)
+		{
+			if (cl -> insn >= 0 && (instab[cl -> insn].flags & parallel_skipflags))
+				continue;
+			c -> as.cl = cl;
+			(*parallel_fn)(&(c -> as), cl);
+		}
+	}
+}
+
+/*
+Run fn on every line, except those whose instruction has one of skipflags,
+using as -> threads threads. Returns 0 without doing anything if the pass
+should be done serially instead.
+*/
+int lwasm_parallel_pass(asmstate_t *as, lwasm_linefn_t *fn, int skipflags)
+{
+	struct parallel_chunk *c;
+	pthread_t *threads;
+	line_t *cl;
+	int nlines = 0, nthreads, n, i;
+	int errorcount, warningcount, testmode_errorcount;
+
+	if (as -> threads < 2 || as -> debug_level > 0)
+		return 0;
+
+	for (cl = as -> line_head; cl; cl = cl -> next)
+	{
+		if (as -> output_format == OUTPUT_OBJ && CURPRAGMA(cl, PRAGMA_UNDEFEXTERN))
+			return 0;
+		nlines++;
+	}
+
+	parallel_nchunks = nlines / PARALLEL_MINLINES;
+	if (parallel_nchunks < 2)
+		return 0;
+	if (parallel_nchunks > as -> threads * PARALLEL_CHUNKS)
+		parallel_nchunks = as -> threads * PARALLEL_CHUNKS;
+	nthreads = as -> threads;
+	if (nthreads > parallel_nchunks)
+		nthreads = parallel_nchunks;
+
+	// split the lines as evenly as possible and point each at its chunk
+	parallel_chunks = lw_alloc(sizeof(struct parallel_chunk) * parallel_nchunks);
+	cl = as -> line_head;
+	for (i = 0; i < parallel_nchunks; i++)
+	{
+		c = &parallel_chunks[i];
+		c -> as = *as;
+		c -> as.parallel = 1;
+		c -> as.cl = NULL;
+		c -> as.exprctx = lw_expr_ctx_create();
+		lw_expr_ctx_set_special_handler(c -> as.exprctx, lwasm_evaluate_special);
+		lw_expr_ctx_set_var_handler(c -> as.exprctx, lwasm_evaluate_var);
+		lw_expr_ctx_set_term_parser(c -> as.exprctx, lwasm_parse_term);
+		lw_expr_ctx_setdivzero(c -> as.exprctx, lwasm_dividezero);
+
+		c -> first = cl;
+		for (n = nlines * (i + 1) / parallel_nchunks - nlines * i / parallel_nchunks; n > 0; n--)
+		{
+			cl -> as = &(c -> as);
+			cl = cl -> next;
+		}
+		c -> end = cl;
+	}
+
+	parallel_next = 0;
+	parallel_fn = fn;
+	parallel_skipflags = skipflags;
+	threads = lw_alloc(sizeof(pthread_t) * nthreads);
+	for (i = 0; i < nthreads; i++)
+	{
+		if (pthread_create(&threads[i], NULL, parallel_worker, NULL) != 0)
+			break;
+	}
+	// if no threads could be started, do the work here
+	if (i == 0)
+		parallel_worker(NULL);
+	while (i-- > 0)
+		pthread_join(threads[i], NULL);
+	lw_free(threads);
+
+	// give the lines back to the real state and add up what the chunks counted
+	errorcount = as -> errorcount;
+	warningcount = as -> warningcount;
+	testmode_errorcount = as -> testmode_errorcount;
+	for (i = 0; i < parallel_nchunks; i++)
+	{
+		c = &parallel_chunks[i];
+		for (cl = c -> first; cl != c -> end; cl = cl -> next)
+			cl -> as = as;
+		as -> errorcount += c -> as.errorcount - errorcount;
+		as -> warningcount += c -> as.warningcount - warningcount;
+		as -> testmode_errorcount += c -> as.testmode_errorcount - testmode_errorcount;
+		lw_expr_ctx_destroy(c -> as.exprctx);
+	}
+	lw_free(parallel_chunks);
+	as -> cl = as -> line_tail;
+	return 1;
+}
+
+#endif
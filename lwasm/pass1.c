@@ -34,6 +34,8 @@ this program. If not, see <http://www.gnu.org/licenses/>.
 int expand_macro(asmstate_t *as, line_t *l, char **p, char *opc);
 int expand_struct(asmstate_t *as, line_t *l, char **p, char *opc);
 int add_macro_line(asmstate_t *as, char *optr);
+void lwasm_span_guess(asmstate_t *as, line_t *cl);
+void lwasm_peephole(asmstate_t *as, line_t *cl);
 
 /*
 pass 1: parse the lines
@@ -143,6 +145,9 @@ void do_pass1(asmstate_t *as)
 			cl -> lineno = as -> line_tail -> lineno + 1;
 			as -> line_tail -> next = cl;
 
+			// last chance to rewrite the previous line before its length is used
+			lwasm_peephole(as, cl -> prev);
+
 			// set the line address
 			te = lw_expr_build(lw_expr_type_special, lwasm_expr_linelen, cl -> prev);
 			cl -> addr = lw_expr_build(lw_expr_type_oper, lw_expr_oper_plus, cl -> prev -> addr, te);
@@ -286,7 +291,7 @@ void do_pass1(asmstate_t *as)
 			for (; *p1 && isspace(*p1); p1++)
 				/* do nothing */ ;
 
-			for (opnum = 0; instab[opnum].opcode; opnum++)
+			for (opnum = instab_find(sym, -1); instab[opnum].opcode; opnum = instab_find(sym, opnum))
 			{
 				// ignore 6800 compatibility opcodes unless asked for
 				if ((instab[opnum].flags & lwasm_insn_is6800) && !CURPRAGMA(cl, PRAGMA_6800COMPAT)) continue;
@@ -299,8 +304,7 @@ void do_pass1(asmstate_t *as)
 				// ignore emulator extension opcodes unless asked for
 				if ((instab[opnum].flags & lwasm_insn_isemuext) && !CURPRAGMA(cl, PRAGMA_EMUEXT)) continue;
 
-				if (!strcasecmp(instab[opnum].opcode, sym))
-					break;
+				break;
 			}
 			
 			// have to go to linedone here in case there was a symbol
@@ -378,7 +382,12 @@ void do_pass1(asmstate_t *as)
 						debug_message(as, 100, "len = %d, dlen = %d", cl -> len, cl -> dlen);
 						(instab[opnum].parse)(as, cl, &p1);
 
-						// if we're forcing address modes on pass 1, force a resolution
+						// if we're forcing address modes on pass 1, guess at the
+						// size of anything span dependent, then force a resolution
+						if (CURPRAGMA(cl, PRAGMA_FORWARDREFMAX) && !CURPRAGMA(cl, PRAGMA_NOSPANSIZE) && cl -> span != SPAN_NONE && cl -> len == -1)
+						{
+							lwasm_span_guess(as, cl);
+						}
 						if (CURPRAGMA(cl, PRAGMA_FORWARDREFMAX) && instab[opnum].resolve)
 						{
 							(instab[opnum].resolve)(as, cl, 1);
@@ -472,4 +481,5 @@ nextline:
 		if (as -> endseen)
 			return;
 	}
+	lwasm_peephole(as, as -> line_tail);
 }
@@ -70,21 +70,32 @@ static int exprok(asmstate_t *as, lw_expr_t e)
 }
 
 
+static void pass6_line(asmstate_t *as, line_t *cl)
+{
+	struct line_expr_s *le;
+
+	for (le = cl -> exprs; le; le = le -> next)
+	{
+		lwasm_reduce_expr(as, le -> expr);
+		if (!exprok(as, le -> expr))
+		{
+			lwasm_register_error2(as, cl, E_EXPRESSION_BAD, "%s",
+				as -> exprctx ? lw_expr_print_ctx(as -> exprctx, le -> expr) : lw_expr_print(le -> expr));
+		}
+	}
+}
+
 void do_pass6(asmstate_t *as)
 {
 	line_t *cl;
-	struct line_expr_s *le;
+
+	// each line is independent here so this can be done by worker threads
+	if (lwasm_parallel_pass(as, pass6_line, 0))
+		return;
 
 	for (cl = as -> line_head; cl; cl = cl -> next)
 	{
 		as -> cl = cl;
-		for (le = cl -> exprs; le; le = le -> next)
-		{
-			lwasm_reduce_expr(as, le -> expr);
-			if (!exprok(as, le -> expr))
-			{
-				lwasm_register_error2(as, cl, E_EXPRESSION_BAD, "%s", lw_expr_print(le -> expr));
-			}
-		}
+		pass6_line(as, cl);
 	}
 }
@@ -32,44 +32,92 @@ this program. If not, see <http://www.gnu.org/licenses/>.
 emit pass
 
 Generate object code
+
+With worker threads, everything but the lines marked lwasm_insn_serial is
+emitted by the threads first. The parts that depend on line order are then
+done here in one pass over the lines: the relocations the threads kept with
+each line are added to its section, the module CRC is accumulated over the
+bytes of each module line, the serial lines are emitted, and the testmode
+checks are run.
 */
+static void pass7_line(asmstate_t *as, line_t *cl)
+{
+	if (cl -> insn != -1 && instab[cl -> insn].emit)
+		(instab[cl -> insn].emit)(as, cl);
+}
+
+// add the results of a line emitted by a worker thread, in line order
+static void pass7_merge(asmstate_t *as, line_t *cl)
+{
+	reloctab_t *re, *rl = NULL;
+	int i;
+
+	// the line's relocations are newest first; add them oldest first
+	while ((re = cl -> relocs))
+	{
+		cl -> relocs = re -> next;
+		re -> next = rl;
+		rl = re;
+	}
+	while ((re = rl))
+	{
+		rl = re -> next;
+		re -> next = cl -> csect -> reloctab;
+		cl -> csect -> reloctab = re;
+	}
+
+	if (cl -> inmod)
+	{
+		for (i = 0; i < cl -> outputl; i++)
+			lwasm_crc_update(as, cl -> output[i]);
+	}
+}
+
+static void pass7_testmode(line_t *cl)
+{
+	char* buf;
+	int len;
+	lwasm_testflags_t flags;
+	lwasm_errorcode_t err;
+
+	lwasm_parse_testmode_comment(cl, &flags, &err, &len, &buf);
+
+	if (flags == TF_ERROR && cl -> err_testmode == 0)
+	{
+		char s[128];
+		sprintf(s, "expected %d but assembled OK", err);
+		lwasm_error_testmode(cl, s, 0);
+	}
+
+	if (flags == TF_EMIT)
+	{
+		if (cl -> len != len) lwasm_error_testmode(cl, "incorrect assembly (wrong length)", 0);
+		if (memcmp(buf, cl -> output, len) != 0) lwasm_error_testmode(cl, "incorrect assembly", 0);
+		lw_free(buf);
+	}
+}
+
 void do_pass7(asmstate_t *as)
 {
 	line_t *cl;
+	int parallel;
+
+	parallel = lwasm_parallel_pass(as, pass7_line, lwasm_insn_serial);
 
 	for (cl = as -> line_head; cl; cl = cl -> next)
 	{
 		as -> cl = cl;
 		if (cl -> insn != -1)
 		{
-			if (instab[cl -> insn].emit)
-			{
-				(instab[cl -> insn].emit)(as, cl);
-			}
+			if (!parallel || (instab[cl -> insn].flags & lwasm_insn_serial))
+				pass7_line(as, cl);
+			else
+				pass7_merge(as, cl);
 
 			if (CURPRAGMA(cl, PRAGMA_TESTMODE))
-			{
-				char* buf;
-				int len;
-				lwasm_testflags_t flags;
-				lwasm_errorcode_t err;
-
-				lwasm_parse_testmode_comment(cl, &flags, &err, &len, &buf);
-
-				if (flags == TF_ERROR && cl -> err_testmode == 0)
-				{
-					char s[128];
-					sprintf(s, "expected %d but assembled OK", err);
-					lwasm_error_testmode(cl, s, 0);
-				}
-
-				if (flags == TF_EMIT)
-				{
-					if (cl -> len != len) lwasm_error_testmode(cl, "incorrect assembly (wrong length)", 0);
-					if (memcmp(buf, cl -> output, len) != 0) lwasm_error_testmode(cl, "incorrect assembly", 0);
-					lw_free(buf);
-				}
-			}
+				pass7_testmode(cl);
 		}
+		else if (parallel)
+			pass7_merge(as, cl);
 	}
 }
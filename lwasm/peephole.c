@@ -0,0 +1,390 @@
+/*
+peephole.c
+
+Copyright © 2026 William Astle
+
+This file is part of LWTOOLS.
+
+LWTOOLS is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <lw_expr.h>
+
+#include "lwasm.h"
+#include "instab.h"
+
+/*
+Peephole optimizer
+
+This looks at each instruction together with the instruction before it
+and replaces the pair with something smaller or faster that leaves the
+registers, memory, and flags exactly as they would have been. It runs on
+pass 1 just before the next line gets its address, so the last line can
+still change length; the one before it can too as long as the last line
+has no operand that could depend on its own address. Nothing is combined
+across a label, a pseudo op, or a line that is not listed.
+
+A removed instruction stays in the source list as a line with no
+instruction and no length.
+*/
+
+PARSEFUNC(insn_parse_inh);
+PARSEFUNC(insn_parse_rtor);
+PARSEFUNC(insn_parse_rlist);
+PARSEFUNC(insn_parse_relgen);
+PARSEFUNC(insn_parse_gen0);
+PARSEFUNC(insn_parse_gen8);
+PARSEFUNC(insn_parse_gen16);
+
+// inherent instructions that set C without looking at it first
+static const int peep_setsc[] = {
+	0x40, 0x43, 0x44, 0x47, 0x48, 0x4f,		// nega coma lsra asra lsla clra
+	0x50, 0x53, 0x54, 0x57, 0x58, 0x5f,		// negb comb lsrb asrb lslb clrb
+	0x3d,									// mul
+	0x1040, 0x1043, 0x1044, 0x1047, 0x1048, 0x104f,	// negd comd lsrd asrd lsld clrd
+	0x1053, 0x1054, 0x105f,					// comw lsrw clrw
+	0x1143, 0x114f, 0x1153, 0x115f,			// come clre comf clrf
+	-1
+};
+
+static int peep_isinsn(line_t *cl, const char *name)
+{
+	return cl -> insn >= 0 && !strcmp(instab[cl -> insn].opcode, name);
+}
+
+// find the table entry for name; if flags is set, the entry must have one of them
+static int peep_findinsn(const char *name, int flags)
+{
+	int i;
+
+	for (i = 0; instab[i].opcode; i++)
+	{
+		if (strcmp(instab[i].opcode, name))
+			continue;
+		if (flags && !(instab[i].flags & flags))
+			continue;
+		return i;
+	}
+	return -1;
+}
+
+// best estimate of the cycles cl takes as it stands
+static int peep_cycles(line_t *cl)
+{
+	instab_t *it;
+	int opc;
+
+	if (cl -> insn < 0)
+		return 0;
+	it = &instab[cl -> insn];
+	if (it -> parse == insn_parse_relgen)
+		opc = (cl -> lint == 16) ? it -> ops[3] : it -> ops[2];
+	else if (it -> parse == insn_parse_gen0 || it -> parse == insn_parse_gen8 || it -> parse == insn_parse_gen16)
+		opc = it -> ops[(cl -> lint2 >= 0) ? cl -> lint2 : 2];
+	else
+		opc = it -> ops[0];
+	if (it -> parse == insn_parse_rlist)
+		return lwasm_cycle_base(cl, opc) + lwasm_cycle_calc_rlist(cl);
+	return lwasm_cycle_base(cl, opc);
+}
+
+static void peep_setlen(line_t *cl, int len)
+{
+	cl -> len = len;
+	if (cl -> inmod == 0)
+		cl -> dlen = len;
+}
+
+static void peep_remove(line_t *cl)
+{
+	cl -> insn = -1;
+	peep_setlen(cl, 0);
+}
+
+// turn cl into the inherent instruction at table entry insn
+static void peep_setinh(line_t *cl, int insn)
+{
+	cl -> insn = insn;
+	peep_setlen(cl, OPLEN(instab[insn].ops[0]));
+}
+
+// tfr/exg register number for a single register push/pull mask
+static int peep_rlistreg(line_t *cl, int mask)
+{
+	switch (mask)
+	{
+	case 0x01: return 10;	// CC
+	case 0x02: return 8;	// A
+	case 0x04: return 9;	// B
+	case 0x06: return 0;	// D
+	case 0x08: return 11;	// DP
+	case 0x10: return 1;	// X
+	case 0x20: return 2;	// Y
+	case 0x40: return (instab[cl -> insn].ops[0] & 2) ? 4 : 3;	// S or U
+	}
+	return -1;
+}
+
+// jsr/bsr/lbsr followed by rts becomes jmp/bra/lbra
+static int peep_callret(asmstate_t *as, line_t *p, line_t *n)
+{
+	static const char *calls[] = { "jsr", "jmp", "bsr", "bra", "lbsr", "lbra", NULL };
+	int i;
+
+	if (!p || !peep_isinsn(n, "rts") || p -> conditional_return)
+		return 0;
+	for (i = 0; calls[i]; i += 2)
+	{
+		if (peep_isinsn(p, calls[i]))
+		{
+			p -> insn = peep_findinsn(calls[i + 1], 0);
+			peep_remove(n);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// tfr or exg of a register to itself does nothing
+static int peep_tfrself(asmstate_t *as, line_t *p, line_t *n)
+{
+	if (!peep_isinsn(n, "tfr") && !peep_isinsn(n, "exg"))
+		return 0;
+	if ((n -> pb >> 4) != (n -> pb & 0x0f) || (n -> pb & 0x0f) == 5)
+		return 0;
+	peep_remove(n);
+	return 1;
+}
+
+// a tfr that repeats or reverses the one just before it does nothing
+static int peep_tfrrepeat(asmstate_t *as, line_t *p, line_t *n)
+{
+	int r0 = p ? p -> pb >> 4 : 0;
+	int r1 = p ? p -> pb & 0x0f : 0;
+
+	if (!p || !peep_isinsn(p, "tfr") || !peep_isinsn(n, "tfr"))
+		return 0;
+	// same size registers only; PC, CC, and the zero registers are special
+	if ((r0 >> 3) != (r1 >> 3))
+		return 0;
+	if (r0 == 5 || r1 == 5 || r0 == 10 || r1 == 10 || r0 == 12 || r1 == 12 || r0 == 13 || r1 == 13)
+		return 0;
+	if (n -> pb != p -> pb && n -> pb != ((r1 << 4) | r0))
+		return 0;
+	peep_remove(n);
+	return 1;
+}
+
+// a push followed by a pull of the same registers does nothing
+static int peep_pushpull(asmstate_t *as, line_t *p, line_t *n)
+{
+	if (!p || p -> pb != n -> pb || (p -> pb & 0x80))
+		return 0;
+	if (!((peep_isinsn(p, "pshs") && peep_isinsn(n, "puls")) || (peep_isinsn(p, "pshu") && peep_isinsn(n, "pulu"))))
+		return 0;
+	peep_remove(p);
+	peep_remove(n);
+	return 1;
+}
+
+// pushing one register and pulling another of the same size is a tfr
+static int peep_pushtfr(asmstate_t *as, line_t *p, line_t *n)
+{
+	int r0, r1;
+
+	if (!p || !((peep_isinsn(p, "pshs") && peep_isinsn(n, "puls")) || (peep_isinsn(p, "pshu") && peep_isinsn(n, "pulu"))))
+		return 0;
+	r0 = peep_rlistreg(p, p -> pb);
+	r1 = peep_rlistreg(n, n -> pb);
+	if (r0 < 0 || r1 < 0 || r0 == r1 || (r0 >> 3) != (r1 >> 3))
+		return 0;
+	p -> insn = peep_findinsn("tfr", 0);
+	p -> pb = (r0 << 4) | r1;
+	peep_setlen(p, 2);
+	peep_remove(n);
+	return 1;
+}
+
+// loading zero is a clear when the next instruction sets C anyway
+static int peep_loadzero(asmstate_t *as, line_t *p, line_t *n)
+{
+	static const char *loads[] = { "lda", "ldb", "ldd", "lde", "ldf", "ldw", NULL };
+	char clr[5];
+	lw_expr_t e;
+	int i, insn;
+
+	if (!p || p -> lint2 != 3 || instab[n -> insn].parse != insn_parse_inh)
+		return 0;
+	for (i = 0; peep_setsc[i] != -1; i++)
+	{
+		if (peep_setsc[i] == instab[n -> insn].ops[0])
+			break;
+	}
+	if (peep_setsc[i] == -1)
+		return 0;
+	for (i = 0; loads[i]; i++)
+	{
+		if (peep_isinsn(p, loads[i]))
+			break;
+	}
+	if (!loads[i])
+		return 0;
+	e = lwasm_fetch_expr(p, 0);
+	if (!e || !lw_expr_istype(e, lw_expr_type_int) || lw_expr_intval(e) != 0)
+		return 0;
+
+	// clra and clrb exist everywhere; the rest are 6309 only
+	sprintf(clr, "clr%c", loads[i][2]);
+	if (i < 2)
+		insn = peep_findinsn(clr, 0);
+	else if (CURPRAGMA(p, PRAGMA_6809))
+		return 0;
+	else
+		insn = peep_findinsn(clr, lwasm_insn_is6309);
+	if (insn < 0)
+		return 0;
+	peep_setinh(p, insn);
+	return 1;
+}
+
+// clre and clrf together are clrw
+static int peep_clrw(asmstate_t *as, line_t *p, line_t *n)
+{
+	if (!p || CURPRAGMA(n, PRAGMA_6809))
+		return 0;
+	if (!((peep_isinsn(p, "clre") && peep_isinsn(n, "clrf")) || (peep_isinsn(p, "clrf") && peep_isinsn(n, "clre"))))
+		return 0;
+	peep_setinh(p, peep_findinsn("clrw", lwasm_insn_is6309));
+	peep_remove(n);
+	return 1;
+}
+
+static struct peeprule_s
+{
+	char *name;
+	int (*fn)(asmstate_t *as, line_t *p, line_t *n);
+} peeprules[] =
+{
+	{ "call-return",	peep_callret },
+	{ "tfr-self",		peep_tfrself },
+	{ "tfr-repeat",		peep_tfrrepeat },
+	{ "push-pull",		peep_pushpull },
+	{ "push-pull-tfr",	peep_pushtfr },
+	{ "load-zero",		peep_loadzero },
+	{ "clr-pair",		peep_clrw },
+	{ NULL,				NULL }
+};
+
+// recompute the addresses of the lines after p up to and including n
+static void peep_readdress(asmstate_t *as, line_t *p, line_t *n)
+{
+	line_t *ocl = as -> cl;
+	line_t *cl;
+	lw_expr_t te;
+
+	for (cl = p -> next; cl; cl = cl -> next)
+	{
+		as -> cl = cl;
+		lw_expr_destroy(cl -> addr);
+		te = lw_expr_build(lw_expr_type_special, lwasm_expr_linelen, cl -> prev);
+		cl -> addr = lw_expr_build(lw_expr_type_oper, lw_expr_oper_plus, cl -> prev -> addr, te);
+		lw_expr_destroy(te);
+		lwasm_reduce_expr(as, cl -> addr);
+
+		lw_expr_destroy(cl -> daddr);
+		if (as -> output_format == OUTPUT_OS9)
+		{
+			te = lw_expr_build(lw_expr_type_special, lwasm_expr_linedlen, cl -> prev);
+			cl -> daddr = lw_expr_build(lw_expr_type_oper, lw_expr_oper_plus, cl -> prev -> daddr, te);
+			lw_expr_destroy(te);
+			lwasm_reduce_expr(as, cl -> daddr);
+		}
+		else
+		{
+			cl -> daddr = lw_expr_copy(cl -> addr);
+		}
+		if (cl == n)
+			break;
+	}
+	as -> cl = ocl;
+}
+
+static int peep_ok(line_t *cl)
+{
+	return cl -> insn >= 0 && !(cl -> err) && CURPRAGMA(cl, PRAGMA_PEEPHOLE) && !CURPRAGMA(cl, PRAGMA_NOLIST);
+}
+
+/*
+look at n, the last line parsed, and the instruction before it; called
+from pass 1 before the next line gets its address
+*/
+void lwasm_peephole(asmstate_t *as, line_t *n)
+{
+	line_t *p;
+	int i, bytes, cycles;
+
+	if (!n || !peep_ok(n))
+		return;
+
+	// skip back over comments and blank lines
+	for (p = n -> prev; p; p = p -> prev)
+	{
+		if (p -> insn >= 0 || p -> sym || p -> len > 0)
+			break;
+	}
+	if (p && (n -> sym || !peep_ok(p)))
+		p = NULL;
+
+	bytes = (p && p -> len > 0 ? p -> len : 0) + (n -> len > 0 ? n -> len : 0);
+	cycles = (p ? peep_cycles(p) : 0) + peep_cycles(n);
+	for (i = 0; peeprules[i].name; i++)
+	{
+		if ((peeprules[i].fn)(as, p, n))
+			break;
+	}
+	if (!peeprules[i].name)
+		return;
+
+	bytes -= (p && p -> len > 0 ? p -> len : 0) + (n -> len > 0 ? n -> len : 0);
+	cycles -= (p ? peep_cycles(p) : 0) + peep_cycles(n);
+	debug_message(as, 50, "Peephole %s: %d bytes, %d cycles", peeprules[i].name, bytes, cycles);
+	as -> peepstats[i].count++;
+	as -> peepstats[i].bytes += bytes;
+	as -> peepstats[i].cycles += cycles;
+	if (p)
+		peep_readdress(as, p, n);
+}
+
+void lwasm_peephole_report(asmstate_t *as)
+{
+	int i;
+	int count = 0, bytes = 0, cycles = 0;
+
+	if (!(as -> flags & FLAG_PEEPSTATS))
+		return;
+	for (i = 0; peeprules[i].name; i++)
+	{
+		if (as -> peepstats[i].count == 0)
+			continue;
+		fprintf(stderr, "Peephole %-14s %5d applied %6d bytes %7d cycles saved\n", peeprules[i].name,
+			as -> peepstats[i].count, as -> peepstats[i].bytes, as -> peepstats[i].cycles);
+		count += as -> peepstats[i].count;
+		bytes += as -> peepstats[i].bytes;
+		cycles += as -> peepstats[i].cycles;
+	}
+	fprintf(stderr, "Peephole %-14s %5d applied %6d bytes %7d cycles saved\n", "total", count, bytes, cycles);
+}
@@ -78,6 +78,8 @@ static const struct pragma_list set_pragmas[] =
 	{ "emuext", "noemuext", PRAGMA_EMUEXT },
 	{ "nooutput", "output", PRAGMA_NOOUTPUT },
 	{ "noexpandcond", "expandcond", PRAGMA_NOEXPANDCOND },
+	{ "nospansize", "spansize", PRAGMA_NOSPANSIZE },
+	{ "peephole", "nopeephole", PRAGMA_PEEPHOLE },
 	{ 0, 0, 0 }
 };
 
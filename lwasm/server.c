@@ -0,0 +1,476 @@
+/*
+server.c
+
+Copyright © 2026 William Astle
+
+This file is part of LWTOOLS.
+
+LWTOOLS is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+Server mode
+
+With --server, lwasm listens on a Unix domain socket and assembles one
+request at a time. A request is a command line sent as a sequence of NUL
+terminated strings: the number of arguments, the directory to assemble in,
+then the arguments themselves. Any arguments given to the server (less
+--server) come before those of each request, as with --batch.
+
+Each request is assembled by a child copy of the server (see job.c), so it
+starts with the same state a new lwasm process would and cannot affect
+later requests.
+What the server keeps warm is what does not depend on the source: the
+opcode index and the contents of the include files requests have read,
+which are checked against the files before each use (see input.c). Macros,
+structures and symbols are defined by the source that includes a file, so
+they are built again for each request.
+
+The reply is a series of records, each a header line followed by the number
+of bytes given in the header:
+
+	status N			exit status of the assembly; always first, no data
+	stdout LEN			what the assembly wrote to standard output
+	stderr LEN			what the assembly wrote to standard error
+	output LEN FILE		the contents of the output file, if one was written
+
+The socket is only accessible to the user running the server, and the
+server also drops any connection from another user, since some systems
+ignore the permissions of a socket.
+
+With --connect, lwasm sends its own command line (less --connect) to a
+server, copies what the assembly printed, and exits with its status. The
+server writes the output file itself.
+*/
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE	// for struct ucred
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lw_alloc.h>
+#include <lw_string.h>
+#include <lw_stringlist.h>
+
+#include "lwasm.h"
+#include "input.h"
+#include "instab.h"
+
+#if defined(WIN32) || defined(WIN64)
+
+int lwasm_server(asmstate_t *as, int argc, char **argv)
+{
+	fprintf(stderr, "Server mode is not supported on this system\n");
+	return 1;
+}
+
+int lwasm_connect(asmstate_t *as, int argc, char **argv)
+{
+	fprintf(stderr, "Server mode is not supported on this system\n");
+	return 1;
+}
+
+#else
+
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "job.h"
+
+#define SERVER_MAXARGS	4096	// most arguments a request may have
+#define SERVER_TIMEOUT	5		// seconds to wait on a client before dropping it
+
+static char *server_path;
+
+/* is arg --server or --connect; set *skip if the value is the next argument */
+static int server_isserveropt(const char *arg, int *skip)
+{
+	*skip = 0;
+	if (!strcmp(arg, "--server") || !strcmp(arg, "--connect"))
+	{
+		*skip = 1;
+		return 1;
+	}
+	if (!strncmp(arg, "--server=", 9) || !strncmp(arg, "--connect=", 10))
+		return 1;
+	return 0;
+}
+
+static void server_sockaddr(const char *path, struct sockaddr_un *sa)
+{
+	if (strlen(path) >= sizeof(sa -> sun_path))
+	{
+		fprintf(stderr, "Socket path too long: %s\n", path);
+		exit(1);
+	}
+	memset(sa, 0, sizeof(struct sockaddr_un));
+	sa -> sun_family = AF_UNIX;
+	strcpy(sa -> sun_path, path);
+}
+
+/* copy len bytes from in to out (or discard them if out is NULL) */
+static int server_copy(FILE *in, FILE *out, long len)
+{
+	char buf[4096];
+	size_t n;
+
+	while (len > 0)
+	{
+		n = fread(buf, 1, len < (long)sizeof(buf) ? len : (long)sizeof(buf), in);
+		if (n == 0)
+			return -1;
+		if (out)
+			fwrite(buf, 1, n, out);
+		len -= n;
+	}
+	return 0;
+}
+
+static void server_addarg(char ***argv, int *argc, const char *arg)
+{
+	*argv = lw_realloc(*argv, sizeof(char *) * (*argc + 2));
+	(*argv)[(*argc)++] = lw_strdup(arg);
+	(*argv)[*argc] = NULL;
+}
+
+/* send the contents of f as a record and close it */
+static void server_sendfile(FILE *out, const char *tag, FILE *f, const char *fn)
+{
+	long len;
+
+	fseek(f, 0, SEEK_END);
+	len = ftell(f);
+	rewind(f);
+	if (fn)
+		fprintf(out, "%s %ld %s\n", tag, len, fn);
+	else
+		fprintf(out, "%s %ld\n", tag, len);
+	server_copy(f, out, len);
+	fclose(f);
+}
+
+/* is the other end of fd run by the same user as the server */
+static int server_peerok(int fd)
+{
+#ifdef SO_PEERCRED
+	struct ucred cr;
+	socklen_t len = sizeof(cr);
+
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cr, &len) == -1)
+		return 0;
+	return cr.uid == geteuid();
+#else
+	uid_t uid;
+	gid_t gid;
+
+	if (getpeereid(fd, &uid, &gid) == -1)
+		return 0;
+	return uid == geteuid();
+#endif
+}
+
+static void server_stop(int sig)
+{
+	unlink(server_path);
+	_exit(0);
+}
+
+/* read and assemble one request on fd, then close it */
+static void server_request(int fd, int argc, char **argv)
+{
+	struct lwasm_job job;
+	FILE *in, *out, *f;
+	char *cwd = NULL, *s = NULL, *line = NULL, *fn, *msg = NULL;
+	char **jargv = NULL;
+	size_t ssize = 0, linesize = 0;
+	ssize_t len;
+	int jargc = 0, n, i, skip, status, code;
+
+	in = fdopen(dup(fd), "r");
+	out = fdopen(fd, "w");
+	if (!in || !out)
+	{
+		fprintf(stderr, "Cannot read request: %s\n", strerror(errno));
+		exit(1);
+	}
+
+	n = -1;
+	if (getdelim(&s, &ssize, '\0', in) > 0)
+		n = atoi(s);
+	if (n < 0 || getdelim(&s, &ssize, '\0', in) <= 0)
+	{
+		// not a request; nothing to reply to
+		free(s);
+		fclose(in);
+		fclose(out);
+		return;
+	}
+	cwd = lw_strdup(s);
+
+	server_addarg(&jargv, &jargc, argv[0]);
+	for (i = 1; i < argc; i++)
+	{
+		if (server_isserveropt(argv[i], &skip))
+		{
+			i += skip;
+			continue;
+		}
+		server_addarg(&jargv, &jargc, argv[i]);
+	}
+	if (n > SERVER_MAXARGS)
+		msg = "Too many arguments in request\n";
+	for (i = 0; !msg && i < n; i++)
+	{
+		if (getdelim(&s, &ssize, '\0', in) <= 0)
+			break;
+		if (server_isserveropt(s, &skip))
+		{
+			// a request cannot start another server
+			if (skip && getdelim(&s, &ssize, '\0', in) <= 0)
+				break;
+			i += skip;
+			continue;
+		}
+		server_addarg(&jargv, &jargc, s);
+	}
+	free(s);
+	fclose(in);
+
+	if (!msg && i < n)
+		msg = "Incomplete request\n";
+	if (msg)
+	{
+		fprintf(out, "status 1\nstderr %d\n%s", (int)strlen(msg), msg);
+		fclose(out);
+		goto done;
+	}
+
+	if (job_start(&job, jargc, jargv, cwd, 1) == -1)
+	{
+		fprintf(stderr, "Failed to start assembly: %s\n", strerror(errno));
+		exit(1);
+	}
+
+	while (waitpid(job.pid, &status, 0) == -1)
+	{
+		if (errno != EINTR)
+		{
+			fprintf(stderr, "waitpid failed: %s\n", strerror(errno));
+			exit(1);
+		}
+	}
+	if (WIFSIGNALED(status))
+	{
+		fprintf(job.err, "lwasm terminated by signal %d\n", WTERMSIG(status));
+		code = 1;
+	}
+	else
+		code = WEXITSTATUS(status);
+
+	fprintf(out, "status %d\n", code);
+	server_sendfile(out, "stdout", job.out, NULL);
+	server_sendfile(out, "stderr", job.err, NULL);
+	rewind(job.outputs);
+	while ((len = getline(&line, &linesize, job.outputs)) > 0)
+	{
+		if (line[len - 1] == '\n')
+			line[--len] = '\0';
+		if (line[0] == '/')
+			fn = lw_strdup(line);
+		else
+		{
+			fn = lw_alloc(strlen(cwd) + len + 2);
+			sprintf(fn, "%s/%s", cwd, line);
+		}
+		f = fopen(fn, "rb");
+		if (f)
+			server_sendfile(out, "output", f, line);
+		lw_free(fn);
+	}
+	free(line);
+	fclose(job.outputs);
+	fclose(out);
+
+	/* the client has its reply; now keep the include files it read */
+	job_cacheresults(&job);
+
+done:
+	for (i = 0; i < jargc; i++)
+		lw_free(jargv[i]);
+	lw_free(jargv);
+	lw_free(cwd);
+}
+
+/*
+Listen on as -> server_socket and assemble requests until stopped by a
+signal. Only returns if the server cannot be started.
+*/
+int lwasm_server(asmstate_t *as, int argc, char **argv)
+{
+	struct sockaddr_un sa;
+	struct stat st;
+	struct timeval tv;
+	mode_t mask;
+	int sock, fd, r;
+
+	if (lw_stringlist_nstrings(as -> input_files) > 0)
+	{
+		fprintf(stderr, "Input files must be given in each request with --server\n");
+		return 1;
+	}
+
+	server_sockaddr(as -> server_socket, &sa);
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock == -1)
+	{
+		fprintf(stderr, "Cannot create socket: %s\n", strerror(errno));
+		return 1;
+	}
+	// a socket left by a server that was not stopped cleanly
+	if (lstat(as -> server_socket, &st) == 0 && S_ISSOCK(st.st_mode))
+		unlink(as -> server_socket);
+	// no window where another user can connect
+	mask = umask(0177);
+	r = bind(sock, (struct sockaddr *)&sa, sizeof(sa));
+	umask(mask);
+	if (r == -1 || listen(sock, 16) == -1)
+	{
+		fprintf(stderr, "Cannot listen on %s: %s\n", as -> server_socket, strerror(errno));
+		return 1;
+	}
+
+	server_path = as -> server_socket;
+	signal(SIGINT, server_stop);
+	signal(SIGTERM, server_stop);
+	signal(SIGHUP, server_stop);
+	signal(SIGPIPE, SIG_IGN);
+
+	// every request gets this from the server instead of building it
+	instab_init();
+
+	for (;;)
+	{
+		fd = accept(sock, NULL, NULL);
+		if (fd == -1)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			fprintf(stderr, "accept failed: %s\n", strerror(errno));
+			unlink(server_path);
+			return 1;
+		}
+		if (!server_peerok(fd))
+		{
+			fprintf(stderr, "Rejected connection from another user\n");
+			close(fd);
+			continue;
+		}
+		// a client that stops sending or reading must not hold up the server
+		tv.tv_sec = SERVER_TIMEOUT;
+		tv.tv_usec = 0;
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+		server_request(fd, argc, argv);
+	}
+}
+
+/*
+Send the command line to the server on as -> connect_socket and output
+what the assembly printed. Returns the exit status of the assembly.
+*/
+int lwasm_connect(asmstate_t *as, int argc, char **argv)
+{
+	struct sockaddr_un sa;
+	FILE *in, *out;
+	char *line = NULL, *cwd;
+	char tag[16];
+	size_t linesize = 0;
+	long len;
+	int sock, i, n = 0, skip, status = -1;
+
+	server_sockaddr(as -> connect_socket, &sa);
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock == -1 || connect(sock, (struct sockaddr *)&sa, sizeof(sa)) == -1)
+	{
+		fprintf(stderr, "Cannot connect to %s: %s\n", as -> connect_socket, strerror(errno));
+		return 1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+	in = fdopen(dup(sock), "r");
+	out = fdopen(sock, "w");
+	if (!in || !out)
+	{
+		fprintf(stderr, "Cannot connect to %s: %s\n", as -> connect_socket, strerror(errno));
+		return 1;
+	}
+
+	for (i = 1; i < argc; i++)
+	{
+		if (server_isserveropt(argv[i], &skip))
+		{
+			i += skip;
+			continue;
+		}
+		n++;
+	}
+	fprintf(out, "%d%c", n, 0);
+	cwd = input_getcwd();
+	fprintf(out, "%s%c", cwd, 0);
+	lw_free(cwd);
+	for (i = 1; i < argc; i++)
+	{
+		if (server_isserveropt(argv[i], &skip))
+		{
+			i += skip;
+			continue;
+		}
+		fprintf(out, "%s%c", argv[i], 0);
+	}
+	fflush(out);
+
+	while (getline(&line, &linesize, in) > 0)
+	{
+		if (sscanf(line, "%15s %ld", tag, &len) != 2)
+			break;
+		if (!strcmp(tag, "status"))
+		{
+			status = len;
+			continue;
+		}
+		// the server has already written the output file
+		if (server_copy(in, !strcmp(tag, "stdout") ? stdout : (!strcmp(tag, "stderr") ? stderr : NULL), len) != 0)
+			break;
+	}
+	free(line);
+	fclose(in);
+	fclose(out);
+	if (status < 0)
+	{
+		fprintf(stderr, "No reply from server on %s\n", as -> connect_socket);
+		return 1;
+	}
+	return status;
+}
+
+#endif
@@ -0,0 +1,258 @@
+/*
+span.c
+
+Copyright © 2026 William Astle
+
+This file is part of LWTOOLS.
+
+LWTOOLS is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <lw_alloc.h>
+#include <lw_expr.h>
+
+#include "lwasm.h"
+#include "instab.h"
+
+/*
+Span dependent sizing
+
+Under the "forwardrefmax" pragma, an instruction whose operand is still a
+forward reference on pass 1 has to be given a length right away so every
+address stays a constant. That used to be the maximum length. Now it is a
+guess: the smallest length the instruction can have, or whatever an earlier
+round found it needs. This covers branches with automatic length selection,
+direct/extended operands, and indexed offsets.
+
+Once everything is resolved, the span check pass evaluates each guessed
+operand. A guess that holds gets its final addressing mode. A guess that
+does not hold is grown to the length the operand needs, and the whole
+assembly is redone with the new guesses. Guesses only ever grow, so this
+settles after a few rounds, and each round costs no more than assembling
+with maximum lengths. If it somehow does not settle, the last round falls
+back to maximum lengths, which always fit.
+
+*/
+
+#define SPAN_MAXROUNDS 10
+
+// smallest valid length for cl that is at least len
+static int span_fit(line_t *cl, int len)
+{
+	int rn = cl -> spanpb & 0x07;
+
+	if (len <= cl -> minlen)
+	{
+		// PC relative indexing has no 5 bit or no offset form
+		if (cl -> span == SPAN_INDEXED && rn >= 5)
+			return cl -> minlen + 1;
+		return cl -> minlen;
+	}
+	// only indexing has an 8 bit offset, and not from W
+	if (len == cl -> minlen + 1 && cl -> span == SPAN_INDEXED && rn != 4)
+		return len;
+	return cl -> maxlen;
+}
+
+// can an indexed operand of v use the no offset form?
+static int span_zerooffset(line_t *cl, int v)
+{
+	if (v != 0 || CURPRAGMA(cl, PRAGMA_NOINDEX0TONONE) || (cl -> spanpb & 0x40))
+		return 0;
+	return (cl -> spanpb & 0x07) <= 4;
+}
+
+// the length the operand of cl needs now that everything is resolved
+static int span_needed(asmstate_t *as, line_t *cl, int *v)
+{
+	lw_expr_t e;
+	int rn;
+
+	e = lw_expr_copy(lwasm_fetch_expr(cl, 0));
+	as -> cl = cl;
+	lwasm_reduce_expr(as, e);
+	if (!lw_expr_istype(e, lw_expr_type_int))
+	{
+		lw_expr_destroy(e);
+		return cl -> maxlen;
+	}
+	*v = lw_expr_intval(e);
+	lw_expr_destroy(e);
+
+	switch (cl -> span)
+	{
+	case SPAN_REL:
+		if (*v >= -128 && *v <= 127)
+			return cl -> minlen;
+		return cl -> maxlen;
+
+	case SPAN_DIRECT:
+		if (((*v >> 8) & 0xff) == (cl -> dpval & 0xff))
+			return cl -> minlen;
+		return cl -> maxlen;
+
+	case SPAN_INDEXED:
+		rn = cl -> spanpb & 0x07;
+		if (span_zerooffset(cl, *v))
+			return cl -> minlen;
+		if (*v < -128 || *v > 127)
+			return cl -> maxlen;
+		if (rn < 4 && !(cl -> spanpb & 0x80) && *v >= -16 && *v <= 15)
+			return cl -> minlen;
+		return span_fit(cl, cl -> minlen + 1);
+	}
+	return cl -> maxlen;
+}
+
+/*
+set the addressing mode for the guessed length; the post byte for a
+short indexed operand depends on the operand value, so it is only a
+placeholder until "known" is set
+*/
+static void span_setmode(line_t *cl, int known, int v)
+{
+	int rn = cl -> spanpb & 0x07;
+	int indir = (cl -> spanpb & 0x80) ? 0x10 : 0;
+
+	switch (cl -> span)
+	{
+	case SPAN_REL:
+		cl -> lint = (cl -> len == cl -> minlen) ? 8 : 16;
+		break;
+
+	case SPAN_DIRECT:
+		cl -> lint2 = (cl -> len == cl -> minlen) ? 0 : 2;
+		break;
+
+	case SPAN_INDEXED:
+		cl -> lint = cl -> len - cl -> minlen;
+		if (cl -> lint == 0)
+		{
+			if (!known)
+				return;
+			if (span_zerooffset(cl, v))
+			{
+				if (rn < 4)
+					cl -> pb = 0x84 | (rn << 5) | indir;
+				else
+					cl -> pb = indir ? 0x90 : 0x8F;
+			}
+			else
+			{
+				cl -> pb = (rn << 5) | (v & 0x1F);
+			}
+		}
+		else if (cl -> lint == 1)
+		{
+			if (rn < 4)
+				cl -> pb = 0x88 | (rn << 5) | indir;
+			else
+				cl -> pb = indir ? 0x9C : 0x8C;
+		}
+		else
+		{
+			if (rn < 4)
+				cl -> pb = 0x89 | (rn << 5) | indir;
+			else if (rn == 4)
+				cl -> pb = indir ? 0xB0 : 0xAF;
+			else
+				cl -> pb = indir ? 0x9D : 0x8D;
+		}
+		break;
+	}
+}
+
+/*
+give a line whose operand is a forward reference its guessed length; called
+from pass 1 right after the line is parsed
+*/
+void lwasm_span_guess(asmstate_t *as, line_t *cl)
+{
+	spanstate_t *ss = as -> spanstate;
+	int n;
+
+	if (!ss || !lwasm_fetch_expr(cl, 0))
+		return;
+
+	n = as -> spancount++;
+	if (n >= ss -> nguess)
+	{
+		ss -> guess = lw_realloc(ss -> guess, sizeof(int) * (n + 64));
+		memset(ss -> guess + ss -> nguess, 0, sizeof(int) * (n + 64 - ss -> nguess));
+		ss -> nguess = n + 64;
+	}
+
+	cl -> spanidx = n;
+	cl -> spanpb = cl -> pb;
+	if (ss -> allmax)
+		cl -> spanlen = cl -> maxlen;
+	else
+		cl -> spanlen = span_fit(cl, ss -> guess[n]);
+	cl -> len = cl -> spanlen;
+	span_setmode(cl, 0, 0);
+}
+
+/*
+Span check pass
+
+check the guesses made on pass 1 against the resolved operands
+*/
+void do_spancheck(asmstate_t *as)
+{
+	spanstate_t *ss = as -> spanstate;
+	line_t *cl;
+	int count[4] = { 0 };
+	int grown = 0;
+	int saved = 0;
+	int n, v = 0;
+
+	if (!ss)
+		return;
+
+	for (cl = as -> line_head; cl; cl = cl -> next)
+	{
+		if (cl -> spanlen <= 0)
+			continue;
+		n = span_needed(as, cl, &v);
+		if (n > cl -> len)
+		{
+			debug_message(as, 100, "Span guess %d too small: %d -> %d", cl -> spanidx, cl -> len, n);
+			ss -> guess[cl -> spanidx] = n;
+			grown++;
+			continue;
+		}
+		span_setmode(cl, 1, v);
+		count[cl -> span]++;
+		saved += cl -> maxlen - cl -> len;
+	}
+
+	ss -> rounds++;
+	if (grown > 0)
+	{
+		debug_message(as, 50, "Span round %d: %d guesses grown", ss -> rounds, grown);
+		if (ss -> rounds >= SPAN_MAXROUNDS)
+			ss -> allmax = 1;
+		ss -> retry = 1;
+		return;
+	}
+
+	if (as -> flags & FLAG_SPANSTATS)
+	{
+		fprintf(stderr, "Span sizing: %d branches, %d direct/extended, %d indexed; %d rounds; %d bytes saved\n",
+			count[SPAN_REL], count[SPAN_DIRECT], count[SPAN_INDEXED], ss -> rounds, saved);
+	}
+}
@@ -28,223 +28,1129 @@ this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include "tree.h"
 
-char *generate_nextlabel(void)
+/*
+Code generation works a function at a time. The function body is lowered to
+a linear IR whose operands are virtual registers, the virtual registers are
+given machine locations by a linear scan over their live ranges, and the IR
+is then turned into assembly using those locations.
+
+Arithmetic on the 6809 only happens in D so every ALU result passes through
+D. Values that have to survive while D is busy go to X, Y, or U (or W when
+generating 6309 code) and only go to the stack frame when no register is
+free or, on the 6809, when the value is the memory operand of an ALU or
+compare instruction.
+
+Arithmetic helpers (___mul16i and friends) take the left operand on the
+stack and the right operand in D and leave the result in the stack slot.
+They may clobber D, X, and W but preserve Y and U, which are saved by any
+function that uses them.
+*/
+
+extern int target_6309;
+
+/* IR operations */
+enum
+{
+    IR_LOAD,        // dst = imm
+    IR_COPY,        // dst = a
+    IR_ADD,         // dst = a + b
+    IR_SUB,         // dst = a - b
+    IR_AND,         // dst = a & b
+    IR_OR,          // dst = a | b
+    IR_XOR,         // dst = a ^ b
+    IR_LSH,         // dst = a << imm
+    IR_RSH,         // dst = a >> imm
+    IR_CALL,        // dst = helper(a, b)
+    IR_CMP,         // set flags for a - b
+    IR_TEST,        // set flags for a
+    IR_BRANCH,      // branch to label if cond holds
+    IR_JUMP,        // branch to label
+    IR_LABEL,       // define label
+    IR_RETURN       // a (if any) is the function result
+};
+
+/* branch conditions */
+enum
+{
+    COND_EQ,
+    COND_NE,
+    COND_LT,
+    COND_GE,
+    COND_GT,
+    COND_LE
+};
+
+static const char *cond_names[] = { "eq", "ne", "lt", "ge", "gt", "le" };
+static const int cond_swapped[] = { COND_EQ, COND_NE, COND_GT, COND_LE, COND_LT, COND_GE };
+
+// the opposite of a condition is its neighbour in the table
+#define cond_negate(c) ((c) ^ 1)
+
+/* a b operand of NOREG means imm is the operand */
+#define NOREG (-1)
+
+struct ir_insn
+{
+    int op;
+    int dst, a, b;          // virtual registers
+    long imm;               // immediate operand or shift count
+    int cond;               // condition for IR_BRANCH
+    int label;              // label for IR_BRANCH, IR_JUMP, and IR_LABEL
+    const char *helper;     // routine for IR_CALL
+};
+
+/* machine locations; frame slot n is LOC_SLOT + n */
+#define LOC_D       0
+#define LOC_X       1
+#define LOC_Y       2
+#define LOC_U       3
+#define LOC_W       4
+#define NUMREGS     5
+#define LOC_SLOT    8
+
+static const char *reg_names[] = { "d", "x", "y", "u", "w" };
+
+/* the order registers are handed out in */
+static const int reg_order[] = { LOC_D, LOC_X, LOC_W, LOC_Y, LOC_U };
+
+struct vreg
+{
+    int start;              // first instruction that defines it
+    int end;                // last instruction that uses it
+    int loc;                // where it lives
+    int operand;            // nonzero if it is the second operand of an ALU op or compare
+};
+
+static struct ir_insn *insns;
+static int ninsns;
+static int ainsns;
+static struct vreg *vregs;
+static int nvregs;
+static int avregs;
+static int nslots;          // frame slots used by the function
+static int saved_y;         // nonzero if Y must be preserved
+static int saved_u;         // nonzero if U must be preserved
+static int stack_depth;     // bytes pushed on top of the frame
+static int labelnum = 0;
+
+static int new_label(void)
+{
+    return labelnum++;
+}
+
+static int new_vreg(void)
+{
+    if (nvregs == avregs)
+    {
+        avregs += 32;
+        vregs = lw_realloc(vregs, sizeof(struct vreg) * avregs);
+    }
+    vregs[nvregs].start = -1;
+    vregs[nvregs].end = -1;
+    vregs[nvregs].loc = -1;
+    vregs[nvregs].operand = 0;
+    return nvregs++;
+}
+
+static struct ir_insn *emit_ir(int op)
 {
-    static int labelnum = 0;
-    char buf[16];
+    struct ir_insn *i;
     
-    sprintf(buf, "L%d", labelnum++);
-    return lw_strdup(buf);
+    if (ninsns == ainsns)
+    {
+        ainsns += 64;
+        insns = lw_realloc(insns, sizeof(struct ir_insn) * ainsns);
+    }
+    i = &(insns[ninsns++]);
+    memset(i, 0, sizeof(struct ir_insn));
+    i -> op = op;
+    i -> dst = NOREG;
+    i -> a = NOREG;
+    i -> b = NOREG;
+    return i;
+}
+
+static void emit_label(int label)
+{
+    emit_ir(IR_LABEL) -> label = label;
 }
 
-void generate_code(node_t *n, FILE *output);
+static void emit_jump(int label)
+{
+    emit_ir(IR_JUMP) -> label = label;
+}
 
-void generate_code_shift(node_t *n, FILE *output, int dir)
+/* emit a three operand instruction and return its result */
+static int emit_op(int op, int a, int b, long imm)
 {
-    generate_code(n -> children, output);
-    if (n -> children -> next_child -> type == NODE_CONST_INT)
+    struct ir_insn *i;
+    
+    i = emit_ir(op);
+    i -> dst = new_vreg();
+    i -> a = a;
+    i -> b = b;
+    i -> imm = imm;
+    return i -> dst;
+}
+
+static int is_const(node_t *n)
+{
+    return n -> type == NODE_CONST_INT;
+}
+
+/* the value of a constant, as a 16 bit int */
+static long const_value(node_t *n)
+{
+    long v;
+    
+    v = strtol(n -> strval, NULL, 0) & 0xffff;
+    if (v > 32767)
+        v -= 65536;
+    return v;
+}
+
+static int is_expression(node_t *n)
+{
+    return n -> type == NODE_CONST_INT || n -> type == NODE_IDENT || (n -> type >= NODE_OPER_PLUS && n -> type <= NODE_TYPECAST);
+}
+
+/*
+Estimate how many registers evaluating n needs (the Sethi-Ullman number).
+The operand that needs more is evaluated first so fewer values have to be
+kept around while the other one is computed. Helper calls count high since
+they clobber most registers.
+*/
+static int need(node_t *n)
+{
+    node_t *nn;
+    int m = 0, ties = 0, k;
+    
+    switch (n -> type)
     {
-        long ival;
-        int i;
-        ival = strtol(n -> children -> next_child -> strval, NULL, 0);
-        if (ival <= 0)
-            return;
-        if (ival >= 16)
-        {
-            fprintf(output, "\tldd #%d\n", dir == 1 ? 0 : -1);
-            return;
-        }
-        if (ival >= 8)
+    case NODE_CONST_INT:
+        return 0;
+
+    case NODE_TYPECAST:
+        return need(n -> children -> next_child);
+
+    case NODE_OPER_TIMES:
+    case NODE_OPER_DIVIDE:
+    case NODE_OPER_MOD:
+        return 8;
+    
+    case NODE_OPER_LSH:
+    case NODE_OPER_RSH:
+        if (!is_const(n -> children -> next_child))
+            return 8;
+        break;
+    }
+    for (nn = n -> children; nn; nn = nn -> next_child)
+    {
+        k = need(nn);
+        if (k < 1)
+            k = 1;
+        if (k > m)
         {
-            if (dir == 1)
-            {
-                fprintf(output, "\ttfr b,a\n\tclrb\n");
-                for (i = ival - 8; i > 0; i--)
-                {
-                    fprintf(output, "\tlsla\n");
-                }
-            }
-            else
-            {
-                fprintf(output, "\ttfr a,b\n\tsex\n");
-                for (i = ival - 8; i > 0; i--)
-                {
-                    fprintf(output, "\tasrb\n");
-                }
-            }
-            return;
+            m = k;
+            ties = 0;
         }
-        for (i = ival; i > 0; i--)
+        else if (k == m)
         {
-            if (dir == 1)
-            {
-                fprintf(output, "\taslb\n\trola\n");
-            }
-            else
-            {
-                fprintf(output, "\tasra\n\trorb\n");
-            }
+            ties = 1;
         }
-        return;
+    }
+    return m + ties;
+}
+
+static int lower_expr(node_t *n);
+static void lower_branch(node_t *n, int label, int sense);
+
+/* lower an ALU operator, using the immediate form if either side is constant */
+static int lower_alu(int op, node_t *n, int commutative)
+{
+    node_t *l = n -> children;
+    node_t *r = l -> next_child;
+    int a, b;
+    
+    if (is_const(r))
+    {
+        a = lower_expr(l);
+        return emit_op(op, a, NOREG, const_value(r));
+    }
+    if (is_const(l) && commutative)
+    {
+        a = lower_expr(r);
+        return emit_op(op, a, NOREG, const_value(l));
+    }
+    if (is_const(l))
+    {
+        // c - x is ~x + c + 1
+        a = lower_expr(r);
+        a = emit_op(IR_XOR, a, NOREG, -1);
+        return emit_op(IR_ADD, a, NOREG, (const_value(l) + 1) & 0xffff);
+    }
+    
+    // the operand evaluated last is the one that ends up in D
+    if (commutative && need(l) >= need(r))
+    {
+        b = lower_expr(l);
+        a = lower_expr(r);
     }
     else
     {
-        fprintf(output, "\tpshs d\n");
-        generate_code(n -> children -> next_child, output);
-        fprintf(output, "\tjsr ___%ssh16\n\tpuls d\n", dir == 1 ? "l" : "r");
+        b = lower_expr(r);
+        a = lower_expr(l);
     }
+    return emit_op(op, a, b, 0);
 }
 
+static int lower_call(const char *helper, node_t *n)
+{
+    node_t *l = n -> children;
+    node_t *r = l -> next_child;
+    struct ir_insn *i;
+    int a, b;
+    
+    if (need(r) > need(l))
+    {
+        b = lower_expr(r);
+        a = lower_expr(l);
+    }
+    else
+    {
+        a = lower_expr(l);
+        b = lower_expr(r);
+    }
+    i = emit_ir(IR_CALL);
+    i -> dst = new_vreg();
+    i -> a = a;
+    i -> b = b;
+    i -> helper = helper;
+    return i -> dst;
+}
 
-void generate_code(node_t *n, FILE *output)
+static int lower_shift(int op, const char *helper, node_t *n)
 {
-    node_t *nn;
-    char *label1, *label2;
+    node_t *r = n -> children -> next_child;
+    
+    if (!is_const(r))
+        return lower_call(helper, n);
+    return emit_op(op, lower_expr(n -> children), NOREG, const_value(r));
+}
+
+/* compute a truth value into a register */
+static int lower_truth(node_t *n)
+{
+    struct ir_insn *i;
+    int r, ltrue, lend;
+    
+    r = new_vreg();
+    ltrue = new_label();
+    lend = new_label();
+    lower_branch(n, ltrue, 1);
+    i = emit_ir(IR_LOAD);
+    i -> dst = r;
+    i -> imm = 0;
+    emit_jump(lend);
+    emit_label(ltrue);
+    i = emit_ir(IR_LOAD);
+    i -> dst = r;
+    i -> imm = 1;
+    emit_label(lend);
+    return r;
+}
 
+static int lower_cond(node_t *n)
+{
+    node_t *cond = n -> children;
+    struct ir_insn *i;
+    int r, lelse, lend, v;
+    
+    r = new_vreg();
+    lelse = new_label();
+    lend = new_label();
+    lower_branch(cond, lelse, 0);
+    v = lower_expr(cond -> next_child);
+    i = emit_ir(IR_COPY);
+    i -> dst = r;
+    i -> a = v;
+    emit_jump(lend);
+    emit_label(lelse);
+    v = lower_expr(cond -> next_child -> next_child);
+    i = emit_ir(IR_COPY);
+    i -> dst = r;
+    i -> a = v;
+    emit_label(lend);
+    return r;
+}
+
+static int lower_expr(node_t *n)
+{
+    node_t *nn;
+    struct ir_insn *i;
+    
     switch (n -> type)
     {
-    // function definition - output prologue, then statements, then epilogue
-    case NODE_FUNDEF:
-        fprintf(output, "\tsection .text\n\texport _%s\n_%s\n", n->children->next_child->strval, n->children->next_child->strval);
-        generate_code(n->children->next_child->next_child->next_child, output);
-        fprintf(output, "\trts\n");
-        break;
-    
-    case NODE_CONST_INT:
-        fprintf(output, "\tldd #%s\n", n->strval);
-        break;
+    case NODE_TYPECAST:
+        return lower_expr(n -> children -> next_child);
 
     case NODE_OPER_PLUS:
-        generate_code(n->children, output);
-        fprintf(output, "\tpshs d\n");
-        generate_code(n->children->next_child, output);
-        fprintf(output, "\taddd ,s++\n");
-        break;
+        return lower_alu(IR_ADD, n, 1);
     
     case NODE_OPER_MINUS:
-        generate_code(n->children, output);
-        fprintf(output, "\tpshs d,x\n");
-        generate_code(n->children->next_child, output);
-        fprintf(output, "\tstd 2,s\n\tpuls d\n\tsubd ,s++\n");
-        break;
-
+        return lower_alu(IR_SUB, n, 0);
+    
+    case NODE_OPER_BWAND:
+        return lower_alu(IR_AND, n, 1);
+    
+    case NODE_OPER_BWOR:
+        return lower_alu(IR_OR, n, 1);
+    
+    case NODE_OPER_BWXOR:
+        return lower_alu(IR_XOR, n, 1);
+    
     case NODE_OPER_TIMES:
-        generate_code(n -> children, output);
-        fprintf(output, "\tpshs d\n");
-        generate_code(n->children->next_child, output);
-        fprintf(output, "\tjsr ___mul16i\n\tpuls d\n");
-        break;
-
+        return lower_call("___mul16i", n);
+    
     case NODE_OPER_DIVIDE:
-        generate_code(n -> children, output);
-        fprintf(output, "\tpshs d\n");
-        generate_code(n->children->next_child, output);
-        fprintf(output, "\tjsr ___div16i\n\tpuls d\n");
-        break;
+        return lower_call("___div16i", n);
     
     case NODE_OPER_MOD:
-        generate_code(n -> children, output);
-        fprintf(output, "\tpshs d\n");
-        generate_code(n -> children -> next_child, output);
-        fprintf(output, "\tjsr ___mod16i\n\tpuls d\n");
-        break;
-
+        return lower_call("___mod16i", n);
+    
     case NODE_OPER_LSH:
-        generate_code_shift(n, output, 1);
-        break;
-
+        return lower_shift(IR_LSH, "___lsh16", n);
+    
     case NODE_OPER_RSH:
-        generate_code_shift(n, output, 0);
-        break;
-
+        return lower_shift(IR_RSH, "___rsh16", n);
+    
     case NODE_OPER_COND:
-        label1 = generate_nextlabel();
-        label2 = generate_nextlabel();
-        generate_code(n -> children, output);
-        fprintf(output, "\tsubd #0\n\tbeq %s\n", label1);
-        generate_code(n -> children -> next_child, output);
-        fprintf(output, "\tbra %s\n%s\n", label2, label1);
-        generate_code(n -> children -> next_child -> next_child, output);
-        fprintf(output, "%s\n", label2);
-        lw_free(label1);
-        lw_free(label2);
-        break;
+        return lower_cond(n);
     
     case NODE_OPER_COMMA:
-        generate_code(n -> children, output);
-        generate_code(n -> children -> next_child, output);
-        break;
-    
-    case NODE_OPER_BWAND:
-        generate_code(n -> children, output);
-        fprintf(output, "\tpshs d\n");
-        generate_code(n -> children -> next_child, output);
-        fprintf(output, "\tandb 1,s\n\tanda ,s++\n");
-        break;
-
-    case NODE_OPER_BWOR:
-        generate_code(n -> children, output);
-        fprintf(output, "\tpshs d\n");
-        generate_code(n -> children -> next_child, output);
-        fprintf(output, "\torb 1,s\n\tora ,s++\n");
-        break;
-
-    case NODE_OPER_BWXOR:
-        generate_code(n -> children, output);
-        fprintf(output, "\tpshs d\n");
-        generate_code(n -> children -> next_child, output);
-        fprintf(output, "\teorb 1,s\n\teora ,s++\n");
-        break;
+        lower_expr(n -> children);
+        return lower_expr(n -> children -> next_child);
 
+    case NODE_OPER_EQ:
+    case NODE_OPER_NE:
+    case NODE_OPER_LT:
+    case NODE_OPER_LE:
+    case NODE_OPER_GT:
+    case NODE_OPER_GE:
     case NODE_OPER_BAND:
-        label1 = generate_nextlabel();
-        generate_code(n -> children, output);
-        fprintf(output, "\tsubd #0\n\tbeq %s\n", label1);
-        generate_code(n -> children -> next_child, output);
-        fprintf(output, "\tsubd #0\n\tbeq %s\n\tldd #1\n%s\n", label1, label1);
-        lw_free(label1);
-        break;
-
     case NODE_OPER_BOR:
-        label1 = generate_nextlabel();
-        label2 = generate_nextlabel();
-        generate_code(n -> children, output);
-        fprintf(output, "\tsubd #0\n\tbne %s\n", label1);
-        generate_code(n -> children -> next_child, output);
-        fprintf(output, "\tsubd #0\n\tbeq %s\n%s\tldd #1\n%s\n", label2, label1, label2);
-        lw_free(label1);
-        lw_free(label2);
-        break; 
+        return lower_truth(n);
+    
+    case NODE_CONST_INT:
+        i = emit_ir(IR_LOAD);
+        i -> dst = new_vreg();
+        i -> imm = const_value(n);
+        return i -> dst;
+    
+    default:
+        // nothing else produces a value yet; evaluate the operands anyway
+        for (nn = n -> children; nn; nn = nn -> next_child)
+        {
+            if (is_expression(nn))
+                lower_expr(nn);
+        }
+        i = emit_ir(IR_LOAD);
+        i -> dst = new_vreg();
+        i -> imm = 0;
+        return i -> dst;
+    }
+}
 
-    case NODE_OPER_NE:
+static int comparison_cond(int type)
+{
+    switch (type)
+    {
     case NODE_OPER_EQ:
+        return COND_EQ;
+    case NODE_OPER_NE:
+        return COND_NE;
     case NODE_OPER_LT:
+        return COND_LT;
+    case NODE_OPER_LE:
+        return COND_LE;
     case NODE_OPER_GT:
+        return COND_GT;
+    default:
+        return COND_GE;
+    }
+}
+
+/* emit code that branches to label if the truth of n is sense and falls
+   through otherwise */
+static void lower_branch(node_t *n, int label, int sense)
+{
+    node_t *l = n -> children;
+    node_t *r;
+    struct ir_insn *i;
+    int cond, a, b, skip;
+    long imm = 0;
+    
+    switch (n -> type)
+    {
+    case NODE_OPER_EQ:
+    case NODE_OPER_NE:
+    case NODE_OPER_LT:
     case NODE_OPER_LE:
+    case NODE_OPER_GT:
     case NODE_OPER_GE:
-        generate_code(n -> children, output);
+        r = l -> next_child;
+        cond = comparison_cond(n -> type);
+        if (!sense)
+            cond = cond_negate(cond);
+        if (is_const(l) && !is_const(r))
+        {
+            l = r;
+            r = n -> children;
+            cond = cond_swapped[cond];
+        }
+        if (is_const(r))
+        {
+            a = lower_expr(l);
+            b = NOREG;
+            imm = const_value(r);
+        }
+        else
+        {
+            b = lower_expr(r);
+            a = lower_expr(l);
+        }
+        i = emit_ir(IR_CMP);
+        i -> a = a;
+        i -> b = b;
+        i -> imm = imm;
+        i = emit_ir(IR_BRANCH);
+        i -> cond = cond;
+        i -> label = label;
+        return;
+    
+    case NODE_OPER_BAND:
+        if (sense)
+        {
+            skip = new_label();
+            lower_branch(l, skip, 0);
+            lower_branch(l -> next_child, label, 1);
+            emit_label(skip);
+        }
+        else
+        {
+            lower_branch(l, label, 0);
+            lower_branch(l -> next_child, label, 0);
+        }
+        return;
+    
+    case NODE_OPER_BOR:
+        if (sense)
+        {
+            lower_branch(l, label, 1);
+            lower_branch(l -> next_child, label, 1);
+        }
+        else
+        {
+            skip = new_label();
+            lower_branch(l, skip, 1);
+            lower_branch(l -> next_child, label, 0);
+            emit_label(skip);
+        }
+        return;
+    
+    case NODE_OPER_COMMA:
+        lower_expr(l);
+        lower_branch(l -> next_child, label, sense);
+        return;
+    
+    case NODE_CONST_INT:
+        if ((const_value(n) != 0) == sense)
+            emit_jump(label);
+        return;
+    }
+    
+    a = lower_expr(n);
+    emit_ir(IR_TEST) -> a = a;
+    i = emit_ir(IR_BRANCH);
+    i -> cond = sense ? COND_NE : COND_EQ;
+    i -> label = label;
+}
+
+static void lower_statement(node_t *n, int epilogue)
+{
+    node_t *nn;
+    int a = NOREG;
+    
+    if (n -> type == NODE_STMT_RETURN)
+    {
+        if (n -> children)
+            a = lower_expr(n -> children);
+        emit_ir(IR_RETURN) -> a = a;
+        emit_jump(epilogue);
+        return;
+    }
+    if (is_expression(n))
+    {
+        lower_expr(n);
+        return;
+    }
+    for (nn = n -> children; nn; nn = nn -> next_child)
+        lower_statement(nn, epilogue);
+}
+
+/* register allocation */
+
+static int needs_d(struct ir_insn *i)
+{
+    return (i -> op >= IR_ADD && i -> op <= IR_RSH) || i -> op == IR_CALL;
+}
+
+/* nonzero if something between the definition and the use of v destroys reg */
+static int clobbered(int v, int reg)
+{
+    int i;
+    
+    for (i = vregs[v].start + 1; i < vregs[v].end; i++)
+    {
+        if (reg == LOC_D && needs_d(&(insns[i])))
+            return 1;
+        if (insns[i].op == IR_CALL && (reg == LOC_X || reg == LOC_W))
+            return 1;
+    }
+    return 0;
+}
+
+static void compute_ranges(void)
+{
+    struct ir_insn *in;
+    int i;
+    
+    for (i = 0; i < ninsns; i++)
+    {
+        in = &(insns[i]);
+        if (in -> a != NOREG)
+            vregs[in -> a].end = i;
+        if (in -> b != NOREG)
+        {
+            vregs[in -> b].end = i;
+            if (in -> op != IR_CALL)
+                vregs[in -> b].operand = 1;
+        }
+        if (in -> dst != NOREG)
+        {
+            if (vregs[in -> dst].start < 0)
+                vregs[in -> dst].start = i;
+            if (vregs[in -> dst].end < i)
+                vregs[in -> dst].end = i;
+        }
+    }
+}
+
+static int compare_start(const void *a, const void *b)
+{
+    return vregs[*(const int *)a].start - vregs[*(const int *)b].start;
+}
+
+/*
+Linear scan: walk the live ranges in order of their start, releasing the
+locations of ranges that have ended, and give each range the first register
+that is free and survives everything the range spans. A range ending where
+another starts can hand its location over since the instruction reads its
+operands before it writes its result.
+*/
+static void allocate_registers(void)
+{
+    int owner[NUMREGS];
+    int *slots = NULL;
+    int *order;
+    int i, j, k, v, reg;
+    
+    order = lw_alloc(sizeof(int) * (nvregs + 1));
+    for (i = 0; i < nvregs; i++)
+        order[i] = i;
+    qsort(order, nvregs, sizeof(int), compare_start);
+    for (i = 0; i < NUMREGS; i++)
+        owner[i] = -1;
+    nslots = 0;
+    
+    for (i = 0; i < nvregs; i++)
+    {
+        v = order[i];
+        if (vregs[v].start < 0)
+            continue;
+        for (j = 0; j < NUMREGS; j++)
+        {
+            if (owner[j] >= 0 && vregs[owner[j]].end <= vregs[v].start)
+                owner[j] = -1;
+        }
+        for (j = 0; j < nslots; j++)
+        {
+            if (slots[j] >= 0 && vregs[slots[j]].end <= vregs[v].start)
+                slots[j] = -1;
+        }
+        
+        vregs[v].loc = -1;
+        // the 6809 has no register to register arithmetic
+        if (!vregs[v].operand || target_6309)
+        {
+            for (j = 0; j < NUMREGS; j++)
+            {
+                reg = reg_order[j];
+                if (reg == LOC_W && !target_6309)
+                    continue;
+                if (reg == LOC_D && vregs[v].operand)
+                    continue;
+                if (owner[reg] >= 0 || clobbered(v, reg))
+                    continue;
+                vregs[v].loc = reg;
+                owner[reg] = v;
+                if (reg == LOC_Y)
+                    saved_y = 1;
+                if (reg == LOC_U)
+                    saved_u = 1;
+                break;
+            }
+        }
+        if (vregs[v].loc >= 0)
+            continue;
+        
+        for (k = 0; k < nslots; k++)
+        {
+            if (slots[k] < 0)
+                break;
+        }
+        if (k == nslots)
+        {
+            nslots++;
+            slots = lw_realloc(slots, sizeof(int) * nslots);
+        }
+        slots[k] = v;
+        vregs[v].loc = LOC_SLOT + k;
+    }
+    lw_free(slots);
+    lw_free(order);
+}
+
+/* assembly output */
+
+static FILE *output;
+
+static int loc(int v)
+{
+    return vregs[v].loc;
+}
+
+static int slot_offset(int l)
+{
+    return (l - LOC_SLOT) * 2 + stack_depth;
+}
+
+/* return a register not holding anything live at instruction pos, or -1 */
+static int scratch_reg(int pos)
+{
+    static const int scratch[] = { LOC_D, LOC_X, LOC_W };
+    int i, v;
+    
+    for (i = 0; i < 3; i++)
+    {
+        if (scratch[i] == LOC_W && !target_6309)
+            continue;
+        for (v = 0; v < nvregs; v++)
+        {
+            if (vregs[v].loc == scratch[i] && vregs[v].start <= pos && vregs[v].end >= pos)
+                break;
+        }
+        if (v == nvregs)
+            return scratch[i];
+    }
+    return -1;
+}
+
+/* copy the value at location from to location to */
+static void gen_move(int to, int from, int pos)
+{
+    int r;
+    
+    if (to == from)
+        return;
+    if (to < LOC_SLOT && from < LOC_SLOT)
+    {
+        fprintf(output, "\ttfr %s,%s\n", reg_names[from], reg_names[to]);
+    }
+    else if (to < LOC_SLOT)
+    {
+        fprintf(output, "\tld%s %d,s\n", reg_names[to], slot_offset(from));
+    }
+    else if (from < LOC_SLOT)
+    {
+        fprintf(output, "\tst%s %d,s\n", reg_names[from], slot_offset(to));
+    }
+    else if ((r = scratch_reg(pos)) >= 0)
+    {
+        fprintf(output, "\tld%s %d,s\n", reg_names[r], slot_offset(from));
+        fprintf(output, "\tst%s %d,s\n", reg_names[r], slot_offset(to));
+    }
+    else
+    {
+        stack_depth += 2;
+        fprintf(output, "\tpshs d\n\tldd %d,s\n\tstd %d,s\n\tpuls d\n", slot_offset(from), slot_offset(to));
+        stack_depth -= 2;
+    }
+}
+
+static void gen_load_imm(int to, long imm, int pos)
+{
+    int r;
+    
+    if (to < LOC_SLOT)
+    {
+        fprintf(output, "\tld%s #%ld\n", reg_names[to], imm);
+    }
+    else if ((r = scratch_reg(pos)) >= 0)
+    {
+        fprintf(output, "\tld%s #%ld\n\tst%s %d,s\n", reg_names[r], imm, reg_names[r], slot_offset(to));
+    }
+    else
+    {
+        stack_depth += 2;
+        fprintf(output, "\tpshs d\n\tldd #%ld\n\tstd %d,s\n\tpuls d\n", imm, slot_offset(to));
+        stack_depth -= 2;
+    }
+}
+
+/* make sure v is in a register for a compare; returns the register or -1
+   if D had to be borrowed, in which case the caller must restore it */
+static int gen_compare_reg(int v, int pos)
+{
+    int r;
+    
+    if (loc(v) < LOC_SLOT)
+        return loc(v);
+    r = scratch_reg(pos);
+    if (r < 0)
+    {
+        // PULS does not touch the condition codes
         fprintf(output, "\tpshs d\n");
-        generate_code(n -> children -> next_child, output);
-        fprintf(output, "\tsubd ,s++\n");
-        label1 = generate_nextlabel();
-        label2 = generate_nextlabel();
-        fprintf(output, "\t%s %s\n", (
-            (n -> type == NODE_OPER_NE ? "bne" :
-            (n -> type == NODE_OPER_EQ ? "beq" :
-            (n -> type == NODE_OPER_LT ? "bge" :
-            (n -> type == NODE_OPER_GT ? "ble" :
-            (n -> type == NODE_OPER_LE ? "bgt" :
-            (n -> type == NODE_OPER_GE ? "blt" :
-            "foobar"))))))
-        ), label1);
-        fprintf(output, "\tldd #0\n\tbra %s\n%s\tldd #1\n%s\n", label2, label1, label2);
-        lw_free(label1);
-        lw_free(label2);
+        stack_depth += 2;
+        fprintf(output, "\tldd %d,s\n", slot_offset(loc(v)));
+        return -1;
+    }
+    fprintf(output, "\tld%s %d,s\n", reg_names[r], slot_offset(loc(v)));
+    return r;
+}
+
+static void gen_compare(struct ir_insn *in, int pos)
+{
+    int r, l;
+    
+    r = gen_compare_reg(in -> a, pos);
+    l = (r < 0) ? LOC_D : r;
+    if (in -> b == NOREG)
+        fprintf(output, "\tcmp%s #%ld\n", reg_names[l], in -> imm);
+    else if (loc(in -> b) >= LOC_SLOT)
+        fprintf(output, "\tcmp%s %d,s\n", reg_names[l], slot_offset(loc(in -> b)));
+    else
+        fprintf(output, "\tcmpr %s,%s\n", reg_names[loc(in -> b)], reg_names[l]);
+    if (r < 0)
+    {
+        stack_depth -= 2;
+        fprintf(output, "\tpuls d\n");
+    }
+}
+
+static void gen_test(struct ir_insn *in, int pos)
+{
+    int r;
+    
+    switch (loc(in -> a))
+    {
+    case LOC_D:
+        fprintf(output, target_6309 ? "\ttstd\n" : "\tsubd #0\n");
+        return;
+    
+    case LOC_W:
+        fprintf(output, "\ttstw\n");
+        return;
+    
+    case LOC_X:
+    case LOC_Y:
+    case LOC_U:
+        fprintf(output, "\tcmp%s #0\n", reg_names[loc(in -> a)]);
+        return;
+    }
+    // loading the value sets the flags
+    r = gen_compare_reg(in -> a, pos);
+    if (r < 0)
+    {
+        stack_depth -= 2;
+        fprintf(output, "\tpuls d\n");
+    }
+}
+
+/* apply an 8 bit immediate operation to one half of D */
+static void gen_byte_op(int op, const char *acc, int v)
+{
+    switch (op)
+    {
+    case IR_AND:
+        if (v == 0)
+            fprintf(output, "\tclr%s\n", acc);
+        else if (v != 0xff)
+            fprintf(output, "\tand%s #%d\n", acc, v);
         break;
     
-    default:
-        for (nn = n -> children; nn; nn = nn -> next_child)
-            generate_code(nn, output);
+    case IR_OR:
+        if (v != 0)
+            fprintf(output, "\tor%s #%d\n", acc, v);
+        break;
+    
+    case IR_XOR:
+        if (v == 0xff)
+            fprintf(output, "\tcom%s\n", acc);
+        else if (v != 0)
+            fprintf(output, "\teor%s #%d\n", acc, v);
         break;
     }
 }
+
+static void gen_shift(int op, long count)
+{
+    long i;
+    
+    if (count <= 0)
+        return;
+    if (count >= 16)
+    {
+        if (op == IR_LSH)
+            fprintf(output, "\tldd #0\n");
+        else
+            fprintf(output, "\ttfr a,b\n\tsex\n\ttfr a,b\n");
+        return;
+    }
+    if (count >= 8)
+    {
+        if (op == IR_LSH)
+        {
+            fprintf(output, "\ttfr b,a\n\tclrb\n");
+            for (i = count - 8; i > 0; i--)
+                fprintf(output, "\tlsla\n");
+        }
+        else
+        {
+            fprintf(output, "\ttfr a,b\n\tsex\n");
+            for (i = count - 8; i > 0; i--)
+                fprintf(output, "\tasrb\n");
+        }
+        return;
+    }
+    for (i = count; i > 0; i--)
+    {
+        if (target_6309)
+            fprintf(output, op == IR_LSH ? "\tlsld\n" : "\tasrd\n");
+        else
+            fprintf(output, op == IR_LSH ? "\taslb\n\trola\n" : "\tasra\n\trorb\n");
+    }
+}
+
+static void gen_alu(struct ir_insn *in)
+{
+    static const char *ops[] = { "add", "sub", "and", "or", "eor" };
+    const char *opn = ops[in -> op - IR_ADD];
+    int l;
+    
+    if (in -> b == NOREG)
+    {
+        switch (in -> op)
+        {
+        case IR_ADD:
+        case IR_SUB:
+            if (in -> imm != 0)
+                fprintf(output, "\t%sd #%ld\n", opn, in -> imm);
+            break;
+        
+        default:
+            if (target_6309 && in -> op == IR_XOR && (in -> imm & 0xffff) == 0xffff)
+                fprintf(output, "\tcomd\n");
+            else if (target_6309)
+                fprintf(output, "\t%sd #%ld\n", opn, in -> imm);
+            else
+            {
+                gen_byte_op(in -> op, "a", (in -> imm >> 8) & 0xff);
+                gen_byte_op(in -> op, "b", in -> imm & 0xff);
+            }
+            break;
+        }
+        return;
+    }
+    
+    l = loc(in -> b);
+    if (l < LOC_SLOT)
+        fprintf(output, "\t%sr %s,d\n", opn, reg_names[l]);
+    else if (target_6309 || in -> op == IR_ADD || in -> op == IR_SUB)
+        fprintf(output, "\t%sd %d,s\n", opn, slot_offset(l));
+    else
+        fprintf(output, "\t%sa %d,s\n\t%sb %d,s\n", opn, slot_offset(l), opn, slot_offset(l) + 1);
+}
+
+static void gen_call(struct ir_insn *in, int pos)
+{
+    int la = loc(in -> a);
+    int lb = loc(in -> b);
+    int r;
+    
+    // the left operand goes on the stack, the right one in D
+    if (la < LOC_SLOT)
+    {
+        fprintf(output, "\tpshs %s\n", reg_names[la]);
+    }
+    else
+    {
+        r = (lb == LOC_D) ? LOC_X : LOC_D;
+        fprintf(output, "\tld%s %d,s\n\tpshs %s\n", reg_names[r], slot_offset(la), reg_names[r]);
+    }
+    stack_depth += 2;
+    gen_move(LOC_D, lb, pos);
+    fprintf(output, "\tjsr %s\n\tpuls d\n", in -> helper);
+    stack_depth -= 2;
+    gen_move(loc(in -> dst), LOC_D, pos);
+}
+
+/* nonzero if the next real instruction after pos is label */
+static int falls_into(int pos, int label)
+{
+    for (pos++; pos < ninsns && insns[pos].op == IR_LABEL; pos++)
+    {
+        if (insns[pos].label == label)
+            return 1;
+    }
+    return 0;
+}
+
+static void generate_insns(void)
+{
+    struct ir_insn *in;
+    int i;
+    
+    for (i = 0; i < ninsns; i++)
+    {
+        in = &(insns[i]);
+        switch (in -> op)
+        {
+        case IR_LOAD:
+            gen_load_imm(loc(in -> dst), in -> imm, i);
+            break;
+        
+        case IR_COPY:
+            gen_move(loc(in -> dst), loc(in -> a), i);
+            break;
+        
+        case IR_ADD:
+        case IR_SUB:
+        case IR_AND:
+        case IR_OR:
+        case IR_XOR:
+            gen_move(LOC_D, loc(in -> a), i);
+            gen_alu(in);
+            gen_move(loc(in -> dst), LOC_D, i);
+            break;
+        
+        case IR_LSH:
+        case IR_RSH:
+            gen_move(LOC_D, loc(in -> a), i);
+            gen_shift(in -> op, in -> imm);
+            gen_move(loc(in -> dst), LOC_D, i);
+            break;
+        
+        case IR_CALL:
+            gen_call(in, i);
+            break;
+        
+        case IR_CMP:
+            gen_compare(in, i);
+            break;
+        
+        case IR_TEST:
+            gen_test(in, i);
+            break;
+        
+        case IR_BRANCH:
+            fprintf(output, "\tb%s L%d\n", cond_names[in -> cond], in -> label);
+            break;
+        
+        case IR_JUMP:
+            if (!falls_into(i, in -> label))
+                fprintf(output, "\tbra L%d\n", in -> label);
+            break;
+        
+        case IR_LABEL:
+            fprintf(output, "L%d\n", in -> label);
+            break;
+        
+        case IR_RETURN:
+            if (in -> a != NOREG)
+                gen_move(LOC_D, loc(in -> a), i);
+            break;
+        }
+    }
+}
+
+static void generate_function(node_t *n, FILE *of)
+{
+    char *name = n -> children -> next_child -> strval;
+    int epilogue;
+    int i, j;
+    
+    output = of;
+    ninsns = 0;
+    nvregs = 0;
+    nslots = 0;
+    saved_y = 0;
+    saved_u = 0;
+    stack_depth = 0;
+    
+    epilogue = new_label();
+    lower_statement(n -> children -> next_child -> next_child -> next_child, epilogue);
+    emit_label(epilogue);
+    compute_ranges();
+    allocate_registers();
+    
+    fprintf(output, "\tsection .text\n");
+    for (i = 0; i < ninsns; i++)
+    {
+        if (insns[i].op != IR_CALL)
+            continue;
+        // only import each helper once
+        for (j = 0; j < i; j++)
+        {
+            if (insns[j].op == IR_CALL && strcmp(insns[j].helper, insns[i].helper) == 0)
+                break;
+        }
+        if (j == i)
+            fprintf(output, "\timport %s\n", insns[i].helper);
+    }
+    fprintf(output, "\texport _%s\n_%s\n", name, name);
+    if (saved_y || saved_u)
+        fprintf(output, "\tpshs %s\n", saved_y ? (saved_u ? "y,u" : "y") : "u");
+    if (nslots)
+        fprintf(output, "\tleas -%d,s\n", nslots * 2);
+    generate_insns();
+    if (nslots)
+        fprintf(output, "\tleas %d,s\n", nslots * 2);
+    if (saved_y || saved_u)
+        fprintf(output, "\tpuls %s,pc\n", saved_y ? (saved_u ? "y,u" : "y") : "u");
+    else
+        fprintf(output, "\trts\n");
+}
+
+void generate_code(node_t *n, FILE *of)
+{
+    node_t *nn;
+    
+    if (n -> type == NODE_FUNDEF)
+    {
+        generate_function(n, of);
+        return;
+    }
+    for (nn = n -> children; nn; nn = nn -> next_child)
+        generate_code(nn, of);
+}
@@ -38,6 +38,7 @@ node_t *process_file(const char *);
 static void do_error(const char *f, ...);
 extern node_t *parse_program(struct preproc_info *pp);
 extern void generate_code(node_t *n, FILE *of);
+extern void optimize_tree(node_t *n);
 
 node_t *program_tree = NULL;
 
@@ -53,6 +54,7 @@ lw_stringlist_t macrolist;
 
 /* various flags */
 int trigraphs = 0;
+int target_6309 = 0;
 char *output_file = NULL;
 FILE *output_fp = NULL;
 
@@ -64,6 +66,7 @@ static struct lw_cmdline_options options[] =
 	{ "sincludedir", 'S',	"PATH",		0,							"Add entry to the system include path" },
 	{ "define", 	'D',	"SYM[=VAL]",0, 							"Automatically define SYM to be VAL (or 1)"},
 	{ "trigraphs",	0x100,	NULL,		0,							"Enable interpretation of trigraphs" },
+	{ "machine",	'm',	"CPU",		0,							"Generate code for CPU (6809 or 6309)" },
 	{ 0 }
 };
 
@@ -92,6 +95,15 @@ static int parse_opts(int key, char *arg, void *state)
 	case 'D':
 		lw_stringlist_addstring(macrolist, arg);
 		break;
+	
+	case 'm':
+		if (strcmp(arg, "6309") == 0)
+			target_6309 = 1;
+		else if (strcmp(arg, "6809") == 0)
+			target_6309 = 0;
+		else
+			do_error("Unknown CPU %s", arg);
+		break;
 		
 	case lw_cmdline_key_end:
 		break;
@@ -173,7 +185,12 @@ int main(int argc, char **argv)
 	lw_stringlist_destroy(sysincludedirs);
 	lw_stringlist_destroy(macrolist);
 	
-	node_display(program_tree, stdout);
+	// simplify the tree before it is shown or turned into code
+	optimize_tree(program_tree);
+	
+	/* the tree dump would corrupt the output if it goes to stdout */
+	if (output_fp != stdout)
+		node_display(program_tree, stdout);
 	
 	// generate output
 	generate_code(program_tree, output_fp);
@@ -191,6 +208,7 @@ node_t *process_file(const char *fn)
 	pp = preproc_init(fn);
 	if (!pp)
 		return NULL;
+	pp -> trigraphs = trigraphs;
 
 	/* set up the include paths */
 	lw_stringlist_reset(includedirs);
@@ -0,0 +1,355 @@
+/*
+lwcc/cc-optimize.c
+
+Copyright © 2026 William Astle
+
+This file is part of LWTOOLS.
+
+LWTOOLS is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+Tree level simplification, run between parsing and code generation
+
+The tree is rewritten bottom up:
+
+- operators whose operands are all constants are folded, using the same
+  16 bit signed arithmetic the generated code does
+- constants are gathered in chains of additions and subtractions, so
+  (x + 1) + 2 becomes x + 3
+- multiplications by a power of two become left shifts, and divisions by a
+  power of two become shifts with the rounding correction signed division
+  needs, when the dividend can safely be evaluated twice
+- identities like x + 0, x * 1, x | 0, and x << 0 are dropped, and x * 0
+  and x & 0 become 0 when x has no side effects
+- conditionals, && and || with a constant condition and commas with a
+  constant left side keep only what can actually be evaluated
+
+Anything that cannot be done exactly (division by zero, literals that do
+not fit in 16 bits, negative shift counts) is left for run time.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lw_alloc.h>
+#include <lw_string.h>
+
+#include "tree.h"
+
+/* fetch the value of a constant node that fits in an int; returns 0 if n
+   is not such a constant */
+static int const_value(node_t *n, long *v)
+{
+    char *ep;
+    long val;
+
+    if (!n || n -> type != NODE_CONST_INT)
+        return 0;
+    val = strtol(n -> strval, &ep, 0);
+    while (*ep == 'u' || *ep == 'U' || *ep == 'l' || *ep == 'L')
+        ep++;
+    if (*ep || val < -32768 || val > 65535)
+        return 0;
+    // bring unsigned spellings into signed range
+    if (val > 32767)
+        val -= 65536;
+    *v = val;
+    return 1;
+}
+
+/* wrap a value to a signed 16 bit int */
+static long wrap16(long v)
+{
+    v &= 0xffff;
+    if (v > 32767)
+        v -= 65536;
+    return v;
+}
+
+/* return the power of two v is, or -1 if it is not one */
+static int log2_exact(long v)
+{
+    int i;
+
+    if (v <= 0 || (v & (v - 1)))
+        return -1;
+    for (i = 0; v > 1; i++)
+        v >>= 1;
+    return i;
+}
+
+static node_t *make_const(long v)
+{
+    char buf[16];
+
+    sprintf(buf, "%ld", v);
+    return node_create(NODE_CONST_INT, buf);
+}
+
+/* nonzero if evaluating n could do anything other than produce a value */
+static int has_side_effects(node_t *n)
+{
+    node_t *nn;
+
+    switch (n -> type)
+    {
+    case NODE_OPER_FNCALL:
+    case NODE_OPER_POSTINC:
+    case NODE_OPER_POSTDEC:
+    case NODE_OPER_ASS:
+    case NODE_OPER_ADDASS:
+    case NODE_OPER_SUBASS:
+    case NODE_OPER_MULASS:
+    case NODE_OPER_DIVASS:
+    case NODE_OPER_MODASS:
+    case NODE_OPER_LSHASS:
+    case NODE_OPER_RSHASS:
+    case NODE_OPER_BWANDASS:
+    case NODE_OPER_BWXORASS:
+    case NODE_OPER_BWORASS:
+        return 1;
+    }
+    for (nn = n -> children; nn; nn = nn -> next_child)
+        if (has_side_effects(nn))
+            return 1;
+    return 0;
+}
+
+/* fold a binary operator on two constants; returns 0 if it cannot be done
+   exactly at compile time */
+static int fold_binary(int type, long a, long b, long *r)
+{
+    switch (type)
+    {
+    case NODE_OPER_PLUS:    *r = a + b; break;
+    case NODE_OPER_MINUS:   *r = a - b; break;
+    case NODE_OPER_TIMES:   *r = a * b; break;
+    case NODE_OPER_DIVIDE:
+    case NODE_OPER_MOD:
+        if (b == 0 || (a == -32768 && b == -1))
+            return 0;
+        *r = (type == NODE_OPER_DIVIDE) ? a / b : a % b;
+        break;
+    case NODE_OPER_LSH:
+    case NODE_OPER_RSH:
+        if (b < 0)
+            return 0;
+        // counts of 16 or more give what the generated code gives
+        if (b > 15)
+            *r = (type == NODE_OPER_LSH || a >= 0) ? 0 : -1;
+        else
+            *r = (type == NODE_OPER_LSH) ? a << b : a >> b;
+        break;
+    case NODE_OPER_LT:      *r = a < b; break;
+    case NODE_OPER_LE:      *r = a <= b; break;
+    case NODE_OPER_GT:      *r = a > b; break;
+    case NODE_OPER_GE:      *r = a >= b; break;
+    case NODE_OPER_EQ:      *r = a == b; break;
+    case NODE_OPER_NE:      *r = a != b; break;
+    case NODE_OPER_BWAND:   *r = a & b; break;
+    case NODE_OPER_BWXOR:   *r = a ^ b; break;
+    case NODE_OPER_BWOR:    *r = a | b; break;
+    case NODE_OPER_BAND:    *r = a && b; break;
+    case NODE_OPER_BOR:     *r = a || b; break;
+    default:
+        return 0;
+    }
+    *r = wrap16(*r);
+    return 1;
+}
+
+/*
+Rewrite x / 2^k, for x that may be evaluated twice, as
+(x + ((x >> 15) & (2^k - 1))) >> k, which rounds toward zero like the
+division does.
+*/
+static void reduce_divide(node_t *n, int k)
+{
+    node_t *x, *bias;
+
+    x = n -> children;
+    node_removechild(n, x);
+    node_removechild_destroy(n, n -> children);
+    bias = node_create(NODE_OPER_BWAND,
+        node_create(NODE_OPER_RSH, node_copy(x), make_const(15)),
+        make_const((1L << k) - 1));
+    node_addchild(n, node_create(NODE_OPER_PLUS, x, bias));
+    node_addchild(n, make_const(k));
+    n -> type = NODE_OPER_RSH;
+}
+
+static void optimize_node(node_t *n)
+{
+    node_t *nn, *l, *r;
+    long a = 0, b = 0, v;
+    int lc, rc, k;
+
+    for (nn = n -> children; nn; nn = nn -> next_child)
+        optimize_node(nn);
+
+    l = n -> children;
+    r = l ? l -> next_child : NULL;
+    lc = const_value(l, &a);
+    rc = const_value(r, &b);
+
+    switch (n -> type)
+    {
+    case NODE_OPER_COND:
+        if (lc)
+            node_collapse(n, a ? r : r -> next_child);
+        return;
+
+    case NODE_OPER_COMMA:
+        if (lc)
+            node_collapse(n, r);
+        return;
+
+    case NODE_OPER_BAND:
+    case NODE_OPER_BOR:
+        // the right side is not evaluated if the left side decides it
+        if (lc && !rc && (n -> type == NODE_OPER_BAND ? !a : a))
+            node_set_const(n, n -> type == NODE_OPER_BOR);
+        break;
+
+    case NODE_OPER_PLUS:
+    case NODE_OPER_MINUS:
+        // gather constants: (x + c1) + c2 and friends
+        if (rc && !lc && (l -> type == NODE_OPER_PLUS || l -> type == NODE_OPER_MINUS) && const_value(l -> children -> next_child, &v))
+        {
+            if (l -> type == NODE_OPER_MINUS)
+                v = -v;
+            v = wrap16(n -> type == NODE_OPER_PLUS ? v + b : v - b);
+            node_removechild_destroy(n, r);
+            node_collapse(n, l);
+            node_set_const(n -> children -> next_child, v);
+            n -> type = NODE_OPER_PLUS;
+            optimize_node(n);
+            return;
+        }
+        if (rc && !lc && b == 0)
+        {
+            node_collapse(n, l);
+            return;
+        }
+        if (lc && !rc && a == 0 && n -> type == NODE_OPER_PLUS)
+        {
+            node_collapse(n, r);
+            return;
+        }
+        break;
+
+    case NODE_OPER_TIMES:
+        // put the constant on the right
+        if (lc && !rc)
+        {
+            node_removechild(n, l);
+            node_addchild(n, l);
+            l = n -> children;
+            r = l -> next_child;
+            b = a;
+            lc = 0;
+            rc = 1;
+        }
+        if (rc && !lc)
+        {
+            if (b == 1)
+            {
+                node_collapse(n, l);
+                return;
+            }
+            if (b == 0 && !has_side_effects(l))
+            {
+                node_set_const(n, 0);
+                return;
+            }
+            k = log2_exact(b);
+            if (k > 0)
+            {
+                node_set_const(r, k);
+                n -> type = NODE_OPER_LSH;
+                return;
+            }
+        }
+        break;
+
+    case NODE_OPER_DIVIDE:
+        if (rc && !lc)
+        {
+            if (b == 1)
+            {
+                node_collapse(n, l);
+                return;
+            }
+            k = log2_exact(b);
+            if (k > 0 && k < 15 && !has_side_effects(l) && (l -> type == NODE_IDENT || l -> type == NODE_CONST_INT))
+            {
+                reduce_divide(n, k);
+                return;
+            }
+        }
+        break;
+
+    case NODE_OPER_MOD:
+        if (rc && !lc && b == 1 && !has_side_effects(l))
+        {
+            node_set_const(n, 0);
+            return;
+        }
+        break;
+
+    case NODE_OPER_LSH:
+    case NODE_OPER_RSH:
+    case NODE_OPER_BWOR:
+    case NODE_OPER_BWXOR:
+        if (rc && !lc && b == 0)
+        {
+            node_collapse(n, l);
+            return;
+        }
+        if (lc && !rc && a == 0 && n -> type != NODE_OPER_LSH && n -> type != NODE_OPER_RSH)
+        {
+            node_collapse(n, r);
+            return;
+        }
+        break;
+
+    case NODE_OPER_BWAND:
+        if ((rc && !lc && b == 0 && !has_side_effects(l)) || (lc && !rc && a == 0 && !has_side_effects(r)))
+        {
+            node_set_const(n, 0);
+            return;
+        }
+        if (rc && !lc && b == -1)
+        {
+            node_collapse(n, l);
+            return;
+        }
+        if (lc && !rc && a == -1)
+        {
+            node_collapse(n, r);
+            return;
+        }
+        break;
+    }
+
+    // everything else folds only when all operands are constants
+    if (lc && rc && !(r -> next_child) && fold_binary(n -> type, a, b, &v))
+        node_set_const(n, v);
+}
+
+void optimize_tree(node_t *n)
+{
+    optimize_node(n);
+}
@@ -160,9 +160,13 @@ int main(int argc, char **argv)
 	exit(retval);
 }
 
-static void print_line_marker(FILE *fp, int line, const char *fn, int flag)
+/* output a line marker on a line of its own; *bol is set if the output is
+   at the start of a line */
+static void print_line_marker(FILE *fp, int *bol, int line, const char *fn, int flag)
 {
-	fprintf(fp, "\n# %d \"", line);
+	if (!*bol)
+		fprintf(fp, "\n");
+	fprintf(fp, "# %d \"", line);
 	while (*fn)
 	{
 		if (*fn < 32 || *fn == 34 || *fn > 126)
@@ -175,7 +179,8 @@ static void print_line_marker(FILE *fp, int line, const char *fn, int flag)
 		}
 		fn++;
 	}
-	fprintf(fp, "\" %d", flag);
+	fprintf(fp, "\" %d\n", flag);
+	*bol = 1;
 }
 
 int process_file(const char *fn)
@@ -183,12 +188,16 @@ int process_file(const char *fn)
 	struct preproc_info *pp;
 	struct token *tok = NULL;
 	int last_line = 0;
-	char *last_fn = NULL;
+	char **fstack = NULL;
+	int fdepth = 0;
+	int bol = 1;
+	int i;
 	char *tstr;
 		
 	pp = preproc_init(fn);
 	if (!pp)
 		return -1;
+	pp -> trigraphs = trigraphs;
 
 	/* set up the include paths */
 	lw_stringlist_reset(includedirs);
@@ -210,40 +219,69 @@ int process_file(const char *fn)
 		preproc_add_macro(pp, tstr);
 	}
 
-	print_line_marker(output_fp, 1, fn, 1);
-	last_fn = lw_strdup(fn);	
+	/* fstack holds the names of the files being read, the current one
+	   last; a token from a file further down means the files above it
+	   have ended (flag 2), any other file has been entered (flag 1) */
+	fstack = lw_alloc(sizeof(char *));
+	fstack[fdepth++] = lw_strdup(fn);
+	last_line = 1;
+	print_line_marker(output_fp, &bol, last_line, fn, 1);
 	for (;;)
 	{
 		tok = preproc_next(pp);
 		if (tok -> ttype == TOK_EOF)
 			break;
-		if (strcmp(tok -> fn, last_fn) != 0)
+		if (strcmp(tok -> fn, fstack[fdepth - 1]) != 0)
 		{
-			int lt = 1;
-			if (tok -> lineno != 1)
+			for (i = fdepth - 2; i >= 0; i--)
 			{
-				lt = 2;
+				if (strcmp(tok -> fn, fstack[i]) == 0)
+					break;
 			}
-			lw_free(last_fn);
-			last_fn = lw_strdup(tok -> fn);
-			last_line = tok -> lineno;
-			print_line_marker(output_fp, last_line, last_fn, lt);
-		}
-		else
-		{
-			while (tok -> lineno > last_line)
+			if (i >= 0)
 			{
-				fprintf(output_fp, "\n");
-				last_line++;
+				while (fdepth > i + 1)
+					lw_free(fstack[--fdepth]);
+				/* the end of the #include line itself is covered by
+				   the marker */
+				last_line = tok -> lineno;
+				if (tok -> ttype == TOK_EOL)
+				{
+					last_line++;
+					print_line_marker(output_fp, &bol, last_line, tok -> fn, 2);
+					token_free(tok);
+					continue;
+				}
+				print_line_marker(output_fp, &bol, last_line, tok -> fn, 2);
+			}
+			else
+			{
+				fstack = lw_realloc(fstack, sizeof(char *) * (fdepth + 1));
+				fstack[fdepth++] = lw_strdup(tok -> fn);
+				last_line = 1;
+				print_line_marker(output_fp, &bol, last_line, tok -> fn, 1);
 			}
 		}
+		while (tok -> lineno > last_line)
+		{
+			fprintf(output_fp, "\n");
+			last_line++;
+			bol = 1;
+		}
 		token_print(tok, output_fp);
 		if (tok -> ttype == TOK_EOL)
+		{
 			last_line++;
+			bol = 1;
+		}
+		else
+			bol = 0;
 		token_free(tok);
 	}
 	token_free(tok);
-	lw_free(last_fn);
+	while (fdepth > 0)
+		lw_free(fstack[--fdepth]);
+	lw_free(fstack);
 //	symtab_dump(pp);
 	preproc_finish(pp);
 	return 0;
@@ -29,16 +29,18 @@ this program. If not, see <http://www.gnu.org/licenses/>.
 #include <lw_stringlist.h>
 #include <lw_strpool.h>
 #include "cpp.h"
+#include "symbol.h"
 
 
 struct token *preproc_lex_next_token(struct preproc_info *);
+void preproc_lex_free_source(struct preproc_info *);
 
 struct preproc_info *preproc_init(const char *fn)
 {
 	FILE *fp;
 	struct preproc_info *pp;
 	
-	if (!fn || (fn[0] == '-' && fn[1] == '0'))
+	if (!fn || (fn[0] == '-' && fn[1] == '\0'))
 	{
 		fp = stdin;
 	}
@@ -52,10 +54,14 @@ struct preproc_info *preproc_init(const char *fn)
 	pp = lw_alloc(sizeof(struct preproc_info));
 	memset(pp, 0, sizeof(struct preproc_info));
 	pp -> strpool = lw_strpool_create();
+	pp -> arena = token_arena_create();
+	token_arena_use(pp -> arena);
+	pp -> sh = symtab_create();
+	pp -> findcache = preproc_map_create();
+	pp -> guards = preproc_map_create();
 	pp -> fn = lw_strpool_strdup(pp -> strpool, fn);
+	pp -> incpath = pp -> fn;
 	pp -> fp = fp;
-	pp -> ra = CPP_NOUNG;
-	pp -> unget = CPP_NOUNG;
 	pp -> ppeolseen = 1;
 	pp -> lineno = 1;
 	pp -> n = NULL;
@@ -79,20 +85,6 @@ struct token *preproc_next_token(struct preproc_info *pp)
 	if (pp -> curtok)
 		token_free(pp -> curtok);
 
-	/*
-	If there is a list of tokens to process, move it to the "unget" queue
-	with an EOF marker at the end of it.
-	*/	
-	if (pp -> sourcelist)
-	{
-		for (t = pp -> sourcelist; t -> next; t = t -> next)
-			/* do nothing */ ;
-		t -> next = token_create(TOK_EOF, NULL, -1, -1, "");
-		t -> next -> next = pp -> tokqueue;
-		pp -> tokqueue = pp -> sourcelist;
-		pp -> sourcelist = NULL;
-	}
-again:
 	if (pp -> tokqueue)
 	{
 		t = pp -> tokqueue;
@@ -102,20 +94,10 @@ again:
 		t -> next = NULL;
 		t -> prev = NULL;
 		pp -> curtok = t;
-		goto ret;
+		return t;
 	}
 	pp -> curtok = preproc_lex_next_token(pp);
-	t = pp -> curtok;
-ret:
-	if (t -> ttype == TOK_ENDEXPAND)
-	{
-		struct expand_e *e;
-		e = pp -> expand_list;
-		pp -> expand_list = e -> next;
-		lw_free(e);
-		goto again;
-	}
-	return t;
+	return pp -> curtok;
 }
 
 void preproc_unget_token(struct preproc_info *pp, struct token *t)
@@ -129,15 +111,15 @@ void preproc_unget_token(struct preproc_info *pp, struct token *t)
 void preproc_finish(struct preproc_info *pp)
 {
 	fclose(pp -> fp);
+	preproc_lex_free_source(pp);
+	preproc_end_file(pp);
+	preproc_map_destroy(pp -> findcache);
+	preproc_map_destroy(pp -> guards);
 	lw_stringlist_destroy(pp -> inclist);
 	lw_stringlist_destroy(pp -> quotelist);
-	if (pp -> curtok)
-		token_free(pp -> curtok);
-	while (pp -> tokqueue)
-	{
-		preproc_next_token(pp);
-		token_free(pp -> curtok);
-	}
+	symtab_destroy(pp -> sh);
+	/* this releases any tokens still queued as well */
+	token_arena_destroy(pp -> arena);
 	lw_strpool_free(pp -> strpool);
 	lw_free(pp);
 }
@@ -166,12 +148,15 @@ static void preproc_throw_message(struct preproc_info *pp, void (*cb)(const char
 {
 	int s, s2;
 	char *b;
+	va_list args2;
 	
+	va_copy(args2, args);
 	s2 = snprintf(NULL, 0, "(%s:%d:%d) ", pp -> fn, pp -> lineno, pp -> column);
 	s = vsnprintf(NULL, 0, m, args);
 	b = lw_alloc(s + s2 + 1);
 	snprintf(b, s2 + 1, "(%s:%d:%d) ", pp -> fn, pp -> lineno, pp -> column);
-	vsnprintf(b + s2, s + 1, m, args);
+	vsnprintf(b + s2, s + 1, m, args2);
+	va_end(args2);
 	(*cb)(b);
 	lw_free(b);
 }
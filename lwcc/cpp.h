@@ -31,16 +31,43 @@ this program. If not, see <http://www.gnu.org/licenses/>.
 
 #define TOKBUFSIZE 32
 
-struct expand_e
+struct preproc_srcmark
 {
-	struct expand_e *next;
-	struct symtab_e *s;		// symbol table entry of the expanding symbol
+	long pos;				// position in the normalised text
+	int splice;				// nonzero for a line splice, zero for a trigraph
+};
+
+struct preproc_source
+{
+	unsigned char *buf;		// normalised contents of the file
+	long len;				// length of the normalised contents
+	long pos;				// current read position
+	struct preproc_srcmark *marks;	// splices and trigraphs, in order
+	int nmarks;				// number of marks
+	int amarks;				// number of marks allocated
+	int curmark;			// next mark to apply
+};
+
+/* simple string to string map used for include file bookkeeping */
+#define PREPROC_MAPSIZE 256
+
+struct preproc_mapent
+{
+	char *key;
+	char *value;			// may be NULL
+	struct preproc_mapent *next;
+};
+
+struct preproc_map
+{
+	struct preproc_mapent *buckets[PREPROC_MAPSIZE];
 };
 
 struct preproc_info
 {
 	const char *fn;
 	FILE *fp;
+	struct preproc_source *src;	// contents of the current file, loaded on first use
 	struct token *tokqueue;
 	struct token *curtok;
 	void (*errorcb)(const char *);
@@ -49,12 +76,9 @@ struct preproc_info
 	int lineno;				// the current input line number
 	int column;				// the current input column
 	int trigraphs;			// nonzero if we're going to handle trigraphs
-	int ra;
-	int qseen;
 	int ungetbufl;
 	int ungetbufs;
 	int *ungetbuf;
-	int unget;
 	int eolseen;
 	int nlseen;
 	int ppeolseen;			// nonzero if we've seen only whitespace (or nothing) since a newline
@@ -62,14 +86,18 @@ struct preproc_info
 	int found_level;		// nonzero if we're in a true conditional
 	int else_level;			// for counting #else directives
 	int else_skip_level;	// ditto
-	struct symtab_e *sh;	// the preprocessor's symbol table
-	struct token *sourcelist;	// for expanding a list of tokens
-	struct expand_e *expand_list;	// record of which macros are currently being expanded
+	struct symtab *sh;		// the preprocessor's symbol table
 	char *lexstr;			// for lexing a string (token pasting)
 	int lexstrloc;			// ditto
 	struct preproc_info *n;	// next in file stack
 	struct preproc_info *filestack;	// stack of saved files during include
 	struct lw_strpool *strpool;
+	struct token_arena *arena;	// tokens and token spellings for this translation unit
+	const char *incpath;	// resolved path of the current file
+	int mi_state;			// multiple include (guard) detection state
+	char *mi_macro;			// the guard macro if the file looks guarded
+	struct preproc_map *findcache;	// (directory, name) => resolved include path
+	struct preproc_map *guards;		// resolved include path => guard macro
 	lw_stringlist_t quotelist;
 	lw_stringlist_t inclist;
 };
@@ -86,5 +114,8 @@ extern void preproc_unget_token(struct preproc_info *, struct token *);
 extern void preproc_add_include(struct preproc_info *, char *, int);
 extern void preproc_add_macro(struct preproc_info *, char *);
 extern struct token *preproc_next(struct preproc_info *);
+extern struct preproc_map *preproc_map_create(void);
+extern void preproc_map_destroy(struct preproc_map *);
+extern void preproc_end_file(struct preproc_info *);
 
 #endif // cpp_h_seen___
@@ -0,0 +1,535 @@
+/*
+lwcc/driver-cache.c
+
+Copyright © 2026 William Astle
+
+This file is part of LWTOOLS.
+
+LWTOOLS is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+A content addressed cache of object files for the compiler driver
+
+The key for an object is a 128 bit FNV-1a hash of the preprocessed source,
+the command lines of the programs that turn it into an object (which name
+the programs and carry all the flags), the size and modification time of
+those programs, and the lwtools version. An object is stored as
+<dir>/<first two digits of key>/<rest of key>.o. It is written under a
+temporary name and renamed into place so nobody ever sees a partial one.
+
+<dir>/stats holds the statistics and the total size of the cache. It is
+only changed while holding a lock on it, so any number of compilers can
+share a cache. When the total size goes over the limit, the least recently
+used objects (by modification time, which every hit updates) are removed
+until the cache is back under 90% of the limit.
+*/
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include <lw_alloc.h>
+#include <lw_string.h>
+#include <lw_stringlist.h>
+
+#include <version.h>
+
+extern void do_error(const char *f, ...);
+extern void do_warning(const char *f, ...);
+
+extern const char *cache_dir;
+extern long long cache_max_size;
+extern int cache_verify;
+
+enum
+{
+	STAT_HITS,
+	STAT_MISSES,
+	STAT_VERIFIED,
+	STAT_MISMATCHES,
+	STAT_STORES,
+	STAT_EVICTIONS,
+	STAT_SIZE,
+	STAT_MAX
+};
+
+static const char *stat_names[STAT_MAX] =
+{
+	"hits", "misses", "verified", "mismatches", "stores", "evictions", "size"
+};
+
+// changes made by this process that are not in the stats file yet
+static long long stat_delta[STAT_MAX];
+
+struct hash128
+{
+	unsigned long long hi;
+	unsigned long long lo;
+};
+
+static void hash_bytes(struct hash128 *h, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+	unsigned long long p0, p1, lo;
+
+	while (len-- > 0)
+	{
+		h -> lo ^= *p++;
+		/* multiply by the FNV prime, 2^88 + 0x13b */
+		p0 = (h -> lo & 0xffffffffULL) * 0x13b;
+		p1 = (h -> lo >> 32) * 0x13b;
+		lo = p0 + (p1 << 32);
+		h -> hi = h -> hi * 0x13b + (p1 >> 32) + (lo < p0) + (h -> lo << 24);
+		h -> lo = lo;
+	}
+}
+
+static void hash_str(struct hash128 *h, const char *s)
+{
+	hash_bytes(h, s, strlen(s) + 1);
+}
+
+static void hash_num(struct hash128 *h, long long v)
+{
+	char buf[32];
+
+	snprintf(buf, sizeof(buf), "%lld", v);
+	hash_str(h, buf);
+}
+
+static char *cache_path(const char *key, const char *suffix)
+{
+	char *path;
+	size_t len;
+
+	len = strlen(cache_dir) + strlen(key) + strlen(suffix) + 3;
+	path = lw_alloc(len);
+	snprintf(path, len, "%s/%.2s/%s%s", cache_dir, key, key + 2, suffix);
+	return path;
+}
+
+static char *stats_path(void)
+{
+	char *path;
+
+	path = lw_alloc(strlen(cache_dir) + 7);
+	strcpy(path, cache_dir);
+	strcat(path, "/stats");
+	return path;
+}
+
+/*
+Work out the cache key for making an object from "input" with the commands
+in cmds (argv lists with placeholders instead of file names). Returns a
+string allocated by lw_alloc, or NULL if the input cannot be read.
+*/
+char *cache_key(const char *input, lw_stringlist_t *cmds, int ncmds)
+{
+	struct hash128 h = { 0x6c62272e07bb0142ULL, 0x62b821756295c58dULL };
+	char buf[8192];
+	struct stat sb;
+	FILE *fp;
+	size_t n;
+	char *s;
+	int i;
+
+	hash_str(&h, "lwcc object cache 1");
+	hash_str(&h, PACKAGE_STRING);
+	for (i = 0; i < ncmds; i++)
+	{
+		lw_stringlist_reset(cmds[i]);
+		s = lw_stringlist_current(cmds[i]);
+		/* a rebuilt program counts as a different version */
+		if (s && stat(s, &sb) == 0)
+		{
+			hash_num(&h, sb.st_size);
+			hash_num(&h, sb.st_mtime);
+		}
+		for (; s; s = lw_stringlist_next(cmds[i]))
+			hash_str(&h, s);
+		hash_str(&h, "|");
+	}
+
+	fp = fopen(input, "rb");
+	if (!fp)
+		return NULL;
+	while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+		hash_bytes(&h, buf, n);
+	if (ferror(fp))
+	{
+		fclose(fp);
+		return NULL;
+	}
+	fclose(fp);
+
+	s = lw_alloc(33);
+	snprintf(s, 33, "%016llx%016llx", h.hi, h.lo);
+	return s;
+}
+
+/* copy file "from" to file "to"; returns nonzero on failure */
+static int copy_file(const char *from, const char *to)
+{
+	char buf[8192];
+	FILE *in, *out;
+	size_t n;
+	int rv = 0;
+
+	in = fopen(from, "rb");
+	if (!in)
+		return -1;
+	out = fopen(to, "wb");
+	if (!out)
+	{
+		fclose(in);
+		return -1;
+	}
+	while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+	{
+		if (fwrite(buf, 1, n, out) != n)
+		{
+			rv = -1;
+			break;
+		}
+	}
+	if (ferror(in))
+		rv = -1;
+	fclose(in);
+	if (fclose(out) != 0)
+		rv = -1;
+	return rv;
+}
+
+/* returns nonzero if files a and b have different contents */
+static int compare_files(const char *a, const char *b)
+{
+	char bufa[4096], bufb[4096];
+	FILE *fa, *fb;
+	size_t na, nb;
+	int rv = 1;
+
+	fa = fopen(a, "rb");
+	fb = fopen(b, "rb");
+	if (fa && fb)
+	{
+		for (;;)
+		{
+			na = fread(bufa, 1, sizeof(bufa), fa);
+			nb = fread(bufb, 1, sizeof(bufb), fb);
+			if (na != nb || memcmp(bufa, bufb, na) != 0)
+				break;
+			if (na == 0)
+			{
+				rv = 0;
+				break;
+			}
+		}
+	}
+	if (fa)
+		fclose(fa);
+	if (fb)
+		fclose(fb);
+	return rv;
+}
+
+/*
+Copy the object for key to "out". Returns zero if it was there, nonzero if
+the object has to be built. In verify mode, objects are always built so
+cache_store() can check them against the cached copy.
+*/
+int cache_fetch(const char *key, const char *out)
+{
+	char *path;
+
+	if (cache_verify)
+		return 1;
+	path = cache_path(key, ".o");
+	if (copy_file(path, out) != 0)
+	{
+		lw_free(path);
+		stat_delta[STAT_MISSES]++;
+		return 1;
+	}
+	/* mark it recently used */
+	utime(path, NULL);
+	lw_free(path);
+	stat_delta[STAT_HITS]++;
+	return 0;
+}
+
+/* add the freshly built object "obj" to the cache under key */
+void cache_store(const char *key, const char *obj)
+{
+	struct stat sb;
+	long long oldsize = 0;
+	char *path, *tpath, *sfx;
+
+	path = cache_path(key, ".o");
+	if (stat(path, &sb) == 0)
+	{
+		oldsize = sb.st_size;
+		if (compare_files(path, obj) == 0)
+		{
+			/* already there (verify mode or another compiler beat us) */
+			if (cache_verify)
+				stat_delta[STAT_VERIFIED]++;
+			utime(path, NULL);
+			lw_free(path);
+			return;
+		}
+		if (cache_verify)
+		{
+			do_warning("cached object %s does not match a fresh compile; replacing it", path);
+			stat_delta[STAT_MISMATCHES]++;
+		}
+	}
+	else if (cache_verify)
+	{
+		stat_delta[STAT_MISSES]++;
+	}
+
+	/* make the directories as needed */
+	mkdir(cache_dir, 0777);
+	tpath = cache_path(key, "");
+	tpath[strlen(cache_dir) + 3] = '\0';
+	mkdir(tpath, 0777);
+	lw_free(tpath);
+
+	sfx = lw_alloc(32);
+	snprintf(sfx, 32, ".tmp%ld", (long)getpid());
+	tpath = cache_path(key, sfx);
+	lw_free(sfx);
+	if (copy_file(obj, tpath) != 0 || stat(tpath, &sb) != 0 || rename(tpath, path) != 0)
+	{
+		do_warning("Failed to add %s to the cache: %s", obj, strerror(errno));
+		unlink(tpath);
+	}
+	else
+	{
+		stat_delta[STAT_STORES]++;
+		stat_delta[STAT_SIZE] += sb.st_size - oldsize;
+	}
+	lw_free(tpath);
+	lw_free(path);
+}
+
+struct cache_entry
+{
+	char *path;
+	time_t mtime;
+	long long size;
+};
+
+static int compare_entries(const void *a, const void *b)
+{
+	const struct cache_entry *ea = a, *eb = b;
+
+	if (ea -> mtime < eb -> mtime)
+		return -1;
+	if (ea -> mtime > eb -> mtime)
+		return 1;
+	return strcmp(ea -> path, eb -> path);
+}
+
+/*
+Remove the least recently used objects until the cache is under 90% of its
+limit. The size is worked out from the objects themselves, which also
+repairs the recorded size if it drifted. Returns the new size.
+*/
+static long long cache_evict(long long *evictions)
+{
+	struct cache_entry *ents = NULL;
+	int nents = 0, aents = 0, i;
+	long long total = 0;
+	DIR *d, *sd;
+	struct dirent *de, *sde;
+	struct stat sb;
+	char *sub, *path;
+	size_t len;
+
+	d = opendir(cache_dir);
+	if (!d)
+		return 0;
+	while ((de = readdir(d)))
+	{
+		if (strlen(de -> d_name) != 2 || de -> d_name[0] == '.')
+			continue;
+		len = strlen(cache_dir) + 4;
+		sub = lw_alloc(len);
+		snprintf(sub, len, "%s/%s", cache_dir, de -> d_name);
+		sd = opendir(sub);
+		if (!sd)
+		{
+			lw_free(sub);
+			continue;
+		}
+		while ((sde = readdir(sd)))
+		{
+			len = strlen(sde -> d_name);
+			if (len < 3 || strcmp(sde -> d_name + len - 2, ".o") != 0)
+				continue;
+			len += strlen(sub) + 2;
+			path = lw_alloc(len);
+			snprintf(path, len, "%s/%s", sub, sde -> d_name);
+			if (stat(path, &sb) != 0)
+			{
+				lw_free(path);
+				continue;
+			}
+			if (nents == aents)
+			{
+				aents += 256;
+				ents = lw_realloc(ents, sizeof(struct cache_entry) * aents);
+			}
+			ents[nents].path = path;
+			ents[nents].mtime = sb.st_mtime;
+			ents[nents].size = sb.st_size;
+			nents++;
+			total += sb.st_size;
+		}
+		closedir(sd);
+		lw_free(sub);
+	}
+	closedir(d);
+
+	qsort(ents, nents, sizeof(struct cache_entry), compare_entries);
+	for (i = 0; i < nents; i++)
+	{
+		if (total > cache_max_size / 10 * 9 && unlink(ents[i].path) == 0)
+		{
+			total -= ents[i].size;
+			(*evictions)++;
+		}
+		lw_free(ents[i].path);
+	}
+	lw_free(ents);
+	return total;
+}
+
+static void read_stats(FILE *fp, long long *stats)
+{
+	char name[64];
+	long long v;
+	int i;
+
+	for (i = 0; i < STAT_MAX; i++)
+		stats[i] = 0;
+	while (fscanf(fp, "%63s %lld", name, &v) == 2)
+	{
+		for (i = 0; i < STAT_MAX; i++)
+		{
+			if (strcmp(name, stat_names[i]) == 0)
+				stats[i] = v;
+		}
+	}
+}
+
+/*
+Add this process's statistics to the stats file, and trim the cache if it
+has grown past its limit.
+*/
+void cache_flush(void)
+{
+	long long stats[STAT_MAX];
+	struct flock fl;
+	char *path;
+	FILE *fp;
+	int fd, i;
+
+	for (i = 0; i < STAT_MAX; i++)
+		if (stat_delta[i])
+			break;
+	if (i == STAT_MAX)
+		return;
+
+	mkdir(cache_dir, 0777);
+	path = stats_path();
+	fd = open(path, O_RDWR | O_CREAT, 0666);
+	if (fd == -1 || !(fp = fdopen(fd, "r+")))
+	{
+		do_warning("Cannot update cache statistics in %s: %s", path, strerror(errno));
+		if (fd != -1)
+			close(fd);
+		lw_free(path);
+		return;
+	}
+	lw_free(path);
+
+	memset(&fl, 0, sizeof(fl));
+	fl.l_type = F_WRLCK;
+	fl.l_whence = SEEK_SET;
+	while (fcntl(fd, F_SETLKW, &fl) == -1 && errno == EINTR)
+		/* do nothing */ ;
+
+	read_stats(fp, stats);
+	for (i = 0; i < STAT_MAX; i++)
+	{
+		stats[i] += stat_delta[i];
+		stat_delta[i] = 0;
+	}
+	if (stats[STAT_SIZE] > cache_max_size || stats[STAT_SIZE] < 0)
+		stats[STAT_SIZE] = cache_evict(&stats[STAT_EVICTIONS]);
+
+	rewind(fp);
+	if (ftruncate(fd, 0) == 0)
+	{
+		for (i = 0; i < STAT_MAX; i++)
+			fprintf(fp, "%s %lld\n", stat_names[i], stats[i]);
+	}
+	/* closing releases the lock */
+	fclose(fp);
+}
+
+/* print the cache statistics to f */
+void cache_report(FILE *f)
+{
+	long long stats[STAT_MAX];
+	long long lookups;
+	char *path;
+	FILE *fp;
+	int i;
+
+	path = stats_path();
+	fp = fopen(path, "r");
+	lw_free(path);
+	if (fp)
+	{
+		read_stats(fp, stats);
+		fclose(fp);
+	}
+	else
+	{
+		for (i = 0; i < STAT_MAX; i++)
+			stats[i] = 0;
+	}
+
+	lookups = stats[STAT_HITS] + stats[STAT_MISSES];
+	fprintf(f, "cache directory     %s\n", cache_dir);
+	fprintf(f, "hits                %lld\n", stats[STAT_HITS]);
+	fprintf(f, "misses              %lld\n", stats[STAT_MISSES]);
+	if (lookups)
+		fprintf(f, "hit rate            %.1f%%\n", 100.0 * stats[STAT_HITS] / lookups);
+	fprintf(f, "verified            %lld\n", stats[STAT_VERIFIED]);
+	fprintf(f, "verify mismatches   %lld\n", stats[STAT_MISMATCHES]);
+	fprintf(f, "objects stored      %lld\n", stats[STAT_STORES]);
+	fprintf(f, "objects evicted     %lld\n", stats[STAT_EVICTIONS]);
+	fprintf(f, "cache size          %lld bytes (limit %lld)\n", stats[STAT_SIZE], cache_max_size);
+}
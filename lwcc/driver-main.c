@@ -59,10 +59,16 @@ const char *preprocessor_program_name = "lwcc-cpp";
 /* this will be set to the directory where temporary files get created */
 const char *temp_directory = NULL;
 
+/* the most programs that run at once in a pipeline */
+#define MAX_PIPELINE 3
+
 /* these are for book keeping if we get interrupted - the volatile and atomic
    types are needed because they are accessed in a signal handler */
 static volatile sig_atomic_t sigterm_received = 0;
-static volatile sig_atomic_t child_pid = 0;
+static volatile sig_atomic_t child_pids[MAX_PIPELINE];
+static volatile sig_atomic_t nchildren = 0;
+static volatile sig_atomic_t *job_pids = NULL;
+static volatile sig_atomic_t njob_pids = 0;
 
 /* path specified with --sysroot */
 const char *sysroot = "";
@@ -80,6 +86,11 @@ int verbose_mode = 0;			// set to number of --verbose arguments
 int save_temps = 0;				// set if -save-temps is specified
 int debug_mode = 0;				// set if -g specified
 int pic_mode = 0;				// set to 1 if -fpic, 2 if -fPIC; last one specified wins
+int max_jobs = 1;				// set to the value of the -j option (parallel jobs)
+const char *cache_dir = NULL;	// object cache directory (--cache-dir or LWCC_CACHE_DIR)
+long long cache_max_size = 1024LL * 1024 * 1024;	// object cache size limit (--cache-size)
+int cache_verify = 0;			// set if --cache-verify is specified
+int cache_show_stats = 0;		// set if --cache-stats is specified
 const char *output_file;		// set to the value of the -o option (output file)
 
 /* compiler base directory  - from -B */
@@ -88,6 +99,11 @@ const char *basedir = BASEDIR;
 /* used to ensure a unique temporary file at every stage */
 static int file_counter = 0;
 
+/* with -j, the number of the job this process is running (from 1) and
+   where it reports the files it made back to the parent; see run_jobs() */
+static int job_number = 0;
+static FILE *job_results = NULL;
+
 /* these are various string lists used to keep track of things, mostly
    command line arguments. */
 
@@ -109,14 +125,31 @@ lw_stringlist_t priv_sysincdirs;	// system include directories for lwcc itself
 /* forward delcarations */
 static void parse_command_line(int, char **);
 
+/* object cache; see driver-cache.c */
+extern char *cache_key(const char *, lw_stringlist_t *, int);
+extern int cache_fetch(const char *, const char *);
+extern void cache_store(const char *, const char *);
+extern void cache_flush(void);
+extern void cache_report(FILE *);
+
 /* signal handler for SIGTERM - all it does is record the fact that
    SIGTERM happened and propagate the signal to whatever child process
    might currently be running */
 static void exit_on_signal(int sig)
 {
+	int i;
+	
 	sigterm_received = 1;
-	if (child_pid)
-		kill(child_pid, SIGTERM);
+	for (i = 0; i < nchildren; i++)
+	{
+		if (child_pids[i] > 0)
+			kill(child_pids[i], SIGTERM);
+	}
+	for (i = 0; i < njob_pids; i++)
+	{
+		if (job_pids[i] > 0)
+			kill(job_pids[i], SIGTERM);
+	}
 }
 
 /* utility function to carp about an error condition and bail */
@@ -220,7 +253,7 @@ static char *find_file(const char *fn, lw_stringlist_t p, int mode)
 	{
 		lp = strlen(s);
 		need_slash = 0;
-		if (lp && s[lp - 1] == '/')
+		if (lp && s[lp - 1] != '/')
 			need_slash = 1;
 		f = lw_alloc(lp + lf + need_slash + 1);
 		memcpy(f, s, lp);
@@ -236,35 +269,56 @@ static char *find_file(const char *fn, lw_stringlist_t p, int mode)
 	return lw_strdup(fn);
 }
 
-/* take a string list which contains an argv and execute the specified
-   program */
-static int execute_program(lw_stringlist_t args)
+/* turn a string list into an argv array; the strings are not copied */
+static char **make_argv(lw_stringlist_t args)
 {
 	int argc;
 	char **argv;
-	int result;
 	char *s;
 	
 	argc = lw_stringlist_nstrings(args);
 	argv = lw_alloc(sizeof(char *) * (argc + 1));
 	lw_stringlist_reset(args);
-	for (result = 0, s = lw_stringlist_current(args); s; s = lw_stringlist_next(args))
+	for (argc = 0, s = lw_stringlist_current(args); s; s = lw_stringlist_next(args))
 	{
-		argv[result++] = s;
+		argv[argc++] = s;
 	}
-	argv[result] = NULL;
+	argv[argc] = NULL;
+	return argv;
+}
+
+/* take an array of string lists, each of which contains an argv, and run
+   them as a pipeline: each program reads the standard output of the one
+   before it. A single list simply executes the specified program. */
+static int execute_pipeline(lw_stringlist_t *stages, int nstages)
+{
+	char **argv[MAX_PIPELINE];
+	int status[MAX_PIPELINE];
+	int pfd[2];
+	int infd = -1;
+	int i, failed;
+	pid_t pid;
+	
+	for (i = 0; i < nstages; i++)
+		argv[i] = make_argv(stages[i]);
 
 	if (verbose_mode)
 	{
 		printf("Executing ");
-		print_array(argv);
+		for (i = 0; i < nstages; i++)
+		{
+			if (i)
+				printf(" | ");
+			print_array(argv[i]);
+		}
 		printf("\n");
 	}
 	
 	/* bail now if a signal happened */
 	if (sigterm_received)
 	{
-		lw_free(argv);
+		for (i = 0; i < nstages; i++)
+			lw_free(argv[i]);
 		return 1;
 	}
 
@@ -272,40 +326,131 @@ static int execute_program(lw_stringlist_t args)
 	   child process doesn't get intermingled */
 	fflush(NULL);
 	
-	/* now make the child process */
-	child_pid = fork();
-	if (child_pid == 0)
+	/* now make the child processes, connecting each one's standard output
+	   to the next one's standard input */
+	nchildren = 0;
+	for (i = 0; i < nstages; i++)
 	{
-		/* child process */
-		/* try executing program */
-		execvp(argv[0], argv);
-		/* only way to get here is if execvp() failed so carp about it and exit */
-		fprintf(stderr, "Exec of %s failed: %s", argv[0], strerror(errno));
-		/* exit with failure but don't call any atexit(), etc., functions */
-		_exit(127);
+		if (i < nstages - 1 && pipe(pfd) == -1)
+			do_error("Failed to create pipe: %s", strerror(errno));
+		pid = fork();
+		if (pid == 0)
+		{
+			/* child process */
+			if (infd != -1)
+			{
+				dup2(infd, 0);
+				close(infd);
+			}
+			if (i < nstages - 1)
+			{
+				dup2(pfd[1], 1);
+				close(pfd[0]);
+				close(pfd[1]);
+			}
+			/* try executing program */
+			execvp(argv[i][0], argv[i]);
+			/* only way to get here is if execvp() failed so carp about it and exit */
+			fprintf(stderr, "Exec of %s failed: %s", argv[i][0], strerror(errno));
+			/* exit with failure but don't call any atexit(), etc., functions */
+			_exit(127);
+		}
+		else if (pid == -1)
+		{
+			/* failure to make child process */
+			do_error("Failed to execute program %s: %s", argv[i][0], strerror(errno));
+		}
+		child_pids[i] = pid;
+		nchildren = i + 1;
+		/* the parent keeps only the read end of the new pipe */
+		if (infd != -1)
+			close(infd);
+		if (i < nstages - 1)
+		{
+			close(pfd[1]);
+			infd = pfd[0];
+		}
 	}
-	else if (child_pid == -1)
+	
+	/* parent process - wait for children to exit */
+	for (i = 0; i < nstages; i++)
 	{
-		/* failure to make child process */
-		do_error("Failed to execute program %s: %s", argv[0], strerror(errno));
+		while (waitpid(child_pids[i], &(status[i]), 0) == -1 && errno == EINTR)
+			/* do nothing */;
 	}
-	/* clean up argv */
-	lw_free(argv);
-	
-	/* parent process - wait for child to exit */
-	while (waitpid(child_pid, &result, 0) == -1 && errno == EINTR)
-		/* do nothing */;
-	/* fetch actual return status */
-	result = WEXITSTATUS(result);
-	if (result)
+	nchildren = 0;
+	
+	/* carp about the first program that failed; one that died writing to a
+	   pipe only failed because something after it did */
+	failed = -1;
+	for (i = 0; i < nstages; i++)
+	{
+		if (WIFSIGNALED(status[i]))
+		{
+			if (WTERMSIG(status[i]) == SIGPIPE && failed == -1)
+				failed = i;
+			if (WTERMSIG(status[i]) != SIGPIPE)
+				break;
+		}
+		else if (WEXITSTATUS(status[i]))
+			break;
+	}
+	if (i < nstages)
+		failed = i;
+	if (failed != -1 && !sigterm_received)
 	{
-		/* carp about non-zero return status */
-		do_error("%s terminated with status %d", argv[0], result);
+		if (WIFSIGNALED(status[failed]))
+			do_error("%s terminated by signal %d", argv[failed][0], WTERMSIG(status[failed]));
+		do_error("%s terminated with status %d", argv[failed][0], WEXITSTATUS(status[failed]));
 	}
+	/* clean up argv */
+	for (i = 0; i < nstages; i++)
+		lw_free(argv[i]);
+	
 	/* return nonzero if signalled to exit */
 	return sigterm_received;
 }
 
+/* take a string list which contains an argv and execute the specified
+   program */
+static int execute_program(lw_stringlist_t args)
+{
+	return execute_pipeline(&args, 1);
+}
+
+/* make a temporary directory to hold temporary files and record its name
+   in temp_directory for later cleanup */
+static void make_temp_directory(void)
+{
+	const char *dirtempl;
+	char *path;
+	size_t dirtempl_len;
+	int need_slash;
+	
+	/* look for a TMPFIR environment variable and use that if present
+	   but use /tmp as a fallback */
+	dirtempl = getenv("TMPDIR");
+	if (dirtempl == NULL)
+		dirtempl = "/tmp";
+	dirtempl_len = strlen(dirtempl);
+	/* work out if we need to add a slash on the end of the directory */
+	if (dirtempl_len && dirtempl[dirtempl_len - 1] == '/')
+		need_slash = 0;
+	else
+		need_slash = 1;
+	/* make a string of the form <tempdir>/lwcc-XXXXXX */
+	path = lw_alloc(dirtempl_len + need_slash + 11 + 1);
+	memcpy(path, dirtempl, dirtempl_len);
+	if (need_slash)
+		path[dirtempl_len] = '/';
+	memcpy(path + dirtempl_len + need_slash, "lwcc-XXXXXX", 12);
+	/* now make a temporary directory */
+	if (mkdtemp(path) == NULL)
+		do_error("mkdtemp failed: %s", strerror(errno));
+	/* record the temporary directory name */
+	temp_directory = path;
+}
+
 /*
 construct an output file name as follows:
 
@@ -357,62 +502,43 @@ static char *output_name(const char *f, const char *nsuffix, int last)
 
 	/* finally, use a temporary file */
 	if (temp_directory == NULL)
-	{
-		/* if we haven't already made a temporary directory, do so */
-		const char *dirtempl;
-		char *path;
-		size_t dirtempl_len;
-		int need_slash;
-		
-		/* look for a TMPFIR environment variable and use that if present
-		   but use /tmp as a fallback */
-		dirtempl = getenv("TMPDIR");
-		if (dirtempl == NULL)
-			dirtempl = "/tmp";
-		dirtempl_len = strlen(dirtempl);
-		/* work out if we need to add a slash on the end of the directory */
-		if (dirtempl_len && dirtempl[dirtempl_len - 1] == '/')
-			need_slash = 0;
-		else
-			need_slash = 1;
-		/* make a string of the form <tempdir>/lwcc-XXXXXX */
-		path = lw_alloc(dirtempl_len + need_slash + 11 + 1);
-		memcpy(path, dirtempl, dirtempl_len);
-		if (need_slash)
-			path[dirtempl_len] = '/';
-		memcpy(path + dirtempl_len + need_slash, "lwcc-XXXXXX", 12);
-		/* now make a temporary directory */
-		if (mkdtemp(path) == NULL)
-			do_error("mkdtemp failed: %s", strerror(errno));
-		/* record the temporary directory name */
-		temp_directory = path;
-	}
+		make_temp_directory();
+
 	/* now create a file name in the temporary directory. The strategy here
 	   uses a counter that is passed along and is guaranteed to be unique for
 	   every file requested. */
 	lf = strlen(temp_directory);
 	/* this gets the length of the counter as a string but doesn't actually
-	   allocate anything so we can make a string long enough */
-	counter_len = snprintf(NULL, 0, "%d", file_counter);
+	   allocate anything so we can make a string long enough; parallel jobs
+	   share the directory so the job number is part of the name too */
+	if (job_number)
+		counter_len = snprintf(NULL, 0, "%d-%d", job_number, file_counter);
+	else
+		counter_len = snprintf(NULL, 0, "%d", file_counter);
 	if (counter_len < 1)
 		do_error("snprintf failure: %s", strerror(errno));
 	len = lf + 1 + (size_t)counter_len + ls + 1;
 	name = lw_alloc(len);
 	/* it should be impossible for ths snprintf call to fail */
-	snprintf(name, len, "%s/%d%s", temp_directory, file_counter, nsuffix);
+	if (job_number)
+		snprintf(name, len, "%s/%d-%d%s", temp_directory, job_number, file_counter, nsuffix);
+	else
+		snprintf(name, len, "%s/%d%s", temp_directory, file_counter, nsuffix);
 	
-	/* record the temporary file name for later */
+	/* record the temporary file name for later; a job's parent does the
+	   cleaning up */
 	lw_stringlist_addstring(tempfiles, name);
+	if (job_results)
+		fprintf(job_results, "T%s\n", name);
 	return name;
 }
 
-/* this calls the actual compiler, passing the contents of compiler_args
-   as arguments. It also adds the input file and output file. */
-static int compile_file(const char *file, char *input, char **output, const char *suffix)
+/* build the command line for the compiler, passing the contents of
+   compiler_args as arguments. It also adds the input file and output
+   file; "-" means the standard input or output. */
+static lw_stringlist_t compiler_command(const char *input, const char *out)
 {
 	lw_stringlist_t args;
-	char *out;
-	int retval;
 	char *s;
 	
 	args = lw_stringlist_create();
@@ -428,12 +554,25 @@ static int compile_file(const char *file, char *input, char **output, const char
 	{
 		lw_stringlist_addstring(args, s);
 	}
-	/* work out the output file name and add that to argv */
-	out = output_name(file, suffix, stop_after == PHASE_COMPILE);
+	/* add the output file to argv */
 	lw_stringlist_addstring(args, "-o");
-	lw_stringlist_addstring(args, out);
-	/* add the input file to argv */
-	lw_stringlist_addstring(args, input);
+	lw_stringlist_addstring(args, (char *)out);
+	/* add the input file to argv; the compiler reads stdin if there is none */
+	if (strcmp(input, "-") != 0)
+		lw_stringlist_addstring(args, (char *)input);
+	return args;
+}
+
+/* this calls the actual compiler on input. */
+static int compile_file(const char *file, char *input, char **output, const char *suffix)
+{
+	lw_stringlist_t args;
+	char *out;
+	int retval;
+	
+	/* work out the output file name */
+	out = output_name(file, suffix, stop_after == PHASE_COMPILE);
+	args = compiler_command(input, out);
 	/* if the input file name and the output file name pointers are the same
 	   free the input one */
 	if (*output == input) 
@@ -447,13 +586,11 @@ static int compile_file(const char *file, char *input, char **output, const char
 	return retval;
 }
 
-/* this calls the actual assembler, passing the contents of asm_args
-   as arguments. It also adds the input file and output file. */
-static int assemble_file(const char *file, char *input, char **output, const char *suffix)
+/* build the command line for the assembler, passing the contents of
+   asm_args as arguments. It also adds the input file and output file. */
+static lw_stringlist_t assembler_command(const char *input, const char *out)
 {
 	lw_stringlist_t args;
-	char *out;
-	int retval;
 	char *s;
 	
 	args = lw_stringlist_create();
@@ -472,12 +609,24 @@ static int assemble_file(const char *file, char *input, char **output, const cha
 	{
 		lw_stringlist_addstring(args, s);
 	}
-	/* get an output file name and add that to argv */
-	out = output_name(file, ".o", stop_after == PHASE_ASSEMBLE);
+	/* add the output file to argv */
 	lw_stringlist_addstring(args, "-o");
-	lw_stringlist_addstring(args, out);
+	lw_stringlist_addstring(args, (char *)out);
 	/* finally, add the input file */
-	lw_stringlist_addstring(args, input);
+	lw_stringlist_addstring(args, (char *)input);
+	return args;
+}
+
+/* this calls the actual assembler on input. */
+static int assemble_file(const char *file, char *input, char **output, const char *suffix)
+{
+	lw_stringlist_t args;
+	char *out;
+	int retval;
+	
+	/* get an output file name */
+	out = output_name(file, ".o", stop_after == PHASE_ASSEMBLE);
+	args = assembler_command(input, out);
 	/* clean up input file name if same as output pointer */
 	if (*output == input)
 		lw_free(input);
@@ -490,18 +639,16 @@ static int assemble_file(const char *file, char *input, char **output, const cha
 	return retval;
 }
 
-/* run the preprocessor. Pass along preproc_args and appropriate options
-   for all the include directories */
-static int preprocess_file(const char *file, char *input, char **output, const char *suffix)
+/* build the command line for the preprocessor. Pass along preproc_args and
+   appropriate options for all the include directories */
+static lw_stringlist_t preprocessor_command(const char *input, const char *out)
 {
 	lw_stringlist_t args;
 	char *s;
-	char *out;
-	int retval;
 	
 	args = lw_stringlist_create();
 
-	/* find the linker binary and make that argv[0] */	
+	/* find the preprocessor binary and make that argv[0] */	
 	s = find_file(preprocessor_program_name, program_dirs, X_OK);
 	lw_stringlist_addstring(args, s);
 	lw_free(s);
@@ -554,6 +701,24 @@ static int preprocess_file(const char *file, char *input, char **output, const c
 		}
 	}
 	
+	/* if not stdout, add the output file to argv */
+	if (strcmp(out, "-") != 0)
+	{
+		lw_stringlist_addstring(args, "-o");
+		lw_stringlist_addstring(args, (char *)out);
+	}
+	/* add the input file name to argv */
+	lw_stringlist_addstring(args, (char *)input);
+	return args;
+}
+
+/* run the preprocessor on input */
+static int preprocess_file(const char *file, char *input, char **output, const char *suffix)
+{
+	lw_stringlist_t args;
+	char *out;
+	int retval;
+	
 	/* if we stop after preprocessing, output to stdout if no output file */
 	if (stop_after == PHASE_PREPROCESS && output_file == NULL)
 	{
@@ -564,14 +729,7 @@ static int preprocess_file(const char *file, char *input, char **output, const c
 		/* otherwise, make an output file */
 		out = output_name(file, suffix, stop_after == PHASE_PREPROCESS);
 	}
-	/* if not stdout, add the output file to argv */
-	if (strcmp(out, "-") != 0)
-	{
-		lw_stringlist_addstring(args, "-o");
-		lw_stringlist_addstring(args, out);
-	}
-	/* add the input file name to argv */
-	lw_stringlist_addstring(args, input);
+	args = preprocessor_command(input, out);
 
 	/* if input and output pointers are same, clean up input */	
 	if (*output == input)
@@ -585,6 +743,147 @@ static int preprocess_file(const char *file, char *input, char **output, const c
 	return retval;
 }
 
+/*
+Run every stage an input file needs as a single pipeline, each stage
+reading the previous one's output through a pipe, so the intermediate .i
+and .s files are never written. This is only used without -save-temps. If
+the file needs fewer than two stages, nothing is done and -1 is returned so
+the caller runs the stage the usual way. Otherwise, *input is replaced with
+the name of the final output and *suffix with its suffix.
+*/
+static int pipeline_file(const char *file, char **input, const char **suffix)
+{
+	lw_stringlist_t stages[MAX_PIPELINE];
+	int nstages = 0;
+	int preprocess, compile, assemble;
+	const char *in;
+	char *out;
+	int retval, i;
+	
+	/* work out which stages the file goes through */
+	preprocess = strcmp(*suffix, ".c") == 0 || strcmp(*suffix, ".S") == 0;
+	compile = (strcmp(*suffix, ".c") == 0 || strcmp(*suffix, ".i") == 0) && stop_after >= PHASE_COMPILE;
+	assemble = (preprocess || strcmp(*suffix, ".i") == 0 || strcmp(*suffix, ".s") == 0) && stop_after >= PHASE_ASSEMBLE;
+	if (preprocess && stop_after == PHASE_PREPROCESS)
+		return -1;
+	if (strcmp(*suffix, ".S") == 0 && !assemble)
+		return -1;
+	if (preprocess + compile + assemble < 2)
+		return -1;
+
+	/* only the last stage writes a file */
+	if (assemble)
+	{
+		*suffix = ".o";
+		out = output_name(file, ".o", stop_after == PHASE_ASSEMBLE);
+	}
+	else
+	{
+		*suffix = ".s";
+		out = output_name(file, ".s", stop_after == PHASE_COMPILE);
+	}
+	
+	in = *input;
+	if (preprocess)
+	{
+		stages[nstages++] = preprocessor_command(in, (compile || assemble) ? "-" : out);
+		in = "-";
+	}
+	if (compile)
+	{
+		stages[nstages++] = compiler_command(in, assemble ? "-" : out);
+		in = "-";
+	}
+	if (assemble)
+	{
+		stages[nstages++] = assembler_command(in, out);
+	}
+	
+	retval = execute_pipeline(stages, nstages);
+
+	for (i = 0; i < nstages; i++)
+		lw_stringlist_destroy(stages[i]);
+	lw_free(*input);
+	*input = out;
+	return retval;
+}
+
+/*
+Make the object for an input file through the object cache. The file is
+preprocessed first since the key covers the preprocessed source. The object
+is then copied out of the cache if it is there; otherwise it is compiled and
+assembled straight to its destination and added to the cache. On success,
+*input is the name of the object and *suffix is ".o".
+*/
+static int cached_compile(const char *file, char **input, const char **suffix)
+{
+	lw_stringlist_t stages[MAX_PIPELINE];
+	int nstages, i;
+	int retval = 0;
+	char *key, *obj;
+	
+	if (strcmp(*suffix, ".c") == 0 || strcmp(*suffix, ".S") == 0)
+	{
+		*suffix = (strcmp(*suffix, ".c") == 0) ? ".i" : ".s";
+		retval = preprocess_file(file, *input, input, *suffix);
+		if (retval)
+			return retval;
+	}
+	
+	/* the key covers the commands that make the object but not the
+	   file names they work on */
+	nstages = 0;
+	if (strcmp(*suffix, ".i") == 0)
+		stages[nstages++] = compiler_command("-", "-");
+	stages[nstages++] = assembler_command("-", "-");
+	key = cache_key(*input, stages, nstages);
+	for (i = 0; i < nstages; i++)
+		lw_stringlist_destroy(stages[i]);
+	
+	obj = output_name(file, ".o", stop_after == PHASE_ASSEMBLE);
+	if (key == NULL || cache_fetch(key, obj) != 0)
+	{
+		/* keep the assembler source if asked to */
+		if (strcmp(*suffix, ".i") == 0 && save_temps)
+		{
+			*suffix = ".s";
+			retval = compile_file(file, *input, input, *suffix);
+			if (retval)
+				goto out;
+		}
+		nstages = 0;
+		if (strcmp(*suffix, ".i") == 0)
+		{
+			stages[nstages++] = compiler_command(*input, "-");
+			stages[nstages++] = assembler_command("-", obj);
+		}
+		else
+		{
+			stages[nstages++] = assembler_command(*input, obj);
+		}
+		retval = execute_pipeline(stages, nstages);
+		for (i = 0; i < nstages; i++)
+			lw_stringlist_destroy(stages[i]);
+		if (retval)
+			goto out;
+		if (key)
+			cache_store(key, obj);
+	}
+	else if (verbose_mode)
+	{
+		printf("Using cached object for %s\n", file);
+	}
+	lw_free(*input);
+	*input = obj;
+	obj = NULL;
+	*suffix = ".o";
+out:
+	lw_free(obj);
+	lw_free(key);
+	cache_flush();
+	return retval;
+}
+
 /*
 handle an input file through the various stages of compilation. If any
 stage decides to handle an input file, that fact is recorded. If control
@@ -617,6 +916,30 @@ static int handle_input_file(const char *f)
 	/* make a copy of the file */
 	src = lw_strdup(f);
 	
+	handled = 0;
+	retval = 0;
+	
+	/* use the object cache for anything that ends up as an object */
+	if (cache_dir && stop_after >= PHASE_ASSEMBLE &&
+		(strcmp(suffix, ".c") == 0 || strcmp(suffix, ".S") == 0 || strcmp(suffix, ".i") == 0 || strcmp(suffix, ".s") == 0))
+	{
+		retval = cached_compile(f, &src, &suffix);
+		if (retval)
+			goto done;
+		handled = 1;
+	}
+	
+	/* run the stages together unless the intermediate files are wanted */
+	if (!save_temps)
+	{
+		retval = pipeline_file(f, &src, &suffix);
+		if (retval > 0)
+			goto done;
+		if (retval == 0)
+			handled = 1;
+		retval = 0;
+	}
+
 	/* preprocess if appropriate */
 	if (strcmp(suffix, ".c") == 0)
 	{
@@ -693,6 +1016,182 @@ done:
 	return retval;
 }
 
+/*
+With -j, each input file is handled by a child copy of the driver so that
+up to max_jobs files go through their pipelines at once. A child's
+standard output and standard error are captured in temporary files and
+replayed by the parent in command line order, so diagnostics for one file
+are never mixed with those of another. The child also reports the object
+file it made and any temporary files it created; the parent adds them to
+linker_args and tempfiles in command line order, which keeps the link
+order the same as without -j.
+*/
+struct job
+{
+	const char *file;		// the input file
+	pid_t pid;				// the child process; 0 if not started, -1 when finished
+	int status;				// the child's wait status
+	FILE *out;				// captured standard output
+	FILE *err;				// captured standard error
+	FILE *results;			// files made by the child: "L" to link, "T" temporary
+};
+
+/* start a child driver for job j, which is job number "number" */
+static void start_job(struct job *j, int number)
+{
+	int n, retval;
+	char *s;
+	
+	j -> out = tmpfile();
+	j -> err = tmpfile();
+	j -> results = tmpfile();
+	if (!(j -> out) || !(j -> err) || !(j -> results))
+		do_error("Failed to create temporary file: %s", strerror(errno));
+	
+	/* make sure nothing buffered gets output twice */
+	fflush(NULL);
+	
+	j -> pid = fork();
+	if (j -> pid == -1)
+		do_error("Failed to start job for %s: %s", j -> file, strerror(errno));
+	if (j -> pid != 0)
+		return;
+
+	/* child process */
+	njob_pids = 0;
+	dup2(fileno(j -> out), 1);
+	dup2(fileno(j -> err), 2);
+	job_number = number;
+	job_results = j -> results;
+	
+	n = lw_stringlist_nstrings(linker_args);
+	retval = handle_input_file(j -> file);
+	/* report whatever handle_input_file() added to the linker arguments */
+	lw_stringlist_reset(linker_args);
+	for (s = lw_stringlist_current(linker_args); s; s = lw_stringlist_next(linker_args))
+	{
+		if (n-- > 0)
+			continue;
+		fprintf(job_results, "L%s\n", s);
+	}
+	exit(retval);
+}
+
+/* copy the contents of a capture file to f and close it */
+static void replay_file(FILE *cf, FILE *f)
+{
+	char buf[4096];
+	size_t n;
+	
+	rewind(cf);
+	while ((n = fread(buf, 1, sizeof(buf), cf)) > 0)
+		fwrite(buf, 1, n, f);
+	fclose(cf);
+}
+
+/* output what a finished job printed and collect the files it made;
+   returns nonzero if the job failed */
+static int finish_job(struct job *j)
+{
+	char *line = NULL;
+	size_t linesize = 0;
+	ssize_t len;
+	
+	replay_file(j -> out, stdout);
+	fflush(stdout);
+	replay_file(j -> err, stderr);
+	
+	rewind(j -> results);
+	while ((len = getline(&line, &linesize, j -> results)) > 0)
+	{
+		if (line[len - 1] == '\n')
+			line[--len] = '\0';
+		if (line[0] == 'L')
+			lw_stringlist_addstring(linker_args, line + 1);
+		else if (line[0] == 'T')
+			lw_stringlist_addstring(tempfiles, line + 1);
+	}
+	free(line);
+	fclose(j -> results);
+	
+	if (WIFEXITED(j -> status) && WEXITSTATUS(j -> status) == 0)
+		return 0;
+	return 1;
+}
+
+/* handle all the input files, running up to max_jobs of them at once. No
+   new jobs are started once one fails, as without -j. */
+static int run_jobs(void)
+{
+	struct job *jobs;
+	int njobs, next, done, running;
+	int i, status, retval;
+	pid_t pid;
+	char *ap;
+	
+	njobs = lw_stringlist_nstrings(input_files);
+	jobs = lw_alloc(sizeof(struct job) * njobs);
+	job_pids = lw_alloc(sizeof(sig_atomic_t) * njobs);
+	lw_stringlist_reset(input_files);
+	for (i = 0, ap = lw_stringlist_current(input_files); ap; i++, ap = lw_stringlist_next(input_files))
+	{
+		jobs[i].file = ap;
+		jobs[i].pid = 0;
+		job_pids[i] = 0;
+	}
+	njob_pids = njobs;
+	
+	/* the jobs must all share one temporary directory */
+	if (!save_temps && temp_directory == NULL)
+		make_temp_directory();
+
+	retval = 0;
+	next = done = running = 0;
+	while (done < njobs)
+	{
+		while (running < max_jobs && next < njobs && !retval && !sigterm_received)
+		{
+			start_job(&jobs[next], next + 1);
+			job_pids[next] = jobs[next].pid;
+			next++;
+			running++;
+		}
+		if (running == 0)
+			break;
+		
+		/* wait for a job to finish */
+		while ((pid = waitpid(-1, &status, 0)) == -1 && errno == EINTR)
+			/* do nothing */;
+		if (pid == -1)
+			do_error("waitpid failed: %s", strerror(errno));
+		for (i = 0; i < next; i++)
+		{
+			if (jobs[i].pid == pid)
+			{
+				jobs[i].pid = -1;
+				jobs[i].status = status;
+				job_pids[i] = 0;
+				running--;
+				break;
+			}
+		}
+		
+		/* report finished jobs in command line order */
+		while (done < next && jobs[done].pid == -1)
+		{
+			if (finish_job(&jobs[done]))
+				retval = 1;
+			done++;
+		}
+	}
+	
+	njob_pids = 0;
+	lw_free((void *)job_pids);
+	job_pids = NULL;
+	lw_free(jobs);
+	return retval || sigterm_received;
+}
+
 /*
 This actually runs the linker. Along the way, all the files the linker
 is supposed to handle will have been added to linker_args.
@@ -785,8 +1284,24 @@ int main(int argc, char **argv)
 	if (stop_after == PHASE_PREPROCESS && output_file == NULL)
 		output_file = "-";
 	
+	/* an empty LWCC_CACHE_DIR means no cache */
+	if (cache_dir == NULL)
+		cache_dir = getenv("LWCC_CACHE_DIR");
+	if (cache_dir && *cache_dir == '\0')
+		cache_dir = NULL;
+	if (cache_verify && !cache_dir)
+		do_error("--cache-verify requires a cache directory");
+
 	if (lw_stringlist_nstrings(input_files) == 0)
+	{
+		/* just report on the cache if that's all that was asked for */
+		if (cache_show_stats && cache_dir)
+		{
+			cache_report(stdout);
+			return 0;
+		}
 		do_error("No input files specified");
+	}
 
 	/* handle -B here */
 	ap = lw_alloc(strlen(basedir) + 10);
@@ -806,11 +1321,18 @@ int main(int argc, char **argv)
 	signal(SIGTERM, exit_on_signal);
 	
 	/* handle input files */
-	lw_stringlist_reset(input_files);
-	for (ap = lw_stringlist_current(input_files); ap; ap = lw_stringlist_next(input_files))
+	if (max_jobs > 1 && lw_stringlist_nstrings(input_files) > 1)
+	{
+		retval = run_jobs();
+	}
+	else
 	{
-		if (handle_input_file(ap))
-			retval = 1;
+		lw_stringlist_reset(input_files);
+		for (ap = lw_stringlist_current(input_files); ap; ap = lw_stringlist_next(input_files))
+		{
+			if (handle_input_file(ap))
+				retval = 1;
+		}
 	}
 
 	if (!retval && stop_after >= PHASE_LINK)
@@ -822,6 +1344,9 @@ int main(int argc, char **argv)
 	if (sigterm_received)
 		do_warning("Terminating on signal");
 
+	if (cache_show_stats && cache_dir)
+		cache_report(stdout);
+
 	/* clean up temporary files */
 	if (!save_temps)
 	{
@@ -971,6 +1496,47 @@ static int cmdline_misc(char *opt, char *optarg, int optcode, void *optptr)
 	return 0;
 }
 
+/* set the number of parallel jobs */
+static int cmdline_jobs(char *opt, char *optarg, int optcode, void *optptr)
+{
+	char *ep;
+	long n;
+	
+	n = strtol(optarg, &ep, 10);
+	if (*ep || n < 1 || n > 1024)
+		return -1;
+	*((int *)optptr) = n;
+	return 0;
+}
+
+/* set the object cache size limit; a K, M, or G suffix multiplies it */
+static int cmdline_cache_size(char *opt, char *optarg, int optcode, void *optptr)
+{
+	char *ep;
+	long long n;
+	
+	n = strtoll(optarg, &ep, 10);
+	switch (*ep)
+	{
+	case 'G':
+	case 'g':
+		n *= 1024;
+		/* fall through */
+	case 'M':
+	case 'm':
+		n *= 1024;
+		/* fall through */
+	case 'K':
+	case 'k':
+		n *= 1024;
+		ep++;
+	}
+	if (*ep || n < 1)
+		return -1;
+	*((long long *)optptr) = n;
+	return 0;
+}
+
 static int cmdline_set_intifzero(char *opt, char *optarg, int optcode, void *optptr)
 {
 	int *iv = (int *)optptr;
@@ -987,6 +1553,10 @@ struct option_e optionlist[] =
 {
 	{ "--version",			OPT_ARG_OPT, 	1,	CMD_MISC_VERSION, 	NULL,			cmdline_misc },
 	{ "--sysroot=",			OPT_ARG_INC,	0,	0,					&sysroot,		cmdline_set_string },
+	{ "--cache-dir=",		OPT_ARG_INC,	0,	0,					&cache_dir,		cmdline_set_string },
+	{ "--cache-size=",		OPT_ARG_INC,	0,	0,					&cache_max_size, cmdline_cache_size },
+	{ "--cache-stats",		OPT_ARG_OPT,	1,	1,					&cache_show_stats, cmdline_set_int },
+	{ "--cache-verify",		OPT_ARG_OPT,	1,	1,					&cache_verify,	cmdline_set_int },
 	{ "-B",					OPT_ARG_INC,	0,	0,					&basedir,		cmdline_set_string },
 	{ "-C",					OPT_ARG_OPT,	1,	0,					&preproc_args,	cmdline_arglist },
 	{ "-c",					OPT_ARG_OPT,	1,	PHASE_ASSEMBLE,		&stop_after,	cmdline_set_intifzero },
@@ -999,7 +1569,10 @@ struct option_e optionlist[] =
 	{ "-include",			OPT_ARG_SEP,	1,	0,					&includes,		cmdline_optarglist },
 	{ "-isysroot",			OPT_ARG_SEP,	1,	0,					&isysroot,		cmdline_set_string },
 	{ "-isystem",			OPT_ARG_SEP,	1,	0,					&user_sysincdirs, cmdline_optarglist },
+	{ "-j",					OPT_ARG_SEP,	0,	0,					&max_jobs,		cmdline_jobs },
 	{ "-M",					OPT_ARG_OPT,	1,	0,					&preproc_args,	cmdline_arglist },
+	{ "-m6309",				OPT_ARG_OPT,	1,	0,					&compiler_args,	cmdline_arglist },
+	{ "-m6809",				OPT_ARG_OPT,	1,	0,					&compiler_args,	cmdline_arglist },
 	{ "-nostartfiles",		OPT_ARG_OPT,	1,	1,					&nostartfiles,	cmdline_set_int },
 	{ "-nostdinc",			OPT_ARG_OPT,	1,	1,					&nostdinc,		cmdline_set_int },
 	{ "-nostdlib",			OPT_ARG_OPT,	1,	1,					&nostdlib,		cmdline_set_int },
@@ -1057,7 +1630,7 @@ static void parse_command_line(int argc, char **argv)
 			optarg = argv[i] + ilen;
 		if (!optarg && optionlist[j].needarg == 1)
 		{
-			if (i == argc)
+			if (i + 1 == argc)
 			{
 				do_error("Option %s requires an argument", argv[i]);
 			}
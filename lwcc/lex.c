@@ -21,6 +21,8 @@ this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include <ctype.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <lw_alloc.h>
 #include <lw_strbuf.h>
@@ -28,161 +30,241 @@ this program. If not, see <http://www.gnu.org/licenses/>.
 #include "cpp.h"
 #include "token.h"
 
-/* fetch a raw input byte from the current file. Will return CPP_EOF if
-   EOF is encountered and CPP_EOL if an end of line sequence is encountered.
-   End of line is defined as either CR, CRLF, LF, or LFCR. CPP_EOL is
-   returned on the first CR or LF encountered. The complementary CR or LF
-   is munched, if present, when the *next* character is read. This always
-   operates on file_stack.
-
-   This function also accounts for line numbers in input files and also
-   character columns.
+/*
+Source files are read into memory in one go (mapped where possible) and
+normalised in a single pass before lexing starts:
+
+* every end of line sequence (CR, CRLF, LF, or LFCR) becomes a single LF
+* trigraphs are replaced, if enabled
+* backslash-newline sequences are removed
+
+The lexer then reads bytes straight from the buffer. To keep line and
+column numbers right, the positions of removed line splices and replaced
+trigraphs are recorded as marks which are applied as the read position
+passes them. Only unfetched characters, marks, line ends, and comments
+need the general fetch path; runs of identifier characters, white space,
+string contents, and comment text are scanned in the buffer directly.
 */
-static int fetch_byte_ll(struct preproc_info *pp)
+
+/* character classes for scanning runs in the source buffer */
+#define LEX_IDENT	1		// letters, digits, and _
+#define LEX_SPACE	2		// white space other than a line end
+#define LEX_STRING	4		// anything but ", \, or a line end
+#define LEX_BLOCK	8		// anything but * or a line end
+#define LEX_LINE	16		// anything but a line end
+
+static unsigned char lexclass[256];
+
+static void init_lexclass(void)
 {
 	int c;
 
-	if (pp -> eolstate != 0)	
+	if (lexclass['a'])
+		return;
+	for (c = 0; c < 256; c++)
 	{
-		pp -> lineno++;
-		pp -> column = 0;
+		if (c == '\n')
+			continue;
+		lexclass[c] = LEX_LINE | LEX_STRING | LEX_BLOCK;
+		if (c == '_' || (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'))
+			lexclass[c] |= LEX_IDENT;
+		if (isspace(c))
+			lexclass[c] |= LEX_SPACE;
 	}
-	c = getc(pp -> fp);
-	pp -> column++;
-	if (pp -> eolstate == 1)
+	lexclass['"'] &= ~LEX_STRING;
+	lexclass['\\'] &= ~LEX_STRING;
+	lexclass['*'] &= ~LEX_BLOCK;
+}
+
+static int trigraph_char(int c)
+{
+	switch (c)
 	{
-		// just saw CR, munch LF
-		if (c == 10)
-			c = getc(pp -> fp);
-		pp -> eolstate = 0;
+	case '=':	return '#';
+	case '/':	return '\\';
+	case '\'':	return '^';
+	case '(':	return '[';
+	case ')':	return ']';
+	case '!':	return '|';
+	case '<':	return '{';
+	case '>':	return '}';
+	case '-':	return '~';
 	}
-	else if (pp -> eolstate == 2)
+	return 0;
+}
+
+static void add_mark(struct preproc_source *src, long pos, int splice)
+{
+	if (src -> nmarks >= src -> amarks)
 	{
-		// just saw LF, much CR
-		if (c == 13)
-			c = getc(pp -> fp);
-		pp -> eolstate = 0;
+		src -> amarks = src -> amarks ? src -> amarks * 2 : 16;
+		src -> marks = lw_realloc(src -> marks, sizeof(struct preproc_srcmark) * src -> amarks);
 	}
+	src -> marks[src -> nmarks].pos = pos;
+	src -> marks[src -> nmarks].splice = splice;
+	src -> nmarks++;
+}
+
+/* read the raw contents of the current file */
+static unsigned char *read_source(struct preproc_info *pp, long *len, int *mapped)
+{
+	struct stat st;
+	unsigned char *raw;
+	long alen, l;
 	
-	if (c == 10)
-	{
-		// we have LF - end of line, flag to munch CR
-		pp -> eolstate = 2;
-		c = CPP_EOL;
-	}
-	else if (c == 13)
+	*mapped = 0;
+	if (fstat(fileno(pp -> fp), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
 	{
-		// we have CR - end of line, flag to munch LF
-		pp -> eolstate = 1;
-		c = CPP_EOL;
+		raw = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(pp -> fp), 0);
+		if (raw != MAP_FAILED)
+		{
+			*mapped = 1;
+			*len = st.st_size;
+			return raw;
+		}
 	}
-	else if (c == EOF)
+
+	/* not a regular file or it cannot be mapped; read it in big chunks */
+	alen = 0;
+	*len = 0;
+	raw = NULL;
+	for (;;)
 	{
-		c = CPP_EOF;
+		if (*len == alen)
+		{
+			alen = alen ? alen * 2 : 65536;
+			raw = lw_realloc(raw, alen);
+		}
+		l = fread(raw + *len, 1, alen - *len, pp -> fp);
+		if (l <= 0)
+			break;
+		*len += l;
 	}
-	return c;
+	return raw;
 }
 
-/* This function takes a sequence of bytes from the _ll function above
-   and does trigraph interpretation on it, but only if the global
-   trigraphs is nonzero. */
-static int fetch_byte_tg(struct preproc_info *pp)
+static void load_source(struct preproc_info *pp)
 {
-	int c;
+	static unsigned char special[256];
+	struct preproc_source *src;
+	unsigned char *raw, *out;
+	long rlen, i, o;
+	int mapped, c, c2;
+
+	special['\r'] = 1;
+	special['\n'] = 1;
+	special['\\'] = 1;
+	special['?'] = pp -> trigraphs ? 1 : 0;
+	init_lexclass();
 	
-	if (!pp -> trigraphs)
-	{
-		c = fetch_byte_ll(pp);
-	}
-	else
+	src = lw_alloc(sizeof(struct preproc_source));
+	src -> pos = 0;
+	src -> marks = NULL;
+	src -> nmarks = 0;
+	src -> amarks = 0;
+	src -> curmark = 0;
+	pp -> src = src;
+	
+	raw = read_source(pp, &rlen, &mapped);
+	/* normalising never makes the text longer */
+	out = lw_alloc(rlen + 1);
+	i = 0;
+	o = 0;
+	while (i < rlen)
 	{
-		/* we have to do the trigraph shit here */
-		if (pp -> ra != CPP_NOUNG)
+		/* copy ordinary characters without any further checks */
+		while (i < rlen && !special[raw[i]])
+			out[o++] = raw[i++];
+		if (i >= rlen)
+			break;
+		c = raw[i++];
+		if (c == '?')
 		{
-			if (pp -> qseen > 0)
+			if (i + 1 < rlen && raw[i] == '?' && (c2 = trigraph_char(raw[i + 1])))
 			{
-				c = '?';
-				pp -> qseen -= 1;
-				return c;
-			}
-			else
-			{
-				c = pp -> ra;
-				pp -> ra = CPP_NOUNG;
-				return c;
+				add_mark(src, o, 0);
+				c = c2;
+				i += 2;
 			}
 		}
-	
-		c = fetch_byte_ll(pp);
-		while (c == '?')
+		if (c == '\r' || c == '\n')
 		{
-			pp -> qseen++;
-			c = fetch_byte_ll(pp);
+			/* munch the other half of CRLF or LFCR */
+			if (i < rlen && (raw[i] == '\r' || raw[i] == '\n') && raw[i] != c)
+				i++;
+			c = '\n';
 		}
-	
-		if (pp -> qseen >= 2)
+		else if (c == '\\' && i < rlen && (raw[i] == '\r' || raw[i] == '\n'))
 		{
-			// we have a trigraph
-			switch (c)
-			{
-			case '=':
-				c = '#';
-				pp -> qseen -= 2;
-				break;
-			
-			case '/':
-				c = '\\';
-				pp -> qseen -= 2;
-				break;
-		
-			case '\'':
-				c = '^';
-				pp -> qseen -= 2;
-				break;
-		
-			case '(':
-				c = '[';
-				pp -> qseen -= 2;
-				break;
-		
-			case ')':
-				c = ']';
-				pp -> qseen -= 2;
-				break;
-		
-			case '!':
-				c = '|';
-				pp -> qseen -= 2;
-				break;
-		
-			case '<':
-				c = '{';
-				pp -> qseen -= 2;
-				break;
-		
-			case '>':
-				c = '}';
-				pp -> qseen -= 2;
-				break;
-		
-			case '-':
-				c = '~';
-				pp -> qseen -= 2;
-				break;
-			}
-			if (pp -> qseen > 0)
-			{
-				pp -> ra = c;
-				c = '?';
-				pp -> qseen--;
-			}
+			/* line splice; drop it and note where the line changes */
+			c = raw[i++];
+			if (i < rlen && (raw[i] == '\r' || raw[i] == '\n') && raw[i] != c)
+				i++;
+			add_mark(src, o, 1);
+			continue;
 		}
-		else if (pp -> qseen > 0)
+		out[o++] = c;
+	}
+	out[o] = 0;
+	src -> buf = out;
+	src -> len = o;
+
+	if (mapped)
+		munmap(raw, rlen);
+	else
+		lw_free(raw);
+}
+
+void preproc_lex_free_source(struct preproc_info *pp)
+{
+	if (!pp -> src)
+		return;
+	lw_free(pp -> src -> buf);
+	lw_free(pp -> src -> marks);
+	lw_free(pp -> src);
+	pp -> src = NULL;
+}
+
+/* fetch a byte from the current file. Will return CPP_EOF if EOF is
+   encountered and CPP_EOL at the end of a line. This also accounts for
+   line numbers in input files and also character columns. */
+static int fetch_byte_ll(struct preproc_info *pp)
+{
+	struct preproc_source *src;
+	int c;
+
+	if (!pp -> src)
+		load_source(pp);
+	src = pp -> src;
+
+	if (pp -> eolstate != 0)	
+	{
+		pp -> lineno++;
+		pp -> column = 0;
+		pp -> eolstate = 0;
+	}
+	while (src -> curmark < src -> nmarks && src -> marks[src -> curmark].pos == src -> pos)
+	{
+		if (src -> marks[src -> curmark].splice)
 		{
-			pp -> ra = c;
-			c = '?';
-			pp -> qseen--;
+			pp -> lineno++;
+			pp -> column = 0;
 		}
+		else
+		{
+			/* trigraphs are three characters wide */
+			pp -> column += 2;
+		}
+		src -> curmark++;
+	}
+	pp -> column++;
+	if (src -> pos >= src -> len)
+		return CPP_EOF;
+	c = src -> buf[src -> pos++];
+	if (c == '\n')
+	{
+		pp -> eolstate = 1;
+		c = CPP_EOL;
 	}
 	return c;
 }
@@ -207,13 +289,12 @@ void preproc_lex_unfetch_byte(struct preproc_info *pp, int c)
 	if (pp -> ungetbufl >= pp -> ungetbufs)
 	{
 		pp -> ungetbufs += 100;
-		pp -> ungetbuf = lw_realloc(pp -> ungetbuf, pp -> ungetbufs);
+		pp -> ungetbuf = lw_realloc(pp -> ungetbuf, sizeof(int) * pp -> ungetbufs);
 	}
 	pp -> ungetbuf[pp -> ungetbufl++] = c;
 }
 
-/* This function retrieves a byte from the input stream. It performs
-   backslash-newline splicing on the returned bytes. Any character
+/* This function retrieves a byte from the input stream. Any character
    retrieved from the unfetch buffer is presumed to have already passed
    the backslash-newline filter. */
 static int fetch_byte(struct preproc_info *pp)
@@ -241,26 +322,33 @@ static int fetch_byte(struct preproc_info *pp)
 		return c;
 	}
 	
-again:
-	if (pp -> unget != CPP_NOUNG)
-	{
-		c = pp -> unget;
-		pp -> unget = CPP_NOUNG;
-	}
-	else
-	{
-		c = fetch_byte_tg(pp);
-	}
-	if (c == '\\')
+	return fetch_byte_ll(pp);
+}
+
+/* Skip the run of characters of class cls at the read position, adding
+   them to sb if it is not NULL, and return how many there were. Nothing is
+   skipped if the next character has to go through fetch_byte(): while
+   reading a string, when there are unfetched characters, at the start of
+   a line, or at a mark. The run also stops at the next mark. */
+static long scan_run(struct preproc_info *pp, int cls, struct lw_strbuf *sb)
+{
+	struct preproc_source *src = pp -> src;
+	long start, end;
+
+	if (!src || pp -> lexstr || pp -> ungetbufl > 0 || pp -> eolstate != 0)
+		return 0;
+	end = src -> len;
+	if (src -> curmark < src -> nmarks && src -> marks[src -> curmark].pos < end)
+		end = src -> marks[src -> curmark].pos;
+	start = src -> pos;
+	while (src -> pos < end && (lexclass[src -> buf[src -> pos]] & cls))
 	{
-		int c2;
-		c2 = fetch_byte_tg(pp);
-		if (c2 == CPP_EOL)
-			goto again;
-		else
-			pp -> unget = c2;
+		if (sb)
+			lw_strbuf_add(sb, src -> buf[src -> pos]);
+		src -> pos++;
 	}
-	return c;
+	pp -> column += src -> pos - start;
+	return src -> pos - start;
 }
 
 
@@ -288,7 +376,24 @@ Returned tokens are as follows:
 
 int preproc_lex_fetch_byte(struct preproc_info *pp)
 {
+	struct preproc_source *src = pp -> src;
 	int c;
+
+	/* an ordinary character with nothing to account for comes straight
+	   from the buffer */
+	if (src && !pp -> lexstr && pp -> ungetbufl == 0 && pp -> eolstate == 0 && src -> pos < src -> len &&
+		(src -> curmark >= src -> nmarks || src -> marks[src -> curmark].pos != src -> pos))
+	{
+		c = src -> buf[src -> pos];
+		if (c != '\n' && c != '/')
+		{
+			src -> pos++;
+			pp -> column++;
+			pp -> eolseen = 0;
+			return c;
+		}
+	}
+
 	c = fetch_byte(pp);
 	if (c == CPP_EOF && pp -> eolseen == 0)
 	{
@@ -316,6 +421,7 @@ int preproc_lex_fetch_byte(struct preproc_info *pp)
 			c = ' ';
 			for (;;)
 			{
+				scan_run(pp, LEX_LINE, NULL);
 				c2 = fetch_byte(pp);
 				if (c2 == CPP_EOF || c2 == CPP_EOL)
 					break;
@@ -328,6 +434,7 @@ int preproc_lex_fetch_byte(struct preproc_info *pp)
 			c = ' ';
 			for (;;)
 			{
+				scan_run(pp, LEX_BLOCK, NULL);
 				c2 = fetch_byte(pp);
 				if (c2 == CPP_EOF)
 				{
@@ -390,9 +497,12 @@ fileagain:
 				preproc_throw_error(pp, "Unbalanced conditionals in include file");
 			}
 			fclose(pp -> fp);
+			preproc_lex_free_source(pp);
+			preproc_end_file(pp);
 			fs = pp -> filestack;
 			*pp = *fs;
 			pp -> filestack = fs -> n;
+			lw_free(fs);
 			goto fileagain;
 		}
 		else
@@ -412,7 +522,10 @@ fileagain:
 	if (isspace(c))
 	{
 		while (isspace(c))
+		{
+			scan_run(pp, LEX_SPACE, NULL);
 			c = preproc_lex_fetch_byte(pp);
+		}
 		preproc_lex_unfetch_byte(pp, c);
 		ttype = TOK_WSPACE;
 		goto out;
@@ -659,6 +772,7 @@ strlit:
 		lw_strbuf_add(strbuf, '"');
 		for (;;)
 		{
+			scan_run(pp, LEX_STRING, strbuf);
 			c = preproc_lex_fetch_byte(pp);
 			if (c == CPP_EOF || c == CPP_EOL)
 			{
@@ -721,6 +835,7 @@ strlit:
 		lw_strbuf_add(strbuf, c);
 		for (;;)
 		{
+			scan_run(pp, LEX_IDENT, strbuf);
 			c = preproc_lex_fetch_byte(pp);
 			if ((c == '_') || (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'))
 			{
@@ -34,7 +34,13 @@ this program. If not, see <http://www.gnu.org/licenses/>.
 #include "symbol.h"
 #include "token.h"
 
-static int expand_macro(struct preproc_info *, char *);
+/* states for detecting include guards; see mi_directive() */
+#define MI_START	0		// nothing but whitespace seen so far
+#define MI_GUARD	1		// inside a possible include guard
+#define MI_AFTER	2		// past the #endif of a possible include guard
+#define MI_NONE		3		// the file is not guarded
+
+static int expand_macro(struct preproc_info *, struct token *);
 static void process_directive(struct preproc_info *);
 static long eval_expr(struct preproc_info *);
 extern struct token *preproc_lex_next_token(struct preproc_info *);
@@ -64,6 +70,10 @@ again:
 		process_directive(pp);
 		goto again;
 	}
+	// anything but whitespace outside the include guard means there isn't one
+	if (pp -> mi_state != MI_GUARD && ct -> ttype != TOK_WSPACE)
+		pp -> mi_state = MI_NONE;
+
 	// if we're in a false section, don't return the token; keep scanning
 	if (pp -> skip_level)
 		goto again;
@@ -71,10 +81,10 @@ again:
 	if (ct -> ttype != TOK_WSPACE)
 		pp -> ppeolseen = 0;
 	
-	if (ct -> ttype == TOK_IDENT)
+	if (ct -> ttype == TOK_IDENT && symtab_is_macro(ct -> strval))
 	{
 		// possible macro expansion
-		if (expand_macro(pp, ct -> strval))
+		if (expand_macro(pp, ct))
 	 		goto again;
 	}
 	
@@ -180,6 +190,13 @@ static void dir_ifndef(struct preproc_info *pp)
 		skip_eol(pp);
 	}
 	
+	if (pp -> mi_state == MI_START && pp -> found_level == 0 && ct -> ttype == TOK_IDENT)
+	{
+		/* this might be an include guard */
+		pp -> mi_state = MI_GUARD;
+		pp -> mi_macro = lw_strdup(ct -> strval);
+	}
+
 	if (symtab_find(pp, ct -> strval) != NULL)
 	{
 		pp -> skip_level++;
@@ -362,6 +379,9 @@ baddefine2:
 	
 		if (ct -> ttype == TOK_EOL)
 			break;
+		/* white space before the replacement list is not part of it */
+		if (ct -> ttype == TOK_WSPACE && tl -> head == NULL)
+			continue;
 		token_list_append(tl, token_dup(ct));
 	}
 out:
@@ -477,6 +497,93 @@ static void dir_warning(struct preproc_info *pp)
 	lw_free(s);
 }
 
+static unsigned int preproc_map_hash(const char *key)
+{
+	unsigned int h = 2166136261U;
+
+	while (*key)
+	{
+		h ^= (unsigned char)*key++;
+		h *= 16777619U;
+	}
+	return h % PREPROC_MAPSIZE;
+}
+
+struct preproc_map *preproc_map_create(void)
+{
+	struct preproc_map *m;
+
+	m = lw_alloc(sizeof(struct preproc_map));
+	memset(m, 0, sizeof(struct preproc_map));
+	return m;
+}
+
+void preproc_map_destroy(struct preproc_map *m)
+{
+	struct preproc_mapent *e, *n;
+	int i;
+
+	for (i = 0; i < PREPROC_MAPSIZE; i++)
+	{
+		for (e = m -> buckets[i]; e; e = n)
+		{
+			n = e -> next;
+			lw_free(e -> key);
+			lw_free(e -> value);
+			lw_free(e);
+		}
+	}
+	lw_free(m);
+}
+
+static struct preproc_mapent *preproc_map_find(struct preproc_map *m, const char *key)
+{
+	struct preproc_mapent *e;
+
+	for (e = m -> buckets[preproc_map_hash(key)]; e; e = e -> next)
+	{
+		if (strcmp(e -> key, key) == 0)
+			return e;
+	}
+	return NULL;
+}
+
+static void preproc_map_set(struct preproc_map *m, const char *key, const char *value)
+{
+	struct preproc_mapent *e;
+	unsigned int h;
+
+	e = preproc_map_find(m, key);
+	if (e)
+	{
+		lw_free(e -> value);
+	}
+	else
+	{
+		h = preproc_map_hash(key);
+		e = lw_alloc(sizeof(struct preproc_mapent));
+		e -> key = lw_strdup(key);
+		e -> next = m -> buckets[h];
+		m -> buckets[h] = e;
+	}
+	e -> value = value ? lw_strdup(value) : NULL;
+}
+
+/*
+Called when the end of a file is reached. If the whole file turned out to
+be wrapped in an include guard, remember the guard macro so the file can
+be skipped without opening it next time it is included while the macro
+is defined.
+*/
+void preproc_end_file(struct preproc_info *pp)
+{
+	if (pp -> mi_state == MI_AFTER && pp -> mi_macro)
+		preproc_map_set(pp -> guards, pp -> incpath, pp -> mi_macro);
+	lw_free(pp -> mi_macro);
+	pp -> mi_macro = NULL;
+	pp -> mi_state = MI_NONE;
+}
+
 static char *preproc_file_exists_in_dir(char *dir, char *fn)
 {
 	int l;
@@ -492,9 +599,8 @@ static char *preproc_file_exists_in_dir(char *dir, char *fn)
 	return NULL;
 }
 
-static char *preproc_find_file(struct preproc_info *pp, char *fn, int sys)
+static char *preproc_search_file(struct preproc_info *pp, char *fn, int sys, char *curdir)
 {
-	char *tstr;
 	char *pref;
 	char *rfn;
 
@@ -505,17 +611,7 @@ static char *preproc_find_file(struct preproc_info *pp, char *fn, int sys)
 	if (!sys)
 	{
 		/* look in the directory with the current file */
-		tstr = strchr(pp -> fn, '/');
-		if (!tstr)
-			pref = lw_strdup(".");
-		else
-		{
-			pref = lw_alloc(tstr - pp -> fn + 1);
-			memcpy(pref, pp -> fn, tstr - pp -> fn);
-			pref[tstr - pp -> fn] = 0;
-		}
-		rfn = preproc_file_exists_in_dir(pref, fn);
-		lw_free(pref);
+		rfn = preproc_file_exists_in_dir(curdir, fn);
 		if (rfn)
 			return rfn;
 		
@@ -542,12 +638,57 @@ static char *preproc_find_file(struct preproc_info *pp, char *fn, int sys)
 	return NULL;
 }
 
+/*
+Find an include file. The result only depends on the directory of the
+including file (for quoted includes), the name, and the search lists,
+which do not change, so lookups are cached to avoid probing the file
+system again for headers that are included from many places.
+*/
+static char *preproc_find_file(struct preproc_info *pp, char *fn, int sys)
+{
+	struct preproc_mapent *e;
+	char *curdir, *key, *rfn;
+	const char *tstr;
+	int l;
+
+	/* pass through absolute paths, dumb as they are */	
+	if (fn[0] == '/')
+		return lw_strdup(fn);
+
+	tstr = strrchr(pp -> incpath, '/');
+	if (sys)
+		curdir = lw_strdup("");
+	else if (!tstr)
+		curdir = lw_strdup(".");
+	else
+		curdir = lw_strndup(pp -> incpath, tstr - pp -> incpath);
+
+	l = snprintf(NULL, 0, "%c%s/%s", sys ? '<' : '"', curdir, fn);
+	key = lw_alloc(l + 1);
+	snprintf(key, l + 1, "%c%s/%s", sys ? '<' : '"', curdir, fn);
+
+	e = preproc_map_find(pp -> findcache, key);
+	if (e)
+	{
+		rfn = e -> value ? lw_strdup(e -> value) : NULL;
+	}
+	else
+	{
+		rfn = preproc_search_file(pp, fn, sys, curdir);
+		preproc_map_set(pp -> findcache, key, rfn);
+	}
+	lw_free(key);
+	lw_free(curdir);
+	return rfn;
+}
+
 static void dir_include(struct preproc_info *pp)
 {
 	FILE *fp;
 	struct token *ct;
+	struct preproc_mapent *e;
 	int sys = 0;
-	char *fn;
+	char *fn, *tstr;
 	struct lw_strbuf *strbuf;
 	int i;
 	struct preproc_info *fs;
@@ -639,17 +780,28 @@ usrinc:
 		}
 	}
 doinc:
-	fn = preproc_find_file(pp, fn, sys);
+	tstr = fn;
+	fn = preproc_find_file(pp, tstr, sys);
 	if (!fn)
 		goto badfile;
+
+	/* skip the file entirely if it is guarded and the guard is defined */
+	e = preproc_map_find(pp -> guards, fn);
+	if (e && symtab_find(pp, e -> value))
+	{
+		lw_free(fn);
+		lw_free(tstr);
+		return;
+	}
+
 	fp = fopen(fn, "rb");
 	if (!fp)
 	{
-		lw_free(fn);
 badfile:
-		preproc_throw_error(pp, "Cannot open #include file %s - this is fatal", fn);
+		preproc_throw_error(pp, "Cannot open #include file %s - this is fatal", tstr);
 		exit(1);
 	}
+	lw_free(tstr);
 	
 	/* save the current include file state, etc. */
 	fs = lw_alloc(sizeof(struct preproc_info));
@@ -658,18 +810,19 @@ badfile:
 	pp -> curtok = NULL;
 	pp -> filestack = fs;
 	pp -> fn = lw_strpool_strdup(pp -> strpool, fn);
+	pp -> incpath = pp -> fn;
 	lw_free(fn);
 	pp -> fp = fp;
-	pp -> ra = CPP_NOUNG;
+	pp -> src = NULL;
+	pp -> mi_state = MI_START;
+	pp -> mi_macro = NULL;
 	pp -> ppeolseen = 1;
 	pp -> eolstate = 0;
 	pp -> lineno = 1;
 	pp -> column = 0;
-	pp -> qseen = 0;
 	pp -> ungetbufl = 0;
 	pp -> ungetbufs = 0;
 	pp -> ungetbuf = NULL;
-	pp -> unget = 0;
 	pp -> eolseen = 0;
 	pp -> nlseen = 0;
 	pp -> skip_level = 0;
@@ -760,6 +913,29 @@ struct { char *name; void (*fn)(struct preproc_info *); } dirlist[] =
 	{ NULL, NULL }
 };
 
+/*
+Track include guards. A file is guarded if, apart from whitespace, it is
+a single #ifndef ... #endif block with no #else or #elif at the outer
+level. This is called before each directive is processed; dir_ifndef()
+notices the #ifndef that starts a guard.
+*/
+static void mi_directive(struct preproc_info *pp, void (*fn)(struct preproc_info *))
+{
+	int depth = pp -> skip_level + pp -> found_level;
+
+	if (pp -> mi_state == MI_GUARD)
+	{
+		if (depth == 1 && (fn == dir_else || fn == dir_elif))
+			pp -> mi_state = MI_NONE;
+		else if (depth == 1 && fn == dir_endif)
+			pp -> mi_state = MI_AFTER;
+	}
+	else if (pp -> mi_state != MI_START || fn != dir_ifndef)
+	{
+		pp -> mi_state = MI_NONE;
+	}
+}
+
 static void process_directive(struct preproc_info *pp)
 {
 	struct token *ct;
@@ -811,6 +987,7 @@ static void process_directive(struct preproc_info *pp)
 	{
 		if (strcmp(dirlist[i].name, ct -> strval) == 0)
 		{
+			mi_directive(pp, dirlist[i].fn);
 			(*(dirlist[i].fn))(pp);
 			return;
 		}
@@ -1195,11 +1372,31 @@ done:
 
 /*
 Below here is the logic for expanding a macro
+
+Every token carries a hide set: the macros whose expansion produced it.
+An identifier is never expanded as a macro named in its own hide set,
+which is what stops recursion without keeping a stack of the expansions
+in progress. For a function-like macro, the replacement inherits only the
+names hidden from both the macro name and the closing paren, so an
+invocation that straddles the end of another expansion is still rescanned
+correctly.
 */
+
+/* fetch the next raw token and take ownership of it */
+static struct token *take_token(struct preproc_info *pp)
+{
+	struct token *t;
+	
+	t = preproc_next_token(pp);
+	pp -> curtok = NULL;
+	return t;
+}
+
 static char *stringify(struct token_list *tli)
 {
 	struct lw_strbuf *s;
 	int ws = 0;
+	const char *p;
 	struct token *tl = tli -> head;
 	
 	s = lw_strbuf_new();
@@ -1219,13 +1416,14 @@ static char *stringify(struct token_list *tli)
 		{
 			lw_strbuf_add(s, ' ');
 		}
-		for (ws = 0; tl -> strval[ws]; ws++)
+		for (p = token_spelling(tl); *p; p++)
 		{
 			if (tl -> ttype == TOK_STR_LIT || tl -> ttype == TOK_CHR_LIT)
 			{
-				if (tl -> strval[ws] == '"' || tl -> strval[ws] == '\\')
+				if (*p == '"' || *p == '\\')
 					lw_strbuf_add(s, '\\');
 			}
+			lw_strbuf_add(s, *p);
 		}
 		ws = 0;
 	}
@@ -1237,137 +1435,219 @@ static char *stringify(struct token_list *tli)
 static int macro_arg(struct symtab_e *s, char *str)
 {
 	int i;
+	/* object like macros have no arguments */
+	if (s -> nargs < 0)
+		return -1;
 	if (strcmp(str, "__VA_ARGS__") == 0)
-		i = s -> nargs;
-	else
-		for (i = 0; i < s -> nargs; i++)
-			if (strcmp(s -> params[i], str) == 0)
-				break;
-	if (i == s -> nargs)
-		if (s -> vargs == 0)
-			return -1;
-	return i;
+		return s -> vargs ? s -> nargs : -1;
+	for (i = 0; i < s -> nargs; i++)
+		if (strcmp(s -> params[i], str) == 0)
+			return i;
+	return -1;
 }
 
-/* return list to tokens as a result of ## expansion */
-static struct token_list *paste_tokens(struct preproc_info *pp, struct symtab_e *s, struct token_list **arglist, struct token *t1, struct token *t2)
+/* append copies of the tokens on src to dst; an empty list is a placemarker */
+static void append_copies(struct token_list *dst, struct token_list *src)
 {
-	struct token_list *left;
-	struct token_list *right;
-	char *tstr;
-	struct token *ttok;
-	int i;
+	struct token *t;
 	
-	if (t1 -> ttype == TOK_IDENT)
+	if (src -> head == NULL)
 	{
-		i = macro_arg(s, t1 -> strval);
-		if (i == -1)
+		token_list_append(dst, token_create(TOK_NONE, NULL, -1, -1, ""));
+		return;
+	}
+	for (t = src -> head; t; t = t -> next)
+		token_list_append(dst, token_dup(t));
+}
+
+static void drop_token(struct token *t)
+{
+	token_list_remove(t);
+	token_free(t);
+}
+
+/*
+Paste the tokens on "right" onto the end of "left", gluing the last token
+of left to the first of right when the two spell a single token. A
+placemarker (TOK_NONE) on either side of the ## simply vanishes. "right"
+is consumed.
+*/
+static void paste_tokens(struct preproc_info *pp, struct token_list *left, struct token_list *right)
+{
+	const char *ls, *rs;
+	char *tstr;
+	struct token *t;
+	int nlseen;
+	
+	while (left -> tail && left -> tail -> ttype == TOK_WSPACE)
+		drop_token(left -> tail);
+	while (right -> head && right -> head -> ttype == TOK_WSPACE)
+		drop_token(right -> head);
+
+	if (left -> tail && left -> tail -> ttype == TOK_NONE)
+		drop_token(left -> tail);
+	else if (right -> head && right -> head -> ttype == TOK_NONE)
+		drop_token(right -> head);
+	else if (left -> tail && right -> head)
+	{
+		ls = token_spelling(left -> tail);
+		rs = token_spelling(right -> head);
+		tstr = lw_alloc(strlen(ls) + strlen(rs) + 1);
+		strcpy(tstr, ls);
+		strcat(tstr, rs);
+		
+		nlseen = pp -> nlseen;
+		pp -> lexstr = tstr;
+		pp -> lexstrloc = 0;
+		t = preproc_lex_next_token(pp);
+		if (t -> ttype != TOK_ERROR && pp -> lexstr[pp -> lexstrloc] == 0)
 		{
-			left = token_list_create();
-			token_list_append(left, token_dup(t1));
+			// we have a new token here
+			t -> lineno = left -> tail -> lineno;
+			t -> column = left -> tail -> column;
+			t -> fn = left -> tail -> fn;
+			t -> hs = left -> tail -> hs;
+			drop_token(left -> tail);
+			drop_token(right -> head);
+			token_list_append(left, t);
 		}
 		else
 		{
-			left = token_list_dup(arglist[i]);
+			token_free(t);
 		}
+		lw_free(tstr);
+		pp -> lexstr = NULL;
+		pp -> lexstrloc = 0;
+		pp -> nlseen = nlseen;
 	}
-	else
+	
+	while ((t = right -> head))
 	{
-		left = token_list_create();
-		token_list_append(left, token_dup(t1));
+		token_list_remove(t);
+		token_list_append(left, t);
 	}
-	// munch trailing white space
-	while (left -> tail && left -> tail -> ttype == TOK_WSPACE)
+	token_list_destroy(right);
+}
+
+/*
+Return the fully macro expanded form of argument i. This is done at most
+once per invocation, and only for parameters that are actually
+substituted outside of # and ##. The argument is expanded in isolation by
+queueing a copy of it ahead of an EOF marker.
+*/
+static struct token_list *expand_arg(struct preproc_info *pp, struct token_list **arglist, struct token_list **exparglist, int i)
+{
+	struct token_list *tl;
+	struct token *t;
+	
+	if (exparglist[i])
+		return exparglist[i];
+	tl = token_list_create();
+	exparglist[i] = tl;
+	if (arglist[i] -> head == NULL)
+		return tl;
+
+	preproc_unget_token(pp, token_create(TOK_EOF, NULL, -1, -1, ""));
+	for (t = arglist[i] -> tail; t; t = t -> prev)
+		preproc_unget_token(pp, token_dup(t));
+	for (;;)
 	{
-		token_list_remove(left -> tail);
+		t = preproc_next_processed_token(pp);
+		if (t -> ttype == TOK_EOF)
+			break;
+		pp -> curtok = NULL;
+		token_list_append(tl, t);
 	}
+	return tl;
+}
 
-	if (t2 -> ttype == TOK_IDENT)
+/* build the replacement list for an invocation of s */
+static struct token_list *subst_macro(struct preproc_info *pp, struct symtab_e *s, struct token_list **arglist, struct token_list **exparglist)
+{
+	struct token_list *rl;
+	struct token_list *right;
+	struct token *t, *t2;
+	char *tstr;
+	int i;
+	
+	rl = token_list_create();
+	if (s -> tl == NULL)
+		return rl;
+	
+	for (t = s -> tl -> head; t; t = t -> next)
 	{
-		i = macro_arg(s, t2 -> strval);
-		if (i == -1)
+		// t2 is the next non-whitespace token in the definition
+		for (t2 = t -> next; t2 && t2 -> ttype == TOK_WSPACE; t2 = t2 -> next)
+			/* do nothing */ ;
+
+		if (t -> ttype == TOK_HASH && t2 && t2 -> ttype == TOK_IDENT)
+		{
+			i = macro_arg(s, t2 -> strval);
+			if (i != -1)
+			{
+				tstr = stringify(arglist[i]);
+				token_list_append(rl, token_create(TOK_STR_LIT, tstr, t -> lineno, t -> column, t -> fn));
+				lw_free(tstr);
+				t = t2;
+				continue;
+			}
+		}
+		
+		if (t -> ttype == TOK_DBLHASH && t2)
 		{
 			right = token_list_create();
-			token_list_append(right, token_dup(t2));
+			i = (t2 -> ttype == TOK_IDENT) ? macro_arg(s, t2 -> strval) : -1;
+			if (i != -1)
+				append_copies(right, arglist[i]);
+			else
+				token_list_append(right, token_dup(t2));
+			paste_tokens(pp, rl, right);
+			t = t2;
+			continue;
 		}
-		else
+		
+		if (t -> ttype == TOK_IDENT)
 		{
-			right = token_list_dup(arglist[i]);
+			i = macro_arg(s, t -> strval);
+			if (i != -1)
+			{
+				// operands of ## are not expanded
+				if (t2 && t2 -> ttype == TOK_DBLHASH)
+					append_copies(rl, arglist[i]);
+				else
+					append_copies(rl, expand_arg(pp, arglist, exparglist, i));
+				continue;
+			}
 		}
+		token_list_append(rl, token_dup(t));
 	}
-	else
-	{
-		right = token_list_create();
-		token_list_append(right, token_dup(t2));
-	}
-	// munch leading white space
-	while (right -> head && right -> head -> ttype == TOK_WSPACE)
-	{
-		token_list_remove(right -> head);
-	}
+	return rl;
+}
 
-	// nothing to append at all
-	if (left -> head != NULL && right -> head == NULL)
-	{
-		// right arg is empty - use left
-		token_list_destroy(right);
-		return left;
-	}
-	if (left -> head == NULL && right -> head != NULL)
-	{
-		// left arg is empty, use right
-		token_list_destroy(left);
-		return right;
-	}
-	if (left -> head == NULL && right -> head == NULL)
-	{
-		// both empty, use left
-		token_list_destroy(right);
-		return left;
-	}
-	
-	// both non-empty - past left tail with right head
-	// then past the right list onto the left
-	tstr = lw_alloc(strlen(left -> tail -> strval) + strlen(right -> head -> strval) + 1);
-	strcpy(tstr, left -> tail -> strval);
-	strcat(tstr, right -> head -> strval);
-	
-	pp -> lexstr = tstr;
-	pp -> lexstrloc = 0;
-	
-	ttok = preproc_lex_next_token(pp);
-	if (ttok -> ttype != TOK_ERROR && pp -> lexstr[pp -> lexstrloc] == 0)
-	{
-		// we have a new token here
-		token_list_remove(left -> tail);
-		token_list_remove(right -> head);
-		token_list_append(left, token_dup(ttok));
-	}
-	lw_free(tstr);
-	pp -> lexstr = NULL;
-	pp -> lexstrloc = 0;
-	for (ttok = right -> head; ttok; ttok = ttok -> next)
-	{
-		token_list_append(left, token_dup(ttok));
-	}
-	token_list_destroy(right);
-	return left;
+static void trim_whitespace(struct token_list *tl)
+{
+	while (tl -> head && tl -> head -> ttype == TOK_WSPACE)
+		drop_token(tl -> head);
+	while (tl -> tail && tl -> tail -> ttype == TOK_WSPACE)
+		drop_token(tl -> tail);
 }
 
-static int expand_macro(struct preproc_info *pp, char *mname)
+static int expand_macro(struct preproc_info *pp, struct token *mt)
 {
 	struct symtab_e *s;
-	struct token *t, *t2, *t3;
-	int nargs = 0;
-	struct expand_e *e;
+	struct token *t;
 	struct token_list **exparglist = NULL;
 	struct token_list **arglist = NULL;
+	struct token_list *rl;
+	struct token_list *wl;
+	struct token_hideset *hs, *lasths = NULL, *lastrhs = NULL;
+	char *mname = mt -> strval;
+	const char *mfn = mt -> fn;
+	int mlineno = mt -> lineno;
+	int nargs = 0;
 	int i;
 	int pcount;
 	char *tstr;
-	struct token_list *expand_list;
-	int repl;
-	struct token_list *rtl;
 	
 	// check for built in macros
 	if (strcmp(mname, "__FILE__") == 0)
@@ -1433,12 +1713,9 @@ static int expand_macro(struct preproc_info *pp, char *mname)
 	if (!s)
 		return 0;
 	
-	for (e = pp -> expand_list; e; e = e -> next)
-	{
-		/* don't expand if we're already expanding the same macro */
-		if (e -> s == s)
-			return 0;
-	}
+	/* don't expand if this token came out of the same macro */
+	if (token_hideset_has(mt -> hs, mname))
+		return 0;
 
 	if (s -> nargs == -1)
 	{
@@ -1446,219 +1723,135 @@ static int expand_macro(struct preproc_info *pp, char *mname)
 		if (s -> tl == NULL)
 			return 1;
 
-		goto expandmacro;
+		hs = token_hideset_add(mt -> hs, mname);
+		rl = subst_macro(pp, s, NULL, NULL);
+		goto expanded;
 	}
 	
+	// the name is ours until we know whether this is an invocation
+	if (pp -> curtok == mt)
+		pp -> curtok = NULL;
+
 	// look for opening paren after optional whitespace
-	t2 = NULL;
-	t = NULL;
+	wl = token_list_create();
 	for (;;)
 	{
-		t = preproc_next_token(pp);
+		t = take_token(pp);
 		if (t -> ttype != TOK_WSPACE && t -> ttype != TOK_EOL)
 			break;
-		t -> next = t2;
-		t2 = t2;
+		token_list_append(wl, t);
 	}
 	if (t -> ttype != TOK_OPAREN)
 	{
-		// not a function-like invocation
-		while (t2)
+		// not a function-like invocation; put back what we read
+		preproc_unget_token(pp, t);
+		while ((t = wl -> tail))
 		{
-			t = t2 -> next;
-			preproc_unget_token(pp, t2);
-			t2 = t;
+			token_list_remove(t);
+			preproc_unget_token(pp, t);
 		}
+		token_list_destroy(wl);
+		pp -> curtok = mt;
 		return 0;
 	}
+	token_list_destroy(wl);
+	token_free(t);
 	
-	// parse parameters here
-	t = preproc_next_token_nws(pp);
+	// collect the arguments
 	nargs = 1;
 	arglist = lw_alloc(sizeof(struct token_list *));
 	arglist[0] = token_list_create();
-	t2 = NULL;
-	
-	while (t -> ttype != TOK_CPAREN)
+	pcount = 0;
+	for (;;)
 	{
-		pcount = 0;
+		t = take_token(pp);
 		if (t -> ttype == TOK_EOF)
-		{
 			preproc_throw_error(pp, "Unexpected EOF in macro call");
+		if (t -> ttype == TOK_CPAREN && pcount == 0)
 			break;
-		}
-		if (t -> ttype == TOK_EOL)
-			continue;
 		if (t -> ttype == TOK_OPAREN)
 			pcount++;
-		else if (t -> ttype == TOK_CPAREN && pcount)
+		else if (t -> ttype == TOK_CPAREN)
 			pcount--;
-		if (t -> ttype == TOK_COMMA && pcount == 0)
+		else if (t -> ttype == TOK_EOL)
+			t -> ttype = TOK_WSPACE;
+		else if (t -> ttype == TOK_COMMA && pcount == 0 && (!(s -> vargs) || nargs <= s -> nargs))
 		{
-			if (!(s -> vargs) || (nargs > s -> nargs))
-			{
-				nargs++;
-				arglist = lw_realloc(arglist, sizeof(struct token_list *) * nargs);
-				arglist[nargs - 1] = token_list_create();
-				t2 = NULL;
-				continue;
-			}
+			token_free(t);
+			nargs++;
+			arglist = lw_realloc(arglist, sizeof(struct token_list *) * nargs);
+			arglist[nargs - 1] = token_list_create();
+			continue;
 		}
-		token_list_append(arglist[nargs - 1], token_dup(t));
+		token_list_append(arglist[nargs - 1], t);
 	}
+	hs = token_hideset_add(token_hideset_intersect(mt -> hs, t -> hs), mname);
+	token_free(t);
+	token_free(mt);
+
+	for (i = 0; i < nargs; i++)
+		trim_whitespace(arglist[i]);
 
 	if (s -> vargs)
 	{
-		if (nargs <= s -> nargs)
+		if (nargs < s -> nargs)
 		{
 			preproc_throw_error(pp, "Wrong number of arguments (%d) for variadic macro %s which takes %d arguments", nargs, mname, s -> nargs);
 		}
+		if (nargs == s -> nargs)
+		{
+			// empty variable argument list
+			nargs++;
+			arglist = lw_realloc(arglist, sizeof(struct token_list *) * nargs);
+			arglist[nargs - 1] = token_list_create();
+		}
 	}
 	else
 	{
-		if (s -> nargs != nargs && !(s -> nargs == 0 && nargs == 1 && arglist[nargs - 1]))
+		if (s -> nargs != nargs && !(s -> nargs == 0 && nargs == 1 && arglist[0] -> head == NULL))
 		{
 			preproc_throw_error(pp, "Wrong number of arguments (%d) for macro %s which takes %d arguments", nargs, mname, s -> nargs);
 		}
 	}
 
-	/* now calculate the pre-expansions of the arguments */
+	/* arguments are expanded on demand by subst_macro() */
 	exparglist = lw_alloc(nargs * sizeof(struct token_list *));
 	for (i = 0; i < nargs; i++)
-	{
-		exparglist[i] = token_list_create();
-		// NOTE: do nothing if empty argument
-		if (arglist[i] == NULL || arglist[i] -> head == NULL)
-			continue;
-		pp -> sourcelist = arglist[i]->head;
-		for (;;)
-		{
-			t = preproc_next_processed_token(pp);
-			if (t -> ttype == TOK_EOF)
-				break;
-			token_list_append(exparglist[i], token_dup(t));
-		}
-	}
-
-expandmacro:
-	expand_list = token_list_dup(s -> tl);
+		exparglist[i] = NULL;
+	rl = subst_macro(pp, s, arglist, exparglist);
 
-	// scan for stringification and handle it
-	repl = 0;
-	while (repl == 0)
+	for (i = 0; i < nargs; i++)
 	{
-		for (t = expand_list -> head; t; t = t -> next)
-		{
-			if (t -> ttype == TOK_HASH && t -> next && t -> next -> ttype == TOK_IDENT)
-			{
-				i = macro_arg(s, t -> next -> strval);
-				if (i != -1)
-				{
-					repl = 1;
-					tstr = stringify(arglist[i]);
-					token_list_remove(t -> next);
-					token_list_insert(expand_list, t, token_create(TOK_STR_LIT, tstr, t -> lineno, t -> column, t -> fn));
-					token_list_remove(t);
-					lw_free(tstr);
-					break;
-				}
-			}
-		}
-		repl = 1;
+		token_list_destroy(arglist[i]);
+		token_list_destroy(exparglist[i]);
 	}
+	lw_free(arglist);
+	lw_free(exparglist);
 
-
-	// scan for concatenation and handle it	
-	
-	for (t = expand_list -> head; t; t = t -> next)
+expanded:
+	/* hide the macro from its own replacement and put the replacement
+	   in front of the input; consecutive tokens usually share a hide set
+	   so remember the last union computed; the replacement is reported
+	   at the invocation, not where the macro was defined */
+	while ((t = rl -> tail))
 	{
-		if (t -> ttype == TOK_DBLHASH)
+		token_list_remove(t);
+		if (t -> ttype == TOK_NONE)
 		{
-			// have a concatenation operator here
-			for (t2 = t -> prev; t2; t2 = t2 -> prev)
-			{
-				if (t2 -> ttype != TOK_WSPACE)
-					break;
-			}
-			for (t3 = t -> next; t3; t3 = t3 -> next)
-			{
-				if (t3 -> ttype != TOK_WSPACE)
-					break;
-			}
-			// if no non-whitespace before or after, ignore it
-			if (!t2 || !t3)
-				continue;
-			// eat the whitespace before and after
-			while (t -> prev != t2)
-				token_list_remove(t -> prev);
-			while (t -> next != t3)
-				token_list_remove(t -> next);
-			// now paste t -> prev with t -> next and replace t with the result
-			// continue scanning for ## at t -> next -> next
-			t3 = t -> next -> next;
-			
-			rtl = paste_tokens(pp, s, arglist, t -> prev, t -> next);
-			token_list_remove(t -> next);
-			token_list_remove(t -> prev);
-			t2 = t -> prev;
-			token_list_remove(t);
-			for (t = rtl -> head; t; t = t -> next)
-			{
-				token_list_insert(expand_list, t2, token_dup(t));
-			}
-			t = t3 -> prev;
-			token_list_destroy(rtl);
+			token_free(t);
+			continue;
 		}
-	}
-	
-	// now scan for arguments and expand them
-	for (t = expand_list -> head; t; t = t -> next)
-	{
-	again:
-		if (t -> ttype == TOK_IDENT)
+		t -> fn = mfn;
+		t -> lineno = mlineno;
+		if (t -> hs != lasths || lastrhs == NULL)
 		{
-			/* identifiers might need expansion to arguments */
-			i = macro_arg(s, t -> strval);
-			if (i != -1)
-			{
-				t3 = t -> next;
-				for (t2 = exparglist[i] -> tail; t2; t2 = t2 -> prev)
-					token_list_insert(expand_list, t, token_dup(t2));
-				token_list_remove(t);
-				t = t3;
-				goto again;
-			}
+			lasths = t -> hs;
+			lastrhs = token_hideset_union(t -> hs, hs);
 		}
+		t -> hs = lastrhs;
+		preproc_unget_token(pp, t);
 	}
-
-	/* put the new expansion in front of the input, if relevant; if we
-	   expanded to nothing, no need to create an expansion record or
-	   put anything into the input queue */
-	if (expand_list -> head)
-	{
-		token_list_append(expand_list, token_create(TOK_ENDEXPAND, "", -1, -1, ""));
-		
-		// move the expanded list into the token queue
-		for (t = expand_list -> tail; t; t = t -> prev)
-			preproc_unget_token(pp, token_dup(t));
-		
-		/* set up expansion record */
-		e = lw_alloc(sizeof(struct expand_e));
-		e -> next = pp -> expand_list;
-		pp -> expand_list = e;
-		e -> s = s;
-	}
-	
-	/* now clean up */
-	token_list_destroy(expand_list);
-	for (i = 0; i < nargs; i++)
-	{
-		token_list_destroy(arglist[i]);
-		token_list_destroy(exparglist[i]);
-	}
-	lw_free(arglist);
-	lw_free(exparglist);
-	
+	token_list_destroy(rl);
 	return 1;
 }
 
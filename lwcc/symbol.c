@@ -28,25 +28,115 @@ this program. If not, see <http://www.gnu.org/licenses/>.
 #include "symbol.h"
 #include "token.h"
 
+/*
+The macro table is a hash table with chaining. Lookups happen for every
+identifier the preprocessor sees so they need to be cheap; the full hash
+is kept in each entry so most mismatches never get as far as strcmp().
+The table doubles in size when it gets full so chains stay short.
+
+Macro names are interned token spellings. The spelling of each defined
+macro carries the SYMTAB_ISMACRO flag so the preprocessor can pass over
+ordinary identifiers without looking them up at all.
+*/
+
+#define SYMTAB_INITSIZE 256
+
+static unsigned int symtab_hash(const char *name)
+{
+	unsigned int h = 2166136261U;
+
+	while (*name)
+	{
+		h ^= (unsigned char)*name++;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+/* names handled specially by the preprocessor */
+static char *symtab_builtins[] =
+{
+	"__FILE__",
+	"__LINE__",
+	"__DATE__",
+	"__TIME__",
+	NULL
+};
+
+struct symtab *symtab_create(void)
+{
+	struct symtab *st;
+	int i;
+
+	st = lw_alloc(sizeof(struct symtab));
+	st -> nsyms = 0;
+	st -> size = SYMTAB_INITSIZE;
+	st -> buckets = lw_alloc(sizeof(struct symtab_e *) * st -> size);
+	memset(st -> buckets, 0, sizeof(struct symtab_e *) * st -> size);
+	for (i = 0; symtab_builtins[i]; i++)
+		lw_strpool_flags(token_intern(symtab_builtins[i])) |= SYMTAB_ISMACRO;
+	return st;
+}
+
 void symbol_free(struct symtab_e *s)
 {
 	int i;
 
-	lw_free(s -> name);
-	
 	for (i = 0; i < s -> nargs; i++)
 		lw_free(s -> params[i]);
 	lw_free(s -> params);
 	token_list_destroy(s -> tl);
+	lw_free(s);
+}
+
+void symtab_destroy(struct symtab *st)
+{
+	struct symtab_e *s, *n;
+	int i;
+
+	for (i = 0; i < st -> size; i++)
+	{
+		for (s = st -> buckets[i]; s; s = n)
+		{
+			n = s -> next;
+			symbol_free(s);
+		}
+	}
+	lw_free(st -> buckets);
+	lw_free(st);
+}
+
+static void symtab_grow(struct symtab *st)
+{
+	struct symtab_e **nb, *s, *n;
+	int i, nsize;
+
+	nsize = st -> size * 2;
+	nb = lw_alloc(sizeof(struct symtab_e *) * nsize);
+	memset(nb, 0, sizeof(struct symtab_e *) * nsize);
+	for (i = 0; i < st -> size; i++)
+	{
+		for (s = st -> buckets[i]; s; s = n)
+		{
+			n = s -> next;
+			s -> next = nb[s -> hash & (nsize - 1)];
+			nb[s -> hash & (nsize - 1)] = s;
+		}
+	}
+	lw_free(st -> buckets);
+	st -> buckets = nb;
+	st -> size = nsize;
 }
 
 struct symtab_e *symtab_find(struct preproc_info *pp, char *name)
 {
 	struct symtab_e *s;
+	unsigned int h;
 	
-	for (s = pp -> sh; s; s = s -> next)
+	h = symtab_hash(name);
+	for (s = pp -> sh -> buckets[h & (pp -> sh -> size - 1)]; s; s = s -> next)
 	{
-		if (strcmp(s -> name, name) == 0)
+		if (s -> name == name || (s -> hash == h && strcmp(s -> name, name) == 0))
 		{
 			return s;
 		}
@@ -57,27 +147,37 @@ struct symtab_e *symtab_find(struct preproc_info *pp, char *name)
 void symtab_undef(struct preproc_info *pp, char *name)
 {
 	struct symtab_e *s, **p;
+	unsigned int h;
+	int i;
 	
-	p = &(pp -> sh);
-	for (s = pp -> sh; s; s = s -> next)
+	h = symtab_hash(name);
+	for (p = &(pp -> sh -> buckets[h & (pp -> sh -> size - 1)]); *p; p = &((*p) -> next))
 	{
-		if (strcmp(s -> name, name) == 0)
+		s = *p;
+		if (s -> name == name || (s -> hash == h && strcmp(s -> name, name) == 0))
 		{
-			(*p) -> next = s -> next;
+			*p = s -> next;
+			for (i = 0; symtab_builtins[i]; i++)
+				if (strcmp(symtab_builtins[i], name) == 0)
+					break;
+			if (!symtab_builtins[i])
+				lw_strpool_flags(s -> name) &= ~SYMTAB_ISMACRO;
 			symbol_free(s);
+			pp -> sh -> nsyms--;
 			return;
 		}
-		p = &((*p) -> next);
 	}
 }
 
 void symtab_define(struct preproc_info *pp, char *name, struct token_list *def, int nargs, char **params, int vargs)
 {
-	struct symtab_e *s;
+	struct symtab_e *s, **b;
 	int i;
 		
 	s = lw_alloc(sizeof(struct symtab_e));
-	s -> name = lw_strdup(name);
+	s -> name = token_intern(name);
+	s -> hash = symtab_hash(name);
+	lw_strpool_flags(s -> name) |= SYMTAB_ISMACRO;
 	s -> tl = def;
 	s -> nargs = nargs;
 	s -> params = NULL;
@@ -88,17 +188,23 @@ void symtab_define(struct preproc_info *pp, char *name, struct token_list *def,
 			s -> params[i] = lw_strdup(params[i]);
 	}
 	s -> vargs = vargs;
-	s -> next = pp -> sh;
-	pp -> sh = s;
+
+	if (pp -> sh -> nsyms >= pp -> sh -> size)
+		symtab_grow(pp -> sh);
+	b = &(pp -> sh -> buckets[s -> hash & (pp -> sh -> size - 1)]);
+	s -> next = *b;
+	*b = s;
+	pp -> sh -> nsyms++;
 }
 
 void symtab_dump(struct preproc_info *pp)
 {
 	struct symtab_e *s;
 	struct token *t;
-	int i;
+	int i, b;
 		
-	for (s = pp -> sh; s; s = s -> next)
+	for (b = 0; b < pp -> sh -> size; b++)
+	for (s = pp -> sh -> buckets[b]; s; s = s -> next)
 	{
 		printf("%s", s -> name);
 		if (s -> nargs >= 0)
@@ -22,19 +22,36 @@ this program. If not, see <http://www.gnu.org/licenses/>.
 #ifndef symbol_h_seen___
 #define symbol_h_seen___
 
+#include <lw_strpool.h>
+
 #include "cpp.h"
 #include "token.h"
 
 struct symtab_e
 {
 	char *name;				// symbol name
+	unsigned int hash;		// hash of the symbol name
 	struct token_list *tl;	// token list the name is defined as, NULL for none
 	int nargs;				// number named of arguments - -1 for object like macro
 	int vargs;				// set if macro has varargs style
 	char **params;			// the names of the parameters
-	struct symtab_e *next;	// next entry in list
+	struct symtab_e *next;	// next entry in hash chain
+};
+
+struct symtab
+{
+	int nsyms;					// number of symbols defined
+	int size;					// number of hash buckets (a power of 2)
+	struct symtab_e **buckets;	// the hash chains
 };
 
+/* spelling flag set on interned names that are currently macros */
+#define SYMTAB_ISMACRO 1
+#define symtab_is_macro(name) (lw_strpool_flags(name) & SYMTAB_ISMACRO)
+
+struct symtab *symtab_create(void);
+void symtab_destroy(struct symtab *);
+
 struct symtab_e *symtab_find(struct preproc_info *, char *);
 void symtab_undef(struct preproc_info *, char *);
 void symtab_define(struct preproc_info *, char *, struct token_list *, int, char **, int);
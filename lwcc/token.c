@@ -23,52 +23,211 @@ this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include <lw_alloc.h>
 #include <lw_string.h>
+#include <lw_strpool.h>
 
 #include "token.h"
 
+/*
+Tokens are allocated from an arena that lives as long as a translation
+unit. Freed tokens go on a free list for reuse and everything is released
+at once when the arena is destroyed. Token spellings are interned in the
+arena's string pool, so tokens never own their strings, duplicating a
+token is a plain copy, and identical spellings share one pointer.
+Hide sets are allocated from the arena the same way and never freed
+individually.
+*/
+
+#define TOKEN_BLOCKSIZE 1024
+#define HIDESET_BLOCKSIZE 256
+
+struct token_block
+{
+	struct token_block *next;
+	struct token tokens[TOKEN_BLOCKSIZE];
+};
+
+struct hideset_block
+{
+	struct hideset_block *next;
+	struct token_hideset sets[HIDESET_BLOCKSIZE];
+};
+
+struct token_arena
+{
+	struct token_block *blocks;		// blocks of tokens, newest first
+	int nused;						// tokens handed out from the newest block
+	struct token *freelist;			// tokens available for reuse
+	struct lw_strpool *spellings;	// interned token spellings
+	struct hideset_block *hsblocks;	// blocks of hide set entries, newest first
+	int hsused;						// entries handed out from the newest block
+};
+
+static struct token_arena *cur_arena;
+
+struct token_arena *token_arena_create(void)
+{
+	struct token_arena *a;
+	
+	a = lw_alloc(sizeof(struct token_arena));
+	a -> blocks = NULL;
+	a -> nused = TOKEN_BLOCKSIZE;
+	a -> freelist = NULL;
+	a -> spellings = lw_strpool_create();
+	a -> hsblocks = NULL;
+	a -> hsused = HIDESET_BLOCKSIZE;
+	return a;
+}
+
+void token_arena_destroy(struct token_arena *a)
+{
+	struct token_block *b;
+	struct hideset_block *hb;
+	
+	while (a -> blocks)
+	{
+		b = a -> blocks;
+		a -> blocks = b -> next;
+		lw_free(b);
+	}
+	while (a -> hsblocks)
+	{
+		hb = a -> hsblocks;
+		a -> hsblocks = hb -> next;
+		lw_free(hb);
+	}
+	lw_strpool_free(a -> spellings);
+	if (cur_arena == a)
+		cur_arena = NULL;
+	lw_free(a);
+}
+
+/* make "a" the arena new tokens are allocated from */
+void token_arena_use(struct token_arena *a)
+{
+	cur_arena = a;
+}
+
+static struct token_arena *token_arena(void)
+{
+	if (!cur_arena)
+		cur_arena = token_arena_create();
+	return cur_arena;
+}
+
+/* return the interned copy of a token spelling */
+char *token_intern(const char *s)
+{
+	return lw_strpool_strdup(token_arena() -> spellings, s);
+}
+
+static struct token *token_alloc(void)
+{
+	struct token_arena *a = token_arena();
+	struct token_block *b;
+	struct token *t;
+	
+	if (a -> freelist)
+	{
+		t = a -> freelist;
+		a -> freelist = t -> next;
+		return t;
+	}
+	if (a -> nused == TOKEN_BLOCKSIZE)
+	{
+		b = lw_alloc(sizeof(struct token_block));
+		b -> next = a -> blocks;
+		a -> blocks = b;
+		a -> nused = 0;
+	}
+	return &(a -> blocks -> tokens[a -> nused++]);
+}
+
 struct token *token_create(int ttype, char *strval, int row, int col, const char *fn)
 {
 	struct token *t;
 	
-	t = lw_alloc(sizeof(struct token));
+	t = token_alloc();
 	t -> ttype = ttype;
-	if (strval)
-		t -> strval = lw_strdup(strval);
-	else
-		t -> strval = NULL;
+	t -> strval = token_intern(strval);
 	t -> lineno = row;
 	t -> column = col;
 	t -> fn = fn;
 	t -> next = NULL;
 	t -> prev = NULL;
 	t -> list = NULL;
+	t -> hs = NULL;
 	return t;
 }
 
 void token_free(struct token *t)
 {
-	lw_free(t -> strval);
-	lw_free(t);
+	struct token_arena *a = token_arena();
+
+	t -> next = a -> freelist;
+	a -> freelist = t;
 }
 
 struct token *token_dup(struct token *t)
 {
 	struct token *t2;
 	
-	t2 = lw_alloc(sizeof(struct token));
-	t2 -> ttype = t -> ttype;
-	t2 -> lineno = t -> lineno;
-	t2 -> column = t -> column;
+	t2 = token_alloc();
+	*t2 = *t;
 	t2 -> list = NULL;
 	t2 -> next = NULL;
 	t2 -> prev = NULL;
-	if (t -> strval)
-		t2 -> strval = lw_strdup(t -> strval);
-	else
-		t2 -> strval = NULL;
 	return t2;
 }
 
+int token_hideset_has(struct token_hideset *hs, char *name)
+{
+	for (; hs; hs = hs -> next)
+		if (hs -> name == name)
+			return 1;
+	return 0;
+}
+
+/* return hs with name added; hs itself is unchanged */
+struct token_hideset *token_hideset_add(struct token_hideset *hs, char *name)
+{
+	struct token_arena *a = token_arena();
+	struct hideset_block *b;
+	struct token_hideset *n;
+	
+	if (token_hideset_has(hs, name))
+		return hs;
+	if (a -> hsused == HIDESET_BLOCKSIZE)
+	{
+		b = lw_alloc(sizeof(struct hideset_block));
+		b -> next = a -> hsblocks;
+		a -> hsblocks = b;
+		a -> hsused = 0;
+	}
+	n = &(a -> hsblocks -> sets[a -> hsused++]);
+	n -> name = name;
+	n -> next = hs;
+	return n;
+}
+
+struct token_hideset *token_hideset_union(struct token_hideset *hs1, struct token_hideset *hs2)
+{
+	for (; hs1; hs1 = hs1 -> next)
+		hs2 = token_hideset_add(hs2, hs1 -> name);
+	return hs2;
+}
+
+struct token_hideset *token_hideset_intersect(struct token_hideset *hs1, struct token_hideset *hs2)
+{
+	struct token_hideset *r = NULL;
+
+	if (hs1 == hs2)
+		return hs1;
+	for (; hs1; hs1 = hs1 -> next)
+		if (token_hideset_has(hs2, hs1 -> name))
+			r = token_hideset_add(r, hs1 -> name);
+	return r;
+}
+
 static struct { int ttype; char *tstr; } tok_strs[] =
 {
 	{ TOK_WSPACE, " " },
@@ -124,6 +283,21 @@ static struct { int ttype; char *tstr; } tok_strs[] =
 	{ TOK_NONE, "" }
 };
 
+/* return the source spelling of a token */
+const char *token_spelling(struct token *t)
+{
+	int i;
+	
+	if (t -> strval)
+		return t -> strval;
+	for (i = 0; tok_strs[i].ttype != TOK_NONE; i++)
+	{
+		if (tok_strs[i].ttype == t -> ttype)
+			return tok_strs[i].tstr;
+	}
+	return "";
+}
+
 void token_print(struct token *t, FILE *f)
 {
 	int i;
@@ -201,6 +375,7 @@ void token_list_prepend(struct token_list *tl, struct token *tok)
 	{
 		tl -> head = tl -> tail = tok;
 		tok -> next = tok -> prev = NULL;
+		return;
 	}
 	tl -> head -> prev = tok;
 	tok -> next = tl -> head;
@@ -218,13 +393,19 @@ void token_list_insert(struct token_list *tl, struct token *after, struct token
 		return;
 	}
 	
-	for (t = tl -> head; t && t != after; t = t -> next)
-		/* do nothing */ ;
+	if (after -> list == tl)
+		t = after;
+	else
+	{
+		for (t = tl -> head; t && t != after; t = t -> next)
+			/* do nothing */ ;
+	}
 	if (!t)
 	{
 		token_list_append(tl, newt);
 		return;
 	}
+	newt -> list = tl;
 	newt -> prev = t;
 	newt -> next = t -> next;
 	if (t -> next)
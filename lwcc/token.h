@@ -92,16 +92,24 @@ enum
 #define TOK_ERROR 59
 #define TOK_MAX 60
 
+/* the set of macro names a token may not be expanded as */
+struct token_hideset
+{
+	char *name;					// interned macro name
+	struct token_hideset *next;	// rest of the set (shared)
+};
+
 struct token
 {
 	int ttype;				// token type
-	char *strval;			// the token value if relevant
+	char *strval;			// the token value if relevant (interned; never freed)
 	struct token *prev;		// previous token in a list
 	struct token *next;		// next token in a list
 	struct token_list *list;// pointer to head of list descriptor this token is on
 	int lineno;				// line number token came from
 	int column;				// character column token came from
 	const char *fn;			// file name token came from
+	struct token_hideset *hs;	// macros this token came out of
 };
 
 struct token_list
@@ -110,9 +118,21 @@ struct token_list
 	struct token *tail;		// the tail of the list
 };
 
+struct token_arena;
+
+extern struct token_arena *token_arena_create(void);
+extern void token_arena_destroy(struct token_arena *);
+extern void token_arena_use(struct token_arena *);
+extern char *token_intern(const char *);
 extern void token_free(struct token *);
 extern struct token *token_create(int, char *strval, int, int, const char *);
 extern struct token *token_dup(struct token *);
+extern const char *token_spelling(struct token *);
+/* hide set operations; sets are immutable and shared between tokens */
+extern int token_hideset_has(struct token_hideset *, char *);
+extern struct token_hideset *token_hideset_add(struct token_hideset *, char *);
+extern struct token_hideset *token_hideset_union(struct token_hideset *, struct token_hideset *);
+extern struct token_hideset *token_hideset_intersect(struct token_hideset *, struct token_hideset *);
 /* add a token to the end of a list */
 extern void token_list_append(struct token_list *, struct token *);
 /* add a token to the start of a list */
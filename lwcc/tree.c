@@ -20,6 +20,7 @@ this program. If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <stdarg.h>
+#include <stdio.h>
 #include <string.h>
 #include <lw_alloc.h>
 #include <lw_string.h>
@@ -229,19 +230,16 @@ void node_addchild(node_t *node, node_t *nn)
 void node_removechild(node_t *node, node_t *nn)
 {
 	node_t **pp;
-	node_t *np;
 	
 	if (!node)
 		node = nn -> parent;
 	
-	pp = &(node -> children);
-	for (np = node -> children; np; np = np -> next_child)
+	for (pp = &(node -> children); *pp; pp = &((*pp) -> next_child))
 	{
-		if (np -> next_child == nn)
+		if (*pp == nn)
 			break;
-		pp = &((*pp) -> next_child);
 	}
-	if (!np)
+	if (!*pp)
 		return;
 	
 	*pp = nn -> next_child;
@@ -255,6 +253,55 @@ void node_removechild_destroy(node_t *node, node_t *nn)
 	node_destroy(nn);
 }
 
+/* make a deep copy of a node and its children; the copy has no parent */
+node_t *node_copy(node_t *node)
+{
+	node_t *r;
+	node_t *nn;
+	
+	r = lw_alloc(sizeof(node_t));
+	memset(r, 0, sizeof(node_t));
+	r -> type = node -> type;
+	if (node -> strval)
+		r -> strval = lw_strdup(node -> strval);
+	memcpy(r -> ival, node -> ival, sizeof(r -> ival));
+	for (nn = node -> children; nn; nn = nn -> next_child)
+		node_addchild(r, node_copy(nn));
+	return r;
+}
+
+/* replace node with its child nn in place; the rest of node's children are
+   destroyed and node keeps its position in its parent */
+void node_collapse(node_t *node, node_t *nn)
+{
+	node_t *n;
+	
+	node_removechild(node, nn);
+	while (node -> children)
+		node_removechild_destroy(node, node -> children);
+	lw_free(node -> strval);
+	node -> type = nn -> type;
+	node -> strval = nn -> strval;
+	memcpy(node -> ival, nn -> ival, sizeof(node -> ival));
+	node -> children = nn -> children;
+	for (n = node -> children; n; n = n -> next_child)
+		n -> parent = node;
+	lw_free(nn);
+}
+
+/* turn node into an integer constant with value val */
+void node_set_const(node_t *node, long val)
+{
+	char buf[24];
+	
+	while (node -> children)
+		node_removechild_destroy(node, node -> children);
+	lw_free(node -> strval);
+	sprintf(buf, "%ld", val);
+	node -> type = NODE_CONST_INT;
+	node -> strval = lw_strdup(buf);
+}
+
 static void node_display_aux(node_t *node, FILE *f, int level)
 {
 	node_t *nn;
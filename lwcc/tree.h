@@ -109,5 +109,8 @@ extern void node_addchild(node_t *, node_t *);
 extern void node_removechild(node_t *, node_t *);
 extern void node_display(node_t *, FILE *);
 extern void node_removechild_destroy(node_t *, node_t *);
+extern node_t *node_copy(node_t *);
+extern void node_collapse(node_t *, node_t *);
+extern void node_set_const(node_t *, long);
 
 #endif // tree_h_seen___
@@ -29,37 +29,137 @@ this program. If not, see <http://www.gnu.org/licenses/>.
 #include "lw_error.h"
 #include "lw_string.h"
 
-static lw_expr_fn_t *evaluate_special = NULL;
-static lw_expr_fn2_t *evaluate_var = NULL;
-static lw_expr_fn3_t *parse_term = NULL;
+/*
+Everything the evaluator needs besides the expression itself lives in a
+context so separate contexts can be used at the same time from different
+threads. The functions without a context use a single default one.
+*/
+struct lw_expr_ctx_s
+{
+	lw_expr_fn_t *evaluate_special;
+	lw_expr_fn2_t *evaluate_var;
+	lw_expr_fn3_t *parse_term;
+	void (*divzero)(void *priv);
+	int width;
+
+	/* Q&D to break out of infinite recursion */
+	int level;
+	int bailing;
+	int parse_compact;
+
+	void *(*alloc)(int size);
+	void *(*realloc)(void *ptr, int size);
+	void (*free)(void *ptr);
+
+	char *printbuf;						// result of lw_expr_print
+	int printbufsize;
+};
+
+static lw_expr_ctx_t lw_expr_default_ctx =
+{
+	NULL, NULL, NULL, NULL, 0,
+	0, 0, 0,
+	lw_alloc, lw_realloc, lw_free,
+	NULL, 0
+};
+
+lw_expr_ctx_t *lw_expr_ctx_create(void)
+{
+	lw_expr_ctx_t *ctx;
+
+	ctx = lw_alloc(sizeof(lw_expr_ctx_t));
+	memset(ctx, 0, sizeof(lw_expr_ctx_t));
+	ctx -> alloc = lw_alloc;
+	ctx -> realloc = lw_realloc;
+	ctx -> free = lw_free;
+	return ctx;
+}
+
+void lw_expr_ctx_destroy(lw_expr_ctx_t *ctx)
+{
+	if (!ctx)
+		return;
+	if (ctx -> printbuf)
+		ctx -> free(ctx -> printbuf);
+	lw_free(ctx);
+}
+
+void lw_expr_ctx_set_allocator(lw_expr_ctx_t *ctx, void *(*alloc)(int size), void *(*realloc)(void *ptr, int size), void (*free)(void *ptr))
+{
+	ctx -> alloc = alloc;
+	ctx -> realloc = realloc;
+	ctx -> free = free;
+}
 
-/* Q&D to break out of infinite recursion */
-static int level = 0;
-static int bailing = 0;
-static int parse_compact = 0;
+void lw_expr_ctx_setwidth(lw_expr_ctx_t *ctx, int w)
+{
+	ctx -> width = w;
+}
 
-static void (*divzero)(void *priv) = NULL;
+void lw_expr_ctx_setdivzero(lw_expr_ctx_t *ctx, void (*fn)(void *priv))
+{
+	ctx -> divzero = fn;
+}
 
-static int expr_width = 0;
+void lw_expr_ctx_set_term_parser(lw_expr_ctx_t *ctx, lw_expr_fn3_t *fn)
+{
+	ctx -> parse_term = fn;
+}
+
+void lw_expr_ctx_set_special_handler(lw_expr_ctx_t *ctx, lw_expr_fn_t *fn)
+{
+	ctx -> evaluate_special = fn;
+}
+
+void lw_expr_ctx_set_var_handler(lw_expr_ctx_t *ctx, lw_expr_fn2_t *fn)
+{
+	ctx -> evaluate_var = fn;
+}
 
 void lw_expr_setwidth(int w)
 {
-	expr_width = w;
+	lw_expr_ctx_setwidth(&lw_expr_default_ctx, w);
 }
 
 void lw_expr_setdivzero(void (*fn)(void *priv))
 {
-	divzero = fn;
+	lw_expr_ctx_setdivzero(&lw_expr_default_ctx, fn);
 }
 
-static void lw_expr_divzero(void *priv)
+void lw_expr_set_term_parser(lw_expr_fn3_t *fn)
 {
-	if (divzero)
-		(*divzero)(priv);
+	lw_expr_ctx_set_term_parser(&lw_expr_default_ctx, fn);
+}
+
+void lw_expr_set_special_handler(lw_expr_fn_t *fn)
+{
+	lw_expr_ctx_set_special_handler(&lw_expr_default_ctx, fn);
+}
+
+void lw_expr_set_var_handler(lw_expr_fn2_t *fn)
+{
+	lw_expr_ctx_set_var_handler(&lw_expr_default_ctx, fn);
+}
+
+static void lw_expr_divzero(lw_expr_ctx_t *ctx, void *priv)
+{
+	if (ctx -> divzero)
+		(*(ctx -> divzero))(priv);
 	else
 		fprintf(stderr, "Divide by zero in lw_expr!\n");
 }
 
+static char *lw_expr_strdup(lw_expr_ctx_t *ctx, const char *s)
+{
+	char *r;
+
+	if (!s)
+		s = "(null)";
+	r = ctx -> alloc(strlen(s) + 1);
+	strcpy(r, s);
+	return r;
+}
+
 int lw_expr_istype(lw_expr_t e, int t)
 {
 	/* NULL expression is never of any type */
@@ -95,26 +195,11 @@ int lw_expr_specint(lw_expr_t e)
 	return -1;
 }
 
-void lw_expr_set_term_parser(lw_expr_fn3_t *fn)
-{
-	parse_term = fn;
-}
-
-void lw_expr_set_special_handler(lw_expr_fn_t *fn)
-{
-	evaluate_special = fn;
-}
-
-void lw_expr_set_var_handler(lw_expr_fn2_t *fn)
-{
-	evaluate_var = fn;
-}
-
-lw_expr_t lw_expr_create(void)
+lw_expr_t lw_expr_create_ctx(lw_expr_ctx_t *ctx)
 {
 	lw_expr_t r;
 	
-	r = lw_alloc(sizeof(struct lw_expr_priv));
+	r = ctx -> alloc(sizeof(struct lw_expr_priv));
 	r -> operands = NULL;
 	r -> value2 = NULL;
 	r -> type = lw_expr_type_int;
@@ -122,7 +207,12 @@ lw_expr_t lw_expr_create(void)
 	return r;
 }
 
-void lw_expr_destroy(lw_expr_t E)
+lw_expr_t lw_expr_create(void)
+{
+	return lw_expr_create_ctx(&lw_expr_default_ctx);
+}
+
+void lw_expr_destroy_ctx(lw_expr_ctx_t *ctx, lw_expr_t E)
 {
 	struct lw_expr_opers *o;
 	if (!E)
@@ -131,43 +221,59 @@ void lw_expr_destroy(lw_expr_t E)
 	{
 		o = E -> operands;
 		E -> operands = o -> next;
-		lw_expr_destroy(o -> p);
-		lw_free(o);
+		lw_expr_destroy_ctx(ctx, o -> p);
+		ctx -> free(o);
 	}
 	if (E -> type == lw_expr_type_var)
-		lw_free(E -> value2);
-	lw_free(E);
+		ctx -> free(E -> value2);
+	ctx -> free(E);
+}
+
+void lw_expr_destroy(lw_expr_t E)
+{
+	lw_expr_destroy_ctx(&lw_expr_default_ctx, E);
 }
 
 /* actually duplicates the entire expression */
-void lw_expr_add_operand(lw_expr_t E, lw_expr_t O);
-lw_expr_t lw_expr_copy(lw_expr_t E)
+lw_expr_t lw_expr_copy_ctx(lw_expr_ctx_t *ctx, lw_expr_t E)
 {
 	lw_expr_t r;
-	struct lw_expr_opers *o;
+	struct lw_expr_opers *o, *no, **tail;
 	
 	if (!E)
 		return NULL;
-	r = lw_alloc(sizeof(struct lw_expr_priv));
+	r = ctx -> alloc(sizeof(struct lw_expr_priv));
 	*r = *E;
 	r -> operands = NULL;
 	
 	if (E -> type == lw_expr_type_var)
-		r -> value2 = lw_strdup(E -> value2);
+		r -> value2 = lw_expr_strdup(ctx, E -> value2);
+	// append directly at the tail; lw_expr_add_operand() would walk the
+	// whole list for every operand, which is quadratic for long sums
+	tail = &(r -> operands);
 	for (o = E -> operands; o; o = o -> next)
 	{
-		lw_expr_add_operand(r, o -> p);
+		no = ctx -> alloc(sizeof(struct lw_expr_opers));
+		no -> p = lw_expr_copy_ctx(ctx, o -> p);
+		no -> next = NULL;
+		*tail = no;
+		tail = &(no -> next);
 	}
 	
 	return r;
 }
 
-void lw_expr_add_operand(lw_expr_t E, lw_expr_t O)
+lw_expr_t lw_expr_copy(lw_expr_t E)
+{
+	return lw_expr_copy_ctx(&lw_expr_default_ctx, E);
+}
+
+void lw_expr_add_operand_ctx(lw_expr_ctx_t *ctx, lw_expr_t E, lw_expr_t O)
 {
 	struct lw_expr_opers *o, *t;
 	
-	o = lw_alloc(sizeof(struct lw_expr_opers));
-	o -> p = lw_expr_copy(O);
+	o = ctx -> alloc(sizeof(struct lw_expr_opers));
+	o -> p = lw_expr_copy_ctx(ctx, O);
 	o -> next = NULL;
 	for (t = E -> operands; t && t -> next; t = t -> next)
 		/* do nothing */ ;
@@ -178,7 +284,12 @@ void lw_expr_add_operand(lw_expr_t E, lw_expr_t O)
 		E -> operands = o;
 }
 
-lw_expr_t lw_expr_build_aux(int exprtype, va_list args)
+void lw_expr_add_operand(lw_expr_t E, lw_expr_t O)
+{
+	lw_expr_add_operand_ctx(&lw_expr_default_ctx, E, O);
+}
+
+static lw_expr_t lw_expr_build_aux(lw_expr_ctx_t *ctx, int exprtype, va_list args)
 {
 	lw_expr_t r;
 	int t;
@@ -186,7 +297,7 @@ lw_expr_t lw_expr_build_aux(int exprtype, va_list args)
 	
 	lw_expr_t te1, te2;
 
-	r = lw_expr_create();
+	r = lw_expr_create_ctx(ctx);
 
 	switch (exprtype)
 	{
@@ -199,7 +310,7 @@ lw_expr_t lw_expr_build_aux(int exprtype, va_list args)
 	case lw_expr_type_var:
 		p = va_arg(args, char *);
 		r -> type = lw_expr_type_var;
-		r -> value2 = lw_strdup(p);
+		r -> value2 = lw_expr_strdup(ctx, p);
 		break;
 
 	case lw_expr_type_special:
@@ -220,9 +331,9 @@ lw_expr_t lw_expr_build_aux(int exprtype, va_list args)
 		
 		r -> type = lw_expr_type_oper;
 		r -> value = t;
-		lw_expr_add_operand(r, te1);
+		lw_expr_add_operand_ctx(ctx, r, te1);
 		if (te2)
-			lw_expr_add_operand(r, te2);
+			lw_expr_add_operand_ctx(ctx, r, te2);
 		break;
 	
 	default:
@@ -232,18 +343,29 @@ lw_expr_t lw_expr_build_aux(int exprtype, va_list args)
 	return r;
 }
 
+lw_expr_t lw_expr_build_ctx(lw_expr_ctx_t *ctx, int exprtype, ...)
+{
+	va_list args;
+	lw_expr_t r;
+	
+	va_start(args, exprtype);
+	r = lw_expr_build_aux(ctx, exprtype, args);
+	va_end(args);
+	return r;
+}
+
 lw_expr_t lw_expr_build(int exprtype, ...)
 {
 	va_list args;
 	lw_expr_t r;
 	
 	va_start(args, exprtype);
-	r = lw_expr_build_aux(exprtype, args);
+	r = lw_expr_build_aux(&lw_expr_default_ctx, exprtype, args);
 	va_end(args);
 	return r;
 }
 
-void lw_expr_print_aux(lw_expr_t E, char **obuf, int *buflen, int *bufloc)
+static void lw_expr_print_aux(lw_expr_ctx_t *ctx, lw_expr_t E, char **obuf, int *buflen, int *bufloc)
 {
 	struct lw_expr_opers *o;
 	int c = 0;
@@ -257,7 +379,7 @@ void lw_expr_print_aux(lw_expr_t E, char **obuf, int *buflen, int *bufloc)
 	for (o = E -> operands; o; o = o -> next)
 	{
 		c++;
-		lw_expr_print_aux(o -> p, obuf, buflen, bufloc);
+		lw_expr_print_aux(ctx, o -> p, obuf, buflen, bufloc);
 	}
 	
 	switch (E -> type)
@@ -351,22 +473,25 @@ void lw_expr_print_aux(lw_expr_t E, char **obuf, int *buflen, int *bufloc)
 	if (*bufloc + c >= *buflen)
 	{
 		*buflen += 128;
-		*obuf = lw_realloc(*obuf, *buflen);
+		*obuf = ctx -> realloc(*obuf, *buflen);
 	}
 	strcpy(*obuf + *bufloc, buf);
 	*bufloc += c;
 }
 
-char *lw_expr_print(lw_expr_t E)
+/* the result stays valid until the next print in the same context */
+char *lw_expr_print_ctx(lw_expr_ctx_t *ctx, lw_expr_t E)
 {
-	static char *obuf = NULL;
-	static int obufsize = 0;
-
 	int obufloc = 0;
 
-	lw_expr_print_aux(E, &obuf, &obufsize, &obufloc);
+	lw_expr_print_aux(ctx, E, &(ctx -> printbuf), &(ctx -> printbufsize), &obufloc);
 
-	return obuf;
+	return ctx -> printbuf;
+}
+
+char *lw_expr_print(lw_expr_t E)
+{
+	return lw_expr_print_ctx(&lw_expr_default_ctx, E);
 }
 
 /*
@@ -549,9 +674,9 @@ int lw_expr_contains(lw_expr_t E, lw_expr_t E1)
 	return 0;
 }
 
-void lw_expr_simplify_l(lw_expr_t E, void *priv);
+static void lw_expr_simplify_l(lw_expr_ctx_t *ctx, lw_expr_t E, void *priv);
 
-void lw_expr_simplify_go(lw_expr_t E, void *priv)
+static void lw_expr_simplify_go(lw_expr_ctx_t *ctx, lw_expr_t E, void *priv)
 {
 	struct lw_expr_opers *o;
 
@@ -563,10 +688,10 @@ void lw_expr_simplify_go(lw_expr_t E, void *priv)
 		{
 			lw_expr_t e1, e2;
 			
-			e2 = lw_expr_build(lw_expr_type_int, -1);
-			e1 = lw_expr_build(lw_expr_type_oper, lw_expr_oper_times, e2, o -> p);
-			lw_expr_destroy(o -> p);
-			lw_expr_destroy(e2);
+			e2 = lw_expr_build_ctx(ctx, lw_expr_type_int, -1);
+			e1 = lw_expr_build_ctx(ctx, lw_expr_type_oper, lw_expr_oper_times, e2, o -> p);
+			lw_expr_destroy_ctx(ctx, o -> p);
+			lw_expr_destroy_ctx(ctx, e2);
 			o -> p = e1;
 		}
 		E -> value = lw_expr_oper_plus;
@@ -578,69 +703,69 @@ void lw_expr_simplify_go(lw_expr_t E, void *priv)
 		lw_expr_t e1;
 		
 		E -> value = lw_expr_oper_times;
-		e1 = lw_expr_build(lw_expr_type_int, -1);
-		lw_expr_add_operand(E, e1);
-		lw_expr_destroy(e1);
+		e1 = lw_expr_build_ctx(ctx, lw_expr_type_int, -1);
+		lw_expr_add_operand_ctx(ctx, E, e1);
+		lw_expr_destroy_ctx(ctx, e1);
 	}
 	
 again:
 	// try to resolve non-constant terms to constants here
-	if (E -> type == lw_expr_type_special && evaluate_special)
+	if (E -> type == lw_expr_type_special && ctx -> evaluate_special)
 	{
 		lw_expr_t te;
 		
-		te = evaluate_special(E -> value, E -> value2, priv);
+		te = ctx -> evaluate_special(E -> value, E -> value2, priv);
 		if (lw_expr_contains(te, E))
-			lw_expr_destroy(te);
+			lw_expr_destroy_ctx(ctx, te);
 		else if (te)
 		{
 			for (o = E -> operands; o; o = o -> next)
-				lw_expr_destroy(o -> p);
+				lw_expr_destroy_ctx(ctx, o -> p);
 			if (E -> type == lw_expr_type_var)
-				lw_free(E -> value2);
+				ctx -> free(E -> value2);
 			*E = *te;
 			E -> operands = NULL;
 	
 			if (te -> type == lw_expr_type_var)
-				E -> value2 = lw_strdup(te -> value2);
+				E -> value2 = lw_expr_strdup(ctx, te -> value2);
 			for (o = te -> operands; o; o = o -> next)
 			{
 				lw_expr_t xxx;
-				xxx = lw_expr_copy(o -> p);
-				lw_expr_add_operand(E, xxx);
-				lw_expr_destroy(xxx);
+				xxx = lw_expr_copy_ctx(ctx, o -> p);
+				lw_expr_add_operand_ctx(ctx, E, xxx);
+				lw_expr_destroy_ctx(ctx, xxx);
 			}
-			lw_expr_destroy(te);
+			lw_expr_destroy_ctx(ctx, te);
 			goto again;
 		}
 		return;
 	}
 
-	if (E -> type == lw_expr_type_var && evaluate_var)
+	if (E -> type == lw_expr_type_var && ctx -> evaluate_var)
 	{
 		lw_expr_t te;
 		
-		te = evaluate_var(E -> value2, priv);
+		te = ctx -> evaluate_var(E -> value2, priv);
 		if (!te)
 			return;
 		if (lw_expr_contains(te, E))
-			lw_expr_destroy(te);
+			lw_expr_destroy_ctx(ctx, te);
 		else if (te)
 		{
 			for (o = E -> operands; o; o = o -> next)
-				lw_expr_destroy(o -> p);
+				lw_expr_destroy_ctx(ctx, o -> p);
 			if (E -> type == lw_expr_type_var)
-				lw_free(E -> value2);
+				ctx -> free(E -> value2);
 			*E = *te;
 			E -> operands = NULL;
 	
 			if (te -> type == lw_expr_type_var)
-				E -> value2 = lw_strdup(te -> value2);
+				E -> value2 = lw_expr_strdup(ctx, te -> value2);
 			for (o = te -> operands; o; o = o -> next)
 			{
-				lw_expr_add_operand(E, lw_expr_copy(o -> p));
+				lw_expr_add_operand_ctx(ctx, E, lw_expr_copy_ctx(ctx, o -> p));
 			}
-			lw_expr_destroy(te);
+			lw_expr_destroy_ctx(ctx, te);
 			goto again;
 		}
 		return;
@@ -671,8 +796,8 @@ again:
 					/* do nothing */ ;
 				o2 -> next = o -> next;
 				o -> p -> operands = NULL;
-				lw_expr_destroy(o -> p);
-				lw_free(o);
+				lw_expr_destroy_ctx(ctx, o -> p);
+				ctx -> free(o);
 				goto tryagainplus;
 			}
 		}
@@ -699,8 +824,8 @@ again:
 					/* do nothing */ ;
 				o2 -> next = o -> next;
 				o -> p -> operands = NULL;
-				lw_expr_destroy(o -> p);
-				lw_free(o);
+				lw_expr_destroy_ctx(ctx, o -> p);
+				ctx -> free(o);
 				goto tryagaintimes;
 			}
 		}
@@ -709,7 +834,7 @@ again:
 	// simplify operands
 	for (o = E -> operands; o; o = o -> next)
 		if (o -> p -> type != lw_expr_type_int)
-			lw_expr_simplify_l(o -> p, priv);
+			lw_expr_simplify_l(ctx, o -> p, priv);
 
 	for (o = E -> operands; o; o = o -> next)
 	{
@@ -758,7 +883,7 @@ again:
 			if (E -> operands -> next -> p -> value == 0)
 			{
 				tr = 0;
-				lw_expr_divzero(priv);
+				lw_expr_divzero(ctx, priv);
 				break;
 			}
 			tr = E -> operands -> p -> value / E -> operands -> next -> p -> value;
@@ -768,7 +893,7 @@ again:
 			if (E -> operands -> next -> p -> value == 0)
 			{
 				tr = 0;
-				lw_expr_divzero(priv);
+				lw_expr_divzero(ctx, priv);
 				break;
 			}
 			tr = E -> operands -> p -> value % E -> operands -> next -> p -> value;
@@ -778,7 +903,7 @@ again:
 			if (E -> operands -> next -> p -> value == 0)
 			{
 				tr = 0;
-				lw_expr_divzero(priv);
+				lw_expr_divzero(ctx, priv);
 				break;
 			}
 			tr = E -> operands -> p -> value / E -> operands -> next -> p -> value;
@@ -810,8 +935,8 @@ again:
 		{
 			o = E -> operands;
 			E -> operands = o -> next;
-			lw_expr_destroy(o -> p);
-			lw_free(o);
+			lw_expr_destroy_ctx(ctx, o -> p);
+			ctx -> free(o);
 		}
 		E -> type = lw_expr_type_int;
 		E -> value = tr;
@@ -823,7 +948,7 @@ again:
 		lw_expr_t e1;
 		int cval = 0;
 		
-		e1 = lw_expr_create();
+		e1 = lw_expr_create_ctx(ctx);
 		e1 -> operands = E -> operands;
 		E -> operands = 0;
 		
@@ -832,14 +957,14 @@ again:
 			if (o -> p -> type == lw_expr_type_int)
 				cval += o -> p -> value;
 			else
-				lw_expr_add_operand(E, o -> p);
+				lw_expr_add_operand_ctx(ctx, E, o -> p);
 		}
-		lw_expr_destroy(e1);
+		lw_expr_destroy_ctx(ctx, e1);
 		if (cval)
 		{
-			e1 = lw_expr_build(lw_expr_type_int, cval);
-			lw_expr_add_operand(E, e1);
-			lw_expr_destroy(e1);
+			e1 = lw_expr_build_ctx(ctx, lw_expr_type_int, cval);
+			lw_expr_add_operand_ctx(ctx, E, e1);
+			lw_expr_destroy_ctx(ctx, e1);
 		}
 	}
 
@@ -848,7 +973,7 @@ again:
 		lw_expr_t e1;
 		int cval = 1;
 		
-		e1 = lw_expr_create();
+		e1 = lw_expr_create_ctx(ctx);
 		e1 -> operands = E -> operands;
 		E -> operands = 0;
 		
@@ -857,14 +982,14 @@ again:
 			if (o -> p -> type == lw_expr_type_int)
 				cval *= o -> p -> value;
 			else
-				lw_expr_add_operand(E, o -> p);
+				lw_expr_add_operand_ctx(ctx, E, o -> p);
 		}
-		lw_expr_destroy(e1);
+		lw_expr_destroy_ctx(ctx, e1);
 		if (cval != 1)
 		{
-			e1 = lw_expr_build(lw_expr_type_int, cval);
-			lw_expr_add_operand(E, e1);
-			lw_expr_destroy(e1);
+			e1 = lw_expr_build_ctx(ctx, lw_expr_type_int, cval);
+			lw_expr_add_operand_ctx(ctx, E, e1);
+			lw_expr_destroy_ctx(ctx, e1);
 		}
 	}
 
@@ -879,8 +1004,8 @@ again:
 				{
 					o = E -> operands;
 					E -> operands = o -> next;
-					lw_expr_destroy(o -> p);
-					lw_free(o);
+					lw_expr_destroy_ctx(ctx, o -> p);
+					ctx -> free(o);
 				}
 				E -> type = lw_expr_type_int;
 				E -> value = 0;
@@ -937,16 +1062,16 @@ again:
 					else
 						coef2 = 1;
 					coef += coef2;
-					e1 = lw_expr_create();
+					e1 = lw_expr_create_ctx(ctx);
 					e1 -> type = lw_expr_type_oper;
 					e1 -> value = lw_expr_oper_times;
 					if (coef != 1)
 					{
-						e2 = lw_expr_build(lw_expr_type_int, coef);
-						lw_expr_add_operand(e1, e2);
-						lw_expr_destroy(e2);
+						e2 = lw_expr_build_ctx(ctx, lw_expr_type_int, coef);
+						lw_expr_add_operand_ctx(ctx, e1, e2);
+						lw_expr_destroy_ctx(ctx, e2);
 					}
-					lw_expr_destroy(o -> p);
+					lw_expr_destroy_ctx(ctx, o -> p);
 					o -> p = e1;
 					if (o2 -> p -> type == lw_expr_type_oper)
 					{
@@ -954,15 +1079,15 @@ again:
 						{
 							if (o -> p -> type == lw_expr_type_int)
 								continue;
-							lw_expr_add_operand(e1, o -> p);
+							lw_expr_add_operand_ctx(ctx, e1, o -> p);
 						}
 					}
 					else
 					{
-						lw_expr_add_operand(e1, o2 -> p);
+						lw_expr_add_operand_ctx(ctx, e1, o2 -> p);
 					}
-					lw_expr_destroy(o2 -> p);
-					o2 -> p = lw_expr_build(lw_expr_type_int, 0);
+					lw_expr_destroy_ctx(ctx, o2 -> p);
+					o2 -> p = lw_expr_build_ctx(ctx, lw_expr_type_int, 0);
 					goto again;
 				}
 			}
@@ -990,14 +1115,14 @@ again:
 				o = E -> operands;
 				if (o -> p -> type != lw_expr_type_int || o -> p -> value != 0)
 				{
-					r = lw_expr_copy(o -> p);
+					r = lw_expr_copy_ctx(ctx, o -> p);
 				}
 				E -> operands = o -> next;
-				lw_expr_destroy(o -> p);
-				lw_free(o);
+				lw_expr_destroy_ctx(ctx, o -> p);
+				ctx -> free(o);
 			}
 			*E = *r;
-			lw_free(r);
+			ctx -> free(r);
 			return;
 		}
 		else if (c == 0)
@@ -1007,8 +1132,8 @@ again:
 			{
 				o = E -> operands;
 				E -> operands = o -> next;
-				lw_expr_destroy(o -> p);
-				lw_free(o);
+				lw_expr_destroy_ctx(ctx, o -> p);
+				ctx -> free(o);
 			}
 			E -> type = lw_expr_type_int;
 			E -> value = 0;
@@ -1026,8 +1151,8 @@ again:
 					if (o == E -> operands)
 					{
 						E -> operands = o -> next;
-						lw_expr_destroy(o -> p);
-						lw_free(o);
+						lw_expr_destroy_ctx(ctx, o -> p);
+						ctx -> free(o);
 						o = E -> operands;
 					}
 					else
@@ -1035,8 +1160,8 @@ again:
 						for (o2 = E -> operands; o2 -> next == o; o2 = o2 -> next)
 							/* do nothing */ ;
 						o2 -> next = o -> next;
-						lw_expr_destroy(o -> p);
-						lw_free(o);
+						lw_expr_destroy_ctx(ctx, o -> p);
+						ctx -> free(o);
 						o = o2;
 					}
 				}
@@ -1060,20 +1185,20 @@ again:
 				E3 = E -> operands -> p;
 				if (E2 -> type == lw_expr_type_oper && E2 -> value == lw_expr_oper_plus)
 				{
-					lw_free(E -> operands -> next);
-					lw_free(E -> operands);
+					ctx -> free(E -> operands -> next);
+					ctx -> free(E -> operands);
 					E -> operands = NULL;
 					E -> value = lw_expr_oper_plus;
 					
 					for (o = E2 -> operands; o; o = o -> next)
 					{
-						t1 = lw_expr_build(lw_expr_type_oper, lw_expr_oper_times, E3, o -> p);
-						lw_expr_add_operand(E, t1);
-						lw_expr_destroy(t1);
+						t1 = lw_expr_build_ctx(ctx, lw_expr_type_oper, lw_expr_oper_times, E3, o -> p);
+						lw_expr_add_operand_ctx(ctx, E, t1);
+						lw_expr_destroy_ctx(ctx, t1);
 					}
 					
-					lw_expr_destroy(E2);
-					lw_expr_destroy(E3);
+					lw_expr_destroy_ctx(ctx, E2);
+					lw_expr_destroy_ctx(ctx, E3);
 				}
 			}
 			else if (E -> operands -> next -> p -> type == lw_expr_type_int)
@@ -1083,58 +1208,63 @@ again:
 				E3 = E -> operands -> next -> p;
 				if (E2 -> type == lw_expr_type_oper && E2 -> value == lw_expr_oper_plus)
 				{
-					lw_free(E -> operands -> next);
-					lw_free(E -> operands);
+					ctx -> free(E -> operands -> next);
+					ctx -> free(E -> operands);
 					E -> operands = NULL;
 					E -> value = lw_expr_oper_plus;
 					
 					for (o = E2 -> operands; o; o = o -> next)
 					{
-						t1 = lw_expr_build(lw_expr_type_oper, lw_expr_oper_times, E3, o -> p);
-						lw_expr_add_operand(E, t1);
+						t1 = lw_expr_build_ctx(ctx, lw_expr_type_oper, lw_expr_oper_times, E3, o -> p);
+						lw_expr_add_operand_ctx(ctx, E, t1);
 					}
 					
-					lw_expr_destroy(E2);
-					lw_expr_destroy(E3);
+					lw_expr_destroy_ctx(ctx, E2);
+					lw_expr_destroy_ctx(ctx, E3);
 				}
 			}
 		}
 	}
 }
 
-void lw_expr_simplify_l(lw_expr_t E, void *priv)
+static void lw_expr_simplify_l(lw_expr_ctx_t *ctx, lw_expr_t E, void *priv)
 {
 	lw_expr_t te;
 	int c;
 	
-	(level)++;
+	(ctx -> level)++;
 	// bail out if the level gets too deep
-	if (level >= 500 || bailing)
+	if (ctx -> level >= 500 || ctx -> bailing)
 	{
-		bailing = 1;
-		level--;
-		if (level == 0)
-			bailing = 0;
+		ctx -> bailing = 1;
+		ctx -> level--;
+		if (ctx -> level == 0)
+			ctx -> bailing = 0;
 		return;
 	}
 	do
 	{
-		te = lw_expr_copy(E);
-		lw_expr_simplify_go(E, priv);
+		te = lw_expr_copy_ctx(ctx, E);
+		lw_expr_simplify_go(ctx, E, priv);
 		c = 0;
 		if (lw_expr_compare(te, E) == 0)
 			c = 1;
-		lw_expr_destroy(te);
+		lw_expr_destroy_ctx(ctx, te);
 	}
 	while (c);
-	(level)--;
+	(ctx -> level)--;
 }
 
-void lw_expr_simplify(lw_expr_t E, void *priv)
+void lw_expr_simplify_ctx(lw_expr_ctx_t *ctx, lw_expr_t E, void *priv)
 {
 	if (E -> type == lw_expr_type_int)
 		return;
-	lw_expr_simplify_l(E, priv);
+	lw_expr_simplify_l(ctx, E, priv);
+}
+
+void lw_expr_simplify(lw_expr_t E, void *priv)
+{
+	lw_expr_simplify_ctx(&lw_expr_default_ctx, E, priv);
 }
 
 /*
@@ -1163,22 +1293,22 @@ error.
 
 */
 
-lw_expr_t lw_expr_parse_expr(char **p, void *priv, int prec);
+static lw_expr_t lw_expr_parse_expr(lw_expr_ctx_t *ctx, char **p, void *priv, int prec);
 
-static void lw_expr_parse_next_tok(char **p)
+static void lw_expr_parse_next_tok(lw_expr_ctx_t *ctx, char **p)
 {
-	if (parse_compact)
+	if (ctx -> parse_compact)
 		return;
 	for (; **p && isspace(**p); (*p)++)
 		/* do nothing */ ;
 }
 
-lw_expr_t lw_expr_parse_term(char **p, void *priv)
+static lw_expr_t lw_expr_parse_term(lw_expr_ctx_t *ctx, char **p, void *priv)
 {
 	lw_expr_t term, term2;
 	
 eval_next:
-	lw_expr_parse_next_tok(p);
+	lw_expr_parse_next_tok(ctx, p);
 
 	if (!**p || isspace(**p) || **p == ')' || **p == ']')
 		return NULL;
@@ -1186,11 +1316,11 @@ eval_next:
 	if (**p == '(')
 	{
 		(*p)++;
-		term = lw_expr_parse_expr(p, priv, 0);
-		lw_expr_parse_next_tok(p);
+		term = lw_expr_parse_expr(ctx, p, priv, 0);
+		lw_expr_parse_next_tok(ctx, p);
 		if (**p != ')')
 		{
-			lw_expr_destroy(term);
+			lw_expr_destroy_ctx(ctx, term);
 			return NULL;
 		}
 		(*p)++;
@@ -1208,12 +1338,12 @@ eval_next:
 	if (**p == '-')
 	{
 		(*p)++;
-		term = lw_expr_parse_expr(p, priv, 200);
+		term = lw_expr_parse_expr(ctx, p, priv, 200);
 		if (!term)
 			return NULL;
 		
-		term2 = lw_expr_build(lw_expr_type_oper, lw_expr_oper_neg, term);
-		lw_expr_destroy(term);
+		term2 = lw_expr_build_ctx(ctx, lw_expr_type_oper, lw_expr_oper_neg, term);
+		lw_expr_destroy_ctx(ctx, term);
 		return term2;
 	}
 	
@@ -1221,23 +1351,23 @@ eval_next:
 	if (**p == '^' || **p == '~')
 	{
 		(*p)++;
-		term = lw_expr_parse_expr(p, priv, 200);
+		term = lw_expr_parse_expr(ctx, p, priv, 200);
 		if (!term)
 			return NULL;
 		
-		if (expr_width == 8)
-			term2 = lw_expr_build(lw_expr_type_oper, lw_expr_oper_com8, term);
+		if (ctx -> width == 8)
+			term2 = lw_expr_build_ctx(ctx, lw_expr_type_oper, lw_expr_oper_com8, term);
 		else
-			term2 = lw_expr_build(lw_expr_type_oper, lw_expr_oper_com, term);
-		lw_expr_destroy(term);
+			term2 = lw_expr_build_ctx(ctx, lw_expr_type_oper, lw_expr_oper_com, term);
+		lw_expr_destroy_ctx(ctx, term);
 		return term2;
 	}
 	
 	// non-operator - pass to caller
-	return parse_term(p, priv);
+	return ctx -> parse_term(p, priv);
 }
 
-lw_expr_t lw_expr_parse_expr(char **p, void *priv, int prec)
+static lw_expr_t lw_expr_parse_expr(lw_expr_ctx_t *ctx, char **p, void *priv, int prec)
 {
 	static const struct operinfo
 	{
@@ -1267,16 +1397,16 @@ lw_expr_t lw_expr_parse_expr(char **p, void *priv, int prec)
 	int opern, i;
 	lw_expr_t term1, term2, term3;
 	
-	lw_expr_parse_next_tok(p);
+	lw_expr_parse_next_tok(ctx, p);
 	if (!**p || isspace(**p) || **p == ')' || **p == ',' || **p == ']' || **p == ';')
 		return NULL;
 
-	term1 = lw_expr_parse_term(p, priv);
+	term1 = lw_expr_parse_term(ctx, p, priv);
 	if (!term1)
 		return NULL;
 
 eval_next:
-	lw_expr_parse_next_tok(p);
+	lw_expr_parse_next_tok(ctx, p);
 	if (!**p || isspace(**p) || **p == ')' || **p == ',' || **p == ']' || **p == ';')
 		return term1;
 	
@@ -1292,7 +1422,7 @@ eval_next:
 	if (operators[opern].opernum == lw_expr_oper_none)
 	{
 		// unrecognized operator
-		lw_expr_destroy(term1);
+		lw_expr_destroy_ctx(ctx, term1);
 		return NULL;
 	}
 
@@ -1313,17 +1443,17 @@ eval_next:
 	(*p) += i;
 	
 	// evaluate next expression(s) of higher precedence
-	term2 = lw_expr_parse_expr(p, priv, operators[opern].operprec);
+	term2 = lw_expr_parse_expr(ctx, p, priv, operators[opern].operprec);
 	if (!term2)
 	{
-		lw_expr_destroy(term1);
+		lw_expr_destroy_ctx(ctx, term1);
 		return NULL;
 	}
 	
 	// now create operator
-	term3 = lw_expr_build(lw_expr_type_oper, operators[opern].opernum, term1, term2);
-	lw_expr_destroy(term1);
-	lw_expr_destroy(term2);
+	term3 = lw_expr_build_ctx(ctx, lw_expr_type_oper, operators[opern].opernum, term1, term2);
+	lw_expr_destroy_ctx(ctx, term1);
+	lw_expr_destroy_ctx(ctx, term2);
 	
 	// the new "expression" is the next "left operand"
 	term1 = term3;
@@ -1332,16 +1462,26 @@ eval_next:
 	goto eval_next;
 }
 
+lw_expr_t lw_expr_parse_ctx(lw_expr_ctx_t *ctx, char **p, void *priv)
+{
+	ctx -> parse_compact = 0;
+	return lw_expr_parse_expr(ctx, p, priv, 0);
+}
+
+lw_expr_t lw_expr_parse_compact_ctx(lw_expr_ctx_t *ctx, char **p, void *priv)
+{
+	ctx -> parse_compact = 1;
+	return lw_expr_parse_expr(ctx, p, priv, 0);
+}
+
 lw_expr_t lw_expr_parse(char **p, void *priv)
 {
-	parse_compact = 0;
-	return lw_expr_parse_expr(p, priv, 0);
+	return lw_expr_parse_ctx(&lw_expr_default_ctx, p, priv);
 }
 
 lw_expr_t lw_expr_parse_compact(char **p, void *priv)
 {
-	parse_compact = 1;
-	return lw_expr_parse_expr(p, priv, 0);
+	return lw_expr_parse_compact_ctx(&lw_expr_default_ctx, p, priv);
 }
 	
 
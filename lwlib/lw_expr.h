@@ -76,7 +76,37 @@ typedef lw_expr_t lw_expr_fn2_t(char *var, void *priv);
 typedef lw_expr_t lw_expr_fn3_t(char **p, void *priv);
 typedef int lw_expr_testfn_t(lw_expr_t e, void *priv);
 
-lw_expr_t lwexpr_create(void);
+/*
+An evaluation context holds the handlers, settings, allocator, and working
+state used by the functions taking one. Contexts are independent of each
+other, so each thread can use its own. Expressions must be destroyed with
+the context that created them, and handlers must build any expressions
+they return with it too. The functions without a context all share one
+default context and are not reentrant.
+*/
+typedef struct lw_expr_ctx_s lw_expr_ctx_t;
+
+lw_expr_ctx_t *lw_expr_ctx_create(void);
+void lw_expr_ctx_destroy(lw_expr_ctx_t *ctx);
+// must be set before any expression is created with the context
+void lw_expr_ctx_set_allocator(lw_expr_ctx_t *ctx, void *(*alloc)(int size), void *(*realloc)(void *ptr, int size), void (*free)(void *ptr));
+void lw_expr_ctx_set_special_handler(lw_expr_ctx_t *ctx, lw_expr_fn_t *fn);
+void lw_expr_ctx_set_var_handler(lw_expr_ctx_t *ctx, lw_expr_fn2_t *fn);
+void lw_expr_ctx_set_term_parser(lw_expr_ctx_t *ctx, lw_expr_fn3_t *fn);
+void lw_expr_ctx_setwidth(lw_expr_ctx_t *ctx, int w);
+void lw_expr_ctx_setdivzero(lw_expr_ctx_t *ctx, void (*fn)(void *priv));
+
+lw_expr_t lw_expr_create_ctx(lw_expr_ctx_t *ctx);
+void lw_expr_destroy_ctx(lw_expr_ctx_t *ctx, lw_expr_t E);
+lw_expr_t lw_expr_copy_ctx(lw_expr_ctx_t *ctx, lw_expr_t E);
+void lw_expr_add_operand_ctx(lw_expr_ctx_t *ctx, lw_expr_t E, lw_expr_t O);
+lw_expr_t lw_expr_build_ctx(lw_expr_ctx_t *ctx, int exprtype, ...);
+char *lw_expr_print_ctx(lw_expr_ctx_t *ctx, lw_expr_t E);
+void lw_expr_simplify_ctx(lw_expr_ctx_t *ctx, lw_expr_t E, void *priv);
+lw_expr_t lw_expr_parse_ctx(lw_expr_ctx_t *ctx, char **p, void *priv);
+lw_expr_t lw_expr_parse_compact_ctx(lw_expr_ctx_t *ctx, char **p, void *priv);
+
+lw_expr_t lw_expr_create(void);
 void lw_expr_destroy(lw_expr_t E);
 lw_expr_t lw_expr_copy(lw_expr_t E);
 void lw_expr_add_operand(lw_expr_t E, lw_expr_t O);
@@ -26,46 +26,105 @@ this program. If not, see <http://www.gnu.org/licenses/>.
 #include "lw_string.h"
 #include "lw_strpool.h"
 
+/*
+Strings are kept in a hash table so interning a string costs one hash
+and usually one comparison. Each string is stored once, in the same
+allocation as its hash table entry, so identical strings interned in
+the same pool can be compared by pointer.
+*/
+
+#define LW_STRPOOL_INITSIZE 256
+
+static unsigned int lw_strpool_hash(const char *s)
+{
+	unsigned int h = 2166136261U;
+
+	while (*s)
+	{
+		h ^= (unsigned char)*s++;
+		h *= 16777619U;
+	}
+	return h;
+}
+
 struct lw_strpool *lw_strpool_create(void)
 {
 	struct lw_strpool *sp;
 	
 	sp = lw_alloc(sizeof(struct lw_strpool));
 	sp -> nstrs = 0;
-	sp -> strs = NULL;
+	sp -> size = LW_STRPOOL_INITSIZE;
+	sp -> buckets = lw_alloc(sizeof(struct lw_strpool_e *) * sp -> size);
+	memset(sp -> buckets, 0, sizeof(struct lw_strpool_e *) * sp -> size);
 	return sp;
 }
 
 extern void lw_strpool_free(struct lw_strpool *sp)
 {
+	struct lw_strpool_e *e, *n;
 	int i;
 	
-	for (i = 0; i < sp -> nstrs; i++)
-		lw_free(sp -> strs[i]);
-	lw_free(sp -> strs);
+	for (i = 0; i < sp -> size; i++)
+	{
+		for (e = sp -> buckets[i]; e; e = n)
+		{
+			n = e -> next;
+			lw_free(e);
+		}
+	}
+	lw_free(sp -> buckets);
 	lw_free(sp);
 }
 
+static void lw_strpool_grow(struct lw_strpool *sp)
+{
+	struct lw_strpool_e **nb, *e, *n;
+	int i, nsize;
+
+	nsize = sp -> size * 2;
+	nb = lw_alloc(sizeof(struct lw_strpool_e *) * nsize);
+	memset(nb, 0, sizeof(struct lw_strpool_e *) * nsize);
+	for (i = 0; i < sp -> size; i++)
+	{
+		for (e = sp -> buckets[i]; e; e = n)
+		{
+			n = e -> next;
+			e -> next = nb[e -> hash & (nsize - 1)];
+			nb[e -> hash & (nsize - 1)] = e;
+		}
+	}
+	lw_free(sp -> buckets);
+	sp -> buckets = nb;
+	sp -> size = nsize;
+}
+
 char *lw_strpool_strdup(struct lw_strpool *sp, const char *s)
 {
-	int i;
+	struct lw_strpool_e *e, **b;
+	unsigned int h;
+	int l;
 	
 	if (!s)
 		return NULL;
 
-	/* first do a fast scan for a pointer match */	
-	for (i = 0; i < sp -> nstrs; i++)
-		if (sp -> strs[i] == s)
-			return sp -> strs[i];
-	
-	/* no match - do a slow scan for a string match */
-	for (i = 0; i < sp -> nstrs; i++)
-		if (strcmp(sp -> strs[i], s) == 0)
-			return sp -> strs[i];
+	h = lw_strpool_hash(s);
+	for (e = sp -> buckets[h & (sp -> size - 1)]; e; e = e -> next)
+	{
+		if (e -> str == s || (e -> hash == h && strcmp(e -> str, s) == 0))
+			return e -> str;
+	}
 	
 	/* no match - create a new string entry */
-	sp -> strs = lw_realloc(sp -> strs, sizeof(char *) * (sp -> nstrs + 1));
-	sp -> strs[sp -> nstrs] = lw_strdup(s);
+	if (sp -> nstrs >= sp -> size)
+		lw_strpool_grow(sp);
+	l = strlen(s);
+	e = lw_alloc(sizeof(struct lw_strpool_e) + l);
+	e -> hash = h;
+	e -> flags = 0;
+	memcpy(e -> str, s, l + 1);
+	b = &(sp -> buckets[h & (sp -> size - 1)]);
+	e -> next = *b;
+	*b = e;
 	sp -> nstrs++;
-	return sp -> strs[sp -> nstrs - 1];
+	return e -> str;
 }
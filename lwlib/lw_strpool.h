@@ -22,14 +22,28 @@ this program. If not, see <http://www.gnu.org/licenses/>.
 #ifndef ___lw_strpool_h_seen___
 #define ___lw_strpool_h_seen___
 
+#include <stddef.h>
+
+struct lw_strpool_e
+{
+	unsigned int hash;			// hash of the string
+	int flags;					// for use by whoever owns the pool
+	struct lw_strpool_e *next;	// next entry in the hash chain
+	char str[1];				// the string itself
+};
+
 struct lw_strpool
 {
-	int nstrs;
-	char **strs;
+	int nstrs;					// number of strings in the pool
+	int size;					// number of hash buckets (a power of 2)
+	struct lw_strpool_e **buckets;
 };
 
 extern struct lw_strpool *lw_strpool_create(void);
 extern void lw_strpool_free(struct lw_strpool *);
 extern char *lw_strpool_strdup(struct lw_strpool *, const char *);
 
+/* flags word of a string returned by lw_strpool_strdup() */
+#define lw_strpool_flags(s) (((struct lw_strpool_e *)((s) - offsetof(struct lw_strpool_e, str))) -> flags)
+
 #endif // ___lw_strpool_h_seen____
@@ -0,0 +1,783 @@
+/*
+cache.c
+Copyright © 2026 William Astle
+
+This file is part of LWLINK.
+
+LWLINK is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+Save and restore the resolved link state for incremental links
+
+The cache file sits next to the output file (with ".lwlc" appended) and
+records everything needed to rebuild the output without tracing symbols
+or placing sections again:
+
+- a hash of the link script and output format
+- every input file (and archive member) with a hash of its contents, its
+  "forced" state, and its sections
+- for each section: name, flags, size, placement, padding, local and
+  exported symbols, and the fully relocated section contents
+- the section list in output order
+
+On the next run, files whose contents hash the same are rebuilt straight
+from the cache without being parsed and their relocations are not redone.
+Files that changed are parsed and must have the same sections (names,
+flags, and sizes), the same exported symbols (names and offsets), and
+reference the same external symbols as before. Only their relocations are
+then resolved. Anything else falls back to a full link.
+
+All numbers are 32 bit big endian except hashes which are 64 bit. Strings
+are NUL terminated.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lw_alloc.h>
+#include <lw_string.h>
+
+#include "lwlink.h"
+
+#ifdef _MSC_VER
+#include <lw_win.h>	// windows build
+#endif
+
+#define CACHE_MAGIC		"LWLNKC1"
+
+extern void read_input_file(fileinfo_t *fn);
+extern void read_file(fileinfo_t *fn);
+extern struct section_list *sectlist_add(section_t *s);
+extern int resolve_changed_file(fileinfo_t *fn);
+extern unsigned long long profile_hash;
+
+// the input files in cache order (depth first, parents before subs)
+static fileinfo_t **cachefiles = NULL;
+static int ncachefiles = 0;
+
+// hash of the link script and options; taken before linking modifies them
+static unsigned long long options_hash;
+
+static unsigned long long hash_bytes(unsigned long long h, const void *data, long len)
+{
+	const unsigned char *p = data;
+
+	while (len-- > 0)
+	{
+		h ^= *p++;
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+static unsigned long long hash_int(unsigned long long h, int v)
+{
+	unsigned char b[4];
+
+	b[0] = v >> 24;
+	b[1] = v >> 16;
+	b[2] = v >> 8;
+	b[3] = v;
+	return hash_bytes(h, b, 4);
+}
+
+static unsigned long long hash_str(unsigned long long h, const char *s)
+{
+	if (!s)
+		return hash_int(h, -1);
+	return hash_bytes(h, s, strlen(s) + 1);
+}
+
+// hash everything that affects placement and output other than the files
+static unsigned long long hash_options(void)
+{
+	unsigned long long h = 0xcbf29ce484222325ULL;
+	sectopt_t *so;
+	int i;
+
+	h = hash_int(h, outformat);
+	h = hash_int(h, linkscript.nlines);
+	for (i = 0; i < linkscript.nlines; i++)
+	{
+		h = hash_str(h, linkscript.lines[i].sectname);
+		h = hash_int(h, linkscript.lines[i].loadat);
+		h = hash_int(h, linkscript.lines[i].noflags);
+		h = hash_int(h, linkscript.lines[i].yesflags);
+		h = hash_int(h, linkscript.lines[i].growsdown);
+	}
+	h = hash_int(h, linkscript.padsize);
+	h = hash_str(h, linkscript.execsym);
+	h = hash_int(h, linkscript.execaddr);
+	h = hash_int(h, linkscript.stacksize);
+	h = hash_str(h, linkscript.basesympat);
+	h = hash_str(h, linkscript.lensympat);
+	for (so = section_opts; so; so = so -> next)
+	{
+		h = hash_str(h, so -> name);
+		h = hash_int(h, so -> aftersize);
+		h = hash_bytes(h, so -> afterbytes, so -> aftersize);
+		h = hash_int(h, so -> keeporder);
+	}
+	// a profile changes the section order
+	h = hash_bytes(h, &profile_hash, sizeof(profile_hash));
+	h = hash_str(h, dp_section);
+	return h;
+}
+
+static char *cache_filename(void)
+{
+	char *fn;
+
+	fn = lw_alloc(strlen(outfile) + 6);
+	sprintf(fn, "%s.lwlc", outfile);
+	return fn;
+}
+
+/*
+Writing the cache
+*/
+static void put32(FILE *of, int v)
+{
+	fputc((v >> 24) & 0xff, of);
+	fputc((v >> 16) & 0xff, of);
+	fputc((v >> 8) & 0xff, of);
+	fputc(v & 0xff, of);
+}
+
+static void put64(FILE *of, unsigned long long v)
+{
+	put32(of, (int)(v >> 32));
+	put32(of, (int)(v & 0xffffffff));
+}
+
+static void putstr(FILE *of, const char *s)
+{
+	fwrite(s, 1, strlen(s) + 1, of);
+}
+
+static void putsyms(FILE *of, symtab_t *se)
+{
+	int n;
+	symtab_t *s;
+
+	for (n = 0, s = se; s; s = s -> next)
+		n++;
+	put32(of, n);
+	for (s = se; s; s = s -> next)
+	{
+		putstr(of, (char *)(s -> sym));
+		put32(of, s -> offset);
+	}
+}
+
+static void number_files(fileinfo_t *fn)
+{
+	int i;
+
+	cachefiles = lw_realloc(cachefiles, sizeof(fileinfo_t *) * (ncachefiles + 1));
+	fn -> cacheid = ncachefiles;
+	cachefiles[ncachefiles++] = fn;
+
+	for (i = 0; i < fn -> nsubs; i++)
+		number_files(fn -> subs[i]);
+}
+
+static int compare_names(const void *a, const void *b)
+{
+	return strcmp(*(char **)a, *(char **)b);
+}
+
+/*
+Hash the set of external symbols referenced by a file. Which files are pulled
+into the link depends only on these and the exported symbols so a changed
+file that references the same symbols cannot change that.
+*/
+static unsigned long long hash_refs(fileinfo_t *fn)
+{
+	unsigned long long h = 0xcbf29ce484222325ULL;
+	char **names = NULL;
+	int nnames = 0, i, sn;
+	reloc_t *rl;
+	lw_expr_stack_node_t *n;
+
+	for (sn = 0; sn < fn -> nsections; sn++)
+	{
+		for (rl = fn -> sections[sn].incompletes; rl; rl = rl -> next)
+		{
+			for (n = rl -> expr -> head; n; n = n -> next)
+			{
+				if (n -> term -> term_type != LW_TERM_SYM || n -> term -> value != 0)
+					continue;
+				names = lw_realloc(names, sizeof(char *) * (nnames + 1));
+				names[nnames++] = n -> term -> symbol;
+			}
+		}
+	}
+	if (nnames == 0)
+		return h;
+	qsort(names, nnames, sizeof(char *), compare_names);
+	for (i = 0; i < nnames; i++)
+	{
+		if (i > 0 && !strcmp(names[i], names[i - 1]))
+			continue;
+		h = hash_str(h, names[i]);
+	}
+	lw_free(names);
+	return h;
+}
+
+static void hash_file(fileinfo_t *fn)
+{
+	int i;
+
+	fn -> hash = hash_bytes(0xcbf29ce484222325ULL, fn -> filedata, fn -> filesize);
+	fn -> refhash = hash_refs(fn);
+	for (i = 0; i < fn -> nsubs; i++)
+		hash_file(fn -> subs[i]);
+}
+
+/*
+Record the content hashes of the input files. This must be done before
+any relocations are applied since those modify the file data in place.
+*/
+void hash_input_files(void)
+{
+	int i;
+
+	for (i = 0; i < ninputfiles; i++)
+		hash_file(inputfiles[i]);
+}
+
+/*
+This must be called after all references are resolved but before the
+section padding is added.
+*/
+void save_link_cache(void)
+{
+	FILE *of;
+	char *fn, *tfn;
+	int i, sn;
+	fileinfo_t *f;
+	section_t *s;
+
+	ncachefiles = 0;
+	for (i = 0; i < ninputfiles; i++)
+		number_files(inputfiles[i]);
+
+	fn = cache_filename();
+	tfn = lw_alloc(strlen(fn) + 5);
+	sprintf(tfn, "%s.tmp", fn);
+
+	of = fopen(tfn, "wb");
+	if (!of)
+	{
+		fprintf(stderr, "Warning: cannot write link cache %s\n", tfn);
+		lw_free(tfn);
+		lw_free(fn);
+		return;
+	}
+
+	fwrite(CACHE_MAGIC, 1, 8, of);
+	put64(of, options_hash);
+	put32(of, ninputfiles);
+	put32(of, ncachefiles);
+	for (i = 0; i < ncachefiles; i++)
+	{
+		f = cachefiles[i];
+		putstr(of, f -> filename);
+		put64(of, f -> hash);
+		put64(of, f -> refhash);
+		put32(of, f -> forced);
+		put32(of, f -> nsubs);
+		put32(of, f -> nsections);
+		for (sn = 0; sn < f -> nsections; sn++)
+		{
+			s = &(f -> sections[sn]);
+			putstr(of, (char *)(s -> name));
+			put32(of, s -> flags);
+			put32(of, s -> codesize);
+			put32(of, s -> processed);
+			put32(of, s -> loadaddress);
+			put32(of, s -> aftersize);
+			if (s -> aftersize)
+				fwrite(s -> afterbytes, 1, s -> aftersize, of);
+			putsyms(of, s -> localsyms);
+			putsyms(of, s -> exportedsyms);
+			// section contents are only needed for files in the link
+			if (f -> forced && !(s -> flags & SECTION_BSS))
+				fwrite(s -> code, 1, s -> codesize, of);
+		}
+	}
+	put32(of, nsects);
+	for (i = 0; i < nsects; i++)
+	{
+		s = sectlist[i].ptr;
+		put32(of, s -> file -> cacheid);
+		put32(of, s - s -> file -> sections);
+		put32(of, sectlist[i].forceaddr);
+	}
+
+	i = ferror(of);
+	if (fclose(of) != 0 || i)
+	{
+		fprintf(stderr, "Warning: cannot write link cache %s\n", tfn);
+		remove(tfn);
+	}
+	else
+	{
+		remove(fn);
+		if (rename(tfn, fn) != 0)
+		{
+			fprintf(stderr, "Warning: cannot write link cache %s\n", fn);
+			remove(tfn);
+		}
+	}
+	lw_free(tfn);
+	lw_free(fn);
+}
+
+/*
+Reading the cache
+
+The cache file is read into memory whole and the names and section
+contents of unchanged files point directly into that buffer, the same way
+the object file readers work.
+*/
+struct cachebuf
+{
+	unsigned char *data;
+	long size;
+	long pos;
+	int bad;
+};
+
+static int get32(struct cachebuf *cb)
+{
+	unsigned char *p;
+
+	if (cb -> pos + 4 > cb -> size)
+	{
+		cb -> bad = 1;
+		return 0;
+	}
+	p = cb -> data + cb -> pos;
+	cb -> pos += 4;
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static unsigned long long get64(struct cachebuf *cb)
+{
+	unsigned long long v;
+
+	v = (unsigned int)get32(cb);
+	v = (v << 32) | (unsigned int)get32(cb);
+	return v;
+}
+
+static unsigned char *getstr(struct cachebuf *cb)
+{
+	unsigned char *s;
+
+	s = cb -> data + cb -> pos;
+	while (cb -> pos < cb -> size && cb -> data[cb -> pos])
+		cb -> pos++;
+	if (cb -> pos >= cb -> size)
+	{
+		cb -> bad = 1;
+		return (unsigned char *)"";
+	}
+	cb -> pos++;
+	return s;
+}
+
+static unsigned char *getbytes(struct cachebuf *cb, int len)
+{
+	unsigned char *s;
+
+	if (len < 0 || cb -> pos + len > cb -> size)
+	{
+		cb -> bad = 1;
+		return NULL;
+	}
+	s = cb -> data + cb -> pos;
+	cb -> pos += len;
+	return s;
+}
+
+static symtab_t *getsyms(struct cachebuf *cb)
+{
+	int n;
+	symtab_t *head = NULL, **tail = &head, *se;
+
+	n = get32(cb);
+	while (n-- > 0 && !cb -> bad)
+	{
+		se = lw_alloc(sizeof(symtab_t));
+		se -> sym = getstr(cb);
+		se -> offset = get32(cb);
+		se -> next = NULL;
+		*tail = se;
+		tail = &(se -> next);
+	}
+	return head;
+}
+
+static void freesyms(symtab_t *se)
+{
+	symtab_t *n;
+
+	for ( ; se; se = n)
+	{
+		n = se -> next;
+		lw_free(se);
+	}
+}
+
+static int samesyms(symtab_t *a, symtab_t *b)
+{
+	for ( ; a && b; a = a -> next, b = b -> next)
+	{
+		if (a -> offset != b -> offset || strcmp((char *)(a -> sym), (char *)(b -> sym)))
+			return 0;
+	}
+	return a == NULL && b == NULL;
+}
+
+// one file entry from the cache
+struct cachefile
+{
+	char *filename;
+	unsigned long long hash;
+	unsigned long long refhash;
+	int forced;
+	int nsubs;
+	int nsections;
+	section_t *sections;
+};
+
+static struct cachefile *cfiles = NULL;
+static int ncfiles = 0;
+
+static int read_cache(struct cachebuf *cb)
+{
+	FILE *f;
+	char *fn;
+	int ntop, i, sn;
+	section_t *s;
+
+	fn = cache_filename();
+	f = fopen(fn, "rb");
+	lw_free(fn);
+	if (!f)
+		return 0;
+	fseek(f, 0, SEEK_END);
+	cb -> size = ftell(f);
+	rewind(f);
+	cb -> data = lw_alloc(cb -> size + 1);
+	cb -> pos = 0;
+	cb -> bad = 0;
+	if (fread(cb -> data, 1, cb -> size, f) < cb -> size)
+		cb -> bad = 1;
+	fclose(f);
+
+	if (cb -> bad || cb -> size < 8 || memcmp(cb -> data, CACHE_MAGIC, 8))
+		return 0;
+	cb -> pos = 8;
+
+	if (get64(cb) != options_hash)
+	{
+		if (debug_level > 0)
+			fprintf(stderr, "Link script or format changed; doing a full link\n");
+		return 0;
+	}
+	ntop = get32(cb);
+	if (ntop != ninputfiles)
+		return 0;
+
+	ncfiles = get32(cb);
+	if (cb -> bad || ncfiles < ntop || ncfiles > cb -> size)
+		return 0;
+	cfiles = lw_alloc(sizeof(struct cachefile) * ncfiles);
+	for (i = 0; i < ncfiles && !cb -> bad; i++)
+	{
+		cfiles[i].filename = (char *)getstr(cb);
+		cfiles[i].hash = get64(cb);
+		cfiles[i].refhash = get64(cb);
+		cfiles[i].forced = get32(cb);
+		cfiles[i].nsubs = get32(cb);
+		cfiles[i].nsections = get32(cb);
+		if (cb -> bad || cfiles[i].nsections < 0 || cfiles[i].nsubs < 0 || cfiles[i].nsections > cb -> size)
+			return 0;
+		cfiles[i].sections = lw_alloc(sizeof(section_t) * (cfiles[i].nsections + 1));
+		for (sn = 0; sn < cfiles[i].nsections && !cb -> bad; sn++)
+		{
+			s = &(cfiles[i].sections[sn]);
+			memset(s, 0, sizeof(section_t));
+			s -> name = getstr(cb);
+			s -> flags = get32(cb);
+			s -> codesize = get32(cb);
+			s -> processed = get32(cb);
+			s -> loadaddress = get32(cb);
+			s -> aftersize = get32(cb);
+			if (s -> aftersize)
+				s -> afterbytes = getbytes(cb, s -> aftersize);
+			s -> localsyms = getsyms(cb);
+			s -> exportedsyms = getsyms(cb);
+			if (cfiles[i].forced && !(s -> flags & SECTION_BSS))
+				s -> code = getbytes(cb, s -> codesize);
+		}
+	}
+	return !cb -> bad;
+}
+
+/*
+Rebuild an unchanged file (and its subs) from the cache. Returns the index
+of the next cache entry.
+*/
+static int restore_file(fileinfo_t *fn, int ce)
+{
+	struct cachefile *cf = &(cfiles[ce]);
+	int i;
+
+	fn -> hash = cf -> hash;
+	fn -> refhash = cf -> refhash;
+	fn -> forced = cf -> forced;
+	fn -> sections = cf -> sections;
+	fn -> nsections = cf -> nsections;
+	for (i = 0; i < fn -> nsections; i++)
+		fn -> sections[i].file = fn;
+	fn -> cacheid = ce;
+	cachefiles[ce] = fn;
+
+	fn -> nsubs = cf -> nsubs;
+	fn -> subs = lw_alloc(sizeof(fileinfo_t *) * (fn -> nsubs + 1));
+	ce++;
+	for (i = 0; i < fn -> nsubs; i++)
+	{
+		if (ce >= ncfiles)
+			return -1;
+		fn -> subs[i] = lw_alloc(sizeof(fileinfo_t));
+		memset(fn -> subs[i], 0, sizeof(fileinfo_t));
+		fn -> subs[i] -> filename = cfiles[ce].filename;
+		fn -> subs[i] -> parent = fn;
+		ce = restore_file(fn -> subs[i], ce);
+		if (ce < 0)
+			return -1;
+	}
+	return ce;
+}
+
+/*
+Match a file that was parsed again against its cache entry. Parts that are
+unchanged get their relocated contents from the cache; parts that changed
+must keep the same layout and exports. Returns the index of the next cache
+entry or -1 if the cached state cannot be used.
+*/
+static int reconcile_file(fileinfo_t *fn, int ce, int *changed)
+{
+	struct cachefile *cf = &(cfiles[ce]);
+	section_t *s, *cs;
+	int i, same;
+
+	if (strcmp(fn -> filename, cf -> filename))
+		return -1;
+	if (fn -> nsections != cf -> nsections || fn -> nsubs != cf -> nsubs)
+		return -1;
+
+	fn -> hash = hash_bytes(0xcbf29ce484222325ULL, fn -> filedata, fn -> filesize);
+	same = (fn -> hash == cf -> hash);
+	fn -> refhash = hash_refs(fn);
+	if (cf -> forced && fn -> refhash != cf -> refhash)
+		return -1;
+	fn -> forced = cf -> forced;
+	fn -> cacheid = ce;
+	cachefiles[ce] = fn;
+
+	for (i = 0; i < fn -> nsections; i++)
+	{
+		s = &(fn -> sections[i]);
+		cs = &(cf -> sections[i]);
+		if (strcmp((char *)(s -> name), (char *)(cs -> name)) || s -> flags != cs -> flags || s -> codesize != cs -> codesize)
+			return -1;
+		if (!samesyms(s -> exportedsyms, cs -> exportedsyms))
+			return -1;
+		s -> processed = cs -> processed;
+		s -> loadaddress = cs -> loadaddress;
+		s -> aftersize = cs -> aftersize;
+		s -> afterbytes = cs -> afterbytes;
+		if (same && fn -> forced)
+		{
+			// already relocated last time
+			if (!(s -> flags & SECTION_BSS))
+				s -> code = cs -> code;
+			s -> incompletes = NULL;
+		}
+	}
+	if (!same && fn -> nsections > 0)
+	{
+		(*changed)++;
+		if (debug_level > 0)
+			fprintf(stderr, "Relinking changed file %s\n", fn -> filename);
+	}
+
+	ce++;
+	for (i = 0; i < fn -> nsubs; i++)
+	{
+		if (ce >= ncfiles)
+			return -1;
+		ce = reconcile_file(fn -> subs[i], ce, changed);
+		if (ce < 0)
+			return -1;
+	}
+	return ce;
+}
+
+// throw away any partially restored state so a full link can be done
+static void reset_link_state(void)
+{
+	int i;
+	fileinfo_t *fn;
+
+	for (i = 0; i < ninputfiles; i++)
+	{
+		fn = inputfiles[i];
+		if (fn -> filedata)
+			lw_free(fn -> filedata);
+		fn -> filedata = NULL;
+		fn -> filesize = 0;
+		fn -> sections = NULL;
+		fn -> nsections = 0;
+		fn -> subs = NULL;
+		fn -> nsubs = 0;
+		fn -> forced = fn -> islib ? 0 : 1;
+	}
+	nsects = 0;
+}
+
+/*
+Try to restore the link state from the cache. Returns nonzero if that
+worked, in which case the files have been read, all sections placed, and
+only the relocations in changed files remain to be resolved. Otherwise,
+nothing has been done and a full link is required.
+*/
+int incremental_link(void)
+{
+	struct cachebuf cb = { 0 };
+	int i, ce, n, changed = 0;
+
+	options_hash = hash_options();
+	if (!read_cache(&cb))
+	{
+		lw_free(cb.data);
+		return 0;
+	}
+
+	cachefiles = lw_alloc(sizeof(fileinfo_t *) * ncfiles);
+	memset(cachefiles, 0, sizeof(fileinfo_t *) * ncfiles);
+	ncachefiles = ncfiles;
+
+	for (ce = 0, i = 0; i < ninputfiles; i++)
+	{
+		if (ce >= ncfiles || strcmp(inputfiles[i] -> filename, cfiles[ce].filename))
+			goto fullink;
+		read_input_file(inputfiles[i]);
+		if (hash_bytes(0xcbf29ce484222325ULL, inputfiles[i] -> filedata, inputfiles[i] -> filesize) == cfiles[ce].hash)
+		{
+			// nothing changed; no need to parse it
+			lw_free(inputfiles[i] -> filedata);
+			inputfiles[i] -> filedata = NULL;
+			inputfiles[i] -> filesize = 0;
+			ce = restore_file(inputfiles[i], ce);
+		}
+		else
+		{
+			read_file(inputfiles[i]);
+			ce = reconcile_file(inputfiles[i], ce, &changed);
+		}
+		if (ce < 0)
+			goto fullink;
+	}
+	if (ce != ncfiles)
+		goto fullink;
+
+	// restore the section list
+	n = get32(&cb);
+	if (cb.bad || n < 0)
+		goto fullink;
+	for (i = 0; i < n; i++)
+	{
+		int fi, si, fa;
+
+		fi = get32(&cb);
+		si = get32(&cb);
+		fa = get32(&cb);
+		if (cb.bad || fi < 0 || fi >= ncfiles || si < 0 || si >= cachefiles[fi] -> nsections)
+			goto fullink;
+		sectlist_add(&(cachefiles[fi] -> sections[si])) -> forceaddr = fa;
+	}
+
+	// make sure the changed files do not pull in anything new
+	for (i = 0; i < ncfiles; i++)
+	{
+		fileinfo_t *fn = cachefiles[i];
+
+		if (!(fn -> filedata) || fn -> nsections == 0)
+			continue;
+		if (fn -> hash == cfiles[i].hash)
+			continue;
+		if (resolve_changed_file(fn))
+		{
+			if (debug_level > 0)
+				fprintf(stderr, "Changes in %s alter the link; doing a full link\n", fn -> filename);
+			goto fullink;
+		}
+	}
+
+	if (debug_level > 0)
+		fprintf(stderr, "Incremental link: %d changed file(s)\n", changed);
+
+	// symbols from the cached files are still referenced; only the per
+	// file bookkeeping can go
+	for (i = 0; i < ncfiles; i++)
+	{
+		if (cachefiles[i] -> sections != cfiles[i].sections)
+		{
+			int sn;
+			for (sn = 0; sn < cfiles[i].nsections; sn++)
+			{
+				freesyms(cfiles[i].sections[sn].localsyms);
+				freesyms(cfiles[i].sections[sn].exportedsyms);
+			}
+			lw_free(cfiles[i].sections);
+		}
+	}
+	lw_free(cfiles);
+	cfiles = NULL;
+	ncfiles = 0;
+	return 1;
+
+fullink:
+	if (debug_level > 0)
+		fprintf(stderr, "Link cache does not match; doing a full link\n");
+	reset_link_state();
+	lw_free(cfiles);
+	cfiles = NULL;
+	ncfiles = 0;
+	lw_free(cachefiles);
+	cachefiles = NULL;
+	ncachefiles = 0;
+	lw_free(cb.data);
+	return 0;
+}
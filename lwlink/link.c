@@ -38,9 +38,11 @@ Resolve section and symbol addresses; handle incomplete references
 #endif
 
 void check_os9(void);
+void profile_order(int first, int last, int down);
 
 struct section_list *sectlist = NULL;
 int nsects = 0;
+static int asects = 0;
 static int nforced = 0;
 static int resolveonly = 0;
 
@@ -50,95 +52,260 @@ symlist_t *symlist = NULL;
 
 sectopt_t *section_opts = NULL;
 
-void check_section_name(char *name, int *base, fileinfo_t *fn, int down)
+/*
+The section index maps each section name to every instance of that name
+in the input files, in the same order a depth first walk of the input
+files (sections first, then sub files) would find them. It also keeps
+the full list of instances in that order for the wildcard script lines.
+It is built once when placing sections so that each link script line
+does not have to rescan every input file.
+*/
+struct sectinst_s
 {
-	int sn;
-	sectopt_t *so;
+	section_t *ptr;				// the section instance
+	int linked;					// file (and all parents) are forced in
+	int toplevel;				// section is directly in an input file
+};
+
+typedef struct sectindex_s sectindex_t;
+struct sectindex_s
+{
+	char *name;					// the section name
+	int ninsts;					// number of instances
+	int ainsts;					// allocated instance slots
+	struct sectinst_s *insts;	// the instances, in file order
+	sectindex_t *next;			// next entry in the hash chain
+};
+
+static sectindex_t **sectindex = NULL;
+static int sectindex_size = 0;
+static struct sectinst_s *allsects = NULL;
+static int nallsects = 0;
+
+// add a section to the output list, growing the list as needed
+struct section_list *sectlist_add(section_t *s)
+{
+	if (nsects >= asects)
+	{
+		asects = asects ? asects * 2 : 16;
+		sectlist = lw_realloc(sectlist, sizeof(struct section_list) * asects);
+	}
+	sectlist[nsects].ptr = s;
+	sectlist[nsects].forceaddr = 0;
+	return &(sectlist[nsects++]);
+}
+
+static unsigned int sectindex_hash(char *name)
+{
+	unsigned int h = 5381;
 	
-	//fprintf(stderr, "Considering sections in %s (%d) for %s\n", fn -> filename, fn -> forced, name);
-	if (fn -> forced == 0)
-		return;
+	while (*name)
+		h = h * 33 + (unsigned char)*name++;
+	return h & (sectindex_size - 1);
+}
 
-	for (so = section_opts; so; so = so -> next)
-		if (!strcmp(so -> name, name))
-			break;
+static sectindex_t *sectindex_find(char *name)
+{
+	sectindex_t *e;
+	
+	for (e = sectindex[sectindex_hash(name)]; e; e = e -> next)
+		if (!strcmp(e -> name, name))
+			return e;
+	return NULL;
+}
+
+static int count_sections(fileinfo_t *fn)
+{
+	int sn, n;
+	
+	n = fn -> nsections;
+	for (sn = 0; sn < fn -> nsubs; sn++)
+		n += count_sections(fn -> subs[sn]);
+	return n;
+}
 
+static void index_sections(fileinfo_t *fn, int linked, int toplevel)
+{
+	int sn, h;
+	sectindex_t *e;
+	struct sectinst_s *si;
+	
+	linked = linked && fn -> forced;
 	for (sn = 0; sn < fn -> nsections; sn++)
 	{
-		//fprintf(stderr, "    Considering section %s\n", fn -> sections[sn].name);
-		if (!strcmp(name, (char *)(fn -> sections[sn].name)))
+		si = &(allsects[nallsects++]);
+		si -> ptr = &(fn -> sections[sn]);
+		si -> linked = linked;
+		si -> toplevel = toplevel;
+		
+		e = sectindex_find((char *)(fn -> sections[sn].name));
+		if (!e)
 		{
-			if (fn -> sections[sn].flags & SECTION_CONST)
-				continue;
-			// we have a match
-			//fprintf(stderr, "    Found\n");
-			sectlist = lw_realloc(sectlist, sizeof(struct section_list) * (nsects + 1));
-			sectlist[nsects].ptr = &(fn -> sections[sn]);
-			
-				
-			fn -> sections[sn].processed = 1;
-			if (down)
-			{
-				*base -= fn -> sections[sn].codesize;
-				fn -> sections[sn].loadaddress = *base;
-			}
-			else
-			{
-				fn -> sections[sn].loadaddress = *base;
-				*base += fn -> sections[sn].codesize;
-			}
-			if (down && so && so -> aftersize)
-			{
-				sectlist[nsects].ptr -> afterbytes = so -> afterbytes;
-				sectlist[nsects].ptr -> aftersize = so -> aftersize;
-				sectlist[nsects].ptr -> loadaddress -= so -> aftersize;
-				*base -= so -> aftersize;
-				so -> aftersize = 0;
-			}
-			nsects++;
-			//fprintf(stderr, "Adding section %s (%s) %p %d\n",fn -> sections[sn].name, fn -> filename, sectlist, nsects);
+			h = sectindex_hash((char *)(fn -> sections[sn].name));
+			e = lw_alloc(sizeof(sectindex_t));
+			e -> name = (char *)(fn -> sections[sn].name);
+			e -> ninsts = 0;
+			e -> ainsts = 0;
+			e -> insts = NULL;
+			e -> next = sectindex[h];
+			sectindex[h] = e;
+		}
+		if (e -> ninsts >= e -> ainsts)
+		{
+			e -> ainsts = e -> ainsts ? e -> ainsts * 2 : 4;
+			e -> insts = lw_realloc(e -> insts, sizeof(struct sectinst_s) * e -> ainsts);
 		}
+		e -> insts[e -> ninsts++] = *si;
 	}
 	for (sn = 0; sn < fn -> nsubs; sn++)
+		index_sections(fn -> subs[sn], linked, 0);
+}
+
+static void build_section_index(void)
+{
+	int fn, n = 0;
+	
+	for (fn = 0; fn < ninputfiles; fn++)
+		n += count_sections(inputfiles[fn]);
+
+	for (sectindex_size = 16; sectindex_size < n; sectindex_size *= 2)
+		/* do nothing */ ;
+	sectindex = lw_alloc(sizeof(sectindex_t *) * sectindex_size);
+	memset(sectindex, 0, sizeof(sectindex_t *) * sectindex_size);
+	allsects = lw_alloc(sizeof(struct sectinst_s) * (n + 1));
+	nallsects = 0;
+	
+	for (fn = 0; fn < ninputfiles; fn++)
+		index_sections(inputfiles[fn], 1, 1);
+
+	// every section can be placed at most once by the link script so
+	// size the output list for all of them up front
+	if (asects < n)
 	{
-		check_section_name(name, base, fn -> subs[sn], down);
+		asects = n;
+		sectlist = lw_realloc(sectlist, sizeof(struct section_list) * asects);
 	}
 }
 
-void add_matching_sections(char *name, int yesflags, int noflags, int *base, int down);
-void check_section_flags(int yesflags, int noflags, int *base, fileinfo_t *fn, int down)
+static void free_section_index(void)
+{
+	int i;
+	sectindex_t *e;
+	
+	for (i = 0; i < sectindex_size; i++)
+	{
+		while ((e = sectindex[i]))
+		{
+			sectindex[i] = e -> next;
+			lw_free(e -> insts);
+			lw_free(e);
+		}
+	}
+	lw_free(sectindex);
+	lw_free(allsects);
+	sectindex = NULL;
+	sectindex_size = 0;
+	allsects = NULL;
+	nallsects = 0;
+}
+
+static sectopt_t *find_section_opts(char *name)
 {
-	int sn;
 	sectopt_t *so;
+	
+	for (so = section_opts; so; so = so -> next)
+		if (!strcmp(so -> name, name))
+			break;
+	return so;
+}
 
-//	fprintf(stderr, "Considering sections in %s (%d) for %x/%x\n", fn -> filename, fn -> forced, yesflags, noflags);
+static int section_flags_match(section_t *s, int yesflags, int noflags)
+{
+	// ignore "constant" sections - they're added during the file resolve stage
+	if (s -> flags & SECTION_CONST)
+		return 0;
+	// ignore if the noflags tell us to
+	if (noflags && (s -> flags & noflags))
+		return 0;
+	// ignore unless the yesflags tell us not to
+	if (yesflags && ((s -> flags & yesflags) == 0))
+		return 0;
+	return 1;
+}
 
-	if (fn -> forced == 0)
+// look for all instances of a section by the specified name
+// and resolve base addresses and add to the list
+void check_section_name(char *name, int *base, int down)
+{
+	int i;
+	sectopt_t *so;
+	sectindex_t *e;
+	section_t *s;
+	
+	e = sectindex_find(name);
+	if (!e)
 		return;
+	
+	so = find_section_opts(name);
 
-	for (sn = 0; sn < fn -> nsections; sn++)
+	for (i = 0; i < e -> ninsts; i++)
 	{
-		// ignore "constant" sections - they're added during the file resolve stage
-		if (fn -> sections[sn].flags & SECTION_CONST)
+		if (!(e -> insts[i].linked))
 			continue;
-		// ignore if the noflags tell us to
-		if (noflags && (fn -> sections[sn].flags & noflags))
+		s = e -> insts[i].ptr;
+		if (s -> flags & SECTION_CONST)
+			continue;
+		// a previous script line already placed it
+		if (s -> processed)
+			continue;
+		// we have a match
+		sectlist_add(s);
+		
+		s -> processed = 1;
+		if (down)
+		{
+			*base -= s -> codesize;
+			s -> loadaddress = *base;
+		}
+		else
+		{
+			s -> loadaddress = *base;
+			*base += s -> codesize;
+		}
+		if (down && so && so -> aftersize)
+		{
+			s -> afterbytes = so -> afterbytes;
+			s -> aftersize = so -> aftersize;
+			s -> loadaddress -= so -> aftersize;
+			*base -= so -> aftersize;
+			so -> aftersize = 0;
+		}
+	}
+}
+
+void add_matching_sections(char *name, int yesflags, int noflags, int *base, int down);
+void check_section_flags(int yesflags, int noflags, int *base, int down)
+{
+	int i;
+	sectopt_t *so;
+	section_t *s;
+
+	for (i = 0; i < nallsects; i++)
+	{
+		if (!(allsects[i].linked))
 			continue;
-		// ignore unless the yesflags tell us not to
-		if (yesflags && ((fn -> sections[sn].flags & yesflags) == 0))
+		s = allsects[i].ptr;
+		if (!section_flags_match(s, yesflags, noflags))
 			continue;
 		// ignore it if already processed
-		if (fn -> sections[sn].processed)
+		if (s -> processed)
 			continue;
 
 		// we have a match - now collect *all* sections of the same name!
-//		fprintf(stderr, "    Found\n");
-		add_matching_sections((char *)(fn -> sections[sn].name), 0, 0, base, down);
+		add_matching_sections((char *)(s -> name), 0, 0, base, down);
 
 		/* handle "after padding" */
-		for (so = section_opts; so; so = so -> next)
-			if (!strcmp(so -> name, (char *)(fn -> sections[sn].name)))
-				break;
+		so = find_section_opts((char *)(s -> name));
 		if (so)
 		{
 			if (so -> aftersize)
@@ -159,37 +326,22 @@ void check_section_flags(int yesflags, int noflags, int *base, fileinfo_t *fn, i
 		
 		// and then continue looking for sections
 	}
-	for (sn = 0; sn < fn -> nsubs; sn++)
-	{
-		check_section_flags(yesflags, noflags, base, fn -> subs[sn], down);
-	}
 }
 
 
 
 void add_matching_sections(char *name, int yesflags, int noflags, int *base, int down)
 {
-	int fn;
 	if (name)
 	{
 		// named section
-		// look for all instances of a section by the specified name
-		// and resolve base addresses and add to the list
-		for (fn = 0; fn < ninputfiles; fn++)
-		{
-			check_section_name(name, base, inputfiles[fn], down);
-		}
+		check_section_name(name, base, down);
 	}
 	else
 	{
 		// wildcard section
-		// named section
-		// look for all instances of a section by the specified name
-		// and resolve base addresses and add to the list
-		for (fn = 0; fn < ninputfiles; fn++)
-		{
-			check_section_flags(yesflags, noflags, base, inputfiles[fn], down);
-		}
+		// look for all sections not yet processed that match the flags
+		check_section_flags(yesflags, noflags, base, down);
 	}
 }
 
@@ -199,26 +351,28 @@ void resolve_sections(void)
 {
 	int laddr = 0;
 	int growdown = 0;
-	int ln, sn, fn;
+	int ln, i, j, first;
 	sectopt_t *so;
 	
+	build_section_index();
+
 	for (ln = 0; ln < linkscript.nlines; ln++)
 	{
+		first = nsects;
 		if (linkscript.lines[ln].loadat >= 0)
 		{
 			laddr = linkscript.lines[ln].loadat;
 			growdown = linkscript.lines[ln].growsdown;
 		}
-		//fprintf(stderr, "Adding section %s\n", linkscript.lines[ln].sectname);
+		if (debug_level > 0)
+			fprintf(stderr, "Adding section %s\n", linkscript.lines[ln].sectname ? linkscript.lines[ln].sectname : "*");
 		add_matching_sections(linkscript.lines[ln].sectname, linkscript.lines[ln].yesflags, linkscript.lines[ln].noflags, &laddr, growdown);
 		
 		if (linkscript.lines[ln].sectname)
 		{
 			char *sname = linkscript.lines[ln].sectname;
 			/* handle "after padding" */
-			for (so = section_opts; so; so = so -> next)
-				if (!strcmp(so -> name, sname))
-					break;
+			so = find_section_opts(sname);
 			if (so)
 			{
 				if (so -> aftersize)
@@ -247,74 +401,66 @@ void resolve_sections(void)
 		else
 		{
 			// wildcard section
-			// look for all sections not yet processed that match flags
-
+			// pick up any sections in the input files themselves that
+			// have not been placed yet, along with all sections of the
+			// same name in the input files
 			int f = 0;
-			int fn0, sn0;
 			char *sname;
+			sectindex_t *e;
+			section_t *s;
+			struct section_list *sl;
 			
-			// named section
-			// look for all instances of a section by the specified name
-			// and resolve base addresses and add to the list
-			for (fn0 = 0; fn0 < ninputfiles; fn0++)
+			for (i = 0; i < nallsects; i++)
 			{
-				for (sn0 = 0; sn0 < inputfiles[fn0] -> nsections; sn0++)
+				if (!(allsects[i].toplevel))
+					continue;
+				if (!section_flags_match(allsects[i].ptr, linkscript.lines[ln].yesflags, linkscript.lines[ln].noflags))
+					continue;
+				if (allsects[i].ptr -> processed)
+					continue;
+
+				sname = (char *)(allsects[i].ptr -> name);
+				if (debug_level > 0)
+					fprintf(stderr, "Adding section %s\n", sname);
+				e = sectindex_find(sname);
+				for (j = 0; j < e -> ninsts; j++)
 				{
-					// ignore "constant" sections
-					if (inputfiles[fn0] -> sections[sn0].flags & SECTION_CONST)
+					if (!(e -> insts[j].toplevel))
 						continue;
-					// ignore if the "no flags" bit says to
-					if (linkscript.lines[ln].noflags && (inputfiles[fn0] -> sections[sn0].flags & linkscript.lines[ln].noflags))
-						continue;
-					// ignore unless the yes flags tell us not to
-					if (linkscript.lines[ln].yesflags && ((inputfiles[fn0] -> sections[sn0].flags & linkscript.lines[ln].yesflags) == 0))
-						continue;
-					if (inputfiles[fn0] -> sections[sn0].processed == 0)
+					// we have a match
+					s = e -> insts[j].ptr;
+					sl = sectlist_add(s);
+					
+					s -> processed = 1;
+					if (!f && linkscript.lines[ln].loadat >= 0)
 					{
-						sname = (char *)(inputfiles[fn0] -> sections[sn0].name);
-						fprintf(stderr, "Adding sectoin %s\n", sname);
-						for (fn = 0; fn < ninputfiles; fn++)
-						{
-							for (sn = 0; sn < inputfiles[fn] -> nsections; sn++)
-							{
-								if (!strcmp(sname, (char *)(inputfiles[fn] -> sections[sn].name)))
-								{
-									// we have a match
-									sectlist = lw_realloc(sectlist, sizeof(struct section_list) * (nsects + 1));
-									sectlist[nsects].ptr = &(inputfiles[fn] -> sections[sn]);
-						
-									inputfiles[fn] -> sections[sn].processed = 1;
-									if (!f && linkscript.lines[ln].loadat >= 0)
-									{
-										f = 1;
-										sectlist[nsects].forceaddr = 1;
-										laddr = linkscript.lines[ln].loadat;
-										growdown = linkscript.lines[ln].growsdown;
-									}
-									else
-									{
-										sectlist[nsects].forceaddr = 0;
-									}
-									if (growdown)
-									{
-										laddr -= inputfiles[fn] -> sections[sn].codesize;
-										inputfiles[fn] -> sections[sn].loadaddress = laddr;
-									}
-									else
-									{
-										inputfiles[fn] -> sections[sn].loadaddress = laddr;
-										laddr += inputfiles[fn] -> sections[sn].codesize;
-									}
-									nsects++;
-								}
-							}
-						}
+						f = 1;
+						sl -> forceaddr = 1;
+						laddr = linkscript.lines[ln].loadat;
+						growdown = linkscript.lines[ln].growsdown;
+					}
+					if (growdown)
+					{
+						laddr -= s -> codesize;
+						s -> loadaddress = laddr;
+					}
+					else
+					{
+						s -> loadaddress = laddr;
+						laddr += s -> codesize;
 					}
 				}
 			}
 		}
+
+		// the sections from this line are all placed; a profile may
+		// shuffle them around within the space they take up
+		if (profile_file)
+			profile_order(first, nsects, growdown);
 	}
 	
+	free_section_index();
+
 	// theoretically, all the base addresses are set now
 }
 
@@ -403,11 +549,9 @@ lw_expr_stack_t *find_external_sym_recurse(char *sym, fileinfo_t *fn)
 					if (fn -> sections[sn].flags & SECTION_CONST)
 					{
 						// add to section list
-						sectlist = lw_realloc(sectlist, sizeof(struct section_list) * (nsects + 1));
-						sectlist[nsects].ptr = &(fn -> sections[sn]);
+						sectlist_add(&(fn -> sections[sn]));
 						fn -> sections[sn].processed = 1;
 						fn -> sections[sn].loadaddress = 0;
-						nsects++;
 					}
 					else
 					{
@@ -726,6 +870,23 @@ void resolve_files(void)
 		fprintf(stderr, "Warning: library -l%s (%d) does not resolve any symbols\n", inputfiles[fn] -> filename, fn);
 	}
 }
+/*
+Trace the references in a file that changed since the cached link state was
+saved. Returns nonzero if that pulls in a file or section that was not part
+of the cached link, in which case the cached layout cannot be reused.
+*/
+int resolve_changed_file(fileinfo_t *fn)
+{
+	int osects = nsects;
+	
+	resolveonly = 1;
+	nforced = 0;
+	resolve_files_aux(fn);
+	resolveonly = 0;
+	
+	return nforced || nsects != osects;
+}
+
 void find_section_by_name_once_aux(char *name, fileinfo_t *fn, section_t **rval, int *found);
 void find_section_by_name_once_aux(char *name, fileinfo_t *fn, section_t **rval, int *found)
 {
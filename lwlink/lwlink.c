@@ -36,9 +36,13 @@ this program. If not, see <http://www.gnu.org/licenses/>.
 int debug_level = 0;
 int outformat = OUTPUT_DECB;
 char *outfile = NULL;
+outputspec_t *extra_outputs = NULL;
 char *scriptfile = NULL;
 int symerr = 0;
 char *map_file = NULL;
+int link_cache = 0;
+char *profile_file = NULL;
+char *dp_section = NULL;
 
 fileinfo_t **inputfiles = NULL;
 int ninputfiles = 0;
@@ -72,6 +76,41 @@ void add_input_library(char *libname)
 	inputfiles[ninputfiles++] -> filename = lw_strdup(libname);	
 }
 
+void add_output_file(int format, char *fn)
+{
+	outputspec_t *o, **p;
+
+	o = lw_alloc(sizeof(outputspec_t));
+	o -> format = format;
+	o -> filename = lw_strdup(fn);
+	o -> next = NULL;
+	
+	// keep them in command line order
+	for (p = &extra_outputs; *p; p = &((*p) -> next))
+		/* do nothing */ ;
+	*p = o;
+}
+
+/*
+Extra outputs are written from the same resolved sections as the main
+output. The OS9 and LWEX formats need a layout of their own (module header,
+stack size) so they can only be extra outputs if the main output uses the
+same format.
+*/
+void check_output_files(void)
+{
+	outputspec_t *o;
+	
+	for (o = extra_outputs; o; o = o -> next)
+	{
+		if ((o -> format == OUTPUT_OS9 || o -> format == OUTPUT_LWEX0) && o -> format != outformat)
+		{
+			fprintf(stderr, "%s: os9 and lwex output must match the main output format\n", o -> filename);
+			exit(1);
+		}
+	}
+}
+
 void add_library_search(char *libdir)
 {
 	libdirs = lw_realloc(libdirs, sizeof(char*) * (nlibdirs + 1));
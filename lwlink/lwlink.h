@@ -34,6 +34,14 @@ Contains the main defs used by the linker
 #define OUTPUT_RAW2     5   // raw sequence of bytes, BSS converted to NULs
 #define OUTPUT_IHEX     6   // IHEX output format
 
+typedef struct outputspec_s outputspec_t;
+struct outputspec_s
+{
+	int format;				// output format (OUTPUT_*)
+	char *filename;			// file to write it to
+	outputspec_t *next;		// next output
+};
+
 typedef struct symtab_s symtab_t;
 struct symtab_s
 {
@@ -93,6 +101,10 @@ struct fileinfo_s
 	int nsubs;
 	fileinfo_t **subs;
 	fileinfo_t *parent;
+
+	unsigned long long hash;	// content hash (for the link cache)
+	unsigned long long refhash;	// hash of external symbols referenced
+	int cacheid;			// index in the link cache file list
 };
 
 struct section_list
@@ -108,6 +120,7 @@ struct sectopt_s
 	char *name;					// section name
 	int aftersize;				// number of bytes to append to section
 	unsigned char *afterbytes;	// the bytes to store after the section
+	int keeporder;				// never reorder instances from a profile
 	sectopt_t *next;			// next section option
 };
 
@@ -123,6 +136,7 @@ extern sectopt_t *section_opts;
 extern int debug_level;
 extern int outformat;
 extern char *outfile;
+extern outputspec_t *extra_outputs;
 extern int ninputfiles;
 extern fileinfo_t **inputfiles;
 extern char *scriptfile;
@@ -140,6 +154,11 @@ extern char *map_file;
 
 extern char *sysroot;
 
+extern int link_cache;
+
+extern char *profile_file;
+extern char *dp_section;
+
 #define __lwlink_E__ extern
 #else
 #define __lwlink_E__
@@ -150,6 +169,8 @@ __lwlink_E__ void add_input_library(char *fn);
 __lwlink_E__ void add_library_search(char *fn);
 __lwlink_E__ void add_section_base(char *fn);
 __lwlink_E__ char *sanitize_symbol(char *sym);
+__lwlink_E__ void add_output_file(int format, char *fn);
+__lwlink_E__ void check_output_files(void);
 
 #undef __lwlink_E__
 
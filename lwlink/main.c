@@ -27,6 +27,7 @@ Implements the program startup code
 #include <stdlib.h>
 #include <string.h>
 
+#include <lw_alloc.h>
 #include <lw_cmdline.h>
 
 #include <version.h>
@@ -44,6 +45,27 @@ char *program_name;
 // command line option handling
 #define PROGVER "lwlink from " PACKAGE_STRING
 
+static int parse_format(char *arg)
+{
+	if (!strcasecmp(arg, "decb"))
+		return OUTPUT_DECB;
+	else if (!strcasecmp(arg, "raw"))
+		return OUTPUT_RAW;
+	else if (!strcasecmp(arg, "raw2"))
+		return OUTPUT_RAW2;
+	else if (!strcasecmp(arg, "lwex0") || !strcasecmp(arg, "lwex"))
+		return OUTPUT_LWEX0;
+	else if (!strcasecmp(arg, "os9"))
+		return OUTPUT_OS9;
+	else if (!strcasecmp(arg, "srec"))
+		return OUTPUT_SREC;
+	else if (!strcasecmp(arg, "ihex"))
+		return OUTPUT_IHEX;
+
+	fprintf(stderr, "Invalid output format: %s\n", arg);
+	exit(1);
+}
+
 static int parse_opts(int key, char *arg, void *state)
 {
 	switch (key)
@@ -79,31 +101,46 @@ static int parse_opts(int key, char *arg, void *state)
 		break;
 	
 	case 'f':
-		// output format
-		if (!strcasecmp(arg, "decb"))
-			outformat = OUTPUT_DECB;
-		else if (!strcasecmp(arg, "raw"))
-			outformat = OUTPUT_RAW;
-		else if (!strcasecmp(arg, "raw2"))
-			outformat = OUTPUT_RAW2;
-		else if (!strcasecmp(arg, "lwex0") || !strcasecmp(arg, "lwex"))
-			outformat = OUTPUT_LWEX0;
-		else if (!strcasecmp(arg, "os9"))
-			outformat = OUTPUT_OS9;
-		else if (!strcasecmp(arg, "srec"))
-			outformat = OUTPUT_SREC;
-		else if (!strcasecmp(arg, "ihex"))
-			outformat = OUTPUT_IHEX;
-		else
+		// output format, optionally with an extra output file
 		{
-			fprintf(stderr, "Invalid output format: %s\n", arg);
-			exit(1);
+			char *path;
+			int fmt;
+
+			path = strchr(arg, ':');
+			if (path)
+				*path = '\0';
+			fmt = parse_format(arg);
+			if (path)
+			{
+				*path++ = ':';
+				add_output_file(fmt, path);
+			}
+			else
+			{
+				outformat = fmt;
+			}
 		}
 		break;
+
 	case lw_cmdline_key_end:
 		// done; sanity check
 		if (!outfile)
-			outfile = "a.out";
+		{
+			if (extra_outputs)
+			{
+				// the first extra output becomes the main one
+				outputspec_t *o = extra_outputs;
+				outfile = o -> filename;
+				outformat = o -> format;
+				extra_outputs = o -> next;
+				lw_free(o);
+			}
+			else
+			{
+				outfile = "a.out";
+			}
+		}
+		check_output_files();
 		break;
 	
 	case 'l':
@@ -126,6 +163,18 @@ static int parse_opts(int key, char *arg, void *state)
 		map_file = arg;
 		break;
 	
+	case 0x102:
+		link_cache = 1;
+		break;
+	
+	case 0x103:
+		profile_file = arg;
+		break;
+	
+	case 0x104:
+		dp_section = arg;
+		break;
+	
 	case lw_cmdline_key_arg:
 		add_input_file(arg);
 		break;
@@ -143,7 +192,7 @@ static struct lw_cmdline_options options[] =
 	{ "debug",		'd',	0,		0,
 				"Set debug mode"},
 	{ "format",		'f',	"TYPE",	0,
-				"Select output format: decb, raw, lwex, os9, srec, ihex"},
+				"Select output format: decb, raw, lwex, os9, srec, ihex; TYPE:FILE adds another output"},
 	{ "decb",		'b',	0,		0,
 				"Generate DECB .bin format output, equivalent of --format=decb"},
 	{ "raw",		'r',	0,		0,
@@ -162,6 +211,12 @@ static struct lw_cmdline_options options[] =
 				"Specify the path to replace an initial = with in library paths" },
 	{ "map",		'm',	"FILE",		0,
 				"Output informaiton about the link" },
+	{ "incremental", 0x102,	0,		0,
+				"Keep the link state in OUTFILE.lwlc and reuse it when possible" },
+	{ "profile",	0x103,	"FILE",		0,
+				"Order sections by the symbol hit counts in FILE and report the effect" },
+	{ "dp-section",	0x104,	"SECT",		0,
+				"Pack the most used instances of SECT into its direct page (with --profile)" },
 	{ 0 }
 };
 
@@ -181,8 +236,13 @@ extern void resolve_sections(void);
 extern void generate_symbols(void);
 extern void resolve_references(void);
 extern void resolve_padding(void);
+extern int incremental_link(void);
+extern void save_link_cache(void);
+extern void hash_input_files(void);
 extern void do_output(void);
 extern void display_map(void);
+extern void read_profile(void);
+extern void profile_report(void);
 
 // main function; parse command line, set up assembler state, and run the
 // assembler on the first file
@@ -202,19 +262,39 @@ int main(int argc, char **argv)
 	}
 
 	unlink(outfile);
+	{
+		outputspec_t *o;
+		for (o = extra_outputs; o; o = o -> next)
+			unlink(o -> filename);
+	}
 
 	// handle the linker script
 	setup_script();
 
-	// read the input files
-	read_files();
+	// read the profile before the link cache checks it
+	if (profile_file)
+		read_profile();
 
-	// trace unresolved references and determine which non-forced
-	// objects must be included
-	resolve_files();
+	// reuse the previous link state if nothing but object contents changed;
+	// a profiled link always places sections so it can report the effect
+	if (!link_cache || profile_file || !incremental_link())
+	{
+		// read the input files
+		read_files();
+		if (link_cache)
+			hash_input_files();
+
+		// trace unresolved references and determine which non-forced
+		// objects must be included
+		resolve_files();
 	
-	// resolve section bases and section order
-	resolve_sections();
+		// resolve section bases and section order
+		resolve_sections();
+
+		// report what the profile guided ordering did
+		if (profile_file)
+			profile_report();
+	}
 
 	// generate symbols
 	generate_symbols();
@@ -222,6 +302,10 @@ int main(int argc, char **argv)
 	// resolve incomplete references
 	resolve_references();
 
+	// save the link state for the next incremental link
+	if (link_cache)
+		save_link_cache();
+
 	// resolve section padding bits
 	resolve_padding();
 	
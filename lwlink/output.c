@@ -41,19 +41,19 @@ void do_output_lwex0(FILE *of);
 void do_output_srec(FILE *of);
 void do_output_ihex(FILE *of);
 
-void do_output(void)
+static void do_output_file(int format, char *fn)
 {
 	FILE *of;
 	
-	of = fopen(outfile, "wb");
+	of = fopen(fn, "wb");
 	if (!of)
 	{
-		fprintf(stderr, "Cannot open output file %s: ", outfile);
+		fprintf(stderr, "Cannot open output file %s: ", fn);
 		perror("");
 		exit(1);
 	}
 	
-	switch (outformat)
+	switch (format)
 	{
 	case OUTPUT_DECB:
 		do_output_decb(of);
@@ -91,6 +91,16 @@ void do_output(void)
 	fclose(of);
 }
 
+// write the main output and any extra outputs from the resolved sections
+void do_output(void)
+{
+	outputspec_t *o;
+	
+	do_output_file(outformat, outfile);
+	for (o = extra_outputs; o; o = o -> next)
+		do_output_file(o -> format, o -> filename);
+}
+
 void do_output_decb(FILE *of)
 {
 	int sn, sn2;
@@ -0,0 +1,774 @@
+/*
+profile.c
+Copyright © 2026 William Astle
+
+This file is part of LWLINK.
+
+LWLINK is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+Profile guided section ordering
+
+A profile is a list of symbol names and hit counts, one per line. Only
+exported symbols are matched against it since local names need not be
+unique. Within each run of same named sections placed by a link script line,
+sections that reference each other are chained together, heaviest
+references first, and the chains are then ordered hottest first. The run
+keeps the addresses it had, so nothing outside it moves. The instances of
+the direct page section are instead packed so the hottest variables fit in
+the page the section starts in.
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lw_alloc.h>
+#include <lw_string.h>
+
+#include "expr.h"
+#include "lwlink.h"
+
+#ifdef _MSC_VER
+#include <lw_win.h>	// windows build
+#endif
+
+#define PROF_HASHSIZE	1024
+
+typedef struct profsym_s profsym_t;
+struct profsym_s
+{
+	char *name;					// symbol name
+	unsigned long count;		// hits from the profile
+	profsym_t *next;			// next entry in the hash chain
+};
+
+typedef struct expsym_s expsym_t;
+struct expsym_s
+{
+	char *name;					// exported symbol name
+	section_t *sect;			// section exporting it
+	int offset;					// offset within the section
+	expsym_t *next;				// next entry in the hash chain
+};
+
+typedef struct
+{
+	section_t *sect;			// the section
+	unsigned long heat;			// hits on its exported symbols
+	int origaddr;				// load address before reordering
+} profsect_t;
+
+struct profedge
+{
+	int from, to;				// run indexes, from < to
+	unsigned long weight;		// hits on the referenced symbols
+};
+
+unsigned long long profile_hash = 0;
+
+static profsym_t *profsyms[PROF_HASHSIZE];
+static int nprofsyms = 0;
+static expsym_t *expsyms[PROF_HASHSIZE];
+static profsect_t *profsects = NULL;
+static int nprofsects = 0;
+static int profile_ready = 0;
+static int nreordered = 0;
+
+static unsigned int prof_hash(const char *name)
+{
+	unsigned int h = 5381;
+
+	while (*name)
+		h = h * 33 + (unsigned char)*name++;
+	return h & (PROF_HASHSIZE - 1);
+}
+
+static unsigned long profile_count(const char *name)
+{
+	profsym_t *ps;
+
+	for (ps = profsyms[prof_hash(name)]; ps; ps = ps -> next)
+		if (!strcmp(ps -> name, name))
+			return ps -> count;
+	return 0;
+}
+
+static void hash_profile(const char *p, int len)
+{
+	// FNV-1a, as for the link cache
+	if (!profile_hash)
+		profile_hash = 0xcbf29ce484222325ULL;
+	while (len-- > 0)
+	{
+		profile_hash ^= (unsigned char)*p++;
+		profile_hash *= 0x100000001b3ULL;
+	}
+}
+
+void read_profile(void)
+{
+	FILE *f;
+	char buf[1024];
+	char *p, *n, *e;
+	unsigned long count;
+	int lineno = 0, h;
+	profsym_t *ps;
+
+	f = fopen(profile_file, "r");
+	if (!f)
+	{
+		fprintf(stderr, "Can't open profile %s:", profile_file);
+		perror("");
+		exit(1);
+	}
+
+	while (fgets(buf, sizeof(buf), f))
+	{
+		lineno++;
+		for (p = buf; *p && isspace(*p); p++)
+			/* do nothing */ ;
+		if (!*p || *p == '#' || *p == ';')
+			continue;
+		for (n = p; *p && !isspace(*p); p++)
+			/* do nothing */ ;
+		if (*p)
+			*p++ = '\0';
+		count = strtoul(p, &e, 10);
+		if (e == p)
+			goto bad;
+		for (; *e && isspace(*e); e++)
+			/* do nothing */ ;
+		if (*e)
+			goto bad;
+
+		hash_profile(n, strlen(n) + 1);
+		hash_profile((char *)&count, sizeof(count));
+
+		// the same name more than once adds up
+		h = prof_hash(n);
+		for (ps = profsyms[h]; ps; ps = ps -> next)
+			if (!strcmp(ps -> name, n))
+				break;
+		if (!ps)
+		{
+			ps = lw_alloc(sizeof(profsym_t));
+			ps -> name = lw_strdup(n);
+			ps -> count = 0;
+			ps -> next = profsyms[h];
+			profsyms[h] = ps;
+			nprofsyms++;
+		}
+		ps -> count += count;
+	}
+	fclose(f);
+	return;
+
+bad:
+	fprintf(stderr, "%s:%d: bad profile line\n", profile_file, lineno);
+	exit(1);
+}
+
+static int profsect_cmp(const void *a, const void *b)
+{
+	const section_t *sa = ((const profsect_t *)a) -> sect;
+	const section_t *sb = ((const profsect_t *)b) -> sect;
+
+	if (sa < sb)
+		return -1;
+	return sa > sb;
+}
+
+static profsect_t *find_profsect(section_t *s)
+{
+	profsect_t key;
+
+	key.sect = s;
+	return bsearch(&key, profsects, nprofsects, sizeof(profsect_t), profsect_cmp);
+}
+
+static void collect_sections(fileinfo_t *fn)
+{
+	int sn, h;
+	symtab_t *se;
+	expsym_t *e, **ep;
+	profsect_t *ps;
+
+	for (sn = 0; sn < fn -> nsections; sn++)
+	{
+		ps = &(profsects[nprofsects++]);
+		ps -> sect = &(fn -> sections[sn]);
+		ps -> heat = 0;
+		ps -> origaddr = fn -> sections[sn].loadaddress;
+		for (se = fn -> sections[sn].exportedsyms; se; se = se -> next)
+		{
+			ps -> heat += profile_count((char *)(se -> sym));
+
+			// keep the chains in file order so the first match wins
+			e = lw_alloc(sizeof(expsym_t));
+			e -> name = (char *)(se -> sym);
+			e -> sect = &(fn -> sections[sn]);
+			e -> offset = se -> offset;
+			e -> next = NULL;
+			h = prof_hash(e -> name);
+			for (ep = &(expsyms[h]); *ep; ep = &((*ep) -> next))
+				/* do nothing */ ;
+			*ep = e;
+		}
+	}
+	for (sn = 0; sn < fn -> nsubs; sn++)
+		collect_sections(fn -> subs[sn]);
+}
+
+static int count_all_sections(fileinfo_t *fn)
+{
+	int sn, n;
+
+	n = fn -> nsections;
+	for (sn = 0; sn < fn -> nsubs; sn++)
+		n += count_all_sections(fn -> subs[sn]);
+	return n;
+}
+
+static void profile_setup(void)
+{
+	int fn, n = 0;
+
+	for (fn = 0; fn < ninputfiles; fn++)
+		n += count_all_sections(inputfiles[fn]);
+	profsects = lw_alloc(sizeof(profsect_t) * (n + 1));
+	nprofsects = 0;
+	for (fn = 0; fn < ninputfiles; fn++)
+		collect_sections(inputfiles[fn]);
+	qsort(profsects, nprofsects, sizeof(profsect_t), profsect_cmp);
+	profile_ready = 1;
+}
+
+// find where a symbol in a reference lives, much as resolve_sym() would
+static section_t *find_symbol_section(section_t *s, lw_expr_term_t *t, int *offset)
+{
+	symtab_t *se;
+	expsym_t *e;
+	int i;
+
+	if (t -> value == 1)
+	{
+		// local symbol: this section first, then the rest of the file
+		for (se = s -> localsyms; se; se = se -> next)
+		{
+			if (!strcmp((char *)(se -> sym), t -> symbol))
+			{
+				*offset = se -> offset;
+				return s;
+			}
+		}
+		for (i = 0; i < s -> file -> nsections; i++)
+		{
+			for (se = s -> file -> sections[i].localsyms; se; se = se -> next)
+			{
+				if (!strcmp((char *)(se -> sym), t -> symbol))
+				{
+					*offset = se -> offset;
+					return &(s -> file -> sections[i]);
+				}
+			}
+		}
+		return NULL;
+	}
+
+	// only sections that are part of the link count
+	for (e = expsyms[prof_hash(t -> symbol)]; e; e = e -> next)
+	{
+		if (e -> sect -> processed && !strcmp(e -> name, t -> symbol))
+		{
+			*offset = e -> offset;
+			return e -> sect;
+		}
+	}
+	return NULL;
+}
+
+// the first symbol in a reference that lands in some other section
+static section_t *ref_target(section_t *s, reloc_t *rl, int *offset, char **name)
+{
+	lw_expr_stack_node_t *n;
+	section_t *ts;
+
+	for (n = rl -> expr -> head; n; n = n -> next)
+	{
+		if (n -> term -> term_type != LW_TERM_SYM || !(n -> term -> symbol))
+			continue;
+		ts = find_symbol_section(s, n -> term, offset);
+		if (!ts || ts == s || (ts -> flags & SECTION_CONST))
+			continue;
+		*name = n -> term -> symbol;
+		return ts;
+	}
+	return NULL;
+}
+
+// hits on a referenced symbol; only exported symbols are in the profile
+static unsigned long ref_hits(section_t *ts, char *name)
+{
+	symtab_t *se;
+
+	for (se = ts -> exportedsyms; se; se = se -> next)
+		if (!strcmp((char *)(se -> sym), name))
+			return profile_count(name);
+	return 0;
+}
+
+/* hits on the code at offset in s: those of the exported symbol it comes
+   under, which is the last one at or before it */
+static unsigned long site_hits(section_t *s, int offset)
+{
+	symtab_t *se, *best = NULL;
+
+	for (se = s -> exportedsyms; se; se = se -> next)
+	{
+		if (se -> offset <= offset && (!best || se -> offset > best -> offset))
+			best = se;
+	}
+	return best ? profile_count((char *)(best -> sym)) : 0;
+}
+
+// state for sorting chains and packing; only valid inside order_run()
+static section_t **run_sect;
+static unsigned long *chain_heat;
+static int *chain_size;
+static int *chain_first;
+
+static int edge_pair_cmp(const void *a, const void *b)
+{
+	const struct profedge *ea = a, *eb = b;
+
+	if (ea -> from != eb -> from)
+		return ea -> from - eb -> from;
+	return ea -> to - eb -> to;
+}
+
+static int edge_weight_cmp(const void *a, const void *b)
+{
+	const struct profedge *ea = a, *eb = b;
+
+	if (ea -> weight != eb -> weight)
+		return ea -> weight < eb -> weight ? 1 : -1;
+	return edge_pair_cmp(a, b);
+}
+
+// hottest per byte first; cold chains keep their original order
+static int chain_cmp(const void *a, const void *b)
+{
+	int ca = *(const int *)a, cb = *(const int *)b;
+	unsigned long long da, db;
+
+	da = (unsigned long long)chain_heat[ca] * (chain_size[cb] ? chain_size[cb] : 1);
+	db = (unsigned long long)chain_heat[cb] * (chain_size[ca] ? chain_size[ca] : 1);
+	if (da != db)
+		return da < db ? 1 : -1;
+	return chain_first[ca] - chain_first[cb];
+}
+
+static int chain_offset(int *head, int *next, int i)
+{
+	int j, off = 0;
+
+	for (j = head[i]; j != i; j = next[j])
+		off += run_sect[j] -> codesize;
+	return off;
+}
+
+static void order_run(int a, int b, int down)
+{
+	int n = b - a;
+	int i, j, k, nedges, aedges, nchains, lo, hi, addr, off, ci, cj, dij, dji, space;
+	int *head, *next, *tail, *chains, *order;
+	struct profedge *edges;
+	section_t *ts;
+	reloc_t *rl;
+	sectopt_t *so;
+	char *name;
+
+	for (i = a; i < b; i++)
+		find_profsect(sectlist[i].ptr) -> origaddr = sectlist[i].ptr -> loadaddress;
+	if (n < 2)
+		return;
+	for (so = section_opts; so; so = so -> next)
+		if (!strcmp(so -> name, (char *)(sectlist[a].ptr -> name)))
+			break;
+	if (so && so -> keeporder)
+		return;
+	// padding belongs after the last instance; leave such runs alone
+	for (i = a; i < b; i++)
+		if (sectlist[i].ptr -> aftersize)
+			return;
+
+	run_sect = lw_alloc(sizeof(section_t *) * n);
+	chain_heat = lw_alloc(sizeof(unsigned long) * n);
+	chain_size = lw_alloc(sizeof(int) * n);
+	chain_first = lw_alloc(sizeof(int) * n);
+	head = lw_alloc(sizeof(int) * n);
+	next = lw_alloc(sizeof(int) * n);
+	tail = lw_alloc(sizeof(int) * n);
+	chains = lw_alloc(sizeof(int) * n);
+	order = lw_alloc(sizeof(int) * n);
+	lo = hi = sectlist[a].ptr -> loadaddress;
+	for (i = 0; i < n; i++)
+	{
+		run_sect[i] = sectlist[a + i].ptr;
+		chain_heat[i] = find_profsect(run_sect[i]) -> heat;
+		chain_size[i] = run_sect[i] -> codesize;
+		chain_first[i] = i;
+		head[i] = tail[i] = i;
+		next[i] = -1;
+		if (run_sect[i] -> loadaddress < lo)
+			lo = run_sect[i] -> loadaddress;
+		if (run_sect[i] -> loadaddress + run_sect[i] -> codesize > hi)
+			hi = run_sect[i] -> loadaddress + run_sect[i] -> codesize;
+	}
+
+	nchains = 0;
+	if (dp_section && !down && !strcmp((char *)(run_sect[0] -> name), dp_section))
+	{
+		// direct page: fill the page with the densest variables that fit,
+		// then everything else
+		for (i = 0; i < n; i++)
+			chains[i] = i;
+		qsort(chains, n, sizeof(int), chain_cmp);
+		space = ((lo & 0xff00) + 0x100) - lo;
+		for (i = 0; i < n; i++)
+		{
+			j = chains[i];
+			if (chain_heat[j] && chain_size[j] <= space)
+			{
+				order[nchains++] = j;
+				space -= chain_size[j];
+				chains[i] = -1;
+			}
+		}
+		for (i = 0; i < n; i++)
+			if (chains[i] >= 0)
+				order[nchains++] = chains[i];
+	}
+	else
+	{
+		// gather the references between sections in the run
+		edges = NULL;
+		nedges = aedges = 0;
+		for (i = 0; i < n; i++)
+		{
+			for (rl = run_sect[i] -> incompletes; rl; rl = rl -> next)
+			{
+				ts = ref_target(run_sect[i], rl, &off, &name);
+				if (!ts)
+					continue;
+				for (j = 0; j < n && run_sect[j] != ts; j++)
+					/* do nothing */ ;
+				if (j == n || !ref_hits(ts, name))
+					continue;
+				if (nedges >= aedges)
+				{
+					aedges = aedges ? aedges * 2 : 16;
+					edges = lw_realloc(edges, sizeof(struct profedge) * aedges);
+				}
+				edges[nedges].from = i < j ? i : j;
+				edges[nedges].to = i < j ? j : i;
+				edges[nedges].weight = ref_hits(ts, name);
+				nedges++;
+			}
+		}
+
+		// add up references between the same pair
+		if (nedges)
+		{
+			qsort(edges, nedges, sizeof(struct profedge), edge_pair_cmp);
+			for (i = 1, k = 0; i < nedges; i++)
+			{
+				if (edges[i].from == edges[k].from && edges[i].to == edges[k].to)
+					edges[k].weight += edges[i].weight;
+				else
+					edges[++k] = edges[i];
+			}
+			nedges = k + 1;
+			qsort(edges, nedges, sizeof(struct profedge), edge_weight_cmp);
+		}
+
+		// join chains along the heaviest references first, keeping the
+		// two ends as close together as the chains allow
+		for (k = 0; k < nedges; k++)
+		{
+			i = edges[k].from;
+			j = edges[k].to;
+			ci = head[i];
+			cj = head[j];
+			if (ci == cj)
+				continue;
+			dij = chain_size[ci] - chain_offset(head, next, i) + chain_offset(head, next, j);
+			dji = chain_size[cj] - chain_offset(head, next, j) + chain_offset(head, next, i);
+			if (dji < dij)
+			{
+				ci = head[j];
+				cj = head[i];
+			}
+			next[tail[ci]] = cj;
+			tail[ci] = tail[cj];
+			chain_heat[ci] += chain_heat[cj];
+			chain_size[ci] += chain_size[cj];
+			if (chain_first[cj] < chain_first[ci])
+				chain_first[ci] = chain_first[cj];
+			for (j = cj; j >= 0; j = next[j])
+				head[j] = ci;
+		}
+		lw_free(edges);
+
+		for (i = 0; i < n; i++)
+			if (head[i] == i)
+				chains[nchains++] = i;
+		qsort(chains, nchains, sizeof(int), chain_cmp);
+		for (i = 0, k = 0; i < nchains; i++)
+			for (j = chains[i]; j >= 0; j = next[j])
+				order[k++] = j;
+	}
+
+	for (i = 0; i < n && order[i] == i; i++)
+		/* do nothing */ ;
+	if (i < n)
+	{
+		nreordered++;
+		addr = down ? hi : lo;
+		for (i = 0; i < n; i++)
+		{
+			ts = run_sect[order[i]];
+			sectlist[a + i].ptr = ts;
+			if (down)
+			{
+				addr -= ts -> codesize;
+				ts -> loadaddress = addr;
+			}
+			else
+			{
+				ts -> loadaddress = addr;
+				addr += ts -> codesize;
+			}
+		}
+	}
+
+	lw_free(run_sect);
+	lw_free(chain_heat);
+	lw_free(chain_size);
+	lw_free(chain_first);
+	lw_free(head);
+	lw_free(next);
+	lw_free(tail);
+	lw_free(chains);
+	lw_free(order);
+}
+
+/*
+Reorder the sections placed by one link script line. Each run of sections
+with the same name is handled on its own so the section base and length
+symbols stay correct.
+*/
+void profile_order(int first, int last, int down)
+{
+	int a, b;
+
+	if (!profile_ready)
+		profile_setup();
+	for (a = first; a < last; a = b)
+	{
+		for (b = a + 1; b < last && !strcmp((char *)(sectlist[b].ptr -> name), (char *)(sectlist[a].ptr -> name)); b++)
+			/* do nothing */ ;
+		order_run(a, b, down);
+	}
+}
+
+static int is_pcrel(reloc_t *rl)
+{
+	lw_expr_stack_node_t *n;
+
+	for (n = rl -> expr -> head; n; n = n -> next)
+	{
+		if (n -> term -> term_type == LW_TERM_OPER && (n -> term -> value == LW_OPER_MINUS || n -> term -> value == LW_OPER_TIMES))
+			return 1;
+	}
+	return 0;
+}
+
+// the size of the opcode of a long branch whose offset is at off, or 0
+static int long_branch(section_t *s, reloc_t *rl)
+{
+	int off = rl -> offset;
+
+	if ((rl -> flags & RELOC_8BIT) || !is_pcrel(rl))
+		return 0;
+	if (off >= 2 && s -> code[off - 2] == 0x10 && s -> code[off - 1] >= 0x21 && s -> code[off - 1] <= 0x2f)
+		return 2;	// LBcc
+	if (off >= 1 && (s -> code[off - 1] == 0x16 || s -> code[off - 1] == 0x17))
+		return 1;	// LBRA, LBSR
+	return 0;
+}
+
+static int is_extended(section_t *s, reloc_t *rl)
+{
+	int op;
+
+	if ((rl -> flags & RELOC_8BIT) || rl -> offset < 1)
+		return 0;
+	op = s -> code[rl -> offset - 1] & 0xf0;
+	return op == 0x70 || op == 0xb0 || op == 0xf0;
+}
+
+static int short_reach(int opaddr, int target)
+{
+	int d = target - (opaddr + 2);
+
+	return d >= -128 && d <= 127;
+}
+
+/*
+The linker does not change any instructions so this reports what the new
+layout makes possible: long branches between sections that are now within
+the reach of a short branch, and references to direct page variables that
+could use direct addressing. Cycle figures weight each reference by how
+often it runs, taken as the hits on the exported symbol it comes under,
+and use the 6809 timings: two cycles for a short branch over a long one
+and one for direct over extended addressing.
+*/
+void profile_report(void)
+{
+	int sn, k, off, toff, matched = 0, dpseen = 0, dplo = 0, dpolo = 0;
+	int nbranch = 0, nshort[2] = { 0, 0 }, nbytes[2] = { 0, 0 };
+	int ndpext = 0, ndpout = 0;
+	unsigned long ncycles[2] = { 0, 0 }, dphits[2] = { 0, 0 }, dptotal = 0, dpcycles = 0, hits;
+	section_t *s, *ts;
+	profsect_t *ps, *pt;
+	profsym_t *psym;
+	expsym_t *e;
+	reloc_t *rl;
+	symtab_t *se;
+	char *name;
+
+	if (!profile_ready)
+		profile_setup();
+
+	for (k = 0; k < PROF_HASHSIZE; k++)
+	{
+		for (psym = profsyms[k]; psym; psym = psym -> next)
+		{
+			for (e = expsyms[prof_hash(psym -> name)]; e; e = e -> next)
+				if (e -> sect -> processed && !strcmp(e -> name, psym -> name))
+					break;
+			if (e)
+				matched++;
+		}
+	}
+
+	// where the direct page is, before and after
+	if (dp_section)
+	{
+		for (sn = 0; sn < nsects; sn++)
+		{
+			s = sectlist[sn].ptr;
+			if (strcmp((char *)(s -> name), dp_section))
+				continue;
+			ps = find_profsect(s);
+			if (!dpseen || s -> loadaddress < dplo)
+				dplo = s -> loadaddress;
+			if (!dpseen || ps -> origaddr < dpolo)
+				dpolo = ps -> origaddr;
+			dpseen = 1;
+		}
+		dplo &= 0xff00;
+		dpolo &= 0xff00;
+	}
+
+	for (sn = 0; sn < nsects; sn++)
+	{
+		s = sectlist[sn].ptr;
+		if (s -> flags & SECTION_CONST)
+			continue;
+		ps = find_profsect(s);
+
+		if (dpseen && !strcmp((char *)(s -> name), dp_section))
+		{
+			for (se = s -> exportedsyms; se; se = se -> next)
+			{
+				hits = profile_count((char *)(se -> sym));
+				dptotal += hits;
+				if (((ps -> origaddr + se -> offset) & 0xff00) == dpolo)
+					dphits[0] += hits;
+				if (((s -> loadaddress + se -> offset) & 0xff00) == dplo)
+					dphits[1] += hits;
+			}
+		}
+
+		for (rl = s -> incompletes; rl; rl = rl -> next)
+		{
+			ts = ref_target(s, rl, &toff, &name);
+			if (!ts)
+				continue;
+			pt = find_profsect(ts);
+			hits = site_hits(s, rl -> offset);
+
+			off = long_branch(s, rl);
+			if (off)
+			{
+				nbranch++;
+				if (short_reach(ps -> origaddr + rl -> offset - off, pt -> origaddr + toff))
+				{
+					nshort[0]++;
+					nbytes[0] += off;
+					ncycles[0] += 2 * hits;
+				}
+				if (short_reach(s -> loadaddress + rl -> offset - off, ts -> loadaddress + toff))
+				{
+					nshort[1]++;
+					nbytes[1] += off;
+					ncycles[1] += 2 * hits;
+				}
+				continue;
+			}
+
+			if (!dpseen || strcmp((char *)(ts -> name), dp_section))
+				continue;
+			if (((ts -> loadaddress + toff) & 0xff00) != dplo)
+			{
+				if (rl -> flags & RELOC_8BIT)
+					ndpout++;
+			}
+			else if (is_extended(s, rl))
+			{
+				ndpext++;
+				dpcycles += hits;
+			}
+		}
+	}
+
+	printf("Profile: %d of %d symbols found, %d section runs reordered\n", matched, nprofsyms, nreordered);
+	printf("Profile: %d long branches between sections, %d within short branch range (before: %d)\n", nbranch, nshort[1], nshort[0]);
+	printf("Profile: short branches there would save %d bytes and about %lu cycles (before: %d bytes, %lu cycles)\n", nbytes[1], ncycles[1], nbytes[0], ncycles[0]);
+	if (dp_section && !dpseen)
+	{
+		printf("Profile: no instances of section %s for the direct page\n", dp_section);
+	}
+	else if (dp_section)
+	{
+		printf("Profile: direct page $%04X holds %lu of %lu hits on %s (before: %lu)\n", dplo, dphits[1], dptotal, dp_section, dphits[0]);
+		printf("Profile: %d extended references into the direct page could save %d bytes and about %lu cycles\n", ndpext, ndpext, dpcycles);
+		if (ndpout)
+			fprintf(stderr, "Warning: %d direct references to %s fall outside the direct page\n", ndpout, dp_section);
+	}
+}
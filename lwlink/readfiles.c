@@ -34,6 +34,7 @@ Reads input files
 
 void read_lwobj16v0(fileinfo_t *fn);
 void read_lwar1v(fileinfo_t *fn);
+void read_lwar2v(fileinfo_t *fn);
 
 /*
 The logic of reading the entire file into memory is simple. All the symbol
@@ -52,6 +53,11 @@ void read_file(fileinfo_t *fn)
 			// archive file
 			read_lwar1v(fn);
 		}
+		else if (!memcmp(fn -> filedata, "LWAR2V", 6))
+		{
+			// indexed archive file
+			read_lwar2v(fn);
+		}
 		else
 		{
 			fprintf(stderr, "%s: unknown file format\n", fn -> filename);
@@ -59,92 +65,102 @@ void read_file(fileinfo_t *fn)
 		}
 }
 
-void read_files(void)
+/*
+Load the contents of an input file into memory without parsing it. This
+handles searching the library path for "-l" files.
+*/
+void read_input_file(fileinfo_t *fn)
 {
-	int i;
 	long size;
 	FILE *f;
 	long bread;
-	for (i = 0; i < ninputfiles; i++)
+
+	if (fn -> islib)
 	{
-		if (inputfiles[i] -> islib)
+		char *tf;
+		char *sfn;
+		int s;
+		int j;
+		
+		f = NULL;
+		
+		if (fn -> filename[0] == ':')
 		{
-			char *tf;
-			char *sfn;
-			int s;
-			int j;
-			
-			f = NULL;
-			
-			if (inputfiles[i] -> filename[0] == ':')
+			// : suppresses the libfoo.a behaviour
+			sfn = lw_strdup(fn -> filename + 1);
+		}
+		else
+		{
+			sfn = lw_alloc(strlen(fn -> filename) + 6);
+			sprintf(sfn, "lib%s.a", fn -> filename);
+		}
+		
+		for (j = 0; j < nlibdirs; j++)
+		{
+			if (libdirs[j][0] == '=')
 			{
-				// : suppresses the libfoo.a behaviour
-				sfn = lw_strdup(inputfiles[i] -> filename + 1);
+				// handle sysroot
+				s = strlen(libdirs[j]) + 2 + strlen(sysroot) + strlen(sfn);
+				tf = lw_alloc(s + 1);
+				sprintf(tf, "%s/%s/%s", sysroot, libdirs[j] + 1, sfn);
 			}
 			else
 			{
-				sfn = lw_alloc(strlen(inputfiles[i] -> filename) + 6);
-				sprintf(sfn, "lib%s.a", inputfiles[i] -> filename);
+				s = strlen(libdirs[j]) + 1 + strlen(sfn);
+				tf = lw_alloc(s + 1);
+				sprintf(tf, "%s/%s", libdirs[j], sfn);
 			}
-			
-			for (j = 0; j < nlibdirs; j++)
-			{
-				if (libdirs[j][0] == '=')
-				{
-					// handle sysroot
-					s = strlen(libdirs[j]) + 2 + strlen(sysroot) + strlen(sfn);
-					tf = lw_alloc(s + 1);
-					sprintf(tf, "%s/%s/%s", sysroot, libdirs[j] + 1, sfn);
-				}
-				else
-				{
-					s = strlen(libdirs[j]) + 1 + strlen(sfn);
-					tf = lw_alloc(s + 1);
-					sprintf(tf, "%s/%s", libdirs[j], sfn);
-				}
-				f = fopen(tf, "rb");
-				if (!f)
-				{
-					free(tf);
-					continue;
-				}
-				free(tf);
-				break;
-			}
-			free(sfn);
+			f = fopen(tf, "rb");
 			if (!f)
 			{
-				fprintf(stderr, "Can't open library: -l%s\n", inputfiles[i] -> filename);
-				exit(1);
+				free(tf);
+				continue;
 			}
+			free(tf);
+			break;
 		}
-		else
+		free(sfn);
+		if (!f)
 		{
-			f = fopen(inputfiles[i] -> filename, "rb");
-			if (!f)
-			{
-				fprintf(stderr, "Can't open file %s:", inputfiles[i] -> filename);
-				perror("");
-				exit(1);
-			}
+			fprintf(stderr, "Can't open library: -l%s\n", fn -> filename);
+			exit(1);
 		}
-		fseek(f, 0, SEEK_END);
-		size = ftell(f);
-		rewind(f);
-		
-		inputfiles[i] -> filedata = lw_alloc(size);
-		inputfiles[i] -> filesize = size;
-		
-		bread = fread(inputfiles[i] -> filedata, 1, size, f);
-		if (bread < size)
+	}
+	else
+	{
+		f = fopen(fn -> filename, "rb");
+		if (!f)
 		{
-			fprintf(stderr, "Short read on file %s (%ld/%ld):", inputfiles[i] -> filename, bread, size);
+			fprintf(stderr, "Can't open file %s:", fn -> filename);
 			perror("");
 			exit(1);
 		}
-			
-		fclose(f);
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	rewind(f);
+	
+	fn -> filedata = lw_alloc(size);
+	fn -> filesize = size;
+	
+	bread = fread(fn -> filedata, 1, size, f);
+	if (bread < size)
+	{
+		fprintf(stderr, "Short read on file %s (%ld/%ld):", fn -> filename, bread, size);
+		perror("");
+		exit(1);
+	}
 		
+	fclose(f);
+}
+
+void read_files(void)
+{
+	int i;
+
+	for (i = 0; i < ninputfiles; i++)
+	{
+		read_input_file(inputfiles[i]);
 		read_file(inputfiles[i]);
 	}
 }
@@ -451,3 +467,64 @@ void read_lwar1v(fileinfo_t *fn)
 		cc += flen;
 	}
 }
+
+/*
+Read an indexed archive file. The header is the 6 byte magic number, two
+NULs, the 32 bit offset of the member directory, and the 32 bit number of
+members. Each directory entry is the NUL terminated member name followed
+by 32 bit offset, size, and reserved space, and a 64 bit hash of the member
+data. All numbers are big endian.
+*/
+static unsigned long read_lwar2v_32(unsigned char *p)
+{
+	return ((unsigned long)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+void read_lwar2v(fileinfo_t *fn)
+{
+	unsigned long diroff, nmembers, i, off, len;
+	long cc;
+	char *name;
+
+	if (fn -> filesize < 16)
+	{
+		fprintf(stderr, "Malformed archive file %s.\n", fn -> filename);
+		exit(1);
+	}
+	diroff = read_lwar2v_32(fn -> filedata + 8);
+	nmembers = read_lwar2v_32(fn -> filedata + 12);
+	
+	cc = diroff;
+	for (i = 0; i < nmembers; i++)
+	{
+		name = (char *)(fn -> filedata + cc);
+		for ( ; cc < fn -> filesize && fn -> filedata[cc]; cc++)
+			/* do nothing */ ;
+		cc++;
+		if (cc + 20 > fn -> filesize)
+		{
+			fprintf(stderr, "Malformed archive file %s.\n", fn -> filename);
+			exit(1);
+		}
+		off = read_lwar2v_32(fn -> filedata + cc);
+		len = read_lwar2v_32(fn -> filedata + cc + 4);
+		cc += 20;
+		if (off + len > diroff)
+		{
+			fprintf(stderr, "Malformed archive file %s.\n", fn -> filename);
+			exit(1);
+		}
+		
+		// add the "sub" input file
+		fn -> subs = lw_realloc(fn -> subs, sizeof(fileinfo_t *) * (fn -> nsubs + 1));
+		fn -> subs[fn -> nsubs] = lw_alloc(sizeof(fileinfo_t));
+		memset(fn -> subs[fn -> nsubs], 0, sizeof(fileinfo_t));
+		fn -> subs[fn -> nsubs] -> filedata = fn -> filedata + off;
+		fn -> subs[fn -> nsubs] -> filesize = len;
+		fn -> subs[fn -> nsubs] -> filename = lw_strdup(name);
+		fn -> subs[fn -> nsubs] -> parent = fn;
+		fn -> subs[fn -> nsubs] -> forced = fn -> forced;		
+		read_file(fn -> subs[fn -> nsubs]);
+		fn -> nsubs++;
+	}
+}
@@ -51,6 +51,7 @@ static char *os9_script =
 static char *decb_script =
 	"define basesympat s_%s\n"
 	"define lensympat l_%s\n"
+	"sectopt init keeporder\n"
 	"section init load 2000\n"
 	"section code\n"
 	"section *,!bss\n"
@@ -62,6 +63,7 @@ static char *decb_script =
 static char *srec_script =
 	"define basesympat s_%s\n"
 	"define lensympat l_%s\n"
+	"sectopt init keeporder\n"
 	"section init load 0400\n"
 	"section code\n"
 	"section *,!bss\n"
@@ -73,6 +75,7 @@ static char *srec_script =
 static char *raw_script = 
 	"define basesympat s_%s\n"
 	"define lensympat l_%s\n"
+	"sectopt init keeporder\n"
 	"section init load 0000\n"
 	"section code\n"
 	"section *,!bss\n"
@@ -84,6 +87,7 @@ static char *lwex0_script =
 	"define lensympat l_%s\n"
 	"sectopt .ctors padafter 00,00\n"
 	"sectopt .dtors padafter 00,00\n"
+	"sectopt init keeporder\n"
 	"section init load 0100\n"
 	"section .text\n"
 	"section .data\n"
@@ -287,6 +291,7 @@ void setup_script()
 				so -> name = lw_strdup(sn);
 				so -> aftersize = 0;
 				so -> afterbytes = NULL;
+				so -> keeporder = 0;
 				so -> next = section_opts;
 				section_opts = so;
 			}
@@ -326,6 +331,10 @@ void setup_script()
 					ptr3++;
 				}
 			}
+			else if (!strcmp(ptr2, "keeporder"))
+			{
+				so -> keeporder = 1;
+			}
 			else
 			{
 				fprintf(stderr, "%s: bad script line: %s %s\n", scriptfile, line, ptr2);
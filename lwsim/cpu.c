@@ -0,0 +1,1594 @@
+/*
+cpu.c
+
+Copyright © 2026 William Astle
+
+This file is part of LWTOOLS.
+
+LWTOOLS is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <http://www.gnu.org/licenses/>.
+
+Executes 6809 and 6309 instructions. Cycle counts come from the lwasm cycle
+table so the simulator and the assembler listing always agree.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lwsim.h"
+
+// from lwasm/cycle.c
+int lwasm_cycle_indexed(int pb, int is6309);
+int lwasm_cycle_lookup(int opc, int is6309, int *flags);
+
+typedef struct
+{
+	int opc;							// direct page (or only) opcode, with prefix
+	char *name;
+	int kind;
+} simop_t;
+
+// kinds of entries in the opcode table; the family kinds expand to all
+// the addressing modes of an instruction from its direct page opcode
+enum
+{
+	F_GEN8 = 0x100,						// immediate 8, direct, indexed, extended
+	F_GEN16,							// immediate 16, direct, indexed, extended
+	F_MEM,								// direct, indexed, extended
+	F_RMW,								// direct $0x, indexed $6x, extended $7x
+	F_IMMRMW							// F_RMW with an immediate byte first
+};
+
+static simop_t simops[] =
+{
+	{ 0x00, "NEG", F_RMW },
+	{ 0x01, "OIM", F_IMMRMW },
+	{ 0x02, "AIM", F_IMMRMW },
+	{ 0x03, "COM", F_RMW },
+	{ 0x04, "LSR", F_RMW },
+	{ 0x05, "EIM", F_IMMRMW },
+	{ 0x06, "ROR", F_RMW },
+	{ 0x07, "ASR", F_RMW },
+	{ 0x08, "ASL", F_RMW },
+	{ 0x09, "ROL", F_RMW },
+	{ 0x0a, "DEC", F_RMW },
+	{ 0x0b, "TIM", F_IMMRMW },
+	{ 0x0c, "INC", F_RMW },
+	{ 0x0d, "TST", F_RMW },
+	{ 0x0e, "JMP", F_RMW },
+	{ 0x0f, "CLR", F_RMW },
+
+	{ 0x12, "NOP", SIM_INH },
+	{ 0x13, "SYNC", SIM_INH },
+	{ 0x14, "SEXW", SIM_INH },
+	{ 0x16, "LBRA", SIM_REL16 },
+	{ 0x17, "LBSR", SIM_REL16 },
+	{ 0x19, "DAA", SIM_INH },
+	{ 0x1a, "ORCC", SIM_IMM8 },
+	{ 0x1c, "ANDCC", SIM_IMM8 },
+	{ 0x1d, "SEX", SIM_INH },
+	{ 0x1e, "EXG", SIM_POST },
+	{ 0x1f, "TFR", SIM_POST },
+
+	{ 0x20, "BRA", SIM_REL8 },
+	{ 0x21, "BRN", SIM_REL8 },
+	{ 0x22, "BHI", SIM_REL8 },
+	{ 0x23, "BLS", SIM_REL8 },
+	{ 0x24, "BCC", SIM_REL8 },
+	{ 0x25, "BCS", SIM_REL8 },
+	{ 0x26, "BNE", SIM_REL8 },
+	{ 0x27, "BEQ", SIM_REL8 },
+	{ 0x28, "BVC", SIM_REL8 },
+	{ 0x29, "BVS", SIM_REL8 },
+	{ 0x2a, "BPL", SIM_REL8 },
+	{ 0x2b, "BMI", SIM_REL8 },
+	{ 0x2c, "BGE", SIM_REL8 },
+	{ 0x2d, "BLT", SIM_REL8 },
+	{ 0x2e, "BGT", SIM_REL8 },
+	{ 0x2f, "BLE", SIM_REL8 },
+
+	{ 0x30, "LEAX", SIM_IDX },
+	{ 0x31, "LEAY", SIM_IDX },
+	{ 0x32, "LEAS", SIM_IDX },
+	{ 0x33, "LEAU", SIM_IDX },
+	{ 0x34, "PSHS", SIM_POST },
+	{ 0x35, "PULS", SIM_POST },
+	{ 0x36, "PSHU", SIM_POST },
+	{ 0x37, "PULU", SIM_POST },
+	{ 0x39, "RTS", SIM_INH },
+	{ 0x3a, "ABX", SIM_INH },
+	{ 0x3b, "RTI", SIM_INH },
+	{ 0x3c, "CWAI", SIM_IMM8 },
+	{ 0x3d, "MUL", SIM_INH },
+	{ 0x3f, "SWI", SIM_INH },
+
+	{ 0x40, "NEGA", SIM_INH },
+	{ 0x43, "COMA", SIM_INH },
+	{ 0x44, "LSRA", SIM_INH },
+	{ 0x46, "RORA", SIM_INH },
+	{ 0x47, "ASRA", SIM_INH },
+	{ 0x48, "ASLA", SIM_INH },
+	{ 0x49, "ROLA", SIM_INH },
+	{ 0x4a, "DECA", SIM_INH },
+	{ 0x4c, "INCA", SIM_INH },
+	{ 0x4d, "TSTA", SIM_INH },
+	{ 0x4f, "CLRA", SIM_INH },
+
+	{ 0x50, "NEGB", SIM_INH },
+	{ 0x53, "COMB", SIM_INH },
+	{ 0x54, "LSRB", SIM_INH },
+	{ 0x56, "RORB", SIM_INH },
+	{ 0x57, "ASRB", SIM_INH },
+	{ 0x58, "ASLB", SIM_INH },
+	{ 0x59, "ROLB", SIM_INH },
+	{ 0x5a, "DECB", SIM_INH },
+	{ 0x5c, "INCB", SIM_INH },
+	{ 0x5d, "TSTB", SIM_INH },
+	{ 0x5f, "CLRB", SIM_INH },
+
+	{ 0x90, "SUBA", F_GEN8 },
+	{ 0x91, "CMPA", F_GEN8 },
+	{ 0x92, "SBCA", F_GEN8 },
+	{ 0x93, "SUBD", F_GEN16 },
+	{ 0x94, "ANDA", F_GEN8 },
+	{ 0x95, "BITA", F_GEN8 },
+	{ 0x96, "LDA", F_GEN8 },
+	{ 0x97, "STA", F_MEM },
+	{ 0x98, "EORA", F_GEN8 },
+	{ 0x99, "ADCA", F_GEN8 },
+	{ 0x9a, "ORA", F_GEN8 },
+	{ 0x9b, "ADDA", F_GEN8 },
+	{ 0x9c, "CMPX", F_GEN16 },
+	{ 0x8d, "BSR", SIM_REL8 },
+	{ 0x9d, "JSR", F_MEM },
+	{ 0x9e, "LDX", F_GEN16 },
+	{ 0x9f, "STX", F_MEM },
+
+	{ 0xd0, "SUBB", F_GEN8 },
+	{ 0xd1, "CMPB", F_GEN8 },
+	{ 0xd2, "SBCB", F_GEN8 },
+	{ 0xd3, "ADDD", F_GEN16 },
+	{ 0xd4, "ANDB", F_GEN8 },
+	{ 0xd5, "BITB", F_GEN8 },
+	{ 0xd6, "LDB", F_GEN8 },
+	{ 0xd7, "STB", F_MEM },
+	{ 0xd8, "EORB", F_GEN8 },
+	{ 0xd9, "ADCB", F_GEN8 },
+	{ 0xda, "ORB", F_GEN8 },
+	{ 0xdb, "ADDB", F_GEN8 },
+	{ 0xdc, "LDD", F_GEN16 },
+	{ 0xcd, "LDQ", SIM_IMM32 },
+	{ 0xdd, "STD", F_MEM },
+	{ 0xde, "LDU", F_GEN16 },
+	{ 0xdf, "STU", F_MEM },
+
+	{ 0x1021, "LBRN", SIM_REL16 },
+	{ 0x1022, "LBHI", SIM_REL16 },
+	{ 0x1023, "LBLS", SIM_REL16 },
+	{ 0x1024, "LBCC", SIM_REL16 },
+	{ 0x1025, "LBCS", SIM_REL16 },
+	{ 0x1026, "LBNE", SIM_REL16 },
+	{ 0x1027, "LBEQ", SIM_REL16 },
+	{ 0x1028, "LBVC", SIM_REL16 },
+	{ 0x1029, "LBVS", SIM_REL16 },
+	{ 0x102a, "LBPL", SIM_REL16 },
+	{ 0x102b, "LBMI", SIM_REL16 },
+	{ 0x102c, "LBGE", SIM_REL16 },
+	{ 0x102d, "LBLT", SIM_REL16 },
+	{ 0x102e, "LBGT", SIM_REL16 },
+	{ 0x102f, "LBLE", SIM_REL16 },
+
+	{ 0x1030, "ADDR", SIM_POST },
+	{ 0x1031, "ADCR", SIM_POST },
+	{ 0x1032, "SUBR", SIM_POST },
+	{ 0x1033, "SBCR", SIM_POST },
+	{ 0x1034, "ANDR", SIM_POST },
+	{ 0x1035, "ORR", SIM_POST },
+	{ 0x1036, "EORR", SIM_POST },
+	{ 0x1037, "CMPR", SIM_POST },
+	{ 0x1038, "PSHSW", SIM_INH },
+	{ 0x1039, "PULSW", SIM_INH },
+	{ 0x103a, "PSHUW", SIM_INH },
+	{ 0x103b, "PULUW", SIM_INH },
+	{ 0x103f, "SWI2", SIM_INH },
+
+	{ 0x1040, "NEGD", SIM_INH },
+	{ 0x1043, "COMD", SIM_INH },
+	{ 0x1044, "LSRD", SIM_INH },
+	{ 0x1046, "RORD", SIM_INH },
+	{ 0x1047, "ASRD", SIM_INH },
+	{ 0x1048, "ASLD", SIM_INH },
+	{ 0x1049, "ROLD", SIM_INH },
+	{ 0x104a, "DECD", SIM_INH },
+	{ 0x104c, "INCD", SIM_INH },
+	{ 0x104d, "TSTD", SIM_INH },
+	{ 0x104f, "CLRD", SIM_INH },
+
+	{ 0x1053, "COMW", SIM_INH },
+	{ 0x1054, "LSRW", SIM_INH },
+	{ 0x1056, "RORW", SIM_INH },
+	{ 0x1059, "ROLW", SIM_INH },
+	{ 0x105a, "DECW", SIM_INH },
+	{ 0x105c, "INCW", SIM_INH },
+	{ 0x105d, "TSTW", SIM_INH },
+	{ 0x105f, "CLRW", SIM_INH },
+
+	{ 0x1090, "SUBW", F_GEN16 },
+	{ 0x1091, "CMPW", F_GEN16 },
+	{ 0x1092, "SBCD", F_GEN16 },
+	{ 0x1093, "CMPD", F_GEN16 },
+	{ 0x1094, "ANDD", F_GEN16 },
+	{ 0x1095, "BITD", F_GEN16 },
+	{ 0x1096, "LDW", F_GEN16 },
+	{ 0x1097, "STW", F_MEM },
+	{ 0x1098, "EORD", F_GEN16 },
+	{ 0x1099, "ADCD", F_GEN16 },
+	{ 0x109a, "ORD", F_GEN16 },
+	{ 0x109b, "ADDW", F_GEN16 },
+	{ 0x109c, "CMPY", F_GEN16 },
+	{ 0x109e, "LDY", F_GEN16 },
+	{ 0x109f, "STY", F_MEM },
+	{ 0x10dc, "LDQ", F_MEM },
+	{ 0x10dd, "STQ", F_MEM },
+	{ 0x10de, "LDS", F_GEN16 },
+	{ 0x10df, "STS", F_MEM },
+
+	{ 0x1130, "BAND", SIM_BIT },
+	{ 0x1131, "BIAND", SIM_BIT },
+	{ 0x1132, "BOR", SIM_BIT },
+	{ 0x1133, "BIOR", SIM_BIT },
+	{ 0x1134, "BEOR", SIM_BIT },
+	{ 0x1135, "BIEOR", SIM_BIT },
+	{ 0x1136, "LDBT", SIM_BIT },
+	{ 0x1137, "STBT", SIM_BIT },
+	{ 0x1138, "TFM", SIM_POST },
+	{ 0x1139, "TFM", SIM_POST },
+	{ 0x113a, "TFM", SIM_POST },
+	{ 0x113b, "TFM", SIM_POST },
+	{ 0x113c, "BITMD", SIM_IMM8 },
+	{ 0x113d, "LDMD", SIM_IMM8 },
+	{ 0x113f, "SWI3", SIM_INH },
+
+	{ 0x1143, "COME", SIM_INH },
+	{ 0x114a, "DECE", SIM_INH },
+	{ 0x114c, "INCE", SIM_INH },
+	{ 0x114d, "TSTE", SIM_INH },
+	{ 0x114f, "CLRE", SIM_INH },
+	{ 0x1153, "COMF", SIM_INH },
+	{ 0x115a, "DECF", SIM_INH },
+	{ 0x115c, "INCF", SIM_INH },
+	{ 0x115d, "TSTF", SIM_INH },
+	{ 0x115f, "CLRF", SIM_INH },
+
+	{ 0x1190, "SUBE", F_GEN8 },
+	{ 0x1191, "CMPE", F_GEN8 },
+	{ 0x1193, "CMPU", F_GEN16 },
+	{ 0x1196, "LDE", F_GEN8 },
+	{ 0x1197, "STE", F_MEM },
+	{ 0x119b, "ADDE", F_GEN8 },
+	{ 0x119c, "CMPS", F_GEN16 },
+	{ 0x119d, "DIVD", F_GEN8 },
+	{ 0x119e, "DIVQ", F_GEN16 },
+	{ 0x119f, "MULD", F_GEN16 },
+	{ 0x11d0, "SUBF", F_GEN8 },
+	{ 0x11d1, "CMPF", F_GEN8 },
+	{ 0x11d6, "LDF", F_GEN8 },
+	{ 0x11d7, "STF", F_MEM },
+	{ 0x11db, "ADDF", F_GEN8 },
+
+	{ -1 }
+};
+
+// instructions only the 6309 has
+static int sim6309only[] =
+{
+	0x01, 0x02, 0x05, 0x0b, 0x14, 0xcd,
+	0x1030, 0x1031, 0x1032, 0x1033, 0x1034, 0x1035, 0x1036, 0x1037,
+	0x1038, 0x1039, 0x103a, 0x103b,
+	0x1040, 0x1043, 0x1044, 0x1046, 0x1047, 0x1048, 0x1049, 0x104a,
+	0x104c, 0x104d, 0x104f, 0x1053, 0x1054, 0x1056, 0x1059, 0x105a,
+	0x105c, 0x105d, 0x105f, 0x1090, 0x1091, 0x1092, 0x1094, 0x1095,
+	0x1096, 0x1097, 0x1098, 0x1099, 0x109a, 0x109b, 0x10dc, 0x10dd,
+	0x1130, 0x1131, 0x1132, 0x1133, 0x1134, 0x1135, 0x1136, 0x1137,
+	0x1138, 0x1139, 0x113a, 0x113b, 0x113c, 0x113d,
+	0x1143, 0x114a, 0x114c, 0x114d, 0x114f, 0x1153, 0x115a, 0x115c,
+	0x115d, 0x115f, 0x1190, 0x1191, 0x1196, 0x1197, 0x119b, 0x119d,
+	0x119e, 0x119f, 0x11d0, 0x11d1, 0x11d6, 0x11d7, 0x11db,
+	-1
+};
+
+typedef struct
+{
+	char *name;
+	int mode;
+	int only6309;
+} simdecode_t;
+
+// indexed by page (none, $10, $11) and opcode
+static simdecode_t simdecode[3][256];
+
+static int sim_page(int opc)
+{
+	if (opc < 0x100)
+		return 0;
+	return (opc >> 8) - 0x0f;
+}
+
+static void sim_define(int opc, char *name, int mode)
+{
+	simdecode[sim_page(opc)][opc & 0xff].name = name;
+	simdecode[sim_page(opc)][opc & 0xff].mode = mode;
+}
+
+void sim_init(void)
+{
+	int i, o;
+
+	memset(simdecode, 0, sizeof(simdecode));
+	for (i = 0; simops[i].opc != -1; i++)
+	{
+		o = simops[i].opc;
+		switch (simops[i].kind)
+		{
+		case F_GEN8:
+		case F_GEN16:
+			sim_define(o - 0x10, simops[i].name, simops[i].kind == F_GEN8 ? SIM_IMM8 : SIM_IMM16);
+			// fall through
+		case F_MEM:
+			sim_define(o, simops[i].name, SIM_DIR);
+			sim_define(o + 0x10, simops[i].name, SIM_IDX);
+			sim_define(o + 0x20, simops[i].name, SIM_EXT);
+			break;
+
+		case F_RMW:
+			sim_define(o, simops[i].name, SIM_DIR);
+			sim_define(o + 0x60, simops[i].name, SIM_IDX);
+			sim_define(o + 0x70, simops[i].name, SIM_EXT);
+			break;
+
+		case F_IMMRMW:
+			sim_define(o, simops[i].name, SIM_IMMDIR);
+			sim_define(o + 0x60, simops[i].name, SIM_IMMIDX);
+			sim_define(o + 0x70, simops[i].name, SIM_IMMEXT);
+			break;
+
+		default:
+			sim_define(o, simops[i].name, simops[i].kind);
+			break;
+		}
+	}
+
+	// the 6309 instructions come in families too; mark every mode
+	for (i = 0; sim6309only[i] != -1; i++)
+	{
+		o = sim6309only[i];
+		simdecode[sim_page(o)][o & 0xff].only6309 = 1;
+		if ((o & 0xf0) == 0x90 || (o & 0xf0) == 0xd0)
+		{
+			simdecode[sim_page(o)][(o - 0x10) & 0xff].only6309 = 1;
+			simdecode[sim_page(o)][(o + 0x10) & 0xff].only6309 = 1;
+			simdecode[sim_page(o)][(o + 0x20) & 0xff].only6309 = 1;
+		}
+		else if (o < 0x10)
+		{
+			simdecode[0][o + 0x60].only6309 = 1;
+			simdecode[0][o + 0x70].only6309 = 1;
+		}
+	}
+}
+
+/* name of the instruction with opcode opc (including any prefix) */
+const char *sim_mnemonic(int opc)
+{
+	char *n = simdecode[sim_page(opc)][opc & 0xff].name;
+
+	return n ? n : "???";
+}
+
+void sim_reset(simcpu_t *cpu)
+{
+	cpu -> a = cpu -> b = cpu -> e = cpu -> f = 0;
+	cpu -> x = cpu -> y = cpu -> u = cpu -> s = cpu -> v = 0;
+	cpu -> pc = 0;
+	cpu -> dp = 0;
+	cpu -> cc = CC_I | CC_F;
+	cpu -> md = cpu -> is6309 ? 1 : 0;
+	cpu -> err = NULL;
+}
+
+// data accesses are counted at the address they start at
+static inline int rd8(simcpu_t *cpu, int a)
+{
+	if (cpu -> access)
+		cpu -> access[a & 0xffff]++;
+	return cpu -> mem[a & 0xffff];
+}
+
+static inline int rd16(simcpu_t *cpu, int a)
+{
+	if (cpu -> access)
+		cpu -> access[a & 0xffff]++;
+	return (cpu -> mem[a & 0xffff] << 8) | cpu -> mem[(a + 1) & 0xffff];
+}
+
+static inline void wr8(simcpu_t *cpu, int a, int v)
+{
+	if (cpu -> access)
+		cpu -> access[a & 0xffff]++;
+	cpu -> mem[a & 0xffff] = v;
+}
+
+static inline void wr16(simcpu_t *cpu, int a, int v)
+{
+	if (cpu -> access)
+		cpu -> access[a & 0xffff]++;
+	cpu -> mem[a & 0xffff] = v >> 8;
+	cpu -> mem[(a + 1) & 0xffff] = v;
+}
+
+static inline int fetch8(simcpu_t *cpu)
+{
+	int v = cpu -> mem[cpu -> pc];
+	cpu -> pc = (cpu -> pc + 1) & 0xffff;
+	return v;
+}
+
+static inline int fetch16(simcpu_t *cpu)
+{
+	int v = (cpu -> mem[cpu -> pc] << 8) | cpu -> mem[(cpu -> pc + 1) & 0xffff];
+	cpu -> pc = (cpu -> pc + 2) & 0xffff;
+	return v;
+}
+
+static inline int sext8(int v)
+{
+	return (v & 0x80) ? (v | ~0xff) : (v & 0xff);
+}
+
+static inline int sext16(int v)
+{
+	return (v & 0x8000) ? (v | ~0xffff) : (v & 0xffff);
+}
+
+#define REG_D(cpu) (((cpu) -> a << 8) | (cpu) -> b)
+#define REG_W(cpu) (((cpu) -> e << 8) | (cpu) -> f)
+
+static inline void set_d(simcpu_t *cpu, int v)
+{
+	cpu -> a = (v >> 8) & 0xff;
+	cpu -> b = v & 0xff;
+}
+
+static inline void set_w(simcpu_t *cpu, int v)
+{
+	cpu -> e = (v >> 8) & 0xff;
+	cpu -> f = v & 0xff;
+}
+
+static inline void push8(simcpu_t *cpu, int *sp, int v)
+{
+	*sp = (*sp - 1) & 0xffff;
+	wr8(cpu, *sp, v);
+}
+
+static inline void push16(simcpu_t *cpu, int *sp, int v)
+{
+	push8(cpu, sp, v);
+	push8(cpu, sp, v >> 8);
+}
+
+static inline int pull8(simcpu_t *cpu, int *sp)
+{
+	int v = rd8(cpu, *sp);
+	*sp = (*sp + 1) & 0xffff;
+	return v;
+}
+
+static inline int pull16(simcpu_t *cpu, int *sp)
+{
+	int v = pull8(cpu, sp) << 8;
+	return v | pull8(cpu, sp);
+}
+
+/*
+Register numbers are those used in TFR/EXG post bytes. Mixing sizes follows
+the 6309: an 8 bit accumulator reads as its 16 bit pair and CC or DP is
+copied into both bytes. The 6809 fills the high byte with $FF instead.
+*/
+int sim_getreg(simcpu_t *cpu, int r)
+{
+	switch (r)
+	{
+	case 0: return REG_D(cpu);
+	case 1: return cpu -> x;
+	case 2: return cpu -> y;
+	case 3: return cpu -> u;
+	case 4: return cpu -> s;
+	case 5: return cpu -> pc;
+	case 6: return REG_W(cpu);
+	case 7: return cpu -> v;
+	case 8: return cpu -> a;
+	case 9: return cpu -> b;
+	case 10: return cpu -> cc;
+	case 11: return cpu -> dp;
+	case 14: return cpu -> e;
+	case 15: return cpu -> f;
+	}
+	return 0;
+}
+
+void sim_setreg(simcpu_t *cpu, int r, int v)
+{
+	switch (r)
+	{
+	case 0: set_d(cpu, v); break;
+	case 1: cpu -> x = v & 0xffff; break;
+	case 2: cpu -> y = v & 0xffff; break;
+	case 3: cpu -> u = v & 0xffff; break;
+	case 4: cpu -> s = v & 0xffff; break;
+	case 5: cpu -> pc = v & 0xffff; break;
+	case 6: set_w(cpu, v); break;
+	case 7: cpu -> v = v & 0xffff; break;
+	case 8: cpu -> a = v & 0xff; break;
+	case 9: cpu -> b = v & 0xff; break;
+	case 10: cpu -> cc = v & 0xff; break;
+	case 11: cpu -> dp = v & 0xff; break;
+	case 14: cpu -> e = v & 0xff; break;
+	case 15: cpu -> f = v & 0xff; break;
+	}
+}
+
+static inline int reg_is16(int r)
+{
+	return r < 8;
+}
+
+// read register r as seen by a transfer into register d
+static int sim_xferval(simcpu_t *cpu, int r, int d)
+{
+	int v = sim_getreg(cpu, r);
+
+	if (reg_is16(r) == reg_is16(d))
+		return v;
+	if (reg_is16(r))
+		return v & 0xff;
+	if (!cpu -> is6309)
+		return 0xff00 | v;
+	switch (r)
+	{
+	case 8: case 9: return REG_D(cpu);
+	case 14: case 15: return REG_W(cpu);
+	}
+	return (v << 8) | v;
+}
+
+/* flag helpers */
+static inline void setnz8(simcpu_t *cpu, int r)
+{
+	cpu -> cc &= ~(CC_N | CC_Z);
+	if (r & 0x80)
+		cpu -> cc |= CC_N;
+	if ((r & 0xff) == 0)
+		cpu -> cc |= CC_Z;
+}
+
+static inline void setnz16(simcpu_t *cpu, int r)
+{
+	cpu -> cc &= ~(CC_N | CC_Z);
+	if (r & 0x8000)
+		cpu -> cc |= CC_N;
+	if ((r & 0xffff) == 0)
+		cpu -> cc |= CC_Z;
+}
+
+static inline int logic8(simcpu_t *cpu, int r)
+{
+	setnz8(cpu, r);
+	cpu -> cc &= ~CC_V;
+	return r & 0xff;
+}
+
+static inline int logic16(simcpu_t *cpu, int r)
+{
+	setnz16(cpu, r);
+	cpu -> cc &= ~CC_V;
+	return r & 0xffff;
+}
+
+static int add8(simcpu_t *cpu, int a, int b, int c)
+{
+	int r = a + b + c;
+
+	cpu -> cc &= ~(CC_H | CC_V | CC_C);
+	if ((a ^ b ^ r) & 0x10)
+		cpu -> cc |= CC_H;
+	if ((a ^ r) & (b ^ r) & 0x80)
+		cpu -> cc |= CC_V;
+	if (r & 0x100)
+		cpu -> cc |= CC_C;
+	setnz8(cpu, r);
+	return r & 0xff;
+}
+
+static int sub8(simcpu_t *cpu, int a, int b, int c)
+{
+	int r = a - b - c;
+
+	cpu -> cc &= ~(CC_V | CC_C);
+	if ((a ^ b) & (a ^ r) & 0x80)
+		cpu -> cc |= CC_V;
+	if (r & 0x100)
+		cpu -> cc |= CC_C;
+	setnz8(cpu, r);
+	return r & 0xff;
+}
+
+static int add16(simcpu_t *cpu, int a, int b, int c)
+{
+	int r = a + b + c;
+
+	cpu -> cc &= ~(CC_V | CC_C);
+	if ((a ^ r) & (b ^ r) & 0x8000)
+		cpu -> cc |= CC_V;
+	if (r & 0x10000)
+		cpu -> cc |= CC_C;
+	setnz16(cpu, r);
+	return r & 0xffff;
+}
+
+static int sub16(simcpu_t *cpu, int a, int b, int c)
+{
+	int r = a - b - c;
+
+	cpu -> cc &= ~(CC_V | CC_C);
+	if ((a ^ b) & (a ^ r) & 0x8000)
+		cpu -> cc |= CC_V;
+	if (r & 0x10000)
+		cpu -> cc |= CC_C;
+	setnz16(cpu, r);
+	return r & 0xffff;
+}
+
+#define CARRY(cpu) ((cpu) -> cc & CC_C ? 1 : 0)
+
+// the read-modify-write operations shared by memory, accumulators, D, and W;
+// op is the low nibble of the opcode and bits is 8 or 16
+static int sim_rmw(simcpu_t *cpu, int op, int m, int bits)
+{
+	int sign = bits == 8 ? 0x80 : 0x8000;
+	int mask = bits == 8 ? 0xff : 0xffff;
+	int r;
+
+	switch (op)
+	{
+	case 0x0:	// NEG
+		return bits == 8 ? sub8(cpu, 0, m, 0) : sub16(cpu, 0, m, 0);
+
+	case 0x3:	// COM
+		r = ~m & mask;
+		cpu -> cc = (cpu -> cc & ~CC_V) | CC_C;
+		break;
+
+	case 0x4:	// LSR
+		cpu -> cc = (cpu -> cc & ~CC_C) | (m & 1);
+		r = m >> 1;
+		break;
+
+	case 0x6:	// ROR
+		r = (m >> 1) | (CARRY(cpu) ? sign : 0);
+		cpu -> cc = (cpu -> cc & ~CC_C) | (m & 1);
+		break;
+
+	case 0x7:	// ASR
+		r = (m >> 1) | (m & sign);
+		cpu -> cc = (cpu -> cc & ~CC_C) | (m & 1);
+		break;
+
+	case 0x8:	// ASL
+	case 0x9:	// ROL
+		r = ((m << 1) | (op == 0x9 ? CARRY(cpu) : 0)) & mask;
+		cpu -> cc &= ~(CC_V | CC_C);
+		if (m & sign)
+			cpu -> cc |= CC_C;
+		if ((m ^ (m << 1)) & sign)
+			cpu -> cc |= CC_V;
+		break;
+
+	case 0xa:	// DEC
+		r = (m - 1) & mask;
+		cpu -> cc &= ~CC_V;
+		if (m == sign)
+			cpu -> cc |= CC_V;
+		break;
+
+	case 0xc:	// INC
+		r = (m + 1) & mask;
+		cpu -> cc &= ~CC_V;
+		if (m == sign - 1)
+			cpu -> cc |= CC_V;
+		break;
+
+	case 0xd:	// TST
+		r = m;
+		cpu -> cc &= ~CC_V;
+		break;
+
+	case 0xf:	// CLR
+		r = 0;
+		cpu -> cc &= ~(CC_V | CC_C);
+		break;
+
+	default:
+		return m;
+	}
+	if (bits == 8)
+		setnz8(cpu, r);
+	else
+		setnz16(cpu, r);
+	return r;
+}
+
+static int sim_cond(simcpu_t *cpu, int op)
+{
+	int cc = cpu -> cc;
+	int n = (cc & CC_N) ? 1 : 0;
+	int v = (cc & CC_V) ? 1 : 0;
+	int r;
+
+	switch ((op >> 1) & 7)
+	{
+	case 0: r = 1; break;						// BRA
+	case 1: r = !(cc & (CC_C | CC_Z)); break;	// BHI
+	case 2: r = !(cc & CC_C); break;			// BCC
+	case 3: r = !(cc & CC_Z); break;			// BNE
+	case 4: r = !(cc & CC_V); break;			// BVC
+	case 5: r = !(cc & CC_N); break;			// BPL
+	case 6: r = n == v; break;					// BGE
+	default: r = !(cc & CC_Z) && n == v; break;	// BGT
+	}
+	return (op & 1) ? !r : r;
+}
+
+// work out an indexed effective address; returns -1 for an invalid post byte
+static int sim_indexed(simcpu_t *cpu, int *extra)
+{
+	int pb = fetch8(cpu);
+	int *rp;
+	int ea, w;
+
+	*extra = lwasm_cycle_indexed(pb, cpu -> is6309);
+	switch ((pb >> 5) & 3)
+	{
+	case 0: rp = &(cpu -> x); break;
+	case 1: rp = &(cpu -> y); break;
+	case 2: rp = &(cpu -> u); break;
+	default: rp = &(cpu -> s); break;
+	}
+
+	if (!(pb & 0x80))
+		return (*rp + ((pb & 0x10) ? (pb | ~0x1f) : (pb & 0x0f))) & 0xffff;
+
+	if (cpu -> is6309 && ((pb & 0x9f) == 0x8f || (pb & 0x9f) == 0x90))
+	{
+		// W based modes replace ,R+ indirect and the unused mode 15
+		w = REG_W(cpu);
+		switch (pb & 0x60)
+		{
+		case 0x00:	// ,W
+			ea = w;
+			break;
+		case 0x20:	// n,W
+			ea = (w + fetch16(cpu)) & 0xffff;
+			break;
+		case 0x40:	// ,W++
+			ea = w;
+			set_w(cpu, w + 2);
+			break;
+		default:	// ,--W
+			w = (w - 2) & 0xffff;
+			set_w(cpu, w);
+			ea = w;
+			break;
+		}
+		return (pb & 0x10) ? rd16(cpu, ea) : ea;
+	}
+
+	if (*extra < 0)
+		return -1;
+	switch (pb & 0x0f)
+	{
+	case 0x0:
+		ea = *rp;
+		*rp = (*rp + 1) & 0xffff;
+		break;
+	case 0x1:
+		ea = *rp;
+		*rp = (*rp + 2) & 0xffff;
+		break;
+	case 0x2:
+		*rp = (*rp - 1) & 0xffff;
+		ea = *rp;
+		break;
+	case 0x3:
+		*rp = (*rp - 2) & 0xffff;
+		ea = *rp;
+		break;
+	case 0x4:
+		ea = *rp;
+		break;
+	case 0x5:
+		ea = *rp + sext8(cpu -> b);
+		break;
+	case 0x6:
+		ea = *rp + sext8(cpu -> a);
+		break;
+	case 0x7:
+		if (!cpu -> is6309)
+			return -1;
+		ea = *rp + sext8(cpu -> e);
+		break;
+	case 0x8:
+		ea = *rp + sext8(fetch8(cpu));
+		break;
+	case 0x9:
+		ea = *rp + fetch16(cpu);
+		break;
+	case 0xa:
+		if (!cpu -> is6309)
+			return -1;
+		ea = *rp + sext8(cpu -> f);
+		break;
+	case 0xb:
+		ea = *rp + REG_D(cpu);
+		break;
+	case 0xc:
+		ea = sext8(fetch8(cpu));
+		ea += cpu -> pc;
+		break;
+	case 0xd:
+		ea = fetch16(cpu);
+		ea += cpu -> pc;
+		break;
+	case 0xe:
+		if (!cpu -> is6309)
+			return -1;
+		ea = *rp + REG_W(cpu);
+		break;
+	default:
+		if (pb != 0x9f)
+			return -1;
+		ea = fetch16(cpu);
+		break;
+	}
+	ea &= 0xffff;
+	return (pb & 0x10) ? rd16(cpu, ea) : ea;
+}
+
+// stack the whole machine state as for an interrupt
+static void sim_stackall(simcpu_t *cpu)
+{
+	cpu -> cc |= CC_E;
+	push16(cpu, &(cpu -> s), cpu -> pc);
+	push16(cpu, &(cpu -> s), cpu -> u);
+	push16(cpu, &(cpu -> s), cpu -> y);
+	push16(cpu, &(cpu -> s), cpu -> x);
+	push8(cpu, &(cpu -> s), cpu -> dp);
+	if (cpu -> is6309)
+	{
+		push8(cpu, &(cpu -> s), cpu -> f);
+		push8(cpu, &(cpu -> s), cpu -> e);
+	}
+	push8(cpu, &(cpu -> s), cpu -> b);
+	push8(cpu, &(cpu -> s), cpu -> a);
+	push8(cpu, &(cpu -> s), cpu -> cc);
+}
+
+// PSHS/PSHU/PULS/PULU; returns the extra cycles
+static int sim_rlist(simcpu_t *cpu, int pull, int *sp, int *other, int pb)
+{
+	int n = 0;
+
+	if (pull)
+	{
+		if (pb & 0x01) { cpu -> cc = pull8(cpu, sp); n += 1; }
+		if (pb & 0x02) { cpu -> a = pull8(cpu, sp); n += 1; }
+		if (pb & 0x04) { cpu -> b = pull8(cpu, sp); n += 1; }
+		if (pb & 0x08) { cpu -> dp = pull8(cpu, sp); n += 1; }
+		if (pb & 0x10) { cpu -> x = pull16(cpu, sp); n += 2; }
+		if (pb & 0x20) { cpu -> y = pull16(cpu, sp); n += 2; }
+		if (pb & 0x40) { *other = pull16(cpu, sp); n += 2; }
+		if (pb & 0x80) { cpu -> pc = pull16(cpu, sp); n += 2; }
+	}
+	else
+	{
+		if (pb & 0x80) { push16(cpu, sp, cpu -> pc); n += 2; }
+		if (pb & 0x40) { push16(cpu, sp, *other); n += 2; }
+		if (pb & 0x20) { push16(cpu, sp, cpu -> y); n += 2; }
+		if (pb & 0x10) { push16(cpu, sp, cpu -> x); n += 2; }
+		if (pb & 0x08) { push8(cpu, sp, cpu -> dp); n += 1; }
+		if (pb & 0x04) { push8(cpu, sp, cpu -> b); n += 1; }
+		if (pb & 0x02) { push8(cpu, sp, cpu -> a); n += 1; }
+		if (pb & 0x01) { push8(cpu, sp, cpu -> cc); n += 1; }
+	}
+	return n;
+}
+
+// ADDR, ADCR, SUBR, SBCR, ANDR, ORR, EORR, CMPR; the size of the
+// destination sets the size of the operation
+static void sim_regop(simcpu_t *cpu, int op, int pb)
+{
+	int r0 = pb >> 4, r1 = pb & 0x0f;
+	int a, b, r;
+
+	a = sim_getreg(cpu, r1);
+	b = sim_xferval(cpu, r0, r1);
+	if (reg_is16(r1))
+	{
+		switch (op)
+		{
+		case 0: r = add16(cpu, a, b, 0); break;
+		case 1: r = add16(cpu, a, b, CARRY(cpu)); break;
+		case 2: r = sub16(cpu, a, b, 0); break;
+		case 3: r = sub16(cpu, a, b, CARRY(cpu)); break;
+		case 4: r = logic16(cpu, a & b); break;
+		case 5: r = logic16(cpu, a | b); break;
+		case 6: r = logic16(cpu, a ^ b); break;
+		default: sub16(cpu, a, b, 0); return;
+		}
+	}
+	else
+	{
+		switch (op)
+		{
+		case 0: r = add8(cpu, a, b, 0); break;
+		case 1: r = add8(cpu, a, b, CARRY(cpu)); break;
+		case 2: r = sub8(cpu, a, b, 0); break;
+		case 3: r = sub8(cpu, a, b, CARRY(cpu)); break;
+		case 4: r = logic8(cpu, a & b); break;
+		case 5: r = logic8(cpu, a | b); break;
+		case 6: r = logic8(cpu, a ^ b); break;
+		default: sub8(cpu, a, b, 0); return;
+		}
+	}
+	// the zero registers ignore writes
+	sim_setreg(cpu, r1, r);
+}
+
+// TFM; returns the number of bytes moved or -1 for bad registers
+static int sim_tfm(simcpu_t *cpu, int op, int pb)
+{
+	int r0 = pb >> 4, r1 = pb & 0x0f;
+	int s, d, w, n = 0;
+	int ds = (op == 0x38 || op == 0x3a) ? 1 : (op == 0x39 ? -1 : 0);
+	int dd = (op == 0x38 || op == 0x3b) ? 1 : (op == 0x39 ? -1 : 0);
+
+	if (r0 > 4 || r1 > 4)
+		return -1;
+	for (w = REG_W(cpu); w; w--, n++)
+	{
+		s = sim_getreg(cpu, r0);
+		d = sim_getreg(cpu, r1);
+		wr8(cpu, d, rd8(cpu, s));
+		sim_setreg(cpu, r0, s + ds);
+		sim_setreg(cpu, r1, d + dd);
+	}
+	set_w(cpu, 0);
+	return n;
+}
+
+static void sim_daa(simcpu_t *cpu)
+{
+	int a = cpu -> a, c = 0;
+	int lo = a & 0x0f, hi = a >> 4;
+
+	if (lo > 9 || (cpu -> cc & CC_H))
+		c |= 0x06;
+	if (hi > 9 || (cpu -> cc & CC_C) || (hi > 8 && lo > 9))
+		c |= 0x60;
+	a += c;
+	cpu -> cc &= ~(CC_V);
+	if (a & 0x100)
+		cpu -> cc |= CC_C;
+	cpu -> a = a & 0xff;
+	setnz8(cpu, cpu -> a);
+}
+
+// 6309 divides; returns -1 for division by zero
+static int sim_divd(simcpu_t *cpu, int m)
+{
+	int n = sext16(REG_D(cpu)), d = sext8(m), q;
+
+	if (d == 0)
+		return -1;
+	q = n / d;
+	cpu -> cc &= ~(CC_N | CC_Z | CC_V | CC_C);
+	if (q < -128 || q > 127)
+		cpu -> cc |= CC_V;
+	cpu -> a = (n % d) & 0xff;
+	cpu -> b = q & 0xff;
+	setnz8(cpu, cpu -> b);
+	if (q & 1)
+		cpu -> cc |= CC_C;
+	return 0;
+}
+
+static int sim_divq(simcpu_t *cpu, int m)
+{
+	long n = (long)(int)(((unsigned)REG_D(cpu) << 16) | REG_W(cpu));
+	long d = sext16(m), q;
+
+	if (d == 0)
+		return -1;
+	q = n / d;
+	cpu -> cc &= ~(CC_N | CC_Z | CC_V | CC_C);
+	if (q < -32768 || q > 32767)
+		cpu -> cc |= CC_V;
+	set_d(cpu, n % d);
+	set_w(cpu, q);
+	setnz16(cpu, q);
+	if (q & 1)
+		cpu -> cc |= CC_C;
+	return 0;
+}
+
+// the 6309 bit manipulation instructions
+static int sim_bitop(simcpu_t *cpu, int op, int pb, int ea)
+{
+	int r = pb >> 6, sb = (pb >> 3) & 7, db = pb & 7;
+	int rv, mv, bit;
+
+	if (r == 3)
+		return -1;
+	rv = r == 0 ? cpu -> cc : (r == 1 ? cpu -> a : cpu -> b);
+	mv = rd8(cpu, ea);
+	if (op == 0x37)
+	{
+		// STBT: register bit into memory
+		bit = (rv >> sb) & 1;
+		wr8(cpu, ea, (mv & ~(1 << db)) | (bit << db));
+		return 0;
+	}
+	bit = (mv >> sb) & 1;
+	if (op & 1)
+		bit = !bit;
+	switch (op)
+	{
+	case 0x30: case 0x31: bit &= (rv >> db) & 1; break;
+	case 0x32: case 0x33: bit |= (rv >> db) & 1; break;
+	case 0x34: case 0x35: bit ^= (rv >> db) & 1; break;
+	}
+	rv = (rv & ~(1 << db)) | (bit << db);
+	if (r == 0)
+		cpu -> cc = rv;
+	else if (r == 1)
+		cpu -> a = rv;
+	else
+		cpu -> b = rv;
+	return 0;
+}
+
+static int sim_fail(simcpu_t *cpu, const char *why)
+{
+	cpu -> err = why;
+	cpu -> pc = cpu -> opaddr;
+	return -1;
+}
+
+#define GEN4(o) case (o) - 0x10: case (o): case (o) + 0x10: case (o) + 0x20
+#define GEN3(o) case (o): case (o) + 0x10: case (o) + 0x20
+#define RMW3(o) case (o): case (o) + 0x60: case (o) + 0x70
+
+static int sim_exec(simcpu_t *cpu)
+{
+	simdecode_t *dc;
+	int opc, op, page = 0;
+	int ea = 0, pb = 0, imm = 0, extra = 0;
+	int cycles, t, m;
+
+	cpu -> opaddr = cpu -> pc;
+	op = fetch8(cpu);
+	if (op == 0x10 || op == 0x11)
+	{
+		// only the last of several prefixes counts
+		do
+		{
+			opc = op;
+			op = fetch8(cpu);
+		} while (op == 0x10 || op == 0x11);
+		page = opc - 0x0f;
+		opc = (opc << 8) | op;
+	}
+	else
+	{
+		opc = op;
+	}
+	cpu -> opc = opc;
+
+	dc = &simdecode[page][op];
+	if (dc -> mode == SIM_ILLEGAL || (dc -> only6309 && !cpu -> is6309))
+		return sim_fail(cpu, "illegal instruction");
+
+	cycles = lwasm_cycle_lookup(opc, cpu -> is6309, NULL);
+	if (cycles < 0)
+		return sim_fail(cpu, "instruction has no cycle count");
+
+	switch (dc -> mode)
+	{
+	case SIM_IMM8:
+		// immediate operands are not data accesses
+		cpu -> access = NULL;
+		ea = cpu -> pc;
+		cpu -> pc = (cpu -> pc + 1) & 0xffff;
+		break;
+
+	case SIM_IMM16:
+		cpu -> access = NULL;
+		ea = cpu -> pc;
+		cpu -> pc = (cpu -> pc + 2) & 0xffff;
+		break;
+
+	case SIM_IMM32:
+		cpu -> access = NULL;
+		ea = cpu -> pc;
+		cpu -> pc = (cpu -> pc + 4) & 0xffff;
+		break;
+
+	case SIM_IMMDIR:
+		imm = fetch8(cpu);
+		// fall through
+	case SIM_DIR:
+		ea = (cpu -> dp << 8) | fetch8(cpu);
+		break;
+
+	case SIM_IMMEXT:
+		imm = fetch8(cpu);
+		// fall through
+	case SIM_EXT:
+		ea = fetch16(cpu);
+		break;
+
+	case SIM_IMMIDX:
+		imm = fetch8(cpu);
+		// fall through
+	case SIM_IDX:
+		ea = sim_indexed(cpu, &extra);
+		if (ea < 0)
+			return sim_fail(cpu, "illegal indexing mode");
+		cycles += extra;
+		break;
+
+	case SIM_REL8:
+		t = sext8(fetch8(cpu));
+		ea = (cpu -> pc + t) & 0xffff;
+		break;
+
+	case SIM_REL16:
+		t = fetch16(cpu);
+		ea = (cpu -> pc + t) & 0xffff;
+		break;
+
+	case SIM_POST:
+		pb = fetch8(cpu);
+		break;
+
+	case SIM_BIT:
+		pb = fetch8(cpu);
+		ea = (cpu -> dp << 8) | fetch8(cpu);
+		break;
+	}
+
+	switch (opc)
+	{
+	// memory and accumulator read-modify-write
+	RMW3(0x00): RMW3(0x03): RMW3(0x04): RMW3(0x06): RMW3(0x07):
+	RMW3(0x08): RMW3(0x09): RMW3(0x0a): RMW3(0x0c): RMW3(0x0f):
+		wr8(cpu, ea, sim_rmw(cpu, op & 0x0f, rd8(cpu, ea), 8));
+		break;
+
+	RMW3(0x0d):
+		sim_rmw(cpu, 0x0d, rd8(cpu, ea), 8);
+		break;
+
+	RMW3(0x0e):
+		cpu -> pc = ea;
+		break;
+
+	RMW3(0x01):
+		wr8(cpu, ea, logic8(cpu, rd8(cpu, ea) | imm));
+		break;
+
+	RMW3(0x02):
+		wr8(cpu, ea, logic8(cpu, rd8(cpu, ea) & imm));
+		break;
+
+	RMW3(0x05):
+		wr8(cpu, ea, logic8(cpu, rd8(cpu, ea) ^ imm));
+		break;
+
+	RMW3(0x0b):
+		logic8(cpu, rd8(cpu, ea) & imm);
+		break;
+
+	case 0x40: case 0x43: case 0x44: case 0x46: case 0x47: case 0x48:
+	case 0x49: case 0x4a: case 0x4c: case 0x4d: case 0x4f:
+		cpu -> a = sim_rmw(cpu, op & 0x0f, cpu -> a, 8);
+		break;
+
+	case 0x50: case 0x53: case 0x54: case 0x56: case 0x57: case 0x58:
+	case 0x59: case 0x5a: case 0x5c: case 0x5d: case 0x5f:
+		cpu -> b = sim_rmw(cpu, op & 0x0f, cpu -> b, 8);
+		break;
+
+	case 0x1040: case 0x1043: case 0x1044: case 0x1046: case 0x1047: case 0x1048:
+	case 0x1049: case 0x104a: case 0x104c: case 0x104d: case 0x104f:
+		set_d(cpu, sim_rmw(cpu, op & 0x0f, REG_D(cpu), 16));
+		break;
+
+	case 0x1053: case 0x1054: case 0x1056: case 0x1059: case 0x105a:
+	case 0x105c: case 0x105d: case 0x105f:
+		set_w(cpu, sim_rmw(cpu, op & 0x0f, REG_W(cpu), 16));
+		break;
+
+	case 0x1143: case 0x114a: case 0x114c: case 0x114d: case 0x114f:
+		cpu -> e = sim_rmw(cpu, op & 0x0f, cpu -> e, 8);
+		break;
+
+	case 0x1153: case 0x115a: case 0x115c: case 0x115d: case 0x115f:
+		cpu -> f = sim_rmw(cpu, op & 0x0f, cpu -> f, 8);
+		break;
+
+	// inherent and miscellaneous
+	case 0x12:	// NOP
+		break;
+
+	case 0x13:	// SYNC
+		return sim_fail(cpu, "SYNC waits for an interrupt");
+
+	case 0x3c:	// CWAI
+		return sim_fail(cpu, "CWAI waits for an interrupt");
+
+	case 0x14:	// SEXW
+		set_d(cpu, (cpu -> e & 0x80) ? 0xffff : 0);
+		cpu -> cc &= ~(CC_N | CC_Z);
+		if (cpu -> e & 0x80)
+			cpu -> cc |= CC_N;
+		else if (REG_W(cpu) == 0)
+			cpu -> cc |= CC_Z;
+		break;
+
+	case 0x19:	// DAA
+		sim_daa(cpu);
+		break;
+
+	case 0x1a:	// ORCC
+		cpu -> cc |= rd8(cpu, ea);
+		break;
+
+	case 0x1c:	// ANDCC
+		cpu -> cc &= rd8(cpu, ea);
+		break;
+
+	case 0x1d:	// SEX
+		cpu -> a = (cpu -> b & 0x80) ? 0xff : 0;
+		setnz16(cpu, REG_D(cpu));
+		break;
+
+	case 0x1e:	// EXG
+		t = sim_xferval(cpu, pb >> 4, pb & 0x0f);
+		m = sim_xferval(cpu, pb & 0x0f, pb >> 4);
+		sim_setreg(cpu, pb & 0x0f, t);
+		sim_setreg(cpu, pb >> 4, m);
+		break;
+
+	case 0x1f:	// TFR
+		sim_setreg(cpu, pb & 0x0f, sim_xferval(cpu, pb >> 4, pb & 0x0f));
+		break;
+
+	case 0x3a:	// ABX
+		cpu -> x = (cpu -> x + cpu -> b) & 0xffff;
+		break;
+
+	case 0x3d:	// MUL
+		set_d(cpu, cpu -> a * cpu -> b);
+		cpu -> cc &= ~(CC_Z | CC_C);
+		if (REG_D(cpu) == 0)
+			cpu -> cc |= CC_Z;
+		if (cpu -> b & 0x80)
+			cpu -> cc |= CC_C;
+		break;
+
+	// branches, jumps, and calls
+	case 0x16:	// LBRA
+	case 0x20:	case 0x21: case 0x22: case 0x23: case 0x24: case 0x25: case 0x26: case 0x27:
+	case 0x28:	case 0x29: case 0x2a: case 0x2b: case 0x2c: case 0x2d: case 0x2e: case 0x2f:
+		if (op == 0x16 || sim_cond(cpu, op))
+			cpu -> pc = ea;
+		break;
+
+	case 0x1021: case 0x1022: case 0x1023: case 0x1024: case 0x1025: case 0x1026: case 0x1027:
+	case 0x1028: case 0x1029: case 0x102a: case 0x102b: case 0x102c: case 0x102d: case 0x102e: case 0x102f:
+		if (sim_cond(cpu, op))
+		{
+			cpu -> pc = ea;
+			// a taken long branch costs one more cycle on the 6809
+			if (!cpu -> is6309 && op != 0x21)
+				cycles++;
+		}
+		break;
+
+	case 0x8d:	// BSR
+	case 0x17:	// LBSR
+	GEN3(0x9d):	// JSR
+		push16(cpu, &(cpu -> s), cpu -> pc);
+		cpu -> pc = ea;
+		break;
+
+	case 0x39:	// RTS
+		cpu -> pc = pull16(cpu, &(cpu -> s));
+		break;
+
+	case 0x3b:	// RTI
+		cpu -> cc = pull8(cpu, &(cpu -> s));
+		if (cpu -> cc & CC_E)
+		{
+			cpu -> a = pull8(cpu, &(cpu -> s));
+			cpu -> b = pull8(cpu, &(cpu -> s));
+			if (cpu -> is6309)
+			{
+				cpu -> e = pull8(cpu, &(cpu -> s));
+				cpu -> f = pull8(cpu, &(cpu -> s));
+			}
+			cpu -> dp = pull8(cpu, &(cpu -> s));
+			cpu -> x = pull16(cpu, &(cpu -> s));
+			cpu -> y = pull16(cpu, &(cpu -> s));
+			cpu -> u = pull16(cpu, &(cpu -> s));
+			// the table has the 6809 short form and the 6309 full form
+			cycles = cpu -> is6309 ? cycles : 15;
+		}
+		else
+		{
+			cycles = 6;
+		}
+		cpu -> pc = pull16(cpu, &(cpu -> s));
+		break;
+
+	case 0x3f:	// SWI
+		sim_stackall(cpu);
+		cpu -> cc |= CC_I | CC_F;
+		cpu -> pc = rd16(cpu, 0xfffa);
+		break;
+
+	case 0x103f:	// SWI2
+		sim_stackall(cpu);
+		cpu -> pc = rd16(cpu, 0xfff4);
+		break;
+
+	case 0x113f:	// SWI3
+		sim_stackall(cpu);
+		cpu -> pc = rd16(cpu, 0xfff2);
+		break;
+
+	// stack
+	case 0x34:	// PSHS
+		cycles += sim_rlist(cpu, 0, &(cpu -> s), &(cpu -> u), pb);
+		break;
+
+	case 0x35:	// PULS
+		cycles += sim_rlist(cpu, 1, &(cpu -> s), &(cpu -> u), pb);
+		break;
+
+	case 0x36:	// PSHU
+		cycles += sim_rlist(cpu, 0, &(cpu -> u), &(cpu -> s), pb);
+		break;
+
+	case 0x37:	// PULU
+		cycles += sim_rlist(cpu, 1, &(cpu -> u), &(cpu -> s), pb);
+		break;
+
+	case 0x1038:	// PSHSW
+		push16(cpu, &(cpu -> s), REG_W(cpu));
+		break;
+
+	case 0x1039:	// PULSW
+		set_w(cpu, pull16(cpu, &(cpu -> s)));
+		break;
+
+	case 0x103a:	// PSHUW
+		push16(cpu, &(cpu -> u), REG_W(cpu));
+		break;
+
+	case 0x103b:	// PULUW
+		set_w(cpu, pull16(cpu, &(cpu -> u)));
+		break;
+
+	// effective addresses
+	case 0x30:	// LEAX
+		cpu -> x = ea;
+		cpu -> cc = (cpu -> cc & ~CC_Z) | (ea ? 0 : CC_Z);
+		break;
+
+	case 0x31:	// LEAY
+		cpu -> y = ea;
+		cpu -> cc = (cpu -> cc & ~CC_Z) | (ea ? 0 : CC_Z);
+		break;
+
+	case 0x32:	// LEAS
+		cpu -> s = ea;
+		break;
+
+	case 0x33:	// LEAU
+		cpu -> u = ea;
+		break;
+
+	// 8 bit accumulator operations
+	GEN4(0x90):	cpu -> a = sub8(cpu, cpu -> a, rd8(cpu, ea), 0); break;			// SUBA
+	GEN4(0x91):	sub8(cpu, cpu -> a, rd8(cpu, ea), 0); break;					// CMPA
+	GEN4(0x92):	cpu -> a = sub8(cpu, cpu -> a, rd8(cpu, ea), CARRY(cpu)); break;	// SBCA
+	GEN4(0x94):	cpu -> a = logic8(cpu, cpu -> a & rd8(cpu, ea)); break;			// ANDA
+	GEN4(0x95):	logic8(cpu, cpu -> a & rd8(cpu, ea)); break;					// BITA
+	GEN4(0x96):	cpu -> a = logic8(cpu, rd8(cpu, ea)); break;					// LDA
+	GEN3(0x97):	wr8(cpu, ea, logic8(cpu, cpu -> a)); break;						// STA
+	GEN4(0x98):	cpu -> a = logic8(cpu, cpu -> a ^ rd8(cpu, ea)); break;			// EORA
+	GEN4(0x99):	cpu -> a = add8(cpu, cpu -> a, rd8(cpu, ea), CARRY(cpu)); break;	// ADCA
+	GEN4(0x9a):	cpu -> a = logic8(cpu, cpu -> a | rd8(cpu, ea)); break;			// ORA
+	GEN4(0x9b):	cpu -> a = add8(cpu, cpu -> a, rd8(cpu, ea), 0); break;			// ADDA
+
+	GEN4(0xd0):	cpu -> b = sub8(cpu, cpu -> b, rd8(cpu, ea), 0); break;			// SUBB
+	GEN4(0xd1):	sub8(cpu, cpu -> b, rd8(cpu, ea), 0); break;					// CMPB
+	GEN4(0xd2):	cpu -> b = sub8(cpu, cpu -> b, rd8(cpu, ea), CARRY(cpu)); break;	// SBCB
+	GEN4(0xd4):	cpu -> b = logic8(cpu, cpu -> b & rd8(cpu, ea)); break;			// ANDB
+	GEN4(0xd5):	logic8(cpu, cpu -> b & rd8(cpu, ea)); break;					// BITB
+	GEN4(0xd6):	cpu -> b = logic8(cpu, rd8(cpu, ea)); break;					// LDB
+	GEN3(0xd7):	wr8(cpu, ea, logic8(cpu, cpu -> b)); break;						// STB
+	GEN4(0xd8):	cpu -> b = logic8(cpu, cpu -> b ^ rd8(cpu, ea)); break;			// EORB
+	GEN4(0xd9):	cpu -> b = add8(cpu, cpu -> b, rd8(cpu, ea), CARRY(cpu)); break;	// ADCB
+	GEN4(0xda):	cpu -> b = logic8(cpu, cpu -> b | rd8(cpu, ea)); break;			// ORB
+	GEN4(0xdb):	cpu -> b = add8(cpu, cpu -> b, rd8(cpu, ea), 0); break;			// ADDB
+
+	GEN4(0x1190): cpu -> e = sub8(cpu, cpu -> e, rd8(cpu, ea), 0); break;		// SUBE
+	GEN4(0x1191): sub8(cpu, cpu -> e, rd8(cpu, ea), 0); break;					// CMPE
+	GEN4(0x1196): cpu -> e = logic8(cpu, rd8(cpu, ea)); break;					// LDE
+	GEN3(0x1197): wr8(cpu, ea, logic8(cpu, cpu -> e)); break;					// STE
+	GEN4(0x119b): cpu -> e = add8(cpu, cpu -> e, rd8(cpu, ea), 0); break;		// ADDE
+	GEN4(0x11d0): cpu -> f = sub8(cpu, cpu -> f, rd8(cpu, ea), 0); break;		// SUBF
+	GEN4(0x11d1): sub8(cpu, cpu -> f, rd8(cpu, ea), 0); break;					// CMPF
+	GEN4(0x11d6): cpu -> f = logic8(cpu, rd8(cpu, ea)); break;					// LDF
+	GEN3(0x11d7): wr8(cpu, ea, logic8(cpu, cpu -> f)); break;					// STF
+	GEN4(0x11db): cpu -> f = add8(cpu, cpu -> f, rd8(cpu, ea), 0); break;		// ADDF
+
+	// 16 bit register operations
+	GEN4(0x93):	set_d(cpu, sub16(cpu, REG_D(cpu), rd16(cpu, ea), 0)); break;	// SUBD
+	GEN4(0xd3):	set_d(cpu, add16(cpu, REG_D(cpu), rd16(cpu, ea), 0)); break;	// ADDD
+	GEN4(0xdc):	set_d(cpu, logic16(cpu, rd16(cpu, ea))); break;					// LDD
+	GEN3(0xdd):	wr16(cpu, ea, logic16(cpu, REG_D(cpu))); break;					// STD
+	GEN4(0x9c):	sub16(cpu, cpu -> x, rd16(cpu, ea), 0); break;					// CMPX
+	GEN4(0x9e):	cpu -> x = logic16(cpu, rd16(cpu, ea)); break;					// LDX
+	GEN3(0x9f):	wr16(cpu, ea, logic16(cpu, cpu -> x)); break;					// STX
+	GEN4(0xde):	cpu -> u = logic16(cpu, rd16(cpu, ea)); break;					// LDU
+	GEN3(0xdf):	wr16(cpu, ea, logic16(cpu, cpu -> u)); break;					// STU
+
+	GEN4(0x1090): set_w(cpu, sub16(cpu, REG_W(cpu), rd16(cpu, ea), 0)); break;	// SUBW
+	GEN4(0x1091): sub16(cpu, REG_W(cpu), rd16(cpu, ea), 0); break;				// CMPW
+	GEN4(0x1092): set_d(cpu, sub16(cpu, REG_D(cpu), rd16(cpu, ea), CARRY(cpu))); break;	// SBCD
+	GEN4(0x1093): sub16(cpu, REG_D(cpu), rd16(cpu, ea), 0); break;				// CMPD
+	GEN4(0x1094): set_d(cpu, logic16(cpu, REG_D(cpu) & rd16(cpu, ea))); break;	// ANDD
+	GEN4(0x1095): logic16(cpu, REG_D(cpu) & rd16(cpu, ea)); break;				// BITD
+	GEN4(0x1096): set_w(cpu, logic16(cpu, rd16(cpu, ea))); break;				// LDW
+	GEN3(0x1097): wr16(cpu, ea, logic16(cpu, REG_W(cpu))); break;				// STW
+	GEN4(0x1098): set_d(cpu, logic16(cpu, REG_D(cpu) ^ rd16(cpu, ea))); break;	// EORD
+	GEN4(0x1099): set_d(cpu, add16(cpu, REG_D(cpu), rd16(cpu, ea), CARRY(cpu))); break;	// ADCD
+	GEN4(0x109a): set_d(cpu, logic16(cpu, REG_D(cpu) | rd16(cpu, ea))); break;	// ORD
+	GEN4(0x109b): set_w(cpu, add16(cpu, REG_W(cpu), rd16(cpu, ea), 0)); break;	// ADDW
+	GEN4(0x109c): sub16(cpu, cpu -> y, rd16(cpu, ea), 0); break;				// CMPY
+	GEN4(0x109e): cpu -> y = logic16(cpu, rd16(cpu, ea)); break;				// LDY
+	GEN3(0x109f): wr16(cpu, ea, logic16(cpu, cpu -> y)); break;					// STY
+	GEN4(0x10de): cpu -> s = logic16(cpu, rd16(cpu, ea)); break;				// LDS
+	GEN3(0x10df): wr16(cpu, ea, logic16(cpu, cpu -> s)); break;					// STS
+	GEN4(0x1193): sub16(cpu, cpu -> u, rd16(cpu, ea), 0); break;				// CMPU
+	GEN4(0x119c): sub16(cpu, cpu -> s, rd16(cpu, ea), 0); break;				// CMPS
+
+	// 32 bit operations
+	case 0xcd:	// LDQ immediate
+	GEN3(0x10dc):
+		set_d(cpu, rd16(cpu, ea));
+		set_w(cpu, rd16(cpu, ea + 2));
+		cpu -> cc &= ~(CC_N | CC_Z | CC_V);
+		if (cpu -> a & 0x80)
+			cpu -> cc |= CC_N;
+		if ((REG_D(cpu) | REG_W(cpu)) == 0)
+			cpu -> cc |= CC_Z;
+		break;
+
+	GEN3(0x10dd):	// STQ
+		wr16(cpu, ea, REG_D(cpu));
+		wr16(cpu, ea + 2, REG_W(cpu));
+		cpu -> cc &= ~(CC_N | CC_Z | CC_V);
+		if (cpu -> a & 0x80)
+			cpu -> cc |= CC_N;
+		if ((REG_D(cpu) | REG_W(cpu)) == 0)
+			cpu -> cc |= CC_Z;
+		break;
+
+	GEN4(0x119d):	// DIVD
+		if (sim_divd(cpu, rd8(cpu, ea)) < 0)
+			return sim_fail(cpu, "division by zero");
+		break;
+
+	GEN4(0x119e):	// DIVQ
+		if (sim_divq(cpu, rd16(cpu, ea)) < 0)
+			return sim_fail(cpu, "division by zero");
+		break;
+
+	GEN4(0x119f):	// MULD
+		{
+			long q = (long)sext16(REG_D(cpu)) * sext16(rd16(cpu, ea));
+			set_d(cpu, q >> 16);
+			set_w(cpu, q);
+			cpu -> cc &= ~(CC_N | CC_Z | CC_V | CC_C);
+			if (q < 0)
+				cpu -> cc |= CC_N;
+			if (q == 0)
+				cpu -> cc |= CC_Z;
+		}
+		break;
+
+	// 6309 register and bit operations
+	case 0x1030: case 0x1031: case 0x1032: case 0x1033:
+	case 0x1034: case 0x1035: case 0x1036: case 0x1037:
+		sim_regop(cpu, op & 0x07, pb);
+		break;
+
+	case 0x1130: case 0x1131: case 0x1132: case 0x1133:
+	case 0x1134: case 0x1135: case 0x1136: case 0x1137:
+		if (sim_bitop(cpu, op, pb, ea) < 0)
+			return sim_fail(cpu, "illegal register");
+		break;
+
+	case 0x1138: case 0x1139: case 0x113a: case 0x113b:
+		t = sim_tfm(cpu, op, pb);
+		if (t < 0)
+			return sim_fail(cpu, "illegal register");
+		// three cycles for each byte moved
+		cycles += 3 * t;
+		break;
+
+	case 0x113c:	// BITMD
+		t = cpu -> md & rd8(cpu, ea) & 0xc0;
+		cpu -> cc = (cpu -> cc & ~CC_Z) | (t ? 0 : CC_Z);
+		cpu -> md &= ~t;
+		break;
+
+	case 0x113d:	// LDMD
+		cpu -> md = (cpu -> md & ~0x03) | (rd8(cpu, ea) & 0x03);
+		break;
+
+	default:
+		return sim_fail(cpu, "illegal instruction");
+	}
+	return cycles;
+}
+
+/*
+Execute one instruction. Returns the number of cycles it took, or -1 if the
+instruction could not be executed, in which case err says why and the
+program counter is left pointing at it.
+*/
+int sim_step(simcpu_t *cpu)
+{
+	unsigned long *access = cpu -> access;
+	int cycles;
+
+	cycles = sim_exec(cpu);
+	cpu -> access = access;
+	return cycles;
+}
@@ -0,0 +1,313 @@
+/*
+load.c
+
+Copyright © 2026 William Astle
+
+This file is part of LWTOOLS.
+
+LWTOOLS is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <http://www.gnu.org/licenses/>.
+
+Loads binaries and symbol tables into the simulator
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lw_alloc.h>
+#include <lw_string.h>
+
+#define __load_c_seen__
+#include "lwsim.h"
+
+simsym_t *symbols = NULL;
+int nsymbols = 0;
+
+static unsigned char *read_whole_file(const char *fn, long *size)
+{
+	FILE *f;
+	unsigned char *buf;
+	long bread;
+
+	f = fopen(fn, "rb");
+	if (!f)
+	{
+		fprintf(stderr, "Can't open file %s:", fn);
+		perror("");
+		exit(1);
+	}
+	fseek(f, 0, SEEK_END);
+	*size = ftell(f);
+	rewind(f);
+
+	buf = lw_alloc(*size + 1);
+	bread = fread(buf, 1, *size, f);
+	if (bread < *size)
+	{
+		fprintf(stderr, "Short read on file %s (%ld/%ld):", fn, bread, *size);
+		perror("");
+		exit(1);
+	}
+	buf[*size] = 0;
+	fclose(f);
+	return buf;
+}
+
+static void load_bytes(simcpu_t *cpu, unsigned char *loaded, int addr, unsigned char *data, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+	{
+		cpu -> mem[(addr + i) & 0xffff] = data[i];
+		loaded[(addr + i) & 0xffff] = 1;
+	}
+}
+
+// check that buf is a complete DECB binary: data blocks then a postamble
+static int is_decb(unsigned char *buf, long size)
+{
+	long cc = 0;
+	int len;
+
+	while (cc + 5 <= size)
+	{
+		if (buf[cc] == 0xff)
+			return buf[cc + 1] == 0 && buf[cc + 2] == 0 && cc + 5 == size;
+		if (buf[cc] != 0)
+			return 0;
+		len = (buf[cc + 1] << 8) | buf[cc + 2];
+		cc += 5 + len;
+	}
+	return 0;
+}
+
+static int load_decb(simcpu_t *cpu, unsigned char *loaded, unsigned char *buf)
+{
+	long cc = 0;
+	int len;
+
+	while (buf[cc] == 0)
+	{
+		len = (buf[cc + 1] << 8) | buf[cc + 2];
+		load_bytes(cpu, loaded, (buf[cc + 3] << 8) | buf[cc + 4], buf + cc + 5, len);
+		cc += 5 + len;
+	}
+	return (buf[cc + 3] << 8) | buf[cc + 4];
+}
+
+static int hexval(int c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	c = toupper(c);
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+static int hexbyte(unsigned char *p)
+{
+	int h = hexval(p[0]), l;
+
+	if (h < 0)
+		return -1;
+	l = hexval(p[1]);
+	if (l < 0)
+		return -1;
+	return (h << 4) | l;
+}
+
+static int load_srec(simcpu_t *cpu, unsigned char *loaded, const char *fn, unsigned char *buf)
+{
+	unsigned char *p = buf, *e;
+	unsigned char data[256];
+	int lineno = 0;
+	int count, sum, i, v, addr, exec = -1;
+
+	for (; *p; p = e + (*e ? 1 : 0))
+	{
+		lineno++;
+		for (e = p; *e && *e != '\n'; e++)
+			/* do nothing */ ;
+		while (p < e && isspace(*p))
+			p++;
+		if (p == e)
+			continue;
+		if (*p != 'S' || !isdigit(p[1]))
+			goto bad;
+		count = hexbyte(p + 2);
+		if (count < 3 || p + 4 + count * 2 > e)
+			goto bad;
+		sum = count;
+		for (i = 0; i < count; i++)
+		{
+			v = hexbyte(p + 4 + i * 2);
+			if (v < 0)
+				goto bad;
+			data[i] = v;
+			sum += v;
+		}
+		if ((sum & 0xff) != 0xff)
+		{
+			fprintf(stderr, "%s:%d: bad S record checksum\n", fn, lineno);
+			exit(1);
+		}
+		addr = (data[0] << 8) | data[1];
+		switch (p[1])
+		{
+		case '1':
+			load_bytes(cpu, loaded, addr, data + 2, count - 3);
+			break;
+
+		case '9':
+			exec = addr;
+			break;
+
+		case '0':
+		case '5':
+			break;
+
+		default:
+			fprintf(stderr, "%s:%d: only 16 bit S records are supported\n", fn, lineno);
+			exit(1);
+		}
+	}
+	return exec;
+
+bad:
+	fprintf(stderr, "%s:%d: invalid S record\n", fn, lineno);
+	exit(1);
+}
+
+/*
+Load a binary. Returns its execution address, if it has one, or -1. The
+loaded array is set for every byte the file provides.
+*/
+int load_binary(simcpu_t *cpu, unsigned char *loaded, const char *fn, int format, int base)
+{
+	unsigned char *buf;
+	long size;
+	int exec;
+
+	buf = read_whole_file(fn, &size);
+	if (format == SIM_FORMAT_DETECT)
+	{
+		if (size >= 2 && buf[0] == 'S' && isdigit(buf[1]))
+			format = SIM_FORMAT_SREC;
+		else if (is_decb(buf, size))
+			format = SIM_FORMAT_DECB;
+		else
+			format = SIM_FORMAT_RAW;
+	}
+
+	switch (format)
+	{
+	case SIM_FORMAT_DECB:
+		if (!is_decb(buf, size))
+		{
+			fprintf(stderr, "%s: not a DECB binary\n", fn);
+			exit(1);
+		}
+		exec = load_decb(cpu, loaded, buf);
+		break;
+
+	case SIM_FORMAT_SREC:
+		exec = load_srec(cpu, loaded, fn, buf);
+		break;
+
+	default:
+		if (size > 65536 - base)
+		{
+			fprintf(stderr, "%s: too big to load at $%04X\n", fn, base);
+			exit(1);
+		}
+		load_bytes(cpu, loaded, base, buf, size);
+		exec = base;
+		break;
+	}
+	lw_free(buf);
+	return exec;
+}
+
+static void add_symbol(char *name, int len, int addr)
+{
+	symbols = lw_realloc(symbols, sizeof(simsym_t) * (nsymbols + 1));
+	symbols[nsymbols].name = lw_alloc(len + 1);
+	memcpy(symbols[nsymbols].name, name, len);
+	symbols[nsymbols].name[len] = 0;
+	symbols[nsymbols].addr = addr & 0xffff;
+	nsymbols++;
+}
+
+/*
+Read symbols from an lwasm symbol dump ("sym EQU $1234") or an lwlink map
+("Symbol: sym (file) = 1234"). Anything else in the file is ignored.
+*/
+void load_symbols(const char *fn)
+{
+	unsigned char *buf, *p, *n, *e;
+	long size;
+	int nl;
+
+	buf = read_whole_file(fn, &size);
+	for (p = buf; *p; p = e + (*e ? 1 : 0))
+	{
+		for (e = p; *e && *e != '\n'; e++)
+			/* do nothing */ ;
+		if (!strncmp((char *)p, "Symbol: ", 8))
+		{
+			n = p + 8;
+			for (p = n; p < e && !isspace(*p); p++)
+				/* do nothing */ ;
+			nl = p - n;
+			while (p < e && *p != '=')
+				p++;
+			// skip the linker's own symbols and section base markers
+			if (p < e && *n != '\\' && strncmp((char *)n + nl, " (<synthetic>)", 14))
+				add_symbol((char *)n, nl, strtol((char *)p + 1, NULL, 16));
+			continue;
+		}
+		n = p;
+		for (; p < e && !isspace(*p); p++)
+			/* do nothing */ ;
+		nl = p - n;
+		while (p < e && isspace(*p))
+			p++;
+		if (nl == 0 || e - p < 5 || (strncasecmp((char *)p, "EQU", 3) && strncasecmp((char *)p, "SET", 3)))
+			continue;
+		p += 3;
+		while (p < e && isspace(*p))
+			p++;
+		if (*p == '$')
+			add_symbol((char *)n, nl, strtol((char *)p + 1, NULL, 16));
+	}
+	lw_free(buf);
+}
+
+int find_symbol(const char *name, int *addr)
+{
+	int i;
+
+	for (i = 0; i < nsymbols; i++)
+	{
+		if (!strcmp(symbols[i].name, name))
+		{
+			*addr = symbols[i].addr;
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,103 @@
+/*
+lwsim.h
+
+Copyright © 2026 William Astle
+
+This file is part of LWTOOLS.
+
+LWTOOLS is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <http://www.gnu.org/licenses/>.
+
+Contains the common declarations for the simulator
+*/
+
+#ifndef __lwsim_h_seen__
+#define __lwsim_h_seen__
+
+enum
+{
+	CC_E = 0x80,
+	CC_F = 0x40,
+	CC_H = 0x20,
+	CC_I = 0x10,
+	CC_N = 0x08,
+	CC_Z = 0x04,
+	CC_V = 0x02,
+	CC_C = 0x01
+};
+
+// addressing modes as far as fetching the operand is concerned
+enum
+{
+	SIM_ILLEGAL = 0,
+	SIM_INH,							// no operand
+	SIM_IMM8,							// 8 bit immediate
+	SIM_IMM16,							// 16 bit immediate
+	SIM_IMM32,							// 32 bit immediate (LDQ)
+	SIM_DIR,							// direct page
+	SIM_IDX,							// indexed
+	SIM_EXT,							// extended
+	SIM_REL8,							// short relative
+	SIM_REL16,							// long relative
+	SIM_POST,							// register post byte (TFR, PSHS, TFM, ADDR...)
+	SIM_BIT,							// bit number post byte and direct address
+	SIM_IMMDIR,							// immediate and direct (AIM etc.)
+	SIM_IMMIDX,							// immediate and indexed
+	SIM_IMMEXT							// immediate and extended
+};
+
+typedef struct simcpu_s
+{
+	unsigned char mem[65536];			// the whole address space
+	int is6309;							// simulating a 6309 in native mode
+	int a, b, e, f;						// accumulators
+	int x, y, u, s, v;					// 16 bit registers
+	int pc;								// program counter
+	int dp, cc, md;						// direct page, condition codes, mode
+	int opc;							// opcode of the last instruction, with prefix
+	int opaddr;							// address of the last instruction
+	const char *err;					// reason execution stopped, if it did
+	unsigned long *access;				// data access counts by address, or NULL
+} simcpu_t;
+
+typedef struct simsym_s
+{
+	char *name;
+	int addr;
+} simsym_t;
+
+enum
+{
+	SIM_FORMAT_DETECT = 0,
+	SIM_FORMAT_RAW,
+	SIM_FORMAT_DECB,
+	SIM_FORMAT_SREC
+};
+
+void sim_init(void);
+void sim_reset(simcpu_t *cpu);
+int sim_step(simcpu_t *cpu);
+const char *sim_mnemonic(int opc);
+int sim_getreg(simcpu_t *cpu, int r);
+void sim_setreg(simcpu_t *cpu, int r, int v);
+
+int load_binary(simcpu_t *cpu, unsigned char *loaded, const char *fn, int format, int base);
+void load_symbols(const char *fn);
+int find_symbol(const char *name, int *addr);
+
+#ifndef __load_c_seen__
+extern simsym_t *symbols;
+extern int nsymbols;
+#endif
+
+#endif // __lwsim_h_seen__
@@ -0,0 +1,680 @@
+/*
+main.c
+
+Copyright © 2026 William Astle
+
+This file is part of LWTOOLS.
+
+LWTOOLS is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+more details.
+
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <http://www.gnu.org/licenses/>.
+
+Implements the program startup code, the benchmark runs, and the reports
+
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lw_alloc.h>
+#include <lw_cmdline.h>
+#include <lw_string.h>
+
+#include <version.h>
+
+#include "lwsim.h"
+
+#define PROGVER "lwsim from " PACKAGE_STRING
+char *program_name;
+
+// the return address pushed for each run; a run is over when it comes
+// back here with the stack where it started
+#define SIM_RETURN 0xffff
+
+static char *infile = NULL;
+static int informat = SIM_FORMAT_DETECT;
+static int loadaddr = 0;
+static int is6309 = 1;
+static int stackaddr = 0x8000;
+static unsigned long maxcycles = 100000000UL;
+static int toplines = 10;
+static int brief = 0;
+static int trace = 0;
+static char **runspecs = NULL;
+static int nrunspecs = 0;
+static char **pokespecs = NULL;
+static int npokespecs = 0;
+static char **peekspecs = NULL;
+static int npeekspecs = 0;
+static char **symfiles = NULL;
+static int nsymfiles = 0;
+static char *profilefile = NULL;
+
+static void add_spec(char ***list, int *n, char *arg)
+{
+	*list = lw_realloc(*list, sizeof(char *) * (*n + 1));
+	(*list)[(*n)++] = lw_strdup(arg);
+}
+
+// a number or a symbol name, optionally followed by +N or -N
+static int parse_value(char *s, int *v)
+{
+	char *e;
+	int ov, r;
+
+	for (e = s + 1; *s && *e; e++)
+	{
+		if (*e == '+' || *e == '-')
+		{
+			r = *e;
+			*e = 0;
+			if (parse_value(s, v) && parse_value(e + 1, &ov))
+			{
+				*e = r;
+				*v += (r == '+') ? ov : -ov;
+				return 1;
+			}
+			*e = r;
+			return 0;
+		}
+	}
+
+	if (*s == '$')
+		*v = strtol(s + 1, &e, 16);
+	else if (isdigit(*s) || *s == '-')
+		*v = strtol(s, &e, 0);
+	else
+		return find_symbol(s, v);
+	return *s && !*e;
+}
+
+static int parse_opts(int key, char *arg, void *state)
+{
+	switch (key)
+	{
+	case 'f':
+		if (!strcasecmp(arg, "raw"))
+			informat = SIM_FORMAT_RAW;
+		else if (!strcasecmp(arg, "decb"))
+			informat = SIM_FORMAT_DECB;
+		else if (!strcasecmp(arg, "srec"))
+			informat = SIM_FORMAT_SREC;
+		else
+		{
+			fprintf(stderr, "Invalid input format: %s\n", arg);
+			exit(1);
+		}
+		break;
+
+	case 's':
+		add_spec(&symfiles, &nsymfiles, arg);
+		break;
+
+	case 'r':
+		add_spec(&runspecs, &nrunspecs, arg);
+		break;
+
+	case 'b':
+		brief = 1;
+		break;
+
+	case 't':
+		trace = 1;
+		break;
+
+	case '9':
+		is6309 = 0;
+		break;
+
+	case '3':
+		is6309 = 1;
+		break;
+
+	case 0x100:
+		if (!parse_value(arg, &loadaddr))
+		{
+			fprintf(stderr, "Invalid load address: %s\n", arg);
+			exit(1);
+		}
+		loadaddr &= 0xffff;
+		break;
+
+	case 0x101:
+		add_spec(&pokespecs, &npokespecs, arg);
+		break;
+
+	case 0x102:
+		if (!parse_value(arg, &stackaddr))
+		{
+			fprintf(stderr, "Invalid stack address: %s\n", arg);
+			exit(1);
+		}
+		stackaddr &= 0xffff;
+		break;
+
+	case 0x103:
+		maxcycles = strtoul(arg, NULL, 0);
+		break;
+
+	case 0x104:
+		toplines = atoi(arg);
+		break;
+
+	case 0x105:
+		add_spec(&peekspecs, &npeekspecs, arg);
+		break;
+
+	case 0x106:
+		profilefile = arg;
+		break;
+
+	case lw_cmdline_key_arg:
+		if (infile)
+		{
+			fprintf(stderr, "Only one input file is supported\n");
+			exit(1);
+		}
+		infile = arg;
+		break;
+
+	case lw_cmdline_key_end:
+		break;
+
+	default:
+		return lw_cmdline_err_unknown;
+	}
+	return 0;
+}
+
+static struct lw_cmdline_options options[] =
+{
+	{ "format",		'f',	"TYPE",		0,
+				"Input format: raw, decb, srec (default: detect)" },
+	{ "load",		0x100,	"ADDR",		0,
+				"Load a raw binary at ADDR (default 0)" },
+	{ "symbols",	's',	"FILE",		0,
+				"Read symbols from an lwasm symbol dump or lwlink map" },
+	{ "run",		'r',	"ENTRY[,REG=VAL...]",	0,
+				"Call ENTRY with the given registers; may be repeated" },
+	{ "poke",		0x101,	"ADDR=BYTE[,BYTE...]",	0,
+				"Store bytes at ADDR before each run" },
+	{ "peek",		0x105,	"ADDR[,LEN]",	0,
+				"Show LEN bytes (default 1) at ADDR after each run" },
+	{ "stack",		0x102,	"ADDR",		0,
+				"Initial stack pointer (default 0x8000)" },
+	{ "max-cycles",	0x103,	"N",		0,
+				"Fail a run that takes more than N cycles" },
+	{ "top",		0x104,	"N",		0,
+				"Show N lines of instruction mix and hot spots (0 for all)" },
+	{ "profile",	0x106,	"FILE",		0,
+				"Write symbol hit counts for lwlink --profile to FILE" },
+	{ "brief",		'b',	0,			0,
+				"Only show the cycle and instruction totals" },
+	{ "trace",		't',	0,			0,
+				"Show each instruction as it runs on standard error" },
+	{ "6809",		'9',	0,			0,
+				"Simulate a 6809" },
+	{ "6309",		'3',	0,			0,
+				"Simulate a 6309 in native mode (default)" },
+	{ 0 }
+};
+
+static struct lw_cmdline_parser cmdline_parser =
+{
+	options,
+	parse_opts,
+	"INPUTFILE",
+	"lwsim, a HD6309 and MC6809 benchmark simulator",
+	PROGVER
+};
+
+static simcpu_t cpu;
+static unsigned char image[65536];			// memory as loaded
+static unsigned char loaded[65536];			// which bytes the binary set
+static unsigned long pccycles[65536];		// cycles spent at each address
+static unsigned long pccount[65536];		// instructions run at each address
+static unsigned long opcycles[3 * 256];		// cycles spent in each opcode
+static unsigned long opcount[3 * 256];		// times each opcode ran
+static unsigned long pchits[65536];			// instructions run at each address, all runs
+static unsigned long accesses[65536];		// data accesses to each address, all runs
+
+static int regnum(char *r)
+{
+	static char *names[] = { "D", "X", "Y", "U", "S", "PC", "W", "V",
+		"A", "B", "CC", "DP", "", "", "E", "F" };
+	int i;
+
+	for (i = 0; i < 16; i++)
+	{
+		if (*names[i] && !strcasecmp(r, names[i]))
+			return i;
+	}
+	return -1;
+}
+
+static void apply_pokes(void)
+{
+	char *spec, *p, *n;
+	int i, addr, v;
+
+	for (i = 0; i < npokespecs; i++)
+	{
+		spec = lw_strdup(pokespecs[i]);
+		p = strchr(spec, '=');
+		if (!p)
+			goto bad;
+		*p++ = 0;
+		if (!parse_value(spec, &addr))
+			goto bad;
+		for (; p; p = n)
+		{
+			n = strchr(p, ',');
+			if (n)
+				*n++ = 0;
+			if (!parse_value(p, &v))
+				goto bad;
+			cpu.mem[addr++ & 0xffff] = v;
+		}
+		lw_free(spec);
+	}
+	return;
+
+bad:
+	fprintf(stderr, "Invalid poke: %s\n", pokespecs[i]);
+	exit(1);
+}
+
+static void report_peeks(void)
+{
+	char *spec, *p;
+	int i, j, addr, len;
+
+	for (i = 0; i < npeekspecs; i++)
+	{
+		spec = lw_strdup(peekspecs[i]);
+		len = 1;
+		p = strchr(spec, ',');
+		if (p)
+		{
+			*p++ = 0;
+			if (!parse_value(p, &len) || len < 1)
+				goto bad;
+		}
+		if (!parse_value(spec, &addr))
+			goto bad;
+		printf("  %s ($%04X):", spec, addr & 0xffff);
+		for (j = 0; j < len; j++)
+			printf(" %02X", cpu.mem[(addr + j) & 0xffff]);
+		printf("\n");
+		lw_free(spec);
+	}
+	return;
+
+bad:
+	fprintf(stderr, "Invalid peek: %s\n", peekspecs[i]);
+	exit(1);
+}
+
+static int mixcmp(const void *a, const void *b)
+{
+	unsigned long ca = opcycles[*(const int *)a], cb = opcycles[*(const int *)b];
+
+	if (ca != cb)
+		return ca < cb ? 1 : -1;
+	return *(const int *)a - *(const int *)b;
+}
+
+static int opcfromindex(int i)
+{
+	return i < 256 ? i : (((i >> 8) + 0x0f) << 8) | (i & 0xff);
+}
+
+static void report_mix(void)
+{
+	int idx[3 * 256];
+	int i, j, n = 0;
+	unsigned long c, k;
+	const char *m;
+
+	// merge the addressing modes of each instruction
+	for (i = 0; i < 3 * 256; i++)
+	{
+		if (!opcount[i])
+			continue;
+		m = sim_mnemonic(opcfromindex(i));
+		for (j = 0; j < n; j++)
+		{
+			if (!strcmp(sim_mnemonic(opcfromindex(idx[j])), m))
+				break;
+		}
+		if (j < n)
+		{
+			opcycles[idx[j]] += opcycles[i];
+			opcount[idx[j]] += opcount[i];
+			continue;
+		}
+		idx[n++] = i;
+	}
+	qsort(idx, n, sizeof(int), mixcmp);
+
+	printf("  instruction mix:\n");
+	printf("    %10s %10s  %s\n", "cycles", "count", "instruction");
+	for (i = 0; i < n && (toplines == 0 || i < toplines); i++)
+	{
+		c = opcycles[idx[i]];
+		k = opcount[idx[i]];
+		printf("    %10lu %10lu  %s\n", c, k, sim_mnemonic(opcfromindex(idx[i])));
+	}
+}
+
+typedef struct
+{
+	char *name;
+	int addr;
+	int order;							// position in the symbol files
+	unsigned long cycles;
+	unsigned long count;
+} hotspot_t;
+
+static int hotaddrcmp(const void *a, const void *b)
+{
+	const hotspot_t *ha = a, *hb = b;
+
+	if (ha -> addr != hb -> addr)
+		return ha -> addr - hb -> addr;
+	return ha -> order - hb -> order;
+}
+
+static int hotcyclecmp(const void *a, const void *b)
+{
+	unsigned long ca = ((const hotspot_t *)a) -> cycles, cb = ((const hotspot_t *)b) -> cycles;
+
+	if (ca != cb)
+		return ca < cb ? 1 : -1;
+	return hotaddrcmp(a, b);
+}
+
+/*
+Charge each instruction to the closest label at or before it. Only symbols
+that point into the loaded binary count as labels, which keeps most
+constants out of the way.
+*/
+static void report_hotspots(unsigned long total)
+{
+	hotspot_t *hs;
+	int i, n = 0, lo, hi, mid;
+
+	hs = lw_alloc(sizeof(hotspot_t) * (nsymbols + 1));
+	hs[n].name = "(no label)";
+	hs[n].addr = -1;
+	hs[n].order = -1;
+	hs[n].cycles = hs[n].count = 0;
+	n++;
+	for (i = 0; i < nsymbols; i++)
+	{
+		if (!loaded[symbols[i].addr])
+			continue;
+		hs[n].name = symbols[i].name;
+		hs[n].addr = symbols[i].addr;
+		hs[n].order = i;
+		hs[n].cycles = hs[n].count = 0;
+		n++;
+	}
+	qsort(hs, n, sizeof(hotspot_t), hotaddrcmp);
+
+	for (i = 0; i < 65536; i++)
+	{
+		if (!pccount[i])
+			continue;
+		lo = 0;
+		hi = n - 1;
+		while (lo < hi)
+		{
+			mid = (lo + hi + 1) / 2;
+			if (hs[mid].addr <= i)
+				lo = mid;
+			else
+				hi = mid - 1;
+		}
+		// several labels on one address share; the first one gets it
+		while (lo > 0 && hs[lo - 1].addr == hs[lo].addr)
+			lo--;
+		hs[lo].cycles += pccycles[i];
+		hs[lo].count += pccount[i];
+	}
+	qsort(hs, n, sizeof(hotspot_t), hotcyclecmp);
+
+	printf("  hot spots:\n");
+	printf("    %10s %6s %10s  %s\n", "cycles", "%", "count", "label");
+	for (i = 0; i < n && hs[i].cycles && (toplines == 0 || i < toplines); i++)
+	{
+		printf("    %10lu %6.1f %10lu  %s", hs[i].cycles, total ? 100.0 * hs[i].cycles / total : 0.0, hs[i].count, hs[i].name);
+		if (hs[i].addr >= 0)
+			printf(" ($%04X)", hs[i].addr);
+		printf("\n");
+	}
+	lw_free(hs);
+}
+
+static void report_regs(void)
+{
+	printf("  registers: A=$%02X B=$%02X", cpu.a, cpu.b);
+	if (cpu.is6309)
+		printf(" E=$%02X F=$%02X", cpu.e, cpu.f);
+	printf(" X=$%04X Y=$%04X U=$%04X S=$%04X DP=$%02X CC=$%02X", cpu.x, cpu.y, cpu.u, cpu.s, cpu.dp, cpu.cc);
+	if (cpu.is6309)
+		printf(" V=$%04X MD=$%02X", cpu.v, cpu.md);
+	printf("\n");
+}
+
+// do one benchmark run; returns 0 if the entry point returned normally
+static int do_run(char *spec, int exec)
+{
+	char *s, *p, *n, *r;
+	char *name;
+	int entry, reg, v, pc, c, page, s0;
+	unsigned long total = 0, ninsns = 0;
+
+	s = lw_strdup(spec);
+	p = strchr(s, ',');
+	if (p)
+		*p++ = 0;
+	name = s;
+	if (*s)
+	{
+		if (!parse_value(s, &entry))
+		{
+			fprintf(stderr, "Unknown entry point: %s\n", s);
+			exit(1);
+		}
+	}
+	else
+	{
+		if (exec < 0)
+		{
+			fprintf(stderr, "No entry point given and the binary has no execution address\n");
+			exit(1);
+		}
+		entry = exec;
+		name = "(exec)";
+	}
+
+	memcpy(cpu.mem, image, sizeof(image));
+	apply_pokes();
+	sim_reset(&cpu);
+	cpu.s = stackaddr;
+	for (; p; p = n)
+	{
+		n = strchr(p, ',');
+		if (n)
+			*n++ = 0;
+		r = strchr(p, '=');
+		if (r)
+			*r++ = 0;
+		reg = regnum(p);
+		if (!r || reg < 0 || reg == 5 || !parse_value(r, &v))
+		{
+			fprintf(stderr, "Invalid register setting %s in run %s\n", p, name);
+			exit(1);
+		}
+		sim_setreg(&cpu, reg, v);
+	}
+	s0 = cpu.s;
+	cpu.s = (cpu.s - 2) & 0xffff;
+	cpu.mem[cpu.s] = SIM_RETURN >> 8;
+	cpu.mem[(cpu.s + 1) & 0xffff] = SIM_RETURN & 0xff;
+	cpu.pc = entry;
+
+	memset(pccycles, 0, sizeof(pccycles));
+	memset(pccount, 0, sizeof(pccount));
+	memset(opcycles, 0, sizeof(opcycles));
+	memset(opcount, 0, sizeof(opcount));
+
+	for (;;)
+	{
+		pc = cpu.pc;
+		c = sim_step(&cpu);
+		if (c < 0)
+			break;
+		total += c;
+		ninsns++;
+		if (trace)
+		{
+			fprintf(stderr, "%04X %-6s %3d  A=%02X B=%02X X=%04X Y=%04X U=%04X S=%04X CC=%02X\n",
+				pc, sim_mnemonic(cpu.opc), c, cpu.a, cpu.b, cpu.x, cpu.y, cpu.u, cpu.s, cpu.cc);
+		}
+		pccycles[pc] += c;
+		pccount[pc]++;
+		page = cpu.opc > 0xff ? (cpu.opc >> 8) - 0x0f : 0;
+		opcycles[page * 256 + (cpu.opc & 0xff)] += c;
+		opcount[page * 256 + (cpu.opc & 0xff)]++;
+		if (cpu.pc == SIM_RETURN && cpu.s == s0)
+			break;
+		if (total > maxcycles)
+		{
+			cpu.err = "cycle limit exceeded";
+			break;
+		}
+	}
+
+	printf("%s: %lu cycles, %lu instructions\n", name, total, ninsns);
+	if (cpu.err)
+		printf("  stopped at $%04X (%s): %s\n", cpu.pc, sim_mnemonic(cpu.opc), cpu.err);
+	report_peeks();
+	if (!brief)
+	{
+		report_regs();
+		report_mix();
+		report_hotspots(total);
+	}
+	for (pc = 0; pc < 65536; pc++)
+		pchits[pc] += pccount[pc];
+	fflush(stdout);
+	if (cpu.err)
+		fprintf(stderr, "%s: %s at $%04X\n", name, cpu.err, cpu.pc);
+	lw_free(s);
+	return cpu.err ? -1 : 0;
+}
+
+static int symaddrcmp(const void *a, const void *b)
+{
+	return symbols[*(const int *)a].addr - symbols[*(const int *)b].addr;
+}
+
+/*
+Write a profile for lwlink. A symbol's count is the number of times the
+instruction at it ran plus the number of data accesses from it up to the
+next symbol, but no more than 256 bytes along.
+*/
+static void write_profile(void)
+{
+	FILE *of;
+	int *order, i, j, addr, end;
+	unsigned long count;
+
+	of = fopen(profilefile, "w");
+	if (!of)
+	{
+		fprintf(stderr, "Cannot open profile file %s:", profilefile);
+		perror("");
+		exit(1);
+	}
+	order = lw_alloc(sizeof(int) * (nsymbols + 1));
+	for (i = 0; i < nsymbols; i++)
+		order[i] = i;
+	qsort(order, nsymbols, sizeof(int), symaddrcmp);
+
+	for (i = 0; i < nsymbols; i++)
+	{
+		addr = symbols[order[i]].addr;
+		end = addr + 256;
+		for (j = i + 1; j < nsymbols; j++)
+		{
+			if (symbols[order[j]].addr > addr)
+			{
+				if (symbols[order[j]].addr < end)
+					end = symbols[order[j]].addr;
+				break;
+			}
+		}
+		if (end > 65536)
+			end = 65536;
+		count = pchits[addr];
+		for (j = addr; j < end; j++)
+			count += accesses[j];
+		if (count)
+			fprintf(of, "%s %lu\n", symbols[order[i]].name, count);
+	}
+	lw_free(order);
+	fclose(of);
+}
+
+int main(int argc, char **argv)
+{
+	int exec, i, rval = 0;
+
+	program_name = argv[0];
+
+	if (lw_cmdline_parse(&cmdline_parser, argc, argv, 0, 0, NULL) != 0)
+	{
+		// bail if parsing failed
+		exit(1);
+	}
+	if (!infile)
+	{
+		fprintf(stderr, "No input file\n");
+		exit(1);
+	}
+
+	sim_init();
+	memset(&cpu, 0, sizeof(cpu));
+	cpu.is6309 = is6309;
+	if (profilefile)
+		cpu.access = accesses;
+	exec = load_binary(&cpu, loaded, infile, informat, loadaddr);
+	memcpy(image, cpu.mem, sizeof(image));
+	for (i = 0; i < nsymfiles; i++)
+		load_symbols(symfiles[i]);
+
+	if (nrunspecs == 0)
+		add_spec(&runspecs, &nrunspecs, "");
+	for (i = 0; i < nrunspecs; i++)
+	{
+		if (do_run(runspecs[i], exec) < 0)
+			rval = 1;
+	}
+	if (profilefile)
+		write_profile();
+	exit(rval);
+}
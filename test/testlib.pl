@@ -0,0 +1,49 @@
+#
+# helpers shared by the scripts in the tests directory. A script sets $d to
+# its scratch directory, relative to the top of the source tree, before
+# using them; file names given to these helpers are relative to $d.
+#
+
+use Cwd;
+
+$top = getcwd();
+
+# write a file in the scratch directory
+sub writefile
+{
+	my ($fn, $data) = @_;
+	open H, ">$d/$fn";
+	binmode H;
+	print H $data;
+	close H;
+}
+
+# read a whole file from the scratch directory; undef if it can't be read
+sub readfile
+{
+	my ($fn) = @_;
+	my $data;
+	open H, "<$d/$fn" or return undef;
+	binmode H;
+	local $/;
+	$data = <H>;
+	close H;
+	return $data;
+}
+
+# run a command in the scratch directory; returns its output, with
+# standard error included, and leaves the exit status in $?
+sub run
+{
+	my ($cmd) = @_;
+	return `cd $d && $cmd 2>&1`;
+}
+
+# report a single test result
+sub result
+{
+	my ($name, $ok, $why) = @_;
+	print "$name " . ($ok ? 'PASS' : "FAIL ($why)") . "\n";
+}
+
+1;
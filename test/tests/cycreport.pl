@@ -0,0 +1,56 @@
+#!/usr/bin/env perl
+#
+# these tests check the lwasm cycle budget report. Each test is a name, the
+# lwasm options, the source lines (instructions start with a space), and a
+# pattern the report must match.
+
+$lwasm = './lwasm/lwasm';
+
+@tests = (
+	# straight line code and a call; the callee's cost is included
+	'straight', '--6809', [ 'r lda #1', ' ldb #2', ' rts' ], 'r \(\$0000-\$0004, 6809\): 9-9 cycles\n',
+	'call', '--6809', [ 'r lda #1', ' bsr s', ' rts', 's rts' ], 'r \(\$0000-\$0004, 6809\): 19-19 cycles\n.*\n    calls s\n',
+
+	# a branch gives a range
+	'branch', '--6809', [ 'r tsta', ' beq x', ' inca', 'x rts' ], 'r \(\$0000-\$0003, 6809\): 10-12 cycles\n',
+	'branch_6309', '--6309', [ 'r tsta', ' beq x', ' inca', 'x rts' ], 'r \(\$0000-\$0003, 6309\): 8-9 cycles\n',
+
+	# loops count once, with the cost per trip shown
+	'loop', '--6809', [ 'r ldx #10', 'x leax -1,x', ' bne x', ' rts' ], 'x \(\$0003-\$0007, 6809\): 13-13 cycles; loop\n.*\n.*\n    loop \$0003-\$0006: 8-8 cycles per trip\n',
+
+	# flags
+	'unknown', '--6809', [ 'r jmp ,x' ], 'r \(\$0000-\$0001, 6809\): 3-3 cycles; unknown flow\n',
+	'recursive', '--6809', [ 'r tsta', ' beq x', ' deca', ' bsr r', 'x rts' ], 'r \(\$0000-\$0005, 6809\): [0-9]+-[0-9]+ cycles; recursive\n',
+	'noexit', '--6809', [ 'r bra r' ], 'r \(\$0000-\$0001, 6809\): 3-3 cycles; loop; no exit\n',
+	'estimated', '--6809', [ 'r lbeq x', 'x rts' ], 'estimated',
+
+	# the same numbers in JSON
+	'json', '--6809 --cycle-report-format=json', [ 'r tsta', ' beq x', ' inca', 'x rts' ], '"name": "r",\s*"start": 0,\s*"end": 3,\s*"cpu": "6809",\s*"min": 10,\s*"max": 12,',
+);
+
+while (@tests)
+{
+	($name, $opts, $src, $expected) = splice(@tests, 0, 4);
+
+	$tf = ".cyctmp.$$";
+	open H, ">$tf.asm";
+	print H "$_\n" foreach (@$src);
+	close H;
+	unlink "$tf.rep";
+	$r = `$lwasm --raw $opts -o $tf --cycle-report=$tf.rep $tf.asm 2>&1`;
+	open H, "<$tf.rep";
+	local $/;
+	$report = <H>;
+	close H;
+	unlink $tf, "$tf.rep", "$tf.asm";
+	if ($report !~ /$expected/)
+	{
+		$report =~ s/\n/ | /g;
+		$st = "FAIL ($report$r)";
+	}
+	else
+	{
+		$st = 'PASS';
+	}
+	print "$name $st\n";
+}
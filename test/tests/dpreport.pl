@@ -0,0 +1,74 @@
+#!/usr/bin/env perl
+#
+# these tests check the lwasm direct page analysis. Each test is a name, the
+# lwasm options, the source lines (instructions start with a space), a
+# pattern the report must match, and a pattern the proposed layout must
+# match; an empty pattern is not checked.
+
+$lwasm = './lwasm/lwasm';
+
+@tests = (
+	# each loop a reference is in counts ten times
+	'weight', '--raw', [ ' org $100', 'r lda a', ' ldx #3', 'l ldb b', ' leax -1,x', ' bne l', ' rts', ' org $2000', 'a rmb 1', 'b rmb 1' ],
+		'b +1 +1 +0 +10  \$2001 +\$0000\na +1 +1 +0 +1  \$2000 +\$0001\n', '',
+	'weight_nested', '--raw', [ ' org $100', 'r ldx #3', 'o ldy #3', 'i lda a', ' leay -1,y', ' bne i', ' leax -1,x', ' bne o', ' rts', ' org $2000', 'a rmb 1' ],
+		'a +1 +1 +0 +100  \$2000 ', '',
+
+	# best value per byte first, and only what fits in a page
+	'packing', '--raw', [ ' org $100', 'r lda s1', ' lda s2', ' ldx #3', 'l lda big', ' leax -1,x', ' bne l', ' lda t', ' rts', ' org $2000', 'big rmb 254', 's1 rmb 2', 's2 rmb 2', 't rmb 1' ],
+		't .*\$0000\ns1 .*\$0001\ns2 .*\$0003\nbig .*-\n\nProposed direct page \$00: 3 variables, 5 of 256 bytes\n',
+		'^(?!.*big)',
+	'unused', '--raw', [ ' org $100', 'r lda a', ' rts', ' org $2000', 'a rmb 1', 'z rmb 1' ],
+		'z +1 +0 +0 +0  \$2001 +-\n', '^(?!.*\nz)',
+
+	# savings, including references that are direct already
+	'savings', '--raw', [ ' org $100', 'r lda a', ' ldx #3', 'l ldb b', ' leax -1,x', ' bne l', ' sta c', ' rts', ' org $2000', 'a rmb 1', 'b rmb 1', 'c rmb 2' ],
+		'Proposed direct page \$00: 3 variables, 4 of 256 bytes\nExpected savings: 3 bytes, 12 weighted cycles\n', '',
+	'savings_demoted', '--raw', [ ' setdp $30', ' org $100', 'r lda <big', ' lda s', ' rts', ' org $3000', 'big rmb 250', ' org $2000', 's rmb 10' ],
+		'big .*-\n\n.*\nExpected savings: 0 bytes, 0 weighted cycles\n', '',
+	'page', '--raw', [ ' setdp $30', ' org $100', 'r lda <d', ' lda e', ' rts', ' org $3000', 'd rmb 1', ' org $2000', 'e rmb 1' ],
+		'Proposed direct page \$30: 2 variables', '',
+
+	# the layout as source
+	'layout', '--raw', [ ' org $100', 'r lda a', ' ldx #3', 'l ldb b', ' leax -1,x', ' bne l', ' rts', ' org $2000', 'a rmb 1', 'b rmb 1' ],
+		'', "\n\tsetdp\t\\\$00\n\torg\t\\\$0000\nb\trmb\t1\t; 1 extended, 0 direct references\na\trmb\t1\t; 1 extended, 0 direct references\n\$",
+	'layout_page', '--raw', [ ' setdp $30', ' org $100', 'r lda <d', ' rts', ' org $3000', 'd rmb 1' ],
+		'', "\n\tsetdp\t\\\$30\n\torg\t\\\$3000\nd\trmb\t1\t; 0 extended, 1 direct references\n\$",
+	'layout_obj', '--obj', [ ' section code', 'r lda v', ' rts', ' section bss', 'v export', 'v rmb 2' ],
+		'v +2 +1 +0 +1  bss\+\$0000 +\$0000\n', "\n\tsection\tdp\nv\trmb\t2\t; 1 extended, 0 direct references\n\tendsection\n\$",
+);
+
+while (@tests)
+{
+	($name, $opts, $src, $expected, $explayout) = splice(@tests, 0, 5);
+
+	$tf = ".dptmp.$$";
+	open H, ">$tf.asm";
+	print H "$_\n" foreach (@$src);
+	close H;
+	unlink "$tf.rep", "$tf.lay";
+	$r = `$lwasm $opts -o $tf --dp-report=$tf.rep --dp-layout=$tf.lay $tf.asm 2>&1`;
+	local $/;
+	open H, "<$tf.rep";
+	$report = <H>;
+	close H;
+	open H, "<$tf.lay";
+	$layout = <H>;
+	close H;
+	unlink $tf, "$tf.rep", "$tf.lay", "$tf.asm";
+	if ($expected ne '' && $report !~ /$expected/)
+	{
+		$report =~ s/\n/ | /g;
+		$st = "FAIL ($report$r)";
+	}
+	elsif ($explayout ne '' && $layout !~ /$explayout/s)
+	{
+		$layout =~ s/\n/ | /g;
+		$st = "FAIL ($layout$r)";
+	}
+	else
+	{
+		$st = 'PASS';
+	}
+	print "$name $st\n";
+}
@@ -0,0 +1,125 @@
+#!/usr/bin/env perl
+#
+# these tests check that lwar keeps the members of an archive, and their
+# order, through updates, that an update never overwrites the part of the
+# archive that was in use, that LWAR1V archives can still be read, and
+# that extraction writes every member intact.
+
+require './test/testlib.pl';
+
+$d = ".artmp.$$";
+$lwarbin = "$top/lwar/lwar";
+$lwar = "cd $d && $lwarbin";
+
+sub members
+{
+	my @l = map { (split /:/)[0] } split /\n/, `$lwar -l lib.a`;
+	return join(',', @l);
+}
+
+# extract everything and compare with what the members should contain
+sub check_extract
+{
+	my (%want) = @_;
+	mkdir "$d/x";
+	system("cd $d/x && $lwarbin -x ../lib.a");
+	foreach $m (keys %want)
+	{
+		return 0 if (readfile("x/$m") ne $want{$m});
+	}
+	system("rm -rf $d/x");
+	return 1;
+}
+
+mkdir $d;
+%contents = ('m1' => "one\n" x 4, 'm2' => "two\n" x 5, 'm3' => "three\n" x 6);
+foreach $m (keys %contents)
+{
+	writefile($m, $contents{$m});
+}
+
+system("$lwar -c lib.a m1 m2 m3");
+result('create', members() eq 'm1,m2,m3' && check_extract(%contents), members());
+
+# an unchanged member leaves the archive alone
+$before = readfile('lib.a');
+system("$lwar -r lib.a m2");
+result('replace_unchanged', readfile('lib.a') eq $before, 'archive rewritten');
+
+# a member that grows keeps its place and the old data is not touched
+$contents{'m1'} = "one grew\n" x 40;
+writefile('m1', $contents{'m1'});
+system("$lwar -r lib.a m1");
+$after = readfile('lib.a');
+result('replace_order', members() eq 'm1,m2,m3', members());
+result('replace_contents', check_extract(%contents), 'wrong contents');
+result('replace_append_only', substr($after, 16, length($before) - 16) eq substr($before, 16), 'old data overwritten');
+
+# new members go at the end
+writefile('m4', "four\n");
+$contents{'m4'} = "four\n";
+system("$lwar -r lib.a m4");
+result('replace_add', members() eq 'm1,m2,m3,m4' && check_extract(%contents), members());
+
+system("$lwar --remove lib.a m2");
+delete $contents{'m2'};
+result('remove', members() eq 'm1,m3,m4' && check_extract(%contents), members());
+
+# repeated updates must not make the archive grow without limit
+for ($i = 0; $i < 20; $i++)
+{
+	$contents{'m3'} = "three v$i\n" x 30;
+	writefile('m3', $contents{'m3'});
+	system("$lwar -r lib.a m3");
+}
+$size = -s "$d/lib.a";
+$live = 0;
+$live += length($contents{$_}) foreach (keys %contents);
+result('reclaim', $size < 4 * $live && check_extract(%contents), "$size bytes for $live bytes of members");
+
+# an archive in the original format
+$v1 = 'LWAR1V';
+foreach $m ('m1', 'm3')
+{
+	$v1 .= "$m\0" . pack('N', length($contents{$m})) . $contents{$m};
+}
+$v1 .= "\0";
+writefile('lib.a', $v1);
+result('read_v1', members() eq 'm1,m3' && check_extract('m1' => $contents{'m1'}, 'm3' => $contents{'m3'}), members());
+system("$lwar -r lib.a m4");
+result('convert_v1', substr(readfile('lib.a'), 0, 6) eq 'LWAR2V' && members() eq 'm1,m3,m4' && check_extract(%contents), members());
+
+# extraction: a large member, several threads, and only the members asked
+# for
+$big = '';
+$big .= pack('N', $_ * 2654435761) for (0 .. 300000);
+writefile('big', $big);
+%many = ('big' => $big);
+for ($i = 0; $i < 24; $i++)
+{
+	$many{"n$i"} = "member $i\n" x ($i * 37);
+	writefile("n$i", $many{"n$i"});
+}
+unlink "$d/lib.a";
+system("$lwar -c lib.a big " . join(' ', map { "n$_" } (0 .. 23)));
+result('extract_big', check_extract('big' => $big), 'wrong contents');
+
+mkdir "$d/x";
+system("cd $d/x && $lwarbin -j4 -x ../lib.a");
+$ok = 1;
+foreach $m (keys %many)
+{
+	$ok = 0 if (readfile("x/$m") ne $many{$m});
+}
+system("rm -rf $d/x");
+result('extract_jobs', $ok, 'wrong contents');
+
+mkdir "$d/x";
+system("cd $d/x && $lwarbin -x ../lib.a n7 n3 nothere");
+opendir DH, "$d/x";
+@got = sort grep { !/^\./ } readdir DH;
+closedir DH;
+result('extract_named', join(',', @got) eq 'n3,n7' && readfile('x/n3') eq $many{'n3'} && readfile('x/n7') eq $many{'n7'}, join(',', @got));
+system("rm -rf $d/x");
+
+system("rm -rf $d");
@@ -0,0 +1,51 @@
+#!/usr/bin/env perl
+#
+# these tests check lwasm --batch: every job must produce the same output
+# and messages as running lwasm on it alone, the messages must come out in
+# batch file order, and a failing job must not stop the others.
+
+require './test/testlib.pl';
+
+$d = ".batchtmp.$$";
+$lwasm = "$top/lwasm/lwasm";
+
+mkdir $d;
+writefile('defs.inc', "val1\tequ \$12\nval2\tequ \$3456\n");
+for ($i = 0; $i < 6; $i++)
+{
+	writefile("j$i.asm", "\tinclude \"defs.inc\"\n\torg \$" . (1000 + $i) . "\n\tlda #val1+$i\n\tldx #val2\n\twarning job $i\n\trts\n");
+}
+writefile('bad.asm', "\tlda #300\n");
+
+# each job on its own
+$expected = '';
+for ($i = 0; $i < 6; $i++)
+{
+	$expected .= run("$lwasm --raw -o s$i.bin j$i.asm");
+	$expected .= run("$lwasm --raw -o s9.bin bad.asm") if ($i == 2);
+}
+
+open H, ">$d/jobs";
+print H "# one job per line\n";
+for ($i = 0; $i < 6; $i++)
+{
+	print H "-o b$i.bin j$i.asm\n";
+	print H "\n-o b9.bin bad.asm\n" if ($i == 2);
+}
+close H;
+$msgs = run("$lwasm --raw --batch=jobs --jobs=3");
+$status = $? >> 8;
+
+$same = 1;
+for ($i = 0; $i < 6; $i++)
+{
+	$same = 0 if (!defined(readfile("b$i.bin")) || readfile("b$i.bin") ne readfile("s$i.bin"));
+}
+result('batch_output', $same, 'output differs from separate runs');
+result('batch_messages', $msgs eq $expected, $msgs);
+result('batch_status', $status != 0, 'failing job not reported');
+
+$msgs = run("$lwasm --raw --batch=jobs --jobs=1");
+result('batch_serial', $msgs eq $expected, $msgs);
+
+system("rm -rf $d");
@@ -0,0 +1,119 @@
+#!/usr/bin/env perl
+#
+# these tests check lwasm --server and --connect: a request must produce
+# the same output, messages, and exit status as running lwasm directly,
+# a changed include file must be read again, only the user running the
+# server may use it, and a bad or stalled client cannot stop it.
+
+require './test/testlib.pl';
+use IO::Select;
+use IO::Socket::UNIX;
+
+$d = ".srvtmp.$$";
+$lwasm = "$top/lwasm/lwasm";
+# relative to $d, where both ends run, to keep well within the socket path limit
+$sock = 'sock';
+
+if ($^O eq 'MSWin32')
+{
+	print "server SKIP\n";
+	exit 0;
+}
+
+mkdir $d;
+writefile('defs.inc', "val\tequ \$12\n");
+writefile('a.asm', "\tinclude \"defs.inc\"\n\torg \$100\n\tlda #val\n\twarning here\n\trts\n");
+writefile('bad.asm', "\tldb #300\n");
+
+$pid = fork();
+if ($pid == 0)
+{
+	chdir $d;
+	open STDOUT, '>/dev/null';
+	open STDERR, '>/dev/null';
+	exec $lwasm, '--raw', "--server=$sock";
+	exit 1;
+}
+for ($i = 0; $i < 50 && ! -S "$d/$sock"; $i++)
+{
+	select(undef, undef, undef, 0.1);
+}
+if (! -S "$d/$sock")
+{
+	print "server_start FAIL (no socket)\n";
+	kill 'TERM', $pid;
+	waitpid($pid, 0);
+	system("rm -rf $d");
+	exit 0;
+}
+
+$direct = run("$lwasm --raw -o direct.bin a.asm");
+$msgs = run("$lwasm --connect=$sock -o served.bin a.asm");
+$status = $? >> 8;
+result('server_output', readfile('served.bin') eq readfile('direct.bin'), 'output differs');
+result('server_messages', $msgs eq $direct && $status == 0, $msgs);
+
+$direct = run("$lwasm --raw -o direct.bin bad.asm");
+$dstatus = $? >> 8;
+$msgs = run("$lwasm --connect=$sock -o served.bin bad.asm");
+$status = $? >> 8;
+result('server_errors', $msgs eq $direct && $status == $dstatus && $status != 0, $msgs);
+
+# make sure the modification time differs from the cached copy
+sleep 2;
+writefile('defs.inc', "val\tequ \$34\n");
+run("$lwasm --connect=$sock -o served.bin a.asm");
+result('server_include_changed', unpack('H*', readfile('served.bin')) eq '863439', unpack('H*', readfile('served.bin')));
+
+# the server gives up on a client that sends nothing and serves the next
+$c = IO::Socket::UNIX -> new(Peer => "$d/$sock");
+$start = time;
+$closed = IO::Select -> new($c) -> can_read(30) && !sysread($c, $buf, 1);
+close $c;
+unlink "$d/served.bin";
+run("$lwasm --connect=$sock -o served.bin a.asm");
+result('server_silent_client', $closed && time - $start < 30 && defined(readfile('served.bin')), 'client not dropped');
+
+$c = IO::Socket::UNIX -> new(Peer => "$d/$sock");
+print $c "1000000000\0/\0";
+$c -> shutdown(1);
+$reply = join('', <$c>);
+close $c;
+result('server_too_many', $reply =~ /^status 1\n.*Too many arguments/s, $reply);
+
+result('server_mode', ((stat("$d/$sock"))[2] & 0777) == 0600, sprintf('mode %o', (stat("$d/$sock"))[2] & 0777));
+
+# with the socket opened up, another user still gets no reply; this needs
+# root to become another user
+if ($> == 0)
+{
+	chmod 0666, "$d/$sock";
+	$cpid = fork();
+	if ($cpid == 0)
+	{
+		chdir $d;
+		$( = $) = 65534;
+		$< = $> = 65534;
+		$c = IO::Socket::UNIX -> new(Peer => $sock) or exit 2;
+		print $c "1\0/\0a.asm\0";
+		$c -> shutdown(1);
+		exit(defined(<$c>) ? 1 : 0);
+	}
+	waitpid($cpid, 0);
+	$cstatus = $? >> 8;
+	chmod 0600, "$d/$sock";
+	result('server_other_user', $cstatus == 0, $cstatus == 1 ? 'got a reply' : 'cannot connect');
+}
+else
+{
+	print "server_other_user SKIP\n";
+}
+
+kill 'TERM', $pid;
+waitpid($pid, 0);
+result('server_stop', ! -e "$d/$sock", 'socket left behind');
+
+$msgs = run("$lwasm --connect=$sock -o served.bin a.asm");
+result('server_gone', ($? >> 8) != 0 && $msgs =~ /Cannot connect/, $msgs);
+
+system("rm -rf $d");
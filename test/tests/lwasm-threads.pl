@@ -0,0 +1,115 @@
+#!/usr/bin/env perl
+#
+# these tests check that assembling with --threads produces exactly the
+# same output, listing, and messages as assembling with one thread, for
+# each output format. The source is generated and large enough to be
+# split between the threads.
+
+$lwasm = './lwasm/lwasm';
+$tf = ".thrtmp.$$";
+
+sub readfile
+{
+	my ($fn) = @_;
+	my $data;
+	open H, "<$fn" or return undef;
+	binmode H;
+	local $/;
+	$data = <H>;
+	close H;
+	return $data;
+}
+
+# a source with branches, references both ways, data, and some errors
+sub gensource
+{
+	my ($fmt, $errors) = @_;
+	my $s = '';
+	my $i;
+
+	if ($fmt eq 'obj')
+	{
+		$s .= "\tsection code\n\texport l0\n";
+	}
+	elsif ($fmt eq 'os9')
+	{
+		$s .= "\tmod eom,name,\$11,\$81,l0,256\nname\tfcs /test/\n";
+	}
+	else
+	{
+		$s .= "\torg \$1000\n";
+	}
+	for ($i = 0; $i < 3000; $i++)
+	{
+		$s .= "l$i\tlda #" . ($i & 255) . "\n";
+		$s .= "\tldx #l" . (($i * 7) % 3000) . "\n";
+		$s .= "\tbne l" . ($i > 0 ? $i - 1 : 0) . "\n" if ($i % 3 == 0);
+		$s .= "\tjsr l" . (($i + 11) % 3000) . "\n" if ($i % 5 == 0);
+		$s .= "\tleay " . ($i % 300) . ",y\n" if ($i % 4 == 0);
+		$s .= "\tfdb l$i,$i*3\n" if ($i % 7 == 0);
+		$s .= "\tlda #l$i\n" if ($errors && $i % 97 == 0);
+	}
+	if ($fmt eq 'os9')
+	{
+		$s .= "\temod\neom\tequ *\n";
+	}
+	elsif ($fmt eq 'obj')
+	{
+		$s .= "\tendsect\n";
+	}
+	else
+	{
+		$s .= "\tend l0\n";
+	}
+	return $s;
+}
+
+sub assemble
+{
+	my ($opts, $tag) = @_;
+	my $msgs = `$lwasm $opts -o $tf.$tag --list=$tf.$tag.lst $tf.asm 2>&1`;
+	my @r = ($? >> 8, $msgs, readfile("$tf.$tag"), readfile("$tf.$tag.lst"));
+	unlink "$tf.$tag", "$tf.$tag.lst";
+	return @r;
+}
+
+foreach $t ('decb', 'raw', 'obj', 'os9', 'errors')
+{
+	$fmt = ($t eq 'errors') ? 'raw' : $t;
+	open H, ">$tf.asm";
+	print H gensource($fmt, $t eq 'errors');
+	close H;
+
+	@serial = assemble("--format=$fmt", 's');
+	@threaded = assemble("--format=$fmt --threads=4", 't');
+	if ($t eq 'errors' && $serial[1] eq '')
+	{
+		$st = 'FAIL (no errors reported)';
+	}
+	elsif ($t ne 'errors' && $serial[0] != 0)
+	{
+		$st = "FAIL (assembly failed: $serial[1])";
+	}
+	elsif ($serial[0] != $threaded[0])
+	{
+		$st = "FAIL (exit status $threaded[0], expected $serial[0])";
+	}
+	elsif ($serial[1] ne $threaded[1])
+	{
+		$st = 'FAIL (messages differ)';
+	}
+	elsif ($serial[2] ne $threaded[2])
+	{
+		$st = 'FAIL (output differs)';
+	}
+	elsif ($serial[3] ne $threaded[3])
+	{
+		$st = 'FAIL (listing differs)';
+	}
+	else
+	{
+		$st = 'PASS';
+	}
+	print "threads_$t $st\n";
+	unlink "$tf.asm";
+}
@@ -0,0 +1,87 @@
+#!/usr/bin/env perl
+#
+# these tests check the lwcc object cache: a miss compiles and stores the
+# object, a hit gives the same object without compiling, a changed source
+# never hits, --cache-verify replaces a bad object, the cache is trimmed to
+# --cache-size, and parallel jobs can store into one cache.
+
+require './test/testlib.pl';
+
+$d = ".cachetmp.$$";
+$lwcc = "$top/lwcc/lwcc -B.";
+
+# read the counters from a cache's stats file
+sub stats
+{
+	my ($dir) = @_;
+	my %s = map { split / / } split /\n/, readfile("$dir/stats");
+	return %s;
+}
+
+# list the objects in a cache
+sub objects
+{
+	my ($dir) = @_;
+	return grep { /\.o$/ } split /\n/, run("find $dir -type f");
+}
+
+mkdir $d;
+mkdir "$d/bin";
+foreach $p ('lwcc/lwcc-cpp', 'lwcc/lwcc-cc', 'lwasm/lwasm', 'lwlink/lwlink')
+{
+	symlink("$top/$p", "$d/bin/" . (split /\//, $p)[1]);
+}
+for ($i = 0; $i < 6; $i++)
+{
+	writefile("s$i.c", "int f$i() { return $i; }\n");
+	run("$lwcc -c s$i.c -o ref$i.o");
+}
+
+run("$lwcc --cache-dir=c1 -c s0.c -o a.o");
+%s = stats('c1');
+result('cache_miss', $s{'misses'} == 1 && $s{'stores'} == 1 && $s{'hits'} == 0 && readfile('a.o') eq readfile('ref0.o'), join(',', %s));
+
+run("$lwcc --cache-dir=c1 -c s0.c -o b.o");
+%s = stats('c1');
+result('cache_hit', $s{'hits'} == 1 && $s{'stores'} == 1 && readfile('b.o') eq readfile('ref0.o'), join(',', %s));
+
+# same output name, different source
+writefile('s0.c', "int f0() { return 9; }\n");
+run("$lwcc -c s0.c -o ref9.o");
+run("$lwcc --cache-dir=c1 -c s0.c -o b.o");
+%s = stats('c1');
+result('cache_changed', $s{'misses'} == 2 && readfile('b.o') eq readfile('ref9.o') && readfile('b.o') ne readfile('ref0.o'), join(',', %s));
+
+# a damaged object is noticed and replaced
+@o = objects('c1');
+writefile($_, 'damaged') foreach (@o);
+$msgs = run("$lwcc --cache-dir=c1 --cache-verify -c s0.c -o c.o");
+%s = stats('c1');
+result('cache_verify', $s{'mismatches'} == 1 && $msgs =~ /does not match/ && readfile('c.o') eq readfile('ref9.o') && readfile(join('', grep { readfile($_) ne 'damaged' } @o)) eq readfile('ref9.o'), join(',', %s));
+
+# room for two objects, even after trimming to 90% of the limit
+$limit = int(length(readfile('ref1.o')) * 2.4);
+for ($i = 1; $i < 6; $i++)
+{
+	run("$lwcc --cache-dir=c2 --cache-size=$limit -c s$i.c -o e$i.o");
+}
+%s = stats('c2');
+@o = objects('c2');
+result('cache_evict', $s{'evictions'} == 3 && @o == 2 && $s{'size'} <= $limit && readfile('e5.o') eq readfile('ref5.o'), join(',', %s));
+
+run("$lwcc --cache-dir=c3 -j4 -c s1.c s2.c s3.c s4.c s5.c");
+%s = stats('c3');
+@o = objects('c3');
+@tmp = grep { !/\.o$/ && !/stats$/ } split /\n/, run("find c3 -type f");
+result('cache_jobs_store', $s{'stores'} == 5 && $s{'misses'} == 5 && @o == 5 && !@tmp, join(',', %s));
+unlink map { "$d/s$_.o" } (1 .. 5);
+run("$lwcc --cache-dir=c3 -j4 -c s1.c s2.c s3.c s4.c s5.c");
+%s = stats('c3');
+$same = 1;
+for ($i = 1; $i < 6; $i++)
+{
+	$same = 0 if (readfile("s$i.o") ne readfile("ref$i.o"));
+}
+result('cache_jobs_hit', $s{'hits'} == 5 && $same, join(',', %s));
+
+system("rm -rf $d");
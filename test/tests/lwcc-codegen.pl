@@ -0,0 +1,75 @@
+#!/usr/bin/env perl
+#
+# these tests run code generated by lwcc-cc under lwsim, for both the 6809
+# and the 6309, to check the arithmetic helper calling convention: the left
+# operand on the stack, the right operand in D, the result left in the stack
+# slot, and Y and U preserved across the call. The helpers here clobber
+# everything they are allowed to and do not commute, so an operand that ends
+# up in the wrong place or a register the code relies on across a call shows
+# up in the result.
+#
+# Each test is a name, the expression returned, and the expected value.
+# Dividing by 0 calls ___div16i, which here returns the left operand.
+
+require './test/testlib.pl';
+
+$d = ".cgtmp.$$";
+$cpp = "$top/lwcc/lwcc-cpp";
+$cc = "$top/lwcc/lwcc-cc";
+$lwasm = "$top/lwasm/lwasm";
+$lwlink = "$top/lwlink/lwlink";
+$lwsim = "$top/lwsim/lwsim";
+
+@tests = (
+	'operand_order', '(7 / 0) - (5 / 0)', 2,
+	'helper_order', '((9 / 0) - (2 / 0)) * ((3 / 0) - (1 / 0))', 1009,
+	'helper_chain', '((9 / 0) * (2 / 0)) * (3 / 0)', 2014,
+	'pressure', '((1 / 0) + (2 / 0)) - (((3 / 0) - (4 / 0)) - ((5 / 0) + ((6 / 0) - (7 / 0))))', 8,
+	'mod', '(20 / 0) % (6 / 0)', 2014,
+	'lsh', '(20 / 0) << (6 / 0)', 3014,
+	'rsh', '(20 / 0) >> (6 / 0)', 4014,
+	'compare', '((8 / 0) < (9 / 0)) - ((9 / 0) < (8 / 0))', 1,
+);
+
+# helper stubs: the result is written to the stack slot, then every
+# register a helper may clobber is overwritten
+sub helper
+{
+	my ($cpu, $name, $op, $bias) = @_;
+	my $s = "\texport $name\n$name\tpshs d\n\tldd 4,s\n\t$op ,s++\n";
+	$s .= "\taddd #$bias\n" if $bias;
+	$s .= "\tstd 2,s\n\tldx #\$dead\n\tldd #\$beef\n";
+	$s .= "\tldw #\$f00d\n" if $cpu eq '6309';
+	return "$s\trts\n";
+}
+
+mkdir $d;
+writefile('l.scr', "section .text load 1000\n");
+foreach $cpu ('6809', '6309')
+{
+	$h = "\tsection .text\n";
+	$h .= helper($cpu, '___div16i', 'subd', 0);
+	$h .= helper($cpu, '___mul16i', 'addd', 1000);
+	$h .= helper($cpu, '___mod16i', 'subd', 2000);
+	$h .= helper($cpu, '___lsh16', 'subd', 3000);
+	$h .= helper($cpu, '___rsh16', 'subd', 4000);
+	writefile('h.asm', $h);
+	run("$lwasm --" . ($cpu eq '6309' ? '6309' : '6809') . " --obj -o h.o h.asm");
+
+	@t = @tests;
+	while (@t)
+	{
+		($name, $expr, $expected) = splice(@t, 0, 3);
+		writefile('f.c', "int f() { return $expr; }\n");
+		$msgs = run("$cpp f.c | $cc -m$cpu -o f.s >/dev/null 2>&1 && $lwasm --obj -o f.o f.s && $lwlink --format=raw -s l.scr -m f.map -o f.bin f.o h.o && $lwsim " . ($cpu eq '6309' ? '-3' : '-9') . " --load=0x1000 -s f.map --run=_f,Y=0x1234,U=0x5678 f.bin");
+		if ($msgs !~ /A=\$(..) B=\$(..) .*Y=\$(....) U=\$(....) S=\$(....)/)
+		{
+			result("${name}_$cpu", 0, $msgs);
+			next;
+		}
+		$r = hex($1 . $2);
+		result("${name}_$cpu", $r == $expected && $3 eq '1234' && $4 eq '5678' && $5 eq '8000', "D=$r Y=$3 U=$4 S=$5");
+	}
+}
+
+system("rm -rf $d");
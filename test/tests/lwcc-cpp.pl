@@ -0,0 +1,89 @@
+#!/usr/bin/env perl
+#
+# these tests check the output of the lwcc preprocessor, in particular
+# that line markers are on lines of their own with the right line numbers
+# and flags, and that macro expansions appear where they are invoked.
+#
+# Each test is a set of files; the first one is preprocessed and the
+# output is compared with the expected text. $d in the expected text is
+# the directory the files are in.
+
+$cpp = './lwcc/lwcc-cpp';
+$d = ".cpptmp.$$";
+
+@tests = (
+	'macro_in_header', {
+		'u.c' => "#include \"one.h\"\nint x;\nint y = ONE + 2;\nint z;\n",
+		'one.h' => "#define ONE 1\n",
+	}, "# 1 \"$d/u.c\" 1\n\nint x;\nint y = 1 + 2;\nint z;\n",
+
+	'guarded_twice', {
+		'u.c' => "#include \"g.h\"\n#include \"g.h\"\nint a;\nint b;\n",
+		'g.h' => "#ifndef G_H\n#define G_H\nint g_count;\n#endif\n",
+	}, "# 1 \"$d/u.c\" 1\n# 1 \"$d/g.h\" 1\n\n\nint g_count;\n# 2 \"$d/u.c\" 2\n\nint a;\nint b;\n",
+
+	'nested_include', {
+		'u.c' => "#include \"a.h\"\nint c;\n",
+		'a.h' => "int a;\n#include \"b.h\"\nint a2;\n",
+		'b.h' => "int b;\n",
+	}, "# 1 \"$d/u.c\" 1\n# 1 \"$d/a.h\" 1\nint a;\n# 1 \"$d/b.h\" 1\nint b;\n# 3 \"$d/a.h\" 2\nint a2;\n# 2 \"$d/u.c\" 2\nint c;\n",
+
+	'self_reference', {
+		'u.c' => "#define foo foo\n\n\n\n\n\n\n\nfoo;\n",
+	}, "# 1 \"$d/u.c\" 1\n\n\n\n\n\n\n\n\nfoo;\n",
+
+	'multiline_call', {
+		'u.c' => "#define ADD(x, y) ((x) + (y))\nint s = ADD(1,\n  2);\nint t;\n",
+	}, "# 1 \"$d/u.c\" 1\n\nint s = ((1) + (2))\n;\nint t;\n",
+
+	# enough tokens to need several token blocks, all spelled the same
+	'many_tokens', {
+		'u.c' => "#define A x x x x x x x x x x\n#define B A A A A A A A A A A\n#define C B B B B B B B B B B\n#define D C C C C C C C C C C\nD\nend\n",
+	}, "# 1 \"$d/u.c\" 1\n\n\n\n\n" . join(' ', ('x') x 10000) . "\nend\n",
+
+	# a name stops being a macro when it is undefined
+	'undef', {
+		'u.c' => "#define M 1\n#undef M\nM\n#define M 2\nM\n#define foo bar\nfoo bar foo\n",
+	}, "# 1 \"$d/u.c\" 1\n\n\nM\n\n2\n\nbar bar bar\n",
+
+	# enough macros to make the table grow
+	'many_macros', {
+		'u.c' => join('', map { "#define M$_ $_\n" } (0 .. 299)) . "#undef M150\nM0 M150 M299\n",
+	}, "# 1 \"$d/u.c\" 1\n" . ("\n" x 301) . "0 M150 299\n",
+);
+
+mkdir $d;
+while (@tests)
+{
+	$name = shift @tests;
+	$files = shift @tests;
+	$expected = shift @tests;
+
+	@fl = ();
+	$main = undef;
+	foreach $f (sort { ($b =~ /\.c$/) <=> ($a =~ /\.c$/) } keys %$files)
+	{
+		$main = $f unless defined $main;
+		open H, ">$d/$f";
+		print H $files -> {$f};
+		close H;
+		push @fl, "$d/$f";
+	}
+	$r = `$cpp $d/$main`;
+	unlink @fl;
+	if ($? != 0)
+	{
+		$st = 'FAIL (preprocessor failed)';
+	}
+	elsif ($r ne $expected)
+	{
+		$r =~ s/\n/\\n/g;
+		$st = "FAIL ($r)";
+	}
+	else
+	{
+		$st = 'PASS';
+	}
+	print "$name $st\n";
+}
+rmdir $d;
@@ -0,0 +1,74 @@
+#!/usr/bin/env perl
+#
+# these tests check constant folding and strength reduction in lwcc-cc by
+# looking at the expression tree it keeps for "return EXPR;". Each test is
+# a name, the expression, and the expected tree with the whitespace taken
+# out. The parser has no unary minus, so negative values are written as
+# subtractions from 0.
+
+$cpp = './lwcc/lwcc-cpp';
+$cc = './lwcc/lwcc-cc';
+$tf = ".foldtmp.$$";
+
+$div = '(OPER_DIVIDE(CONST_INT "7")(CONST_INT "0"))';
+
+@tests = (
+	# folding with 16 bit wraparound
+	'fold', '3 * 4 + 1', '(CONST_INT "13")',
+	'fold_negative', '0 - 5 - 3', '(CONST_INT "-8")',
+	'wrap_add', '32767 + 1', '(CONST_INT "-32768")',
+	'wrap_mul', '256 * 256', '(CONST_INT "0")',
+	'wrap_unsigned', '65535 + 1', '(CONST_INT "0")',
+	'divide_truncates', '(0 - 7) / 2', '(CONST_INT "-3")',
+	'mod_sign', '(0 - 7) % 2', '(CONST_INT "-1")',
+
+	# shifts, including counts of 16 or more
+	'lsh_15', '1 << 15', '(CONST_INT "-32768")',
+	'lsh_16', '1 << 16', '(CONST_INT "0")',
+	'rsh_16_positive', '32767 >> 16', '(CONST_INT "0")',
+	'rsh_16_negative', '(0 - 1) >> 16', '(CONST_INT "-1")',
+	'rsh_arith', '(0 - 32768) >> 15', '(CONST_INT "-1")',
+	'shift_negative', '1 << (0 - 1)', '(OPER_LSH(CONST_INT "1")(CONST_INT "-1"))',
+
+	# what is left for run time
+	'div_zero', '7 / 0', $div,
+	'mod_zero', '7 % 0', '(OPER_MOD(CONST_INT "7")(CONST_INT "0"))',
+	'div_overflow', '(0 - 32768) / (0 - 1)', '(OPER_DIVIDE(CONST_INT "-32768")(CONST_INT "-1"))',
+
+	# reductions on values that are not constants
+	'gather', '(7 / 0) + 1 + 2', "(OPER_PLUS$div(CONST_INT \"3\"))",
+	'gather_minus', '(7 / 0) - 1 + 3', "(OPER_PLUS$div(CONST_INT \"2\"))",
+	'times_one', '(7 / 0) * 1', $div,
+	'times_pow2', '(7 / 0) * 8', "(OPER_LSH$div(CONST_INT \"3\"))",
+	'times_pow2_left', '8 * (7 / 0)', "(OPER_LSH$div(CONST_INT \"3\"))",
+	'mod_one', '(7 / 0) % 1', '(CONST_INT "0")',
+	'divide_pow2_complex', '(7 / 0) / 4', "(OPER_DIVIDE$div(CONST_INT \"4\"))",
+	'divide_pow2_simple', '70000 / 4', '(OPER_RSH(OPER_PLUS(CONST_INT "70000")(OPER_BWAND(OPER_RSH(CONST_INT "70000")(CONST_INT "15"))(CONST_INT "3")))(CONST_INT "2"))',
+
+	# conditions decided at compile time
+	'cond', '1 ? 5 : (7 / 0)', '(CONST_INT "5")',
+	'and_short', '0 && (7 / 0)', '(CONST_INT "0")',
+	'or_short', '2 || (7 / 0)', '(CONST_INT "1")',
+);
+
+while (@tests)
+{
+	($name, $expr, $expected) = splice(@tests, 0, 3);
+
+	open H, ">$tf.c";
+	print H "int f() { return $expr; }\n";
+	close H;
+	$r = `$cpp $tf.c | $cc -o $tf.s 2>/dev/null`;
+	unlink "$tf.c", "$tf.s";
+	$r =~ s/\s*\n\s*//g;
+	$r = ($r =~ /\(STMT_RETURN(.*)\)\)\)\)$/) ? $1 : $r;
+	if ($r ne $expected)
+	{
+		$st = "FAIL ($r)";
+	}
+	else
+	{
+		$st = 'PASS';
+	}
+	print "$name $st\n";
+}
@@ -0,0 +1,47 @@
+#!/usr/bin/env perl
+#
+# these tests check lwcc -j: compiling files in parallel must give the same
+# objects, messages in the same order, and the same linked program as
+# compiling them one at a time, and a failing file must fail the build.
+
+require './test/testlib.pl';
+
+$d = ".jobstmp.$$";
+$lwcc = "$top/lwcc/lwcc -B.";
+
+mkdir $d;
+mkdir "$d/bin";
+foreach $p ('lwcc/lwcc-cpp', 'lwcc/lwcc-cc', 'lwasm/lwasm', 'lwlink/lwlink')
+{
+	symlink("$top/$p", "$d/bin/" . (split /\//, $p)[1]);
+}
+# the files differ in size, so the program shows the link order
+@files = ();
+for ($i = 0; $i < 7; $i++)
+{
+	writefile("s$i.c", join('', map { "int f${i}_$_() { return $_; }\n" } (0 .. $i)));
+	push @files, "s$i.c";
+}
+@files = (@files[3 .. 6], @files[0 .. 2]);
+writefile('bad.c', "#error stop\n");
+
+$serial = run("$lwcc -c " . join(' ', @files));
+%objs = map { $_ => readfile($_) } map { s/\.c$/.o/r } @files;
+unlink map { "$d/$_" } keys %objs;
+$parallel = run("$lwcc -j3 -c " . join(' ', @files));
+$same = 1;
+foreach $o (keys %objs)
+{
+	$same = 0 if (!defined($objs{$o}) || readfile($o) ne $objs{$o});
+}
+result('jobs_objects', $same, 'objects differ');
+result('jobs_messages', $serial eq $parallel, 'messages differ');
+
+run("$lwcc -nostdlib -o serial.bin " . join(' ', @files));
+run("$lwcc -j4 -nostdlib -o parallel.bin " . join(' ', @files));
+result('jobs_link_order', defined(readfile('serial.bin')) && readfile('serial.bin') eq readfile('parallel.bin'), 'programs differ');
+
+$msgs = run("$lwcc -j3 -c s0.c bad.c s1.c");
+result('jobs_error', ($? >> 8) != 0 && $msgs =~ /\(bad\.c:1:\d+\) stop/, $msgs);
+
+system("rm -rf $d");
@@ -0,0 +1,74 @@
+#!/usr/bin/env perl
+#
+# these tests check how the lwcc preprocessor reads its input: every kind
+# of line ending, line splices, and trigraphs, and that line and column
+# numbers still count the physical lines and characters of the file. Each
+# test is a name, the preprocessor options, the source, the expected output
+# without the first line marker, and the expected error message, if any.
+
+$cpp = './lwcc/lwcc-cpp';
+$tf = ".lextmp.$$";
+
+@tests = (
+	# CR, CRLF, LF, and LFCR each end one line
+	'line_endings', '', "a __LINE__\r\nb __LINE__\r\rc __LINE__\n\rd __LINE__\n",
+		"a 1\nb 2\n\nc 4\nd 5\n", '',
+	'no_final_newline', '', "a __LINE__\nb __LINE__",
+		"a 1\nb 2\n", "(u.c:2:11) No newline at end of file",
+
+	# a splice joins lines but the lines after it keep their numbers
+	'splice', '', "int x \\\n= __LINE__;\ny __LINE__\n",
+		"int x \n= 2;\ny 3\n", '',
+	'splice_crlf', '', "int x \\\r\n= 1;\r\ny __LINE__\r\n",
+		"int x \n= 1;\ny 3\n", '',
+	'splice_define', '', "#define A 1 \\\n + 2\nA __LINE__\n",
+		"\n\n1 + 2 3\n", '',
+
+	# trigraphs are only replaced when asked for
+	'trigraphs', '--trigraphs', "??=define T 5\nT ??( ??) ??< ??> ??/\n__LINE__ ??! ??- ??' \n__LINE__\n",
+		"\n5 [ ] { } \n3 | ~ ^ \n4\n", '',
+	'trigraphs_off', '', "??=define T 5\nT\n",
+		"??=define T 5\nT\n", '',
+
+	# error positions count the characters as written
+	'column', '', "x\n#bogus\n",
+		"x\n", "(u.c:2:7) Bad preprocessor directive",
+	'column_crlf', '', "x\r\n#bogus\r\n",
+		"x\n", "(u.c:2:7) Bad preprocessor directive",
+	'column_splice', '', "x\n#bo\\\ngus\n",
+		"x\n", "(u.c:3:4) Bad preprocessor directive",
+	'column_trigraph', '--trigraphs', "  ??=bad\n",
+		" ", "(u.c:1:9) Bad preprocessor directive",
+);
+
+mkdir $tf;
+while (@tests)
+{
+	($name, $opts, $src, $expected, $experr) = splice(@tests, 0, 5);
+
+	open H, ">$tf/u.c";
+	binmode H;
+	print H $src;
+	close H;
+	$r = `cd $tf && ../$cpp $opts u.c 2>err`;
+	open H, "<$tf/err";
+	local $/;
+	$err = <H>;
+	close H;
+	$r =~ s/^# 1 "u.c" 1\n//;
+	if ($r ne $expected)
+	{
+		$r =~ s/\n/\\n/g;
+		$st = "FAIL ($r)";
+	}
+	elsif (($experr eq '' && $err ne '') || index($err, $experr) < 0)
+	{
+		$st = "FAIL ($err)";
+	}
+	else
+	{
+		$st = 'PASS';
+	}
+	print "$name $st\n";
+}
+system("rm -rf $tf");
@@ -0,0 +1,39 @@
+#!/usr/bin/env perl
+#
+# these tests check that the lwcc driver runs its stages as a pipeline:
+# no temporary files are written, the object is the same as when the
+# stages run one at a time through files, and a failing stage is named.
+
+require './test/testlib.pl';
+
+$d = ".pipetmp.$$";
+$lwcc = "$top/lwcc/lwcc -B.";
+$lwasm = "$top/lwasm/lwasm";
+
+mkdir $d;
+mkdir "$d/bin";
+mkdir "$d/tmp";
+foreach $p ('lwcc/lwcc-cpp', 'lwcc/lwcc-cc', 'lwasm/lwasm', 'lwlink/lwlink')
+{
+	symlink("$top/$p", "$d/bin/" . (split /\//, $p)[1]);
+}
+writefile('u.c', "int f() { return 13; }\nint g() { return 2; }\n");
+writefile('bad.c', "#error stop\n");
+
+run("TMPDIR=tmp $lwcc -c u.c -o u.o");
+opendir DH, "$d/tmp";
+@left = grep { !/^\./ } readdir DH;
+closedir DH;
+result('pipeline_no_temps', defined(readfile('u.o')) && !@left && ! -e "$d/u.i" && ! -e "$d/u.s", join(',', @left));
+
+mkdir "$d/st";
+run("cd st && $top/lwcc/lwcc -B.. -save-temps -c ../u.c -o u.o");
+result('pipeline_same_object', defined(readfile('st/u.o')) && readfile('st/u.o') eq readfile('u.o'), 'objects differ');
+
+$msgs = run("$lwcc -c bad.c -o bad.o");
+result('pipeline_error', ($? >> 8) != 0 && $msgs =~ /lwcc-cpp terminated with status 1/, $msgs);
+
+$msgs = run("echo ' lda #1' | $lwasm --raw -o stdin.bin -");
+result('lwasm_stdin', unpack('H*', readfile('stdin.bin')) eq '8601', $msgs);
+
+system("rm -rf $d");
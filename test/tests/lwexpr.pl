@@ -0,0 +1,222 @@
+#!/usr/bin/env perl
+#
+# these tests check the lw_expr evaluation contexts: that each context keeps
+# its own handlers and settings, that it allocates only through its own
+# allocator, and that separate contexts can be used from several threads at
+# once. They build a small program against lwlib, which prints its own
+# results; they are skipped if it can't be built.
+
+require './test/testlib.pl';
+
+$d = ".exprtmp.$$";
+$cc = $ENV{'CC'} || 'cc';
+
+$prog = <<'EOF';
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include <lw_expr.h>
+
+struct priv
+{
+	lw_expr_ctx_t *ctx;
+	int x;						// value of the variable x
+	int special;				// value of the special $
+	int divzeros;
+};
+
+static void result(char *name, int ok)
+{
+	printf("%s %s\n", name, ok ? "PASS" : "FAIL");
+}
+
+// numbers, the variable x, and the special $
+static lw_expr_t term(char **p, void *priv)
+{
+	struct priv *pv = priv;
+	int v = 0;
+
+	if (**p == 'x')
+	{
+		(*p)++;
+		return lw_expr_build_ctx(pv -> ctx, lw_expr_type_var, "x");
+	}
+	if (**p == '$')
+	{
+		(*p)++;
+		return lw_expr_build_ctx(pv -> ctx, lw_expr_type_special, 1, (char *)pv);
+	}
+	if (**p < '0' || **p > '9')
+		return NULL;
+	while (**p >= '0' && **p <= '9')
+		v = v * 10 + *(*p)++ - '0';
+	return lw_expr_build_ctx(pv -> ctx, lw_expr_type_int, v);
+}
+
+static lw_expr_t var(char *name, void *priv)
+{
+	struct priv *pv = priv;
+
+	if (strcmp(name, "x"))
+		return NULL;
+	return lw_expr_build_ctx(pv -> ctx, lw_expr_type_int, pv -> x);
+}
+
+static lw_expr_t special(int t, void *ptr, void *priv)
+{
+	struct priv *pv = priv;
+
+	return lw_expr_build_ctx(pv -> ctx, lw_expr_type_int, ((struct priv *)ptr) -> special);
+}
+
+static void divzero(void *priv)
+{
+	((struct priv *)priv) -> divzeros++;
+}
+
+static void setup(struct priv *pv, int x)
+{
+	memset(pv, 0, sizeof(struct priv));
+	pv -> ctx = lw_expr_ctx_create();
+	pv -> x = x;
+	lw_expr_ctx_set_term_parser(pv -> ctx, term);
+	lw_expr_ctx_set_var_handler(pv -> ctx, var);
+	lw_expr_ctx_set_special_handler(pv -> ctx, special);
+	lw_expr_ctx_setdivzero(pv -> ctx, divzero);
+}
+
+// parse and simplify s; the value if it is a constant, or -99999 if not
+static int eval(struct priv *pv, char *s)
+{
+	lw_expr_t e;
+	int v = -99999;
+
+	e = lw_expr_parse_ctx(pv -> ctx, &s, pv);
+	if (!e)
+		return v;
+	lw_expr_simplify_ctx(pv -> ctx, e, pv);
+	if (lw_expr_istype(e, lw_expr_type_int))
+		v = lw_expr_intval(e);
+	lw_expr_destroy_ctx(pv -> ctx, e);
+	return v;
+}
+
+static int nalloc;
+
+static void *count_alloc(int size)
+{
+	nalloc++;
+	return malloc(size);
+}
+
+static void *count_realloc(void *ptr, int size)
+{
+	if (!ptr)
+		nalloc++;
+	return realloc(ptr, size);
+}
+
+static void count_free(void *ptr)
+{
+	if (ptr)
+		nalloc--;
+	free(ptr);
+}
+
+static void *thread(void *arg)
+{
+	struct priv pv;
+	int i, bad = 0;
+
+	setup(&pv, (int)(long)arg);
+	for (i = 0; i < 20000; i++)
+	{
+		if (eval(&pv, "x*3+(x-1)*2") != pv.x * 5 - 2)
+			bad++;
+	}
+	lw_expr_ctx_destroy(pv.ctx);
+	return (void *)(long)bad;
+}
+
+int main(void)
+{
+	struct priv a, b;
+	lw_expr_t e, c;
+	char *s;
+	pthread_t th[4];
+	void *r;
+	int i, bad;
+
+	// each context has its own variables and specials
+	setup(&a, 5);
+	setup(&b, 7);
+	a.special = 100;
+	b.special = 200;
+	result("ctx_var", eval(&a, "x*2+1") == 11 && eval(&b, "x*2+1") == 15);
+	result("ctx_special", eval(&a, "$+x") == 105 && eval(&b, "$+x") == 207);
+
+	// a copy is independent of the original
+	s = "x+3*2";
+	e = lw_expr_parse_ctx(a.ctx, &s, &a);
+	c = lw_expr_copy_ctx(a.ctx, e);
+	lw_expr_simplify_ctx(a.ctx, c, &a);
+	result("ctx_copy", lw_expr_istype(c, lw_expr_type_int) && lw_expr_intval(c) == 11 && strcmp(lw_expr_print_ctx(a.ctx, e), "V(x) 0x3 0x2 [2]* [2]+ ") == 0);
+	lw_expr_destroy_ctx(a.ctx, c);
+	lw_expr_destroy_ctx(a.ctx, e);
+
+	// the width only applies to its own context
+	lw_expr_ctx_setwidth(b.ctx, 8);
+	result("ctx_width", eval(&a, "~1") == -2 && eval(&b, "~1") == 254);
+
+	// division by zero is reported to the right context
+	eval(&b, "5/0");
+	eval(&b, "5%(x-7)");
+	result("ctx_divzero", a.divzeros == 0 && b.divzeros == 2);
+	lw_expr_ctx_destroy(a.ctx);
+	lw_expr_ctx_destroy(b.ctx);
+
+	// everything a context allocates goes through its allocator and is
+	// freed by the time the context is destroyed
+	memset(&a, 0, sizeof(a));
+	a.ctx = lw_expr_ctx_create();
+	lw_expr_ctx_set_allocator(a.ctx, count_alloc, count_realloc, count_free);
+	lw_expr_ctx_set_term_parser(a.ctx, term);
+	lw_expr_ctx_set_var_handler(a.ctx, var);
+	a.x = 3;
+	bad = eval(&a, "x*(x+1)") != 12;
+	s = "x+1";
+	e = lw_expr_parse_ctx(a.ctx, &s, &a);
+	lw_expr_print_ctx(a.ctx, e);
+	bad |= nalloc == 0;
+	lw_expr_destroy_ctx(a.ctx, e);
+	lw_expr_ctx_destroy(a.ctx);
+	result("ctx_allocator", !bad && nalloc == 0);
+
+	// several threads, each with its own context
+	for (i = 0; i < 4; i++)
+		pthread_create(&th[i], NULL, thread, (void *)(long)(i + 2));
+	bad = 0;
+	for (i = 0; i < 4; i++)
+	{
+		pthread_join(th[i], &r);
+		bad += (int)(long)r;
+	}
+	result("ctx_threads", bad == 0);
+	return 0;
+}
+EOF
+
+mkdir $d;
+writefile('t.c', $prog);
+run("$cc -I$top/lwlib -o t t.c $top/lwlib/liblw.a -lpthread");
+if ($? != 0)
+{
+	print "lw_expr_ctx SKIP\n";
+}
+else
+{
+	print run('./t');
+}
+system("rm -rf $d");
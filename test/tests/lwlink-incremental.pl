@@ -0,0 +1,53 @@
+#!/usr/bin/env perl
+#
+# these tests check lwlink --incremental: a relink after a change must
+# produce the same output as a full link, patching only the changed file
+# when its layout is unchanged and falling back to a full link otherwise.
+
+require './test/testlib.pl';
+
+$d = ".incrtmp.$$";
+$lwasm = "$top/lwasm/lwasm";
+$lwlink = "$top/lwlink/lwlink";
+
+sub assemble
+{
+	my ($fn, $src) = @_;
+	writefile("$fn.asm", $src);
+	run("$lwasm --obj -o $fn.o $fn.asm");
+}
+
+# link incrementally and in full; returns the debug messages and whether
+# the outputs match
+sub relink
+{
+	my ($fmt) = @_;
+	my $msgs = run("$lwlink -d --incremental --format=$fmt -o out a.o b.o c.o");
+	run("$lwlink --format=$fmt -o full a.o b.o c.o");
+	my $out = readfile('out');
+	return ($msgs, defined($out) && $out eq readfile('full'));
+}
+
+mkdir $d;
+assemble('a', "\tsection code\n\texport start\n\textern fb\n\textern fc\nstart\tlbsr fb\n\tlbsr fc\n\trts\n");
+assemble('b', "\tsection code\n\texport fb\nfb\tlda #1\n\trts\n");
+assemble('c', "\tsection code\n\texport fc\nfc\tldb #2\n\trts\n\tsection data\n\texport dv\n\textern start\ndv\tfdb start\n");
+
+($msgs, $same) = relink('decb');
+result('incremental_first', $same && -e "$d/out.lwlc", 'output differs or no cache');
+
+assemble('b', "\tsection code\n\texport fb\nfb\tlda #9\n\trts\n");
+($msgs, $same) = relink('decb');
+result('incremental_patch', $same && $msgs =~ /Relinking changed file b\.o/ && $msgs !~ /full link/, $msgs);
+
+($msgs, $same) = relink('decb');
+result('incremental_unchanged', $same && $msgs =~ /Incremental link: 0 changed/, $msgs);
+
+assemble('b', "\tsection code\n\texport fb\nfb\tlda #9\n\tnop\n\trts\n");
+($msgs, $same) = relink('decb');
+result('incremental_layout', $same && $msgs =~ /full link/, $msgs);
+
+($msgs, $same) = relink('raw');
+result('incremental_format', $same && $msgs =~ /format changed; doing a full link/, $msgs);
+
+system("rm -rf $d");
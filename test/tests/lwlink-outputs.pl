@@ -0,0 +1,35 @@
+#!/usr/bin/env perl
+#
+# these tests check that each extra output requested with --format=TYPE:FILE
+# is the same as linking to that format alone, and that the main output is
+# unchanged by the extra ones. The sections are laid out by the main format,
+# so every link uses the same script.
+
+require './test/testlib.pl';
+
+$d = ".outtmp.$$";
+$lwasm = "$top/lwasm/lwasm";
+$lwlink = "$top/lwlink/lwlink";
+
+mkdir $d;
+writefile('a.asm', "\tsection code\n\texport start\n\textern fb\nstart\tlbsr fb\n\trts\n\tsection data\n\texport dv\ndv\tfdb start\n");
+writefile('link.scr', "section code load 2000\nsection data\nentry start\n");
+writefile('b.asm', "\tsection code\n\texport fb\nfb\tlda #1\n\trts\n");
+run("$lwasm --obj -o a.o a.asm");
+run("$lwasm --obj -o b.o b.asm");
+
+foreach $f ('decb', 'raw', 'srec', 'ihex')
+{
+	run("$lwlink --script=link.scr --format=$f -o s.$f a.o b.o");
+}
+
+$msgs = run("$lwlink --script=link.scr --format=decb --format=raw:m.raw --format=srec:m.srec --format=ihex:m.ihex -o m.decb a.o b.o");
+result('outputs_status', ($? >> 8) == 0, $msgs);
+foreach $f ('decb', 'raw', 'srec', 'ihex')
+{
+	$s = readfile("s.$f");
+	$m = readfile("m.$f");
+	result("outputs_$f", defined($s) && defined($m) && $s eq $m, 'output differs from a separate link');
+}
+
+system("rm -rf $d");
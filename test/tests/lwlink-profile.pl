@@ -0,0 +1,32 @@
+#!/usr/bin/env perl
+#
+# these tests check profile guided section ordering in lwlink: the most
+# used section is placed first, and the savings in the report are weighted
+# by how often the referencing code runs, not by the uses of its target.
+
+require './test/testlib.pl';
+
+$d = ".proftmp.$$";
+$lwasm = "$top/lwasm/lwasm";
+$lwlink = "$top/lwlink/lwlink";
+
+mkdir $d;
+writefile('a.asm', "\tsection code\n\texport start\nstart\tlbsr sub\n\trts\n");
+writefile('b.asm', "\tsection code\n\texport sub\nsub\trts\n");
+writefile('prof', "# symbol count\nsub 1000\nstart 10\n");
+run("$lwasm --obj --pragma=undefextern -o a.o a.asm && $lwasm --obj -o b.o b.asm");
+
+$r = run("$lwlink --format=raw --profile=prof -o out a.o b.o");
+$out = unpack('H*', readfile('out'));
+
+result('hot_first', $out eq '3917fffc39', $out);
+result('found', $r =~ /2 of 2 symbols found/, $r);
+# one lbsr in start, which ran 10 times, saving 2 cycles each time
+result('branch_savings', $r =~ /save 1 bytes and about 20 cycles/, $r);
+
+# the same link without a profile keeps the command line order
+run("$lwlink --format=raw -o out a.o b.o");
+$out = unpack('H*', readfile('out'));
+result('no_profile', $out eq '1700013939', $out);
+
+system("rm -rf $d");
@@ -0,0 +1,53 @@
+#!/usr/bin/env perl
+#
+# these tests check the order and addresses lwlink gives sections for
+# various link scripts: named lines take every instance of the name in
+# command line order, library members after the files before them, and
+# wildcard lines take what is left in the order the files define it. Each
+# test is a name, the link script, and the expected sections as
+# name(file)@address.
+
+require './test/testlib.pl';
+
+$d = ".secttmp.$$";
+$lwasm = "$top/lwasm/lwasm";
+$lwlink = "$top/lwlink/lwlink";
+$lwar = "$top/lwar/lwar";
+
+@tests = (
+	'named_wildcard', "section code load 1000\nsection data\nsection *,!bss\nsection bss,bss load 3000\n",
+		'code(a.o)@1000 code(b.o)@1004 code(c.o)@1005 code(d.o)@1006 data(a.o)@1007 data(b.o)@1008 data(c.o)@1009 xtra(b.o)@100A bss(a.o)@3000',
+	'high', "section data high 2000\nsection code\nsection *\n",
+		'data(a.o)@1FFF data(b.o)@1FFE data(c.o)@1FFD code(a.o)@1FF9 code(b.o)@1FF8 code(c.o)@1FF7 code(d.o)@1FF6 bss(a.o)@1FF4 xtra(b.o)@1FF3',
+	'wildcard_only', "section * load 100\n",
+		'bss(a.o)@0100 data(a.o)@0102 data(b.o)@0103 data(c.o)@0104 code(a.o)@0105 code(b.o)@0109 code(c.o)@010A code(d.o)@010B xtra(b.o)@010C',
+	'flags', "section xtra load 500\nsection *,bss load 600\nsection *,!bss\n",
+		'xtra(b.o)@0500 bss(a.o)@0600 data(a.o)@0602 data(b.o)@0603 data(c.o)@0604 code(a.o)@0605 code(b.o)@0609 code(c.o)@060A code(d.o)@060B',
+	# a section named twice is only placed by the first line
+	'named_twice', "section code load 1000\nsection data\nsection code\nsection *\n",
+		'code(a.o)@1000 code(b.o)@1004 code(c.o)@1005 code(d.o)@1006 data(a.o)@1007 data(b.o)@1008 data(c.o)@1009 bss(a.o)@100A xtra(b.o)@100C',
+);
+
+mkdir $d;
+writefile('a.asm', "\tsection code\n\texport start\n\textern lc\nstart\tlbsr lc\n\trts\n\tsection data\nad\tfcb 1\n\tsection bss,bss\nab\trmb 2\n");
+writefile('b.asm', "\tsection data\nbd\tfcb 2\n\tsection code\nbc\trts\n\tsection xtra\nbx\tfcb 3\n");
+writefile('c.asm', "\tsection code\n\texport lc\nlc\trts\n\tsection data\ncd\tfcb 4\n");
+writefile('d.asm', "\tsection code\nunused\trts\n");
+foreach $f ('a', 'b', 'c', 'd')
+{
+	run("$lwasm --obj -o $f.o $f.asm");
+}
+run("$lwar -c lib.a c.o d.o");
+
+while (@tests)
+{
+	($name, $script, $expected) = splice(@tests, 0, 3);
+
+	writefile('link.scr', $script);
+	unlink "$d/out.map";
+	run("$lwlink --format=raw --script=link.scr --map=out.map -o out a.o b.o lib.a");
+	$r = join(' ', map { /^Section: (\S+) (\(\S+\)) load at (\S+),/ ? "$1$2\@$3" : () } split(/\n/, readfile('out.map')));
+	result($name, $r eq $expected, $r);
+}
+
+system("rm -rf $d");
@@ -0,0 +1,44 @@
+#!/usr/bin/env perl
+#
+# these tests check lwsim: cycle and instruction counts for both CPUs, each
+# input format, register, poke, and peek handling, and the failure cases.
+
+require './test/testlib.pl';
+
+$d = ".simtmp.$$";
+$lwasm = "$top/lwasm/lwasm";
+$lwsim = "$top/lwsim/lwsim";
+
+mkdir $d;
+writefile('m.asm', "\torg \$1000\nmul10\tlslb\n\tpshs b\n\tlslb\n\tlslb\n\taddb ,s+\n\trts\nloop\tldx #10\nl1\tleax -1,x\n\tbne l1\n\trts\nbad\tfcb \$01\n");
+writefile('p.asm', "\torg \$1000\nst\tlda \$2000\n\tinca\n\tsta \$2001\n\trts\n");
+run("$lwasm --raw -o m.bin --symbol-dump=m.sym m.asm");
+run("$lwasm --decb -o m.dec m.asm");
+run("$lwasm --format=srec -o m.s19 m.asm");
+run("$lwasm --decb -o p.dec p.asm");
+
+$out = run("$lwsim -9 -b --load=0x1000 -s m.sym --run=mul10,B=3 --run=loop m.bin");
+result('sim_6809', ($? >> 8) == 0 && $out eq "mul10: 23 cycles, 6 instructions\nloop: 88 cycles, 22 instructions\n", $out);
+
+$out = run("$lwsim -3 -b --load=0x1000 -s m.sym --run=mul10,B=3 --run=loop m.bin");
+result('sim_6309', $out =~ /^mul10: 17 cycles, 6 instructions\n/, $out);
+
+$out = run("$lwsim -9 -b -s m.sym --run=mul10,B=3 m.dec");
+result('sim_decb', $out eq "mul10: 23 cycles, 6 instructions\n", $out);
+
+$out = run("$lwsim -9 -b -s m.sym --run=mul10,B=3 m.s19");
+result('sim_srec', $out eq "mul10: 23 cycles, 6 instructions\n", $out);
+
+$out = run("$lwsim -9 --load=0x1000 -s m.sym --run=mul10,B=3 m.bin");
+result('sim_registers', $out =~ /registers: A=\$00 B=\$1E /, $out);
+
+$out = run("$lwsim -b --poke=0x2000=0x41 --peek=0x2000,2 --run=0x1000 p.dec");
+result('sim_poke_peek', $out =~ /\(\$2000\): 41 42\n/, $out);
+
+$out = run("$lwsim -9 -b --load=0x1000 -s m.sym --run=bad m.bin");
+result('sim_illegal', ($? >> 8) != 0 && $out =~ /illegal instruction at \$1010/, $out);
+
+$out = run("$lwsim -9 -b --max-cycles=10 --load=0x1000 -s m.sym --run=loop m.bin");
+result('sim_max_cycles', ($? >> 8) != 0 && $out =~ /cycle limit exceeded/, $out);
+
+system("rm -rf $d");
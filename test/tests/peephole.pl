@@ -0,0 +1,83 @@
+#!/usr/bin/env perl
+#
+# these tests check each peephole rule: the code it should rewrite, and
+# code that looks similar but must be left alone. Each test is a name, the
+# lwasm options, the source lines (instructions start with a space, so a
+# line without one has a label), and the expected output in hex.
+
+$lwasm = './lwasm/lwasm';
+
+@tests = (
+	# call-return
+	'callret_jsr', '--peephole', [ ' jsr $1234', ' rts' ], '7e1234',
+	'callret_bsr', '--peephole', [ ' bsr t', ' rts', 't nop' ], '200012',
+	'callret_lbsr', '--peephole', [ ' lbsr t', ' rts', 't nop' ], '16000012',
+	'callret_label', '--peephole', [ ' jsr $1234', 'x rts' ], 'bd123439',
+	'callret_off', '', [ ' jsr $1234', ' rts' ], 'bd123439',
+
+	# tfr-self
+	'tfrself_tfr', '--peephole', [ ' tfr a,a', ' nop' ], '12',
+	'tfrself_exg', '--peephole', [ ' exg x,x', ' nop' ], '12',
+	'tfrself_pc', '--peephole', [ ' tfr pc,pc' ], '1f55',
+
+	# tfr-repeat
+	'tfrrepeat_same', '--peephole', [ ' tfr x,y', ' tfr x,y' ], '1f12',
+	'tfrrepeat_reverse', '--peephole', [ ' tfr x,y', ' tfr y,x' ], '1f12',
+	'tfrrepeat_cc', '--peephole', [ ' tfr a,cc', ' tfr cc,a' ], '1f8a1fa8',
+	'tfrrepeat_other', '--peephole', [ ' tfr x,y', ' tfr x,u' ], '1f121f13',
+
+	# push-pull
+	'pushpull_s', '--peephole', [ ' pshs a,b', ' puls a,b', ' nop' ], '12',
+	'pushpull_u', '--peephole', [ ' pshu x', ' pulu x', ' nop' ], '12',
+	'pushpull_pc', '--peephole', [ ' pshs pc', ' puls pc' ], '34803580',
+	'pushpull_stacks', '--peephole', [ ' pshs x', ' pulu x' ], '34103710',
+
+	# push-pull-tfr
+	'pushtfr_16', '--peephole', [ ' pshs x', ' puls y' ], '1f12',
+	'pushtfr_8', '--peephole', [ ' pshs a', ' puls b' ], '1f89',
+	'pushtfr_size', '--peephole', [ ' pshs a', ' puls x' ], '34023510',
+
+	# load-zero
+	'loadzero_a', '--peephole', [ ' lda #0', ' lsla' ], '4f48',
+	'loadzero_b', '--peephole', [ ' ldb #0', ' mul' ], '5f3d',
+	'loadzero_keepc', '--peephole', [ ' lda #0', ' inca' ], '86004c',
+	'loadzero_nonzero', '--peephole', [ ' lda #1', ' lsla' ], '860148',
+	'loadzero_d', '--peephole', [ ' ldd #0', ' mul' ], '104f3d',
+	'loadzero_d6809', '--peephole --6809', [ ' ldd #0', ' mul' ], 'cc00003d',
+
+	# clr-pair
+	'clrpair_ef', '--peephole', [ ' clre', ' clrf' ], '105f',
+	'clrpair_fe', '--peephole', [ ' clrf', ' clre' ], '105f',
+	'clrpair_label', '--peephole', [ ' clre', 'x clrf' ], '114f115f',
+
+	# a removed instruction moves the lines after it
+	'readdress', '--peephole', [ ' jsr $1234', ' rts', ' ldx #t', 't nop' ], '7e12348e000612',
+);
+
+while (@tests)
+{
+	($name, $opts, $src, $expected) = splice(@tests, 0, 4);
+
+	$tf = ".peeptmp.$$";
+	open H, ">$tf.asm";
+	print H "$_\n" foreach (@$src);
+	close H;
+	$r = `$lwasm --raw $opts -o $tf $tf.asm 2>&1`;
+	open H, "<$tf";
+	binmode H;
+	$buffer = '';
+	read(H, $buffer, 64);
+	close H;
+	unlink $tf;
+	unlink "$tf.asm";
+	$buffer = unpack('H*', $buffer);
+	if ($buffer ne $expected)
+	{
+		$st = "FAIL ($buffer, expected $expected)";
+	}
+	else
+	{
+		$st = 'PASS';
+	}
+	print "$name $st\n";
+}
@@ -0,0 +1,62 @@
+#!/usr/bin/env perl
+#
+# these tests check the sizes given to forward referenced operands: each
+# should get the smallest form its final value allows. Each test is a name,
+# the lwasm options, the source lines (instructions start with a space),
+# and the expected output in hex.
+
+$lwasm = './lwasm/lwasm';
+
+@tests = (
+	# direct/extended
+	'direct', '', [ ' lda t', 't equ $10' ], '9610',
+	'extended', '', [ ' lda t', 't equ $1234' ], 'b61234',
+	'direct_setdp', '', [ ' setdp $12', ' lda t', 't equ $1234' ], '9634',
+
+	# indexed offsets
+	'indexed_none', '', [ ' lda t,x', 't equ 0' ], 'a684',
+	'indexed_5bit', '', [ ' lda t,x', 't equ 5' ], 'a605',
+	'indexed_5bit_neg', '', [ ' ldx t,y', 't equ -16' ], 'ae30',
+	'indexed_8bit', '', [ ' lda t,x', 't equ 100' ], 'a68864',
+	'indexed_16bit', '', [ ' lda t,x', 't equ 1000' ], 'a68903e8',
+	'indexed_pcr', '', [ ' lda t,pcr', ' nop', 't nop' ], 'a68c011212',
+
+	# branches, with automatic length selection
+	'branch_short', '--pragma=autobranchlength', [ ' bra t', ' zmb 10', 't nop' ], '200a' . ('00' x 10) . '12',
+	'branch_long', '--pragma=autobranchlength', [ ' bra t', ' zmb 200', 't nop' ], '1600c8' . ('00' x 200) . '12',
+	# the branch only fits once the operand between is sized too
+	'branch_depends', '--pragma=autobranchlength', [ ' bra t', ' lda u', ' zmb 124', 't nop', 'u equ $1234' ], '207fb61234' . ('00' x 124) . '12',
+	'branch_grows', '--pragma=autobranchlength', [ ' bra t', ' lda u', ' zmb 125', 't nop', 'u equ $1234' ], '160080b61234' . ('00' x 125) . '12',
+
+	# the old behaviours
+	'nospansize', '--pragma=nospansize', [ ' lda t', 't equ $10' ], 'b60010',
+	'noforwardrefmax', '--pragma=noforwardrefmax', [ ' lda t', 't equ $10' ], '9610',
+);
+
+while (@tests)
+{
+	($name, $opts, $src, $expected) = splice(@tests, 0, 4);
+
+	$tf = ".spantmp.$$";
+	open H, ">$tf.asm";
+	print H "$_\n" foreach (@$src);
+	close H;
+	$r = `$lwasm --raw $opts -o $tf $tf.asm 2>&1`;
+	open H, "<$tf";
+	binmode H;
+	$buffer = '';
+	read(H, $buffer, 1024);
+	close H;
+	unlink $tf;
+	unlink "$tf.asm";
+	$buffer = unpack('H*', $buffer);
+	if ($buffer ne $expected)
+	{
+		$st = "FAIL ($buffer, expected $expected)";
+	}
+	else
+	{
+		$st = 'PASS';
+	}
+	print "$name $st\n";
+}